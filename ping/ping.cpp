@@ -4,10 +4,13 @@
 
 #include "ping.h"
 
+#include <skstream/skchecksum.h>
+
 #include <iostream>
 #include <string>
-#include <map>
-#include <utility>
+#include <vector>
+#include <deque>
+#include <algorithm>
 
 #include <cstdio>
 #include <cstdlib>
@@ -18,6 +21,8 @@
 
 #ifndef _WIN32
 #include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <netdb.h>
 #include <errno.h>
@@ -26,121 +31,236 @@
 
 //---------------------------------------------------------------------------
 // globals
-typedef std::map<std::string,std::pair<unsigned, unsigned> > stat_type;
-stat_type statistics;
-unsigned Ping_Count, transmitted_packets;
-bool Terminate;
-namespace FreeSockets {
-  static const int echo = 7;
+// Replies are matched to requests by sequence number, which is unique
+// among requests in flight on the socket.
+struct host_state {
+  std::string name;
+  std::string address;
+  sockaddr_storage peer;
+  SOCKLEN peer_size;
+  unsigned to_send;
+  long long next_send;
+  unsigned transmitted;
+  unsigned received;
+  long long rtt_min, rtt_max, rtt_total;
+};
+struct request_state {
+  bool waiting;
+  unsigned host;
+  long long sent_at;
 };
+std::vector<host_state> hosts;
+std::vector<request_state> requests(0x10000);
+std::deque<unsigned short> request_order;
+unsigned Ping_Count, Window, outstanding;
+long long Interval, Timeout;
+unsigned short Ident, Next_Seq;
+bool Terminate, Quiet;
 //---------------------------------------------------------------------------
 // Prototypes
-unsigned short in_cksum(unsigned short*, int);
-void ping(const std::string&);
-void send_request(raw_socket_stream&, const std::string&);
-bool recv_reply(raw_socket_stream&, ECHO_REPLY&);
-void print_statistics(const ECHO_REPLY&);
+long long monotonic_usec();
+bool ping(const std::vector<std::string>&);
+bool send_request(raw_socket_stream&, unsigned);
+void recv_replies(raw_socket_stream&);
+void expire_requests(long long);
 void print_final_statistics();
 bool is_broadcast_address();
+void usage();
 //---------------------------------------------------------------------------
 // signal handler
 void CTLRC(int);
 //---------------------------------------------------------------------------
 int main(int argc, char** argv) {
   Ping_Count = 4;
-  std::string host("");
-
-  if (argc < 2) {
-    std::cerr << "Usage: ping [-n NUM] host" << std::endl;
-    return 1;
-  }
+  Window = 64;
+  Interval = 1000000;
+  Timeout = 3000000;
+  Quiet = false;
+  std::vector<std::string> names;
 
   Terminate = false;
 
-  transmitted_packets=0;
-
   for(int i=1; i < argc; i++) {
-    if(std::string(argv[i]).compare("-n")==0) {
+    std::string arg(argv[i]);
+    if(arg == "-q") {
+      Quiet = true;
+    } else if(arg == "-n" || arg == "-w" || arg == "-i" || arg == "-W") {
       if(i == argc-1) {
-        std::cerr << "Usage: ping [-n NUM] host" << std::endl;
+        usage();
         return 1;
       }
       i++;
-      char **error = NULL;
-      Ping_Count = strtoul(argv[i],error,0);
-      if((Ping_Count==0)||(error != NULL)) {
-        std::cerr << "Usage: ping [-n NUM] host" << std::endl;
+      char *end = NULL;
+      unsigned long value = strtoul(argv[i],&end,0);
+      if(value == 0 || *end != '\0') {
+        usage();
         return 1;
       }
+      if(arg == "-n") {
+        Ping_Count = value;
+      } else if(arg == "-w") {
+        Window = std::min(value, 0x8000ul);
+      } else if(arg == "-i") {
+        Interval = value * 1000;
+      } else {
+        Timeout = value * 1000;
+      }
     } else {
-      host.assign(argv[i]);
+      names.push_back(arg);
     }
   }
-  if(host.size() == 0){
-    std::cerr << "Usage: ping [-n NUM] host" << std::endl;
+  if(names.empty()){
+    usage();
     return 1;
   }
 
   // register SIGINT handler
   signal(SIGINT, CTLRC);
 
-  #ifdef __BORLANDC__
-    #define CLOCKS_DIV 1.0/(CLK_TCK*1.0)
-  #else
-    #define CLOCKS_DIV 1.0/(CLOCKS_PER_SEC*1.0)
-  #endif
-  std::cout << "Time resolution: " << CLOCKS_DIV*1000.0 << " msec." << std::endl;
-
-  ping(host);
-
-  return 0;
+  return ping(names) ? 0 : 1;
 }
 //---------------------------------------------------------------------------
-void ping(const std::string& host) {
-  raw_socket_stream ping_socket(FreeSockets::proto_ICMP);
-  if(!ping_socket) {
-    std::cerr << "Could not create raw socket." << std::endl;
-    exit(0);
+void usage() {
+  std::cerr << "Usage: ping [-q] [-n NUM] [-w WINDOW] [-i MSEC] [-W MSEC] "
+               "host..." << std::endl;
+}
+//---------------------------------------------------------------------------
+long long monotonic_usec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+//---------------------------------------------------------------------------
+// Ping every host Ping_Count times, with up to Window requests in flight
+// at once on one socket. Returns true if every host replied.
+bool ping(const std::vector<std::string>& names) {
+  // An unprivileged ICMP socket where the system allows it, otherwise a
+  // raw socket, which needs root.
+  raw_socket_stream ping_socket(FreeSockets::proto_ICMP, SOCK_DGRAM);
+  if(!ping_socket.is_open()) {
+    ping_socket.setProtocol(FreeSockets::proto_ICMP, SOCK_RAW);
+  }
+  if(!ping_socket.is_open()) {
+    std::cerr << "Could not create ICMP socket: "
+              << strerror(ping_socket.getLastError()) << std::endl;
+    exit(1);
   }
 
   if(is_broadcast_address()) {
     if(!ping_socket.setBroadcast(true)) {
       std::cerr << "Could not set broadcast socket." << std::endl;
-      exit(0);
+      exit(1);
     }
   }
 
-  ping_socket.setTarget(host,FreeSockets::echo);
+  // Replies are read until the socket would block.
+  int flags = ::fcntl(ping_socket.getSocket(), F_GETFL);
+  ::fcntl(ping_socket.getSocket(), F_SETFL, flags | O_NONBLOCK);
+
+  Ident = getpid() & 0xffff;
+  Next_Seq = 0;
+  outstanding = 0;
 
-  ECHO_REPLY reply;
-  for(unsigned i=0; i < Ping_Count; i++) {
-    send_request(ping_socket,host);
-    transmitted_packets++;
-    if(recv_reply(ping_socket,reply))
-      print_statistics(reply);
+  for(std::size_t i = 0; i < names.size(); ++i) {
+    if(!ping_socket.setTarget(names[i])) {
+      std::cerr << "Unknown host " << names[i] << std::endl;
+      continue;
+    }
+    host_state host;
+    host.name = names[i];
+    host.peer = ping_socket.getOutpeer();
+    host.peer_size = ping_socket.getOutpeerSize();
+    char hbuf[NI_MAXHOST];
+    if (::getnameinfo((const sockaddr*)&host.peer, host.peer_size,
+                      hbuf, sizeof(hbuf), 0, 0, NI_NUMERICHOST) == 0) {
+      host.address = hbuf;
+    } else {
+      host.address = "unknown";
+    }
+    host.to_send = Ping_Count;
+    host.next_send = 0;
+    host.transmitted = host.received = 0;
+    host.rtt_min = host.rtt_max = host.rtt_total = 0;
+    hosts.push_back(host);
+    if(!Quiet) {
+      std::cout << "Pinging " << host.name << " [" << host.address
+                << "] with " << REQ_DATASIZE << " bytes of data."
+                << std::endl;
+    }
   }
 
+  std::size_t next_host = 0;
   while(!Terminate) {
-    if(recv_reply(ping_socket,reply))
-      print_statistics(reply);
-    else break; // quit on timeout
+    long long now = monotonic_usec();
+    expire_requests(now);
+
+    // Fill the window, taking hosts in turn.
+    long long wake = now + Timeout;
+    bool more = false;
+    for(std::size_t n = 0; n < hosts.size(); ++n) {
+      unsigned h = (next_host + n) % hosts.size();
+      host_state & host = hosts[h];
+      if(host.to_send == 0) {
+        continue;
+      }
+      more = true;
+      if(host.next_send > now) {
+        wake = std::min(wake, host.next_send);
+        continue;
+      }
+      if(outstanding >= Window || !send_request(ping_socket, h)) {
+        next_host = h;
+        break;
+      }
+      host.next_send = now + Interval;
+      wake = std::min(wake, host.next_send);
+    }
+
+    if(!more && outstanding == 0) {
+      break;
+    }
+    if(!request_order.empty()) {
+      const request_state & oldest = requests[request_order.front()];
+      wake = std::min(wake, oldest.sent_at + Timeout);
+    }
+
+    struct pollfd pfd;
+    pfd.fd = ping_socket.getSocket();
+    pfd.events = POLLIN;
+    long long wait = wake - monotonic_usec();
+    int ret = ::poll(&pfd, 1, wait > 0 ? (int)((wait + 999) / 1000) : 0);
+    if(ret > 0) {
+      recv_replies(ping_socket);
+    }
   }
 
   print_final_statistics();
+
+  for(std::size_t i = 0; i < hosts.size(); ++i) {
+    if(hosts[i].received == 0) {
+      return false;
+    }
+  }
+  return hosts.size() == names.size();
 }
 //---------------------------------------------------------------------------
-void send_request(raw_socket_stream& sock, const std::string& host) {
-  static ECHO_REQUEST echoReq;
-  static int nId = 1;
-  static int nSeq = 1;
+bool send_request(raw_socket_stream& sock, unsigned h) {
+  host_state & host = hosts[h];
+  ECHO_REQUEST echoReq;
+
+  // Sequence numbers still waiting for a reply are skipped.
+  unsigned short seq = Next_Seq;
+  while(requests[seq].waiting) {
+    ++seq;
+  }
 
-  // Fill in echo request
+  // Fill in echo request. The kernel replaces the identifier and
+  // checksum of an unprivileged socket.
   echoReq.icmpHdr.Type = ICMP_ECHOREQ;
   echoReq.icmpHdr.Code = 0;
   echoReq.icmpHdr.Checksum = 0;
-  echoReq.icmpHdr.ID = nId++;
-  echoReq.icmpHdr.Seq = nSeq++;
-  echoReq.dwTime = clock();
+  echoReq.icmpHdr.ID = htons(Ident);
+  echoReq.icmpHdr.Seq = htons(seq);
 
   // Fill in some data to send
   for(int i=0; i < REQ_DATASIZE; i++)
@@ -148,108 +268,139 @@ void send_request(raw_socket_stream& sock, const std::string& host) {
 
   // Put data in packet and compute checksum
   echoReq.icmpHdr.Checksum =
-      in_cksum((unsigned short*)&echoReq,sizeof(ECHO_REQUEST));
-
-  const sockaddr_storage & sst = sock.getOutpeer();
-
-  char hbuf[NI_MAXHOST];
-
-  if (::getnameinfo((const sockaddr*)&sst, sock.getOutpeerSize(),
-                    hbuf, sizeof(hbuf), 0, 0, NI_NUMERICHOST) == 0) {
-    std::cout << "Pinging " << host << "[" << hbuf;
-  } else {
-    std::cout << "Pinging [unknown";
-  }
-
-  std::cout << "] with " << REQ_DATASIZE << " bytes of data." << std::endl;
+      internet_checksum::compute(&echoReq, sizeof(ECHO_REQUEST));
 
-  sock.setTimeout(3,0);
-  sock.write((char*)&echoReq,sizeof(ECHO_REQUEST));
-  sock.flush();
-
-  // Check for timeout
-  if(sock.fail()) {
-    if(sock.timeout()) {
-      std::cerr << "Timeout sending ICMP request." << std::endl;
-    } else {
-      unsigned error = sock.getLastError();
-      std::cerr << "SEND: Ping Error #" << error << std::endl;
-      #ifdef __linux__
-        std::cerr << strerror(error) << std::endl;
-      #endif
+  sock.setOutpeer(host.peer, host.peer_size);
+  if(sock.sendDatagram((const char*)&echoReq, sizeof(echoReq)) < 0) {
+    unsigned error = sock.getLastError();
+    sock.clear();
+    if(error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS) {
+      // The socket is full. Try again once replies have been read.
+      return false;
     }
-    exit(0);
+    std::cerr << "SEND: Ping Error #" << error << " to " << host.address
+              << ": " << strerror(error) << std::endl;
+    --host.to_send;
+    ++host.transmitted;
+    return true;
   }
+
+  request_state & request = requests[seq];
+  request.waiting = true;
+  request.host = h;
+  request.sent_at = monotonic_usec();
+  request_order.push_back(seq);
+  Next_Seq = seq + 1;
+  ++outstanding;
+  --host.to_send;
+  ++host.transmitted;
+  return true;
 }
 
 //---------------------------------------------------------------------------
-bool recv_reply(raw_socket_stream& sock, ECHO_REPLY& reply)
+void recv_replies(raw_socket_stream& sock)
 {
-  sock.setTimeout(3,0);
-  sock.read((char*)&reply,sizeof(ECHO_REPLY));
-
-  // Check for timeout
-  if(sock.timeout()) return false;
-
-  // Check for errors
-  if(sock.fail()) {
-    unsigned error = sock.getLastError();
-    std::cerr << "RECV: Ping Error #" << error << std::endl;
+  datagram_view datagram;
+  while(sock.receiveDatagram(datagram) >= 0) {
+    long long now = monotonic_usec();
+    const unsigned char * data = (const unsigned char *)datagram.data;
+    std::size_t len = datagram.size;
+    int ttl = -1;
+
+    // Raw sockets see the IP header, and every ICMP message.
+    if(sock.getType() == SOCK_RAW) {
+      if(len < sizeof(IP_HEADER)) {
+        continue;
+      }
+      std::size_t header_len = (data[0] & 0x0f) * 4;
+      if(len < header_len) {
+        continue;
+      }
+      ttl = ((const IP_HEADER *)data)->TTL;
+      data += header_len;
+      len -= header_len;
+    }
+    if(len < sizeof(ICMP_HEADER)) {
+      continue;
+    }
+    ICMP_HEADER reply;
+    std::memcpy(&reply, data, sizeof(reply));
+    if(reply.Type != ICMP_ECHOREPLY) {
+      continue;
+    }
+    if(sock.getType() == SOCK_RAW && ntohs(reply.ID) != Ident) {
+      continue;
+    }
 
-    #ifdef __linux__
-      std::cerr << strerror(error) << std::endl;
-    #endif
+    unsigned short seq = ntohs(reply.Seq);
+    request_state & request = requests[seq];
+    if(!request.waiting) {
+      // Late, or a duplicate.
+      continue;
+    }
+    host_state & host = hosts[request.host];
+    const sockaddr_in & from = (const sockaddr_in &)*datagram.peer;
+    if(from.sin_addr.s_addr !=
+       ((const sockaddr_in &)host.peer).sin_addr.s_addr) {
+      continue;
+    }
 
-    exit(0);
+    long long rtt = now - request.sent_at;
+    request.waiting = false;
+    --outstanding;
+    if(host.received == 0 || rtt < host.rtt_min) {
+      host.rtt_min = rtt;
+    }
+    host.rtt_max = std::max(host.rtt_max, rtt);
+    host.rtt_total += rtt;
+    ++host.received;
+
+    if(!Quiet) {
+      std::cout << "Reply from: " << host.address << " : bytes="
+                << len - sizeof(ICMP_HEADER) << " seq=" << seq
+                << " time=" << rtt / 1000.0 << "ms";
+      if(ttl >= 0) {
+        std::cout << " TTL=" << ttl;
+      }
+      std::cout << std::endl;
+    }
   }
-
-  return true;
+  sock.clear();
 }
 
 //---------------------------------------------------------------------------
-void print_statistics(const ECHO_REPLY& reply) {
-  // again: portability vs. precision
-  clock_t elapsed = clock() - reply.echoRequest.dwTime;
-
-  std::string replier;
-  char hbuf[NI_MAXHOST];
-
-  if (::getnameinfo((const sockaddr*)&reply.ipHdr.iaSrc,
-                    sizeof(reply.ipHdr.iaSrc),
-                    hbuf, sizeof(hbuf), 0, 0, NI_NUMERICHOST) == 0) {
-    replier = hbuf;
-  } else {
-    replier = "[unknown]";
+// Give up on requests which have waited longer than Timeout. They are
+// sent in order with the same timeout, so the oldest expires first.
+void expire_requests(long long now) {
+  while(!request_order.empty()) {
+    request_state & request = requests[request_order.front()];
+    if(request.waiting) {
+      if(now - request.sent_at < Timeout) {
+        break;
+      }
+      request.waiting = false;
+      --outstanding;
+      if(!Quiet) {
+        std::cout << "Request timed out: " << hosts[request.host].address
+                  << " seq=" << request_order.front() << std::endl;
+      }
+    }
+    request_order.pop_front();
   }
-
-  stat_type::iterator iter = statistics.find(replier);
-  if(iter == statistics.end())
-    iter = statistics.insert(std::pair<std::string, std::pair<unsigned, unsigned> >(replier,std::pair<unsigned, unsigned>(0,0))).first;
-
-  (*iter).second.first++;
-  (*iter).second.second += elapsed;
-
-  std::cout << "Reply from: " << replier;
-  std::cout << " : bytes=" << REQ_DATASIZE << " time=" << elapsed << "ms";
-  std::cout << " TTL=" << int(reply.ipHdr.TTL) << std::endl;
 }
 //---------------------------------------------------------------------------
 void print_final_statistics() {
-  stat_type::iterator iter = statistics.begin();
-
-  std::cout << "\nTransmitted Packets: " << transmitted_packets << std::endl;
-
-  while(iter != statistics.end()) {
-    std::cout << "\nStatistics for host " << (*iter).first << ":" << std::endl;
-    std::cout << "\tPackets received: " << (*iter).second.first << std::endl;
-    double mean = (*iter).second.second/((*iter).second.first*1.0);
-    std::cout << "\tMean ping time: " << mean*CLOCKS_DIV << " msec." << std::endl;
-    unsigned lost_packets = transmitted_packets - (*iter).second.first;
-    std::cout << "\tLost Packets: " << lost_packets << std::endl;
-    std::cout << "\tPacket loss: "<< double(lost_packets/(transmitted_packets*1.0))*100.0 << "%" << std::endl;
-    iter++;
+  for(std::size_t i = 0; i < hosts.size(); ++i) {
+    const host_state & host = hosts[i];
+    std::cout << host.name << " [" << host.address << "]: "
+              << host.received << "/" << host.transmitted << " received";
+    if(host.received > 0) {
+      std::cout << ", rtt min/avg/max " << host.rtt_min / 1000.0 << "/"
+                << host.rtt_total / 1000.0 / host.received << "/"
+                << host.rtt_max / 1000.0 << " ms";
+    }
+    std::cout << std::endl;
   }
-
 }
 
 //---------------------------------------------------------------------------
@@ -261,51 +412,3 @@ void CTLRC(int) {
 bool is_broadcast_address() {
   return true;
 }
-//---------------------------------------------------------------------------
-// Mike Muuss' in_cksum() function
-// and his comments from the original
-// ping program
-//
-// * Author -
-// *	Mike Muuss
-// *	U. S. Army Ballistic Research Laboratory
-// *	December, 1983
-/*
- *			I N _ C K S U M
- *
- * Checksum routine for Internet Protocol family headers (C Version)
- *
- */
-unsigned short in_cksum(unsigned short *addr, int len) {
-  register int nleft = len;
-  register unsigned short *w = addr;
-  register unsigned short answer;
-  register int sum = 0;
-
-  /*
-   *  Our algorithm is simple, using a 32 bit accumulator (sum),
-   *  we add sequential 16 bit words to it, and at the end, fold
-   *  back all the carry bits from the top 16 bits into the lower
-   *  16 bits.
-   */
-  while( nleft > 1 )  {
-    sum += *w++;
-    nleft -= 2;
-  }
-
-  /* mop up an odd byte, if necessary */
-  if( nleft == 1 ) {
-    u_short	u = 0;
-
-    *(u_char *)(&u) = *(u_char *)w ;
-    sum += u;
-  }
-
-  /*
-   * add back carry outs from top 16 bits to low 16 bits
-   */
-  sum = (sum >> 16) + (sum & 0xffff);	/* add hi 16 to low 16 */
-  sum += (sum >> 16);			/* add carry */
-  answer = ~sum;			/* truncate to 16 bits */
-  return (answer);
-}
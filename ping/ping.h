@@ -30,7 +30,6 @@ struct ICMP_HEADER
   unsigned short        Checksum;       // Checksum
   unsigned short        ID;             // Identification
   unsigned short        Seq;            // Sequence
-  char                  Data;           // Data
 };
 
 
@@ -39,16 +38,8 @@ struct ICMP_HEADER
 
 struct ECHO_REQUEST {
   ICMP_HEADER   icmpHdr;
-  unsigned long dwTime;
   char          cData[REQ_DATASIZE];
 };
 
-
-// ICMP Echo Reply
-struct ECHO_REPLY {
-  IP_HEADER     ipHdr;
-  ECHO_REQUEST  echoRequest;
-};
-
 #endif
 
@@ -0,0 +1,225 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skchecksum.h>
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SKSTREAM_CHECKSUM_X86 1
+#include <immintrin.h>
+#endif // __GNUC__ && x86
+
+// Sums of 32-bit words fold to the same 16-bit ones' complement sum as
+// the 16-bit words they hold, as 2^16 is 1 modulo 0xffff.
+static inline uint16_t fold(uint64_t sum)
+{
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return sum;
+}
+
+static inline uint16_t swap(uint16_t word)
+{
+  return (word >> 8) | (word << 8);
+}
+
+// Sum what is left after the whole words, a last byte being the first
+// of a word padded with zero.
+static inline uint64_t sumTail(const unsigned char * data, std::size_t len)
+{
+  uint64_t sum = 0;
+  while(len >= 4) {
+    uint32_t word;
+    std::memcpy(&word, data, 4);
+    sum += word;
+    data += 4;
+    len -= 4;
+  }
+  if(len >= 2) {
+    uint16_t word;
+    std::memcpy(&word, data, 2);
+    sum += word;
+    data += 2;
+    len -= 2;
+  }
+  if(len == 1) {
+    unsigned char last[2] = { data[0], 0 };
+    uint16_t word;
+    std::memcpy(&word, last, 2);
+    sum += word;
+  }
+  return sum;
+}
+
+static uint64_t sumScalar(const unsigned char * data, std::size_t len)
+{
+  uint64_t sum0 = 0, sum1 = 0;
+  while(len >= 16) {
+    uint32_t words[4];
+    std::memcpy(words, data, 16);
+    sum0 += words[0];
+    sum1 += words[1];
+    sum0 += words[2];
+    sum1 += words[3];
+    data += 16;
+    len -= 16;
+  }
+  return sum0 + sum1 + sumTail(data, len);
+}
+
+#ifdef SKSTREAM_CHECKSUM_X86
+
+__attribute__((target("sse2")))
+static uint64_t sumSse2(const unsigned char * data, std::size_t len)
+{
+  // Each 32-bit word is widened into a 64-bit lane, which can't overflow.
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum0 = zero, sum1 = zero;
+  while(len >= 32) {
+    __m128i a = _mm_loadu_si128((const __m128i *)data);
+    __m128i b = _mm_loadu_si128((const __m128i *)(data + 16));
+    sum0 = _mm_add_epi64(sum0, _mm_unpacklo_epi32(a, zero));
+    sum1 = _mm_add_epi64(sum1, _mm_unpackhi_epi32(a, zero));
+    sum0 = _mm_add_epi64(sum0, _mm_unpacklo_epi32(b, zero));
+    sum1 = _mm_add_epi64(sum1, _mm_unpackhi_epi32(b, zero));
+    data += 32;
+    len -= 32;
+  }
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(sum0, sum1));
+  return lanes[0] + lanes[1] + sumTail(data, len);
+}
+
+__attribute__((target("avx2")))
+static uint64_t sumAvx2(const unsigned char * data, std::size_t len)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i sum0 = zero, sum1 = zero;
+  while(len >= 64) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)data);
+    __m256i b = _mm256_loadu_si256((const __m256i *)(data + 32));
+    sum0 = _mm256_add_epi64(sum0, _mm256_unpacklo_epi32(a, zero));
+    sum1 = _mm256_add_epi64(sum1, _mm256_unpackhi_epi32(a, zero));
+    sum0 = _mm256_add_epi64(sum0, _mm256_unpacklo_epi32(b, zero));
+    sum1 = _mm256_add_epi64(sum1, _mm256_unpackhi_epi32(b, zero));
+    data += 64;
+    len -= 64;
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(sum0, sum1));
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumTail(data, len);
+}
+
+#endif // SKSTREAM_CHECKSUM_X86
+
+/////////////////////////////////////////////////////////////////////////////
+// class internet_checksum implementation
+/////////////////////////////////////////////////////////////////////////////
+
+bool internet_checksum::supported(implementation impl)
+{
+  switch(impl) {
+   case SCALAR:
+    return true;
+#ifdef SKSTREAM_CHECKSUM_X86
+   case SSE2:
+    return __builtin_cpu_supports("sse2");
+   case AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif // SKSTREAM_CHECKSUM_X86
+   default:
+    return false;
+  }
+}
+
+internet_checksum::implementation internet_checksum::best()
+{
+  static const implementation chosen = supported(AVX2) ? AVX2 :
+                                       supported(SSE2) ? SSE2 : SCALAR;
+  return chosen;
+}
+
+uint64_t internet_checksum::sum(const void * data, std::size_t len,
+                                implementation impl)
+{
+  const unsigned char * bytes = (const unsigned char *)data;
+  switch(impl) {
+#ifdef SKSTREAM_CHECKSUM_X86
+   case SSE2:
+    return sumSse2(bytes, len);
+   case AVX2:
+    return sumAvx2(bytes, len);
+#endif // SKSTREAM_CHECKSUM_X86
+   default:
+    return sumScalar(bytes, len);
+  }
+}
+
+void internet_checksum::add(const void * data, std::size_t len)
+{
+  uint16_t part = fold(sum(data, len, best()));
+  // After an odd number of bytes, these start in the middle of a word,
+  // which swaps the bytes of their sum.
+  _sum += _odd ? swap(part) : part;
+  _odd ^= (len & 1) != 0;
+}
+
+uint16_t internet_checksum::value() const
+{
+  return ~fold(_sum);
+}
+
+uint16_t internet_checksum::compute(const void * data, std::size_t len)
+{
+  return ~fold(sum(data, len, best()));
+}
+
+uint16_t internet_checksum::update(uint16_t checksum, uint16_t old_word,
+                                   uint16_t new_word)
+{
+  // RFC 1624 equation 3: HC' = ~(~HC + ~m + m')
+  return ~fold((uint16_t)~checksum + (uint16_t)~old_word + new_word);
+}
+
+uint16_t internet_checksum::update(uint16_t checksum, const void * old_data,
+                                   const void * new_data, std::size_t len)
+{
+  implementation impl = best();
+  uint16_t old_sum = fold(sum(old_data, len, impl));
+  uint16_t new_sum = fold(sum(new_data, len, impl));
+  return update(checksum, old_sum, new_sum);
+}
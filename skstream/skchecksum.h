@@ -0,0 +1,100 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_CHECKSUM_H_
+#define RGJ_FREE_SOCKET_CHECKSUM_H_
+
+#include <cstddef>
+
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// class internet_checksum
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief The ones' complement checksum of IP, ICMP, UDP and TCP headers.
+///
+/// Data is summed with SSE2 or AVX2 where the processor has them, chosen
+/// when first used. Checksums are in the byte order of the data they
+/// cover, so they can be copied into a header as they are. Data can be
+/// added in pieces of any length, and a checksum can be updated for a
+/// changed field without summing the rest again, as in RFC 1624.
+class internet_checksum {
+public:
+  enum implementation {
+    SCALAR,
+    SSE2,
+    AVX2
+  };
+
+  internet_checksum() : _sum(0), _odd(false) { }
+
+  /// Add data following what has been added already.
+  void add(const void * data, std::size_t len);
+
+  /// Return the checksum of everything added.
+  uint16_t value() const;
+
+  void reset() {
+    _sum = 0;
+    _odd = false;
+  }
+
+  /// Return the checksum of data.
+  static uint16_t compute(const void * data, std::size_t len);
+
+  /** Return a checksum updated for a 16-bit word of the data it covers
+   *  changing from old_word to new_word.
+   */
+  static uint16_t update(uint16_t checksum, uint16_t old_word,
+                         uint16_t new_word);
+
+  /** Return a checksum updated for a field at an even offset in the data
+   *  changing from old_data to new_data, both len bytes long.
+   */
+  static uint16_t update(uint16_t checksum, const void * old_data,
+                         const void * new_data, std::size_t len);
+
+  /** Return the sum of the 16-bit words of data, not yet folded to 16
+   *  bits, using the given implementation, which must be supported.
+   */
+  static uint64_t sum(const void * data, std::size_t len,
+                      implementation impl);
+
+  /// Return true if this processor can use the implementation.
+  static bool supported(implementation impl);
+
+  /// Return the implementation used by compute() and add().
+  static implementation best();
+
+private:
+  uint64_t _sum;
+  /// Set if an odd number of bytes has been added.
+  bool _odd;
+};
+
+#endif // RGJ_FREE_SOCKET_CHECKSUM_H_
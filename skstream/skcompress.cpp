@@ -0,0 +1,472 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skcompress.h>
+
+#include <skstream/skstream.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif // HAVE_ZSTD
+
+#include <algorithm>
+#include <cstring>
+
+static const std::size_t BUFFER_SIZE = 0x8000;
+
+/////////////////////////////////////////////////////////////////////////////
+// struct compress_streambuf::codec
+/////////////////////////////////////////////////////////////////////////////
+
+// The compression library state for one buffer, in both directions.
+struct compress_streambuf::codec {
+  method m;
+#ifdef HAVE_ZLIB
+  z_stream deflater;
+  z_stream inflater;
+#endif // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx * cctx;
+  ZSTD_DCtx * dctx;
+#endif // HAVE_ZSTD
+
+  codec(method mm) : m(mm) { }
+  ~codec();
+
+  bool init(int level);
+
+  /** Compress from in to out, moving both along. Returns -1 on error, 1
+   *  once the input is used up and anything the mode asks for has been
+   *  written, or 0 if more output space is needed.
+   */
+  int compress(const char *& in, std::size_t & in_len,
+               char *& out, std::size_t & out_len, flush_mode mode);
+
+  /** Decompress from in to out, moving both along. Returns -1 on error, 1
+   *  at the end of the stream, or 0.
+   */
+  int decompress(const char *& in, std::size_t & in_len,
+                 char *& out, std::size_t & out_len);
+};
+
+bool compress_streambuf::codec::init(int level)
+{
+  switch(m) {
+#ifdef HAVE_ZLIB
+   case ZLIB:
+    // On failure the destructor ends whichever streams were started.
+    std::memset(&deflater, 0, sizeof(deflater));
+    std::memset(&inflater, 0, sizeof(inflater));
+    if(deflateInit(&deflater, level == 0 ? Z_DEFAULT_COMPRESSION
+                                         : level) != Z_OK) {
+      return false;
+    }
+    if(inflateInit(&inflater) != Z_OK) {
+      return false;
+    }
+    return true;
+#endif // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+   case ZSTD:
+    // On failure the destructor frees whichever contexts were made.
+    cctx = ZSTD_createCCtx();
+    dctx = ZSTD_createDCtx();
+    if(cctx == 0 || dctx == 0) {
+      return false;
+    }
+    if(level != 0 && ZSTD_isError(ZSTD_CCtx_setParameter(cctx,
+                                    ZSTD_c_compressionLevel, level))) {
+      return false;
+    }
+    return true;
+#endif // HAVE_ZSTD
+   default:
+    return false;
+  }
+}
+
+compress_streambuf::codec::~codec()
+{
+  switch(m) {
+#ifdef HAVE_ZLIB
+   case ZLIB:
+    deflateEnd(&deflater);
+    inflateEnd(&inflater);
+    break;
+#endif // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+   case ZSTD:
+    ZSTD_freeCCtx(cctx);
+    ZSTD_freeDCtx(dctx);
+    break;
+#endif // HAVE_ZSTD
+   default:
+    break;
+  }
+}
+
+int compress_streambuf::codec::compress(const char *& in, std::size_t & in_len,
+                                        char *& out, std::size_t & out_len,
+                                        flush_mode mode)
+{
+  switch(m) {
+#ifdef HAVE_ZLIB
+   case ZLIB: {
+    deflater.next_in = (Bytef *)in;
+    deflater.avail_in = in_len;
+    deflater.next_out = (Bytef *)out;
+    deflater.avail_out = out_len;
+    int ret = deflate(&deflater, mode == END ? Z_FINISH :
+                                 mode == FLUSH ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+    in = (const char *)deflater.next_in;
+    in_len = deflater.avail_in;
+    out = (char *)deflater.next_out;
+    out_len = deflater.avail_out;
+    if(ret == Z_STREAM_ERROR) {
+      return -1;
+    }
+    if(mode == END) {
+      return ret == Z_STREAM_END ? 1 : 0;
+    }
+    // A flush is complete once deflate() leaves output space unused.
+    if(mode == FLUSH) {
+      return (in_len == 0 && out_len > 0) ? 1 : 0;
+    }
+    return in_len == 0 ? 1 : 0;
+   }
+#endif // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+   case ZSTD: {
+    ZSTD_inBuffer input = { in, in_len, 0 };
+    ZSTD_outBuffer output = { out, out_len, 0 };
+    std::size_t ret = ZSTD_compressStream2(cctx, &output, &input,
+                                           mode == END ? ZSTD_e_end :
+                                           mode == FLUSH ? ZSTD_e_flush :
+                                                           ZSTD_e_continue);
+    if(ZSTD_isError(ret)) {
+      return -1;
+    }
+    in += input.pos;
+    in_len -= input.pos;
+    out += output.pos;
+    out_len -= output.pos;
+    if(mode == NO_FLUSH) {
+      return in_len == 0 ? 1 : 0;
+    }
+    // Zero left to flush means the block or frame is complete.
+    return (ret == 0 && in_len == 0) ? 1 : 0;
+   }
+#endif // HAVE_ZSTD
+   default:
+    return -1;
+  }
+}
+
+int compress_streambuf::codec::decompress(const char *& in,
+                                          std::size_t & in_len,
+                                          char *& out, std::size_t & out_len)
+{
+  switch(m) {
+#ifdef HAVE_ZLIB
+   case ZLIB: {
+    inflater.next_in = (Bytef *)in;
+    inflater.avail_in = in_len;
+    inflater.next_out = (Bytef *)out;
+    inflater.avail_out = out_len;
+    int ret = inflate(&inflater, Z_NO_FLUSH);
+    in = (const char *)inflater.next_in;
+    in_len = inflater.avail_in;
+    out = (char *)inflater.next_out;
+    out_len = inflater.avail_out;
+    if(ret == Z_STREAM_END) {
+      return 1;
+    }
+    // Z_BUF_ERROR only means no progress could be made this time.
+    return (ret == Z_OK || ret == Z_BUF_ERROR) ? 0 : -1;
+   }
+#endif // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+   case ZSTD: {
+    ZSTD_inBuffer input = { in, in_len, 0 };
+    ZSTD_outBuffer output = { out, out_len, 0 };
+    std::size_t ret = ZSTD_decompressStream(dctx, &output, &input);
+    if(ZSTD_isError(ret)) {
+      return -1;
+    }
+    in += input.pos;
+    in_len -= input.pos;
+    out += output.pos;
+    out_len -= output.pos;
+    // The frame only ends when the writer calls finish().
+    return ret == 0 ? 1 : 0;
+   }
+#endif // HAVE_ZSTD
+   default:
+    return -1;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class compress_streambuf implementation
+/////////////////////////////////////////////////////////////////////////////
+
+bool compress_streambuf::supported(method m)
+{
+  switch(m) {
+#ifdef HAVE_ZLIB
+   case ZLIB:
+    return true;
+#endif // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+   case ZSTD:
+    return true;
+#endif // HAVE_ZSTD
+   default:
+    return false;
+  }
+}
+
+compress_streambuf::compress_streambuf(std::streambuf & next, method m,
+                                       int level) :
+    _next(next), _next_socket(dynamic_cast<socketbuf *>(&next)),
+    _codec(0), _put(new char[BUFFER_SIZE]), _get(new char[BUFFER_SIZE]),
+    _packed_out(new char[BUFFER_SIZE]), _packed_in(0),
+    _packed_start(0), _packed_end(0),
+    _failed(false), _finished(false), _unflushed(false),
+    _input_ended(false), _get_filled(false),
+    _plain_out_total(0), _packed_out_total(0),
+    _packed_in_total(0), _plain_in_total(0)
+{
+  if(_next_socket == 0) {
+    _packed_in = new char[BUFFER_SIZE];
+  }
+  _codec = new codec(m);
+  if(!supported(m) || !_codec->init(level)) {
+    delete _codec;
+    _codec = 0;
+    _failed = true;
+  }
+  setp(_put, _put + BUFFER_SIZE);
+  setg(_get, _get, _get);
+}
+
+compress_streambuf::~compress_streambuf()
+{
+  sync();
+  delete _codec;
+  delete [] _put;
+  delete [] _get;
+  delete [] _packed_out;
+  delete [] _packed_in;
+}
+
+// Compress the put area and pass it on.
+int compress_streambuf::compress(flush_mode mode)
+{
+  const char * in = pbase();
+  std::size_t in_len = pptr() - pbase();
+  setp(_put, _put + BUFFER_SIZE);
+  if(in_len == 0 && mode == FLUSH && !_unflushed) {
+    return 0;
+  }
+  _plain_out_total += in_len;
+
+  for(;;) {
+    char * out = _packed_out;
+    std::size_t out_len = BUFFER_SIZE;
+    int ret = _codec->compress(in, in_len, out, out_len, mode);
+    if(ret < 0) {
+      _failed = true;
+      return -1;
+    }
+    std::streamsize produced = BUFFER_SIZE - out_len;
+    if(produced > 0) {
+      if(_next.sputn(_packed_out, produced) != produced) {
+        _failed = true;
+        return -1;
+      }
+      _packed_out_total += produced;
+      _unflushed = true;
+    }
+    if(ret == 1) {
+      break;
+    }
+  }
+  if(mode != NO_FLUSH) {
+    _unflushed = false;
+  }
+  return 0;
+}
+
+compress_streambuf::int_type compress_streambuf::overflow(int_type c)
+{
+  if(_failed || _finished || compress(NO_FLUSH) != 0) {
+    return traits_type::eof();
+  }
+  if(!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int compress_streambuf::sync()
+{
+  if(_failed) {
+    return -1;
+  }
+  if(_finished) {
+    return pptr() == pbase() ? 0 : -1;
+  }
+  if(compress(FLUSH) != 0) {
+    return -1;
+  }
+  return _next.pubsync();
+}
+
+int compress_streambuf::finish()
+{
+  if(_failed) {
+    return -1;
+  }
+  if(_finished) {
+    return 0;
+  }
+  if(compress(END) != 0) {
+    return -1;
+  }
+  _finished = true;
+  return _next.pubsync() == 0 ? 0 : -1;
+}
+
+// Find compressed input, in place in a socketbuf if possible.
+std::streamsize compress_streambuf::readPacked(const char *& data)
+{
+  if(_next_socket != 0) {
+    return _next_socket->fillBuffer(data);
+  }
+  if(_packed_start == _packed_end) {
+    std::streamsize avail = _next.in_avail();
+    if(avail <= 0) {
+      if(traits_type::eq_int_type(_next.sgetc(), traits_type::eof())) {
+        return 0;
+      }
+      avail = _next.in_avail();
+    }
+    avail = std::min(avail, (std::streamsize)BUFFER_SIZE);
+    _packed_start = 0;
+    _packed_end = _next.sgetn(_packed_in, avail);
+  }
+  data = _packed_in + _packed_start;
+  return _packed_end - _packed_start;
+}
+
+void compress_streambuf::consumePacked(std::streamsize count)
+{
+  if(_next_socket != 0) {
+    _next_socket->consumeBuffer(count);
+  } else {
+    _packed_start += count;
+  }
+  _packed_in_total += count;
+}
+
+compress_streambuf::int_type compress_streambuf::underflow()
+{
+  if(gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  if(_failed || _input_ended) {
+    return traits_type::eof();
+  }
+
+  // Output left in the codec from last time comes before new input.
+  bool drain = _get_filled;
+  for(;;) {
+    const char * data = 0;
+    std::streamsize avail = 0;
+    if(!drain) {
+      avail = readPacked(data);
+      if(avail <= 0) {
+        return traits_type::eof();
+      }
+    }
+    drain = false;
+
+    const char * in = data;
+    std::size_t in_len = avail;
+    char * out = _get;
+    std::size_t out_len = BUFFER_SIZE;
+    int ret = _codec->decompress(in, in_len, out, out_len);
+    consumePacked(avail - in_len);
+    if(ret < 0) {
+      _failed = true;
+      return traits_type::eof();
+    }
+    std::size_t produced = BUFFER_SIZE - out_len;
+    _plain_in_total += produced;
+    _get_filled = (out_len == 0);
+    if(ret == 1) {
+      _input_ended = true;
+    }
+    if(produced > 0) {
+      setg(_get, _get, _get + produced);
+      return traits_type::to_int_type(*gptr());
+    }
+    if(_input_ended) {
+      return traits_type::eof();
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class compress_stream implementation
+/////////////////////////////////////////////////////////////////////////////
+
+compress_stream::compress_stream(std::iostream & next,
+                                 compress_streambuf::method m, int level) :
+    std::iostream(0), _compressbuf(*next.rdbuf(), m, level)
+{
+  rdbuf(&_compressbuf);
+  if(!_compressbuf.good()) {
+    setstate(std::ios::badbit);
+  }
+}
+
+compress_stream::~compress_stream()
+{
+}
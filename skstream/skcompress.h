@@ -0,0 +1,174 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_COMPRESS_H_
+#define RGJ_FREE_SOCKET_COMPRESS_H_
+
+#include <iostream>
+
+class socketbuf;
+
+/////////////////////////////////////////////////////////////////////////////
+// class compress_streambuf
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief A stream buffer which compresses data on its way to another.
+///
+/// Output is compressed as a stream and passed on to the next buffer, and
+/// input read from it is decompressed. sync() ends a block which the peer
+/// can decompress at once, so a flush after each update gets it there
+/// without waiting for more, while the dictionary built from earlier
+/// updates keeps compressing later ones. When the next buffer is a
+/// socketbuf, input is decompressed straight out of its buffer into this
+/// one, with no copy in between.
+class compress_streambuf : public std::streambuf {
+public:
+  enum method {
+    /// zlib deflate format.
+    ZLIB,
+    /// Zstandard, usually faster and smaller.
+    ZSTD
+  };
+
+  /// Return true if this build can use the method.
+  static bool supported(method m);
+
+  /** Filter another buffer, which must outlive this one. A level of 0
+   *  uses the method's default.
+   */
+  explicit compress_streambuf(std::streambuf & next, method m = ZLIB,
+                              int level = 0);
+  virtual ~compress_streambuf();
+
+  /// Return false if the method is not supported or the data was corrupt.
+  bool good() const {
+    return !_failed;
+  }
+
+  /** End the compressed stream, so the peer sees end of file after the
+   *  data written so far. Nothing can be written afterwards. Returns 0,
+   *  or -1 on error.
+   */
+  int finish();
+
+  /// Bytes written to this buffer and sent on compressed so far.
+  unsigned long long plainOut() const {
+    return _plain_out_total;
+  }
+
+  unsigned long long packedOut() const {
+    return _packed_out_total;
+  }
+
+  /// Bytes read compressed from the next buffer and delivered so far.
+  unsigned long long packedIn() const {
+    return _packed_in_total;
+  }
+
+  unsigned long long plainIn() const {
+    return _plain_in_total;
+  }
+
+protected:
+  virtual int_type overflow(int_type c = traits_type::eof());
+  virtual int_type underflow();
+  virtual int sync();
+
+private:
+  compress_streambuf(const compress_streambuf&);
+  compress_streambuf& operator=(const compress_streambuf&);
+
+  struct codec;
+
+  enum flush_mode {
+    NO_FLUSH,
+    FLUSH,
+    END
+  };
+
+  std::streambuf & _next;
+  socketbuf * _next_socket;
+  codec * _codec;
+  char * _put;
+  char * _get;
+  /// Compressed output on its way to the next buffer.
+  char * _packed_out;
+  /// Input copied from a next buffer which is not a socketbuf.
+  char * _packed_in;
+  std::streamsize _packed_start;
+  std::streamsize _packed_end;
+  bool _failed;
+  bool _finished;
+  /// Set if output has been compressed since the last flush.
+  bool _unflushed;
+  bool _input_ended;
+  /// Set if the last decompression filled the get area, so more output
+  /// may be waiting in the codec.
+  bool _get_filled;
+  unsigned long long _plain_out_total;
+  unsigned long long _packed_out_total;
+  unsigned long long _packed_in_total;
+  unsigned long long _plain_in_total;
+
+  int compress(flush_mode mode);
+  std::streamsize readPacked(const char *& data);
+  void consumePacked(std::streamsize count);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class compress_stream
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief An iostream which compresses what it sends over another stream.
+///
+/// Both ends must wrap their stream the same way. The wrapped stream
+/// must not be used directly while this one is.
+class compress_stream : public std::iostream {
+public:
+  explicit compress_stream(std::iostream & next,
+                           compress_streambuf::method m =
+                             compress_streambuf::ZLIB,
+                           int level = 0);
+  virtual ~compress_stream();
+
+  /// See compress_streambuf::finish().
+  int finish() {
+    return _compressbuf.finish();
+  }
+
+  compress_streambuf & compressbuf() {
+    return _compressbuf;
+  }
+
+private:
+  compress_stream(const compress_stream&);
+  compress_stream& operator=(const compress_stream&);
+
+  compress_streambuf _compressbuf;
+};
+
+#endif // RGJ_FREE_SOCKET_COMPRESS_H_
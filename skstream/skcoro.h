@@ -0,0 +1,392 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_CORO_H_
+#define RGJ_FREE_SOCKET_CORO_H_
+
+// The rest of the library only needs C++11, so this header is optional
+// and only usable from code built as C++20.
+#if !defined(__cpp_impl_coroutine) || __cplusplus < 202002L
+#error skstream/skcoro.h requires a compiler with C++20 coroutine support
+#endif
+
+#include <skstream/skreactor.h>
+#include <skstream/skserver.h>
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <utility>
+
+template <typename T> class socket_task;
+
+namespace skstream_detail {
+
+// Promise state shared by tasks of every result type.
+struct task_promise_base {
+  std::coroutine_handle<> continuation;
+  std::exception_ptr error;
+  bool detached = false;
+
+  std::suspend_always initial_suspend() noexcept {
+    return {};
+  }
+
+  struct final_awaiter {
+    bool await_ready() noexcept {
+      return false;
+    }
+
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+      task_promise_base & p = h.promise();
+      if(p.detached) {
+        // Nobody will collect the result, so clean up now.
+        if(p.error) {
+          std::terminate();
+        }
+        h.destroy();
+        return std::noop_coroutine();
+      }
+      if(p.continuation) {
+        return p.continuation;
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() noexcept { }
+  };
+
+  final_awaiter final_suspend() noexcept {
+    return {};
+  }
+
+  void unhandled_exception() {
+    error = std::current_exception();
+  }
+};
+
+template <typename T>
+struct task_promise : task_promise_base {
+  T value;
+
+  socket_task<T> get_return_object();
+
+  void return_value(T v) {
+    value = std::move(v);
+  }
+
+  T result() {
+    if(error) {
+      std::rethrow_exception(error);
+    }
+    return std::move(value);
+  }
+};
+
+template <>
+struct task_promise<void> : task_promise_base {
+  socket_task<void> get_return_object();
+
+  void return_void() { }
+
+  void result() {
+    if(error) {
+      std::rethrow_exception(error);
+    }
+  }
+};
+
+} // namespace skstream_detail
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_task
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Coroutine type for socket code driven by a socket_reactor.
+///
+/// A task does nothing until it is awaited with co_await, which runs it
+/// and gives its result, or started with spawn(), which runs it
+/// independently until it finishes.
+template <typename T = void>
+class socket_task {
+public:
+  typedef skstream_detail::task_promise<T> promise_type;
+  typedef std::coroutine_handle<promise_type> handle_type;
+
+  explicit socket_task(handle_type h) : _handle(h) { }
+
+  socket_task(socket_task && other) noexcept : _handle(other._handle) {
+    other._handle = nullptr;
+  }
+
+  socket_task & operator=(socket_task && other) noexcept {
+    if(this != &other) {
+      if(_handle) {
+        _handle.destroy();
+      }
+      _handle = other._handle;
+      other._handle = nullptr;
+    }
+    return *this;
+  }
+
+  ~socket_task() {
+    if(_handle) {
+      _handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept {
+    return !_handle || _handle.done();
+  }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+    _handle.promise().continuation = caller;
+    return _handle;
+  }
+
+  T await_resume() {
+    return _handle.promise().result();
+  }
+
+  /// Run the task without waiting for it. It cleans up when it finishes.
+  void start() {
+    handle_type h = _handle;
+    _handle = nullptr;
+    h.promise().detached = true;
+    h.resume();
+  }
+
+private:
+  socket_task(const socket_task&) = delete;
+  socket_task& operator=(const socket_task&) = delete;
+
+  handle_type _handle;
+};
+
+template <typename T>
+inline socket_task<T> skstream_detail::task_promise<T>::get_return_object()
+{
+  return socket_task<T>(socket_task<T>::handle_type::from_promise(*this));
+}
+
+inline socket_task<void> skstream_detail::task_promise<void>::get_return_object()
+{
+  return socket_task<void>(socket_task<void>::handle_type::from_promise(*this));
+}
+
+/// Start a task running, leaving it to finish on its own.
+inline void spawn(socket_task<void> && task)
+{
+  task.start();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Awaitables
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Suspends the awaiting coroutine until a socket is ready.
+///
+/// Resumes with true once the socket is ready for the events. Resumes with
+/// false at once if it could not be watched, or when the socket is removed
+/// from the reactor before it is ready.
+class socket_ready {
+public:
+  socket_ready(socket_reactor & reactor, basic_socket & sock,
+               basic_socket_poll::poll_type events) :
+      _reactor(reactor), _socket(sock), _events(events), _ok(true) { }
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  bool await_suspend(std::coroutine_handle<> h) {
+    // The awaiter lives in the suspended coroutine's frame.
+    if(_reactor.waitFor(&_socket, _events, [this, h](bool ready) {
+          _ok = ready;
+          h.resume();
+        }) != 0) {
+      _ok = false;
+      return false;
+    }
+    return true;
+  }
+
+  bool await_resume() const noexcept {
+    return _ok;
+  }
+
+private:
+  socket_reactor & _reactor;
+  basic_socket & _socket;
+  basic_socket_poll::poll_type _events;
+  bool _ok;
+};
+
+/// \brief Suspends the awaiting coroutine for a number of milliseconds.
+///
+/// Resumes with true once the time has passed, or with false if the
+/// reactor is destroyed first.
+class socket_sleep {
+public:
+  socket_sleep(socket_reactor & reactor, unsigned long milliseconds) :
+      _reactor(reactor), _milliseconds(milliseconds), _ok(true) { }
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  bool await_suspend(std::coroutine_handle<> h) {
+    if(_reactor.sleepFor(_milliseconds, [this, h](bool slept) {
+          _ok = slept;
+          h.resume();
+        }) != 0) {
+      _ok = false;
+      return false;
+    }
+    return true;
+  }
+
+  bool await_resume() const noexcept {
+    return _ok;
+  }
+
+private:
+  socket_reactor & _reactor;
+  unsigned long _milliseconds;
+  bool _ok;
+};
+
+inline socket_sleep async_sleep(socket_reactor & reactor,
+                                unsigned long milliseconds)
+{
+  return socket_sleep(reactor, milliseconds);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Asynchronous operations
+/////////////////////////////////////////////////////////////////////////////
+
+// co_await is kept out of conditions, which GCC 12 miscompiles.
+
+/** Connect a stream, trying each address the host resolves to in turn.
+ *  Returns 0 once connected, or -1 if every address failed.
+ */
+inline socket_task<int> async_connect(socket_reactor & reactor,
+                                      tcp_socket_stream & stream,
+                                      const std::string & host, int port)
+{
+  stream.open(host, port, true);
+  while(stream.connect_pending()) {
+    bool ready = co_await socket_ready(reactor, stream,
+                                       basic_socket_poll::WRITE);
+    if(!ready) {
+      co_return -1;
+    }
+    if(!stream.isReady(0) && stream.connect_pending() &&
+       stream.open_next() < 0) {
+      break;
+    }
+  }
+  co_return stream.is_open() ? 0 : -1;
+}
+
+/** Accept a connection on a listen socket. Returns the new socket, or
+ *  INVALID_SOCKET on error.
+ */
+inline socket_task<SOCKET_TYPE> async_accept(socket_reactor & reactor,
+                                             tcp_socket_server & server)
+{
+  bool ready = co_await socket_ready(reactor, server, basic_socket_poll::READ);
+  if(!ready) {
+    co_return INVALID_SOCKET;
+  }
+  co_return server.accept();
+}
+
+/** Read whatever is available from a stream, up to len bytes, waiting
+ *  only if there is nothing. Returns the number of bytes read, 0 at end
+ *  of file or -1 on error. Puts the stream in non-blocking mode.
+ */
+inline socket_task<std::streamsize> async_read_some(socket_reactor & reactor,
+                                                    stream_socket_stream & stream,
+                                                    char * buf,
+                                                    std::streamsize len)
+{
+  stream.setNonBlocking(true);
+  std::streambuf * sb = stream.rdbuf();
+  for(;;) {
+    std::streamsize avail = sb->in_avail();
+    if(avail > 0) {
+      co_return sb->sgetn(buf, avail < len ? avail : len);
+    }
+    if(sb->sgetc() != std::streambuf::traits_type::eof()) {
+      continue;
+    }
+    if(!stream.wouldBlock()) {
+      co_return stream.readError() == 0 ? 0 : -1;
+    }
+    bool ready = co_await socket_ready(reactor, stream,
+                                       basic_socket_poll::READ);
+    if(!ready) {
+      co_return -1;
+    }
+  }
+}
+
+/** Write to a stream, waiting until all of it has been handed to the
+ *  socket. Returns len, or -1 on error. Puts the stream in non-blocking
+ *  mode.
+ */
+inline socket_task<std::streamsize> async_write(socket_reactor & reactor,
+                                                stream_socket_stream & stream,
+                                                const char * data,
+                                                std::streamsize len)
+{
+  stream.setNonBlocking(true);
+  // In non-blocking mode whatever the socket won't take is queued.
+  stream.write(data, len);
+  stream.flush();
+  while(stream.pendingBytes() > 0) {
+    bool ready = co_await socket_ready(reactor, stream,
+                                       basic_socket_poll::WRITE);
+    if(!ready || stream.flushPending() != 0) {
+      co_return -1;
+    }
+  }
+  co_return len;
+}
+
+inline socket_task<std::streamsize> async_write(socket_reactor & reactor,
+                                                stream_socket_stream & stream,
+                                                const std::string & data)
+{
+  return async_write(reactor, stream, data.data(), data.size());
+}
+
+#endif // RGJ_FREE_SOCKET_CORO_H_
@@ -0,0 +1,448 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skpool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include <errno.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+static inline int getSystemError()
+{
+  #ifdef _WIN32
+    return WSAGetLastError();
+  #else
+    return errno;
+  #endif
+}
+
+static inline bool isWouldBlock(int error)
+{
+  #ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+  #else
+    return error == EAGAIN || error == EWOULDBLOCK;
+  #endif
+}
+
+static inline int pollSocket(struct pollfd * fds, int timeout)
+{
+  #ifdef _WIN32
+    return ::WSAPoll(fds, 1, timeout);
+  #else
+    return ::poll(fds, 1, timeout);
+  #endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class tcp_connection_pool implementation
+/////////////////////////////////////////////////////////////////////////////
+
+tcp_connection_pool::tcp_connection_pool(std::size_t max_per_endpoint,
+                                         unsigned int max_idle) :
+    _max_per_endpoint(std::max<std::size_t>(max_per_endpoint, 1)),
+    _max_idle(max_idle), _connect_timeout(5000), _running(false)
+{
+}
+
+tcp_connection_pool::~tcp_connection_pool()
+{
+  stop();
+  endpoint_map::const_iterator I = _endpoints.begin();
+  for(; I != _endpoints.end(); ++I) {
+    std::deque<idle_stream>::const_iterator J = I->second->idle.begin();
+    for(; J != I->second->idle.end(); ++J) {
+      delete J->stream;
+    }
+    delete I->second;
+  }
+}
+
+tcp_connection_pool::tick_type tcp_connection_pool::now()
+{
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(
+      steady_clock::now().time_since_epoch()).count();
+}
+
+int tcp_connection_pool::getLastError() const
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  error_map::const_iterator I = _errors.find(std::this_thread::get_id());
+  if(I == _errors.end()) {
+    return 0;
+  }
+  return I->second;
+}
+
+void tcp_connection_pool::setLastError(int error)
+{
+  _errors[std::this_thread::get_id()] = error;
+}
+
+bool tcp_connection_pool::isAlive(tcp_socket_stream & stream)
+{
+  if(!stream.is_open() || !stream.good() || stream.rdbuf()->in_avail() > 0) {
+    return false;
+  }
+  char byte;
+  if(::recv(stream.getSocket(), &byte, 1, MSG_PEEK | MSG_DONTWAIT) >= 0) {
+    // Either the peer has closed, or it sent something nobody asked for.
+    return false;
+  }
+  return isWouldBlock(getSystemError());
+}
+
+tcp_connection_pool::endpoint *
+tcp_connection_pool::findEndpoint(const std::string & host, int service,
+                                  std::unique_lock<std::mutex> & lock)
+{
+  endpoint_key key(host, service);
+  endpoint_map::const_iterator I = _endpoints.find(key);
+  if(I != _endpoints.end()) {
+    return I->second;
+  }
+
+  // Don't hold up other endpoints while resolving.
+  lock.unlock();
+  endpoint * e = new endpoint;
+  char serviceName[32];
+  ::sprintf(serviceName, "%d", service);
+  int ret = e->address.resolveConnector(host, serviceName);
+  lock.lock();
+
+  if(ret != 0) {
+    setLastError(e->address.getLastError());
+    delete e;
+    return 0;
+  }
+  I = _endpoints.find(key);
+  if(I != _endpoints.end()) {
+    // Another thread got there first.
+    delete e;
+    return I->second;
+  }
+  _endpoints.insert(std::make_pair(key, e));
+  return e;
+}
+
+const tcp_connection_pool::endpoint *
+tcp_connection_pool::findEndpoint(const std::string & host, int service) const
+{
+  endpoint_map::const_iterator I = _endpoints.find(endpoint_key(host,
+                                                                service));
+  if(I == _endpoints.end()) {
+    return 0;
+  }
+  return I->second;
+}
+
+// Wait for a non-blocking connect to finish, in slices so that the pool's
+// thread notices when it is stopped. Returns 0, or an error.
+int tcp_connection_pool::waitConnected(tcp_socket_stream & stream,
+                                       bool background)
+{
+  SOCKET_TYPE sock = stream.getSocket();
+  tick_type deadline = now() + _connect_timeout;
+  for(;;) {
+    tick_type when = now();
+    if(when >= deadline) {
+      return ETIMEDOUT;
+    }
+    if(background && !_running) {
+      return ECANCELED;
+    }
+    tick_type slice = std::min<tick_type>(deadline - when, 100);
+    // A failed connect may be reported without POLLOUT, so any event
+    // means it has finished.
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    int ret = pollSocket(&pfd, (int)slice);
+    if(ret < 0) {
+      return getSystemError();
+    }
+    if(ret == 0) {
+      continue;
+    }
+    int error = 0;
+    SOCKLEN error_size = sizeof(error);
+    ::getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&error, &error_size);
+    if(error != 0) {
+      return error;
+    }
+    // Connected, so this hands the socket to the stream.
+    if(!stream.isReady(0) || !stream.is_open()) {
+      return stream.getLastError() != 0 ? stream.getLastError() : ENOTCONN;
+    }
+    return 0;
+  }
+}
+
+// Called without the lock held. The endpoint's address is not changed once
+// it has been resolved, so it can be read from several threads at once.
+tcp_socket_stream * tcp_connection_pool::connect(endpoint & e,
+                                                 bool background,
+                                                 int & error)
+{
+  tcp_address::const_iterator I = e.address.begin();
+  for(; I != e.address.end(); ++I) {
+    tcp_socket_stream * stream = new tcp_socket_stream;
+    if(stream->open(*I, true) == 0) {
+      error = waitConnected(*stream, background);
+      if(error == 0) {
+        _options.apply(stream->getSocket());
+        return stream;
+      }
+    } else {
+      error = stream->getLastError();
+    }
+    delete stream;
+    if(error == ECANCELED) {
+      break;
+    }
+  }
+  return 0;
+}
+
+tcp_socket_stream * tcp_connection_pool::acquire(const std::string & host,
+                                                 int service,
+                                                 unsigned int milliseconds)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  endpoint * e = findEndpoint(host, service, lock);
+  if(e == 0) {
+    return 0;
+  }
+
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(milliseconds);
+  for(;;) {
+    // The most recently used stream is taken first, so the rest can age
+    // and be reaped when demand falls.
+    while(!e->idle.empty()) {
+      tcp_socket_stream * stream = e->idle.back().stream;
+      e->idle.pop_back();
+      if(isAlive(*stream)) {
+        ++e->active;
+        _leased[stream] = e;
+        return stream;
+      }
+      delete stream;
+    }
+
+    if(e->size() < _max_per_endpoint) {
+      ++e->opening;
+      lock.unlock();
+      int error = 0;
+      tcp_socket_stream * stream = connect(*e, false, error);
+      lock.lock();
+      --e->opening;
+      if(stream == 0) {
+        setLastError(error);
+        _released.notify_all();
+        return 0;
+      }
+      ++e->active;
+      _leased[stream] = e;
+      return stream;
+    }
+
+    if(std::chrono::steady_clock::now() >= deadline) {
+      setLastError(ETIMEDOUT);
+      return 0;
+    }
+    _released.wait_until(lock, deadline);
+  }
+}
+
+void tcp_connection_pool::release(tcp_socket_stream * stream, bool reuse)
+{
+  if(stream == 0) {
+    return;
+  }
+  if(reuse) {
+    stream->flush();
+    reuse = stream->good() && stream->is_open();
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  stream_map::iterator I = _leased.find(stream);
+  if(I == _leased.end()) {
+    return;
+  }
+  endpoint * e = I->second;
+  _leased.erase(I);
+  --e->active;
+  if(reuse) {
+    idle_stream s = { stream, now() };
+    e->idle.push_back(s);
+  }
+  // Waiters for every endpoint share the condition, so wake them all.
+  _released.notify_all();
+  lock.unlock();
+
+  if(!reuse) {
+    delete stream;
+  }
+}
+
+int tcp_connection_pool::prewarm(const std::string & host, int service,
+                                 std::size_t count)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  endpoint * e = findEndpoint(host, service, lock);
+  if(e == 0) {
+    return -1;
+  }
+  e->warm = std::min(count, _max_per_endpoint);
+  _wake.notify_one();
+  return 0;
+}
+
+std::size_t tcp_connection_pool::reapEndpoint(endpoint & e, tick_type when)
+{
+  std::size_t closed = 0;
+  std::deque<idle_stream>::iterator I = e.idle.begin();
+  while(I != e.idle.end()) {
+    bool expired = when - I->since >= _max_idle && e.size() > e.warm;
+    if(expired || !isAlive(*I->stream)) {
+      delete I->stream;
+      I = e.idle.erase(I);
+      ++closed;
+    } else {
+      ++I;
+    }
+  }
+  return closed;
+}
+
+std::size_t tcp_connection_pool::reap()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  tick_type when = now();
+  std::size_t closed = 0;
+  endpoint_map::const_iterator I = _endpoints.begin();
+  for(; I != _endpoints.end(); ++I) {
+    closed += reapEndpoint(*I->second, when);
+  }
+  return closed;
+}
+
+std::size_t tcp_connection_pool::idle(const std::string & host,
+                                      int service) const
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  const endpoint * e = findEndpoint(host, service);
+  return e == 0 ? 0 : e->idle.size();
+}
+
+std::size_t tcp_connection_pool::active(const std::string & host,
+                                        int service) const
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  const endpoint * e = findEndpoint(host, service);
+  return e == 0 ? 0 : e->active;
+}
+
+int tcp_connection_pool::start()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if(_running) {
+    return -1;
+  }
+  _running = true;
+  _thread = std::thread(&tcp_connection_pool::run, this);
+  return 0;
+}
+
+void tcp_connection_pool::stop()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if(!_running) {
+    return;
+  }
+  _running = false;
+  _wake.notify_one();
+  lock.unlock();
+  _thread.join();
+}
+
+void tcp_connection_pool::run()
+{
+  // Check often enough that no stream stays much past its idle time.
+  std::chrono::milliseconds period(std::min<tick_type>(
+      std::max<tick_type>(_max_idle / 4, 10), 1000));
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  while(_running) {
+    tick_type when = now();
+    endpoint_map::const_iterator I = _endpoints.begin();
+    for(; I != _endpoints.end(); ++I) {
+      reapEndpoint(*I->second, when);
+    }
+
+    // Endpoints are never removed, so the iterator stays valid while the
+    // lock is released to connect.
+    for(I = _endpoints.begin(); _running && I != _endpoints.end(); ++I) {
+      endpoint * e = I->second;
+      while(_running && e->size() < e->warm) {
+        ++e->opening;
+        lock.unlock();
+        int error = 0;
+        tcp_socket_stream * stream = connect(*e, true, error);
+        lock.lock();
+        --e->opening;
+        if(stream == 0) {
+          // Try again next time round. Nobody called, so the error is
+          // not reported.
+          _released.notify_all();
+          break;
+        }
+        idle_stream s = { stream, now() };
+        e->idle.push_back(s);
+        _released.notify_all();
+      }
+    }
+
+    _wake.wait_for(lock, period);
+  }
+}
@@ -0,0 +1,196 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_POOL_H_
+#define RGJ_FREE_SOCKET_POOL_H_
+
+#include <skstream/skstream.h>
+#include <skstream/skaddress.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/////////////////////////////////////////////////////////////////////////////
+// class tcp_connection_pool
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Connected TCP streams kept for reuse by calls to other services.
+///
+/// Streams are kept for each endpoint, a host and port, and acquire()
+/// hands one to a single caller until it is given back with release().
+/// Before an idle stream is handed out it is checked with a non-blocking
+/// MSG_PEEK, so one the peer has closed, or with data left unread from
+/// an earlier call, is closed rather than reused. Each endpoint has a
+/// limit on its streams, in use and idle together. Host names are
+/// resolved once, when an endpoint is first used, and endpoints are kept
+/// for the life of the pool.
+///
+/// Idle streams are closed by reap() once they have been idle too long.
+/// The thread started with start() calls it regularly, and also opens
+/// streams in advance to endpoints given to prewarm(). All methods may be
+/// called from any thread. Streams are opened without blocking, and an
+/// attempt which takes longer than the connect timeout is abandoned.
+class tcp_connection_pool {
+public:
+  /** Create a pool allowing max_per_endpoint streams to each endpoint,
+   *  and closing streams idle for more than max_idle milliseconds.
+   */
+  explicit tcp_connection_pool(std::size_t max_per_endpoint = 8,
+                               unsigned int max_idle = 60000);
+
+  /// Stop the thread and close idle streams. Release all streams first.
+  ~tcp_connection_pool();
+
+  /// Set options for the streams the pool opens. Call this before use.
+  void setOptions(const socket_options & options) {
+    _options = options;
+  }
+
+  /** Set how many milliseconds opening a stream may take before it fails
+   *  with ETIMEDOUT. The default is 5000. Call this before use.
+   */
+  void setConnectTimeout(unsigned int milliseconds) {
+    _connect_timeout = milliseconds;
+  }
+
+  /** Return a connected stream to host and service, an idle one if there
+   *  is one, or a new one. If the endpoint already has as many streams as
+   *  it is allowed, wait up to milliseconds for one to be released.
+   *  Returns 0 if none could be had.
+   */
+  tcp_socket_stream * acquire(const std::string & host, int service,
+                              unsigned int milliseconds = 0);
+
+  /** Give back a stream returned by acquire(). Pass reuse as false if the
+   *  call made on it did not finish cleanly, so it is closed instead.
+   */
+  void release(tcp_socket_stream * stream, bool reuse = true);
+
+  /** Keep at least count streams open to host and service, in use or
+   *  idle, opening them on the pool's thread. Idle streams up to this
+   *  count are not closed for age. Returns 0, or -1 if the host can't
+   *  be resolved.
+   */
+  int prewarm(const std::string & host, int service, std::size_t count);
+
+  /** Close idle streams which have been idle too long, or whose peer has
+   *  closed. Returns the number closed.
+   */
+  std::size_t reap();
+
+  /// Start the thread which reaps and prewarms streams.
+  int start();
+
+  /// Stop the thread and wait for it to finish.
+  void stop();
+
+  /// Return the number of idle streams to host and service.
+  std::size_t idle(const std::string & host, int service) const;
+
+  /// Return the number of streams to host and service in use.
+  std::size_t active(const std::string & host, int service) const;
+
+  /** Return the error from the last call on this thread which failed.
+   *  Each thread has its own for each pool, so a failure in another
+   *  thread, or in another pool, can't be seen.
+   */
+  int getLastError() const;
+
+  /** Return true if an idle stream is still connected, and has no data
+   *  waiting to be read. Does not block.
+   */
+  static bool isAlive(tcp_socket_stream & stream);
+
+private:
+  tcp_connection_pool(const tcp_connection_pool&);
+  tcp_connection_pool& operator=(const tcp_connection_pool&);
+
+  typedef unsigned long long tick_type;
+  typedef std::pair<std::string, int> endpoint_key;
+
+  struct idle_stream {
+    tcp_socket_stream * stream;
+    tick_type since;
+  };
+
+  struct endpoint {
+    tcp_address address;
+    /// Idle streams, the longest idle first.
+    std::deque<idle_stream> idle;
+    std::size_t active;
+    /// Streams being opened, which count towards the limit.
+    std::size_t opening;
+    std::size_t warm;
+
+    endpoint() : active(0), opening(0), warm(0) { }
+
+    std::size_t size() const {
+      return idle.size() + active + opening;
+    }
+  };
+
+  typedef std::map<endpoint_key, endpoint *> endpoint_map;
+  typedef std::map<tcp_socket_stream *, endpoint *> stream_map;
+  typedef std::map<std::thread::id, int> error_map;
+
+  mutable std::mutex _mutex;
+  /// Signalled when a stream is released or fails to open.
+  std::condition_variable _released;
+  /// Signalled to wake the pool's thread.
+  std::condition_variable _wake;
+  endpoint_map _endpoints;
+  stream_map _leased;
+  /// The last error for each thread which has had one.
+  error_map _errors;
+  socket_options _options;
+  std::size_t _max_per_endpoint;
+  tick_type _max_idle;
+  tick_type _connect_timeout;
+  std::thread _thread;
+  /// Read without the lock by the thread while it waits to connect.
+  std::atomic<bool> _running;
+
+  static tick_type now();
+
+  /// Record an error for the calling thread. Call with the lock held.
+  void setLastError(int error);
+
+  endpoint * findEndpoint(const std::string & host, int service,
+                          std::unique_lock<std::mutex> & lock);
+  const endpoint * findEndpoint(const std::string & host, int service) const;
+  tcp_socket_stream * connect(endpoint & e, bool background, int & error);
+  int waitConnected(tcp_socket_stream & stream, bool background);
+  std::size_t reapEndpoint(endpoint & e, tick_type when);
+  void run();
+};
+
+#endif // RGJ_FREE_SOCKET_POOL_H_
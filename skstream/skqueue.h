@@ -0,0 +1,113 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_QUEUE_H_
+#define RGJ_FREE_SOCKET_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+/////////////////////////////////////////////////////////////////////////////
+// class mpsc_queue
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Unbounded lock-free queue for many producers and one consumer.
+///
+/// Any thread may push(), but only one thread at a time may pop(). Pushing
+/// is a single atomic exchange, so producers never wait for each other or
+/// for the consumer. An item being pushed becomes visible to pop() once
+/// its producer has finished linking it in, so pop() can briefly return
+/// false while another push is still in progress. Producers which need
+/// the consumer to notice new items should signal it after pushing.
+template <typename T>
+class mpsc_queue {
+public:
+  mpsc_queue() : _tail(new node) {
+    _head.store(_tail);
+  }
+
+  ~mpsc_queue() {
+    T item;
+    while(pop(item)) { }
+    delete _tail;
+  }
+
+  /// Add an item. Safe to call from any thread.
+  void push(const T & item) {
+    link(new node(item));
+  }
+
+  void push(T && item) {
+    link(new node(std::move(item)));
+  }
+
+  /** Remove the oldest item. Returns false if the queue is empty. Must
+   *  only be called by the consuming thread.
+   */
+  bool pop(T & item) {
+    node * next = _tail->next.load(std::memory_order_acquire);
+    if(next == 0) {
+      return false;
+    }
+    item = std::move(next->value);
+    // next is now the stub, so don't let it hold on to anything.
+    next->value = T();
+    delete _tail;
+    _tail = next;
+    return true;
+  }
+
+  /// Return true if there is nothing to pop. Consumer only.
+  bool empty() const {
+    return _tail->next.load(std::memory_order_acquire) == 0;
+  }
+
+private:
+  mpsc_queue(const mpsc_queue&);
+  mpsc_queue& operator=(const mpsc_queue&);
+
+  struct node {
+    node() : next(0) { }
+    explicit node(const T & v) : next(0), value(v) { }
+    explicit node(T && v) : next(0), value(std::move(v)) { }
+
+    std::atomic<node *> next;
+    T value;
+  };
+
+  void link(node * n) {
+    node * prev = _head.exchange(n);
+    prev->next.store(n);
+  }
+
+  /// Most recently pushed node, where producers add.
+  std::atomic<node *> _head;
+  /// Node before the oldest item, where the consumer removes.
+  node * _tail;
+};
+
+#endif // RGJ_FREE_SOCKET_QUEUE_H_
@@ -0,0 +1,759 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skreactor.h>
+
+#include <skstream/skserver.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif // HAVE_SYS_EPOLL_H
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif // HAVE_SYS_EVENTFD_H
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#endif // _WIN32
+
+#include <algorithm>
+#include <chrono>
+
+static const int MAX_EVENTS = 256;
+
+static inline int waitMask(bool read, bool write)
+{
+  return (read ? basic_socket_poll::READ : 0) |
+         (write ? basic_socket_poll::WRITE : 0);
+}
+
+namespace {
+
+// Lets the wakeup descriptor be passed to basic_socket_poll.
+class wake_socket : public basic_socket {
+public:
+  explicit wake_socket(SOCKET_TYPE fd) : _fd(fd) { }
+
+  virtual SOCKET_TYPE getSocket() const {
+    return _fd;
+  }
+
+private:
+  SOCKET_TYPE _fd;
+};
+
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_reactor implementation
+/////////////////////////////////////////////////////////////////////////////
+
+socket_reactor::socket_reactor() : _timers(now()), _wake_pending(false),
+                                   _running(false), _closing(false),
+                                   _epfd(-1)
+{
+  _wakefd[0] = _wakefd[1] = -1;
+#ifdef HAVE_SYS_EVENTFD_H
+  _wakefd[0] = _wakefd[1] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif !defined(_WIN32)
+  if(::pipe(_wakefd) == 0) {
+    for(int i = 0; i < 2; ++i) {
+      ::fcntl(_wakefd[i], F_SETFL, ::fcntl(_wakefd[i], F_GETFL) | O_NONBLOCK);
+      ::fcntl(_wakefd[i], F_SETFD, FD_CLOEXEC);
+    }
+  } else {
+    _wakefd[0] = _wakefd[1] = -1;
+  }
+#endif // HAVE_SYS_EVENTFD_H
+
+#ifdef HAVE_SYS_EPOLL_H
+  _epfd = ::epoll_create1(EPOLL_CLOEXEC);
+  if(_epfd != -1 && _wakefd[0] != -1) {
+    // A null pointer marks the wakeup descriptor.
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = 0;
+    ::epoll_ctl(_epfd, EPOLL_CTL_ADD, _wakefd[0], &ev);
+  }
+#endif // HAVE_SYS_EPOLL_H
+}
+
+socket_reactor::~socket_reactor()
+{
+  // Take every waiting handler first, as those called may remove sockets.
+  _closing = true;
+  std::vector<wait_handler> waiting;
+  entry_map::const_iterator I = _entries.begin();
+  for(; I != _entries.end(); ++I) {
+    entry * e = I->second;
+    if(e->wait_read) {
+      waiting.push_back(wait_handler());
+      waiting.back().swap(e->wait_read);
+    }
+    if(e->wait_write) {
+      waiting.push_back(wait_handler());
+      waiting.back().swap(e->wait_write);
+    }
+  }
+  waiting.insert(waiting.end(), _sleepers.begin(), _sleepers.end());
+  _sleepers.clear();
+  std::vector<wait_handler>::const_iterator K = waiting.begin();
+  for(; K != waiting.end(); ++K) {
+    (*K)(false);
+  }
+
+  I = _entries.begin();
+  for(; I != _entries.end(); ++I) {
+    delete I->second;
+  }
+  std::vector<entry *>::const_iterator J = _removed.begin();
+  for(; J != _removed.end(); ++J) {
+    delete *J;
+  }
+#ifdef HAVE_SYS_EPOLL_H
+  if(_epfd != -1) {
+    ::close(_epfd);
+  }
+#endif // HAVE_SYS_EPOLL_H
+#ifndef _WIN32
+  if(_wakefd[0] != -1) {
+    ::close(_wakefd[0]);
+  }
+  if(_wakefd[1] != _wakefd[0]) {
+    ::close(_wakefd[1]);
+  }
+#endif // _WIN32
+}
+
+bool socket_reactor::usingEpoll() const
+{
+  return _epfd != -1;
+}
+
+timer_wheel::tick_type socket_reactor::now()
+{
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(
+      steady_clock::now().time_since_epoch()).count();
+}
+
+int socket_reactor::insert(entry * e)
+{
+  if(e->fd == INVALID_SOCKET) {
+    delete e;
+    return -1;
+  }
+  entry_map::const_iterator I = _entries.find(e->socket);
+  if(I != _entries.end()) {
+    entry * old = I->second;
+    if(!old->transient) {
+      delete e;
+      return -1;
+    }
+    // Take over anything waiting on a socket only watched by waitFor().
+    e->wait_read.swap(old->wait_read);
+    e->wait_write.swap(old->wait_write);
+    e->active |= waitMask(e->wait_read != nullptr, e->wait_write != nullptr);
+    remove(e->socket);
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if(_epfd != -1) {
+    struct epoll_event ev;
+    ev.events = 0;
+    ev.data.ptr = e;
+    if(e->active & basic_socket_poll::READ) {
+      ev.events |= EPOLLIN;
+    }
+    if(e->active & basic_socket_poll::WRITE) {
+      ev.events |= EPOLLOUT;
+    }
+    if(e->active & basic_socket_poll::EXCEPT) {
+      ev.events |= EPOLLPRI;
+    }
+    if(::epoll_ctl(_epfd, EPOLL_CTL_ADD, e->fd, &ev) != 0) {
+      delete e;
+      return -1;
+    }
+  }
+#endif // HAVE_SYS_EPOLL_H
+#ifndef _WIN32
+  // select() can't handle descriptors beyond the fd_set
+  if(_epfd == -1 && e->fd >= FD_SETSIZE) {
+    delete e;
+    return -1;
+  }
+#endif // _WIN32
+
+  _entries.insert(std::make_pair(e->socket, e));
+
+  if(e->stream != 0) {
+    check(e);
+  }
+
+  return 0;
+}
+
+int socket_reactor::update(entry * e)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  if(_epfd != -1) {
+    struct epoll_event ev;
+    ev.events = 0;
+    ev.data.ptr = e;
+    if(e->active & basic_socket_poll::READ) {
+      ev.events |= EPOLLIN;
+    }
+    if(e->active & basic_socket_poll::WRITE) {
+      ev.events |= EPOLLOUT;
+    }
+    if(e->active & basic_socket_poll::EXCEPT) {
+      ev.events |= EPOLLPRI;
+    }
+    return ::epoll_ctl(_epfd, EPOLL_CTL_MOD, e->fd, &ev);
+  }
+#endif // HAVE_SYS_EPOLL_H
+  return 0;
+}
+
+int socket_reactor::add(basic_socket * sock, int mask, const handler & h)
+{
+  entry * e = new entry;
+  e->socket = sock;
+  e->stream = 0;
+  e->fd = sock->getSocket();
+  e->mask = mask & basic_socket_poll::MASK;
+  e->active = e->mask;
+  e->buffered = false;
+  e->on_event = h;
+  e->idle_timeout = 0;
+  e->idle_timer = 0;
+  e->transient = false;
+
+  return insert(e);
+}
+
+int socket_reactor::addStream(stream_socket_stream * stream, int mask,
+                              const handler & h)
+{
+  entry * e = new entry;
+  e->socket = stream;
+  e->stream = stream;
+  e->fd = stream->getSocket();
+  e->mask = mask & basic_socket_poll::MASK;
+  e->active = e->mask;
+  e->buffered = false;
+  e->on_event = h;
+  e->idle_timeout = 0;
+  e->idle_timer = 0;
+  e->transient = false;
+
+  return insert(e);
+}
+
+int socket_reactor::addAcceptor(basic_socket_server * server,
+                                const accept_handler & h)
+{
+  return add(server, basic_socket_poll::READ, [server, h](poll_type) {
+    SOCKET_TYPE sock = ::accept(server->getSocket(), 0, 0);
+    if(sock != INVALID_SOCKET) {
+      server->getAcceptOptions().apply(sock);
+      h(sock);
+    }
+  });
+}
+
+int socket_reactor::waitFor(basic_socket * sock, poll_type events,
+                            const wait_handler & h)
+{
+  if(_closing) {
+    return -1;
+  }
+  if(events != basic_socket_poll::READ && events != basic_socket_poll::WRITE) {
+    return -1;
+  }
+
+  entry_map::const_iterator I = _entries.find(sock);
+  if(I == _entries.end() || (I->second->transient &&
+                             I->second->fd != sock->getSocket())) {
+    entry * e = new entry;
+    e->socket = sock;
+    e->stream = 0;
+    e->fd = sock->getSocket();
+    e->mask = 0;
+    e->buffered = false;
+    e->idle_timeout = 0;
+    e->idle_timer = 0;
+    e->transient = true;
+    if(I != _entries.end()) {
+      // The socket has a new descriptor since it was last watched.
+      e->wait_read.swap(I->second->wait_read);
+      e->wait_write.swap(I->second->wait_write);
+      remove(sock);
+    }
+    wait_handler & wait = (events == basic_socket_poll::READ) ? e->wait_read
+                                                              : e->wait_write;
+    if(wait) {
+      delete e;
+      return -1;
+    }
+    wait = h;
+    e->active = waitMask(e->wait_read != nullptr, e->wait_write != nullptr);
+    return insert(e);
+  }
+
+  entry * e = I->second;
+  wait_handler & wait = (events == basic_socket_poll::READ) ? e->wait_read
+                                                            : e->wait_write;
+  if(wait) {
+    return -1;
+  }
+  wait = h;
+  if(e->stream != 0) {
+    check(e);
+    return 0;
+  }
+  updateActive(e);
+  return 0;
+}
+
+// Wait for the events the owner asked for, and any handlers are waiting for.
+void socket_reactor::updateActive(entry * e)
+{
+  int active = e->mask | waitMask(e->wait_read != nullptr,
+                                  e->wait_write != nullptr);
+  if(active != e->active) {
+    e->active = active;
+    update(e);
+  }
+}
+
+int socket_reactor::modify(basic_socket * sock, int mask)
+{
+  entry_map::const_iterator I = _entries.find(sock);
+  if(I == _entries.end()) {
+    return -1;
+  }
+  entry * e = I->second;
+  e->mask = mask & basic_socket_poll::MASK;
+  if(e->stream != 0) {
+    check(e);
+    return 0;
+  }
+  updateActive(e);
+  return 0;
+}
+
+void socket_reactor::refresh(basic_socket * sock)
+{
+  entry_map::const_iterator I = _entries.find(sock);
+  if(I != _entries.end() && I->second->stream != 0) {
+    check(I->second);
+  }
+}
+
+void socket_reactor::remove(basic_socket * sock)
+{
+  entry_map::iterator I = _entries.find(sock);
+  if(I == _entries.end()) {
+    return;
+  }
+  entry * e = I->second;
+  _timers.cancel(e->idle_timer);
+#ifdef HAVE_SYS_EPOLL_H
+  // This fails harmlessly if the socket has already been closed.
+  if(_epfd != -1) {
+    struct epoll_event ev;
+    ::epoll_ctl(_epfd, EPOLL_CTL_DEL, e->fd, &ev);
+  }
+#endif // HAVE_SYS_EPOLL_H
+  if(e->buffered) {
+    // Queued by check() for the next poll, which would find it deleted.
+    _buffered.erase(std::remove(_buffered.begin(), _buffered.end(), e),
+                    _buffered.end());
+  }
+  // Handlers may still be queued for dispatch, so defer deletion.
+  e->socket = 0;
+  e->stream = 0;
+  e->buffered = false;
+  wait_handler on_read, on_write;
+  on_read.swap(e->wait_read);
+  on_write.swap(e->wait_write);
+  _removed.push_back(e);
+  _entries.erase(I);
+
+  // Nothing still waiting will see the socket ready now.
+  if(on_read) {
+    on_read(false);
+  }
+  if(on_write) {
+    on_write(false);
+  }
+}
+
+// Work out what the reactor needs to wait for on behalf of a stream.
+void socket_reactor::check(entry * e)
+{
+  int active = e->mask | waitMask(e->wait_read != nullptr,
+                                  e->wait_write != nullptr);
+  if(e->stream->nonBlocking() && e->stream->pendingBytes() > 0) {
+    active |= basic_socket_poll::WRITE;
+  }
+  if(active != e->active) {
+    e->active = active;
+    update(e);
+  }
+  if((e->mask & basic_socket_poll::READ) && !e->buffered &&
+     e->stream->rdbuf()->in_avail() > 0) {
+    // Already read from the socket, so it won't show up as readable.
+    e->buffered = true;
+    _buffered.push_back(e);
+  }
+}
+
+void socket_reactor::dispatch(entry * e, int events)
+{
+  e->buffered = false;
+
+  // One-shot waits first. Each may set up another wait, or remove the socket.
+  wait_handler on_read, on_write;
+  if(events & basic_socket_poll::READ) {
+    on_read.swap(e->wait_read);
+  }
+  if(events & basic_socket_poll::WRITE) {
+    on_write.swap(e->wait_write);
+  }
+  if(e->transient && !e->wait_read && !e->wait_write) {
+    // Unregister first, so a handler can wait again on a new descriptor.
+    remove(e->socket);
+  }
+  if(on_read) {
+    on_read(true);
+  }
+  if(on_write) {
+    on_write(true);
+  }
+  if(e->socket == 0) {
+    return;
+  }
+  if(e->transient) {
+    updateActive(e);
+    return;
+  }
+
+  if(e->stream != 0 && (events & basic_socket_poll::WRITE) &&
+     e->stream->nonBlocking() && e->stream->pendingBytes() > 0) {
+    e->stream->flush();
+  }
+
+  events &= e->mask;
+  if(events != 0) {
+    e->on_event((poll_type)events);
+    if(e->socket != 0 && e->idle_timeout != 0) {
+      restartIdle(e);
+    }
+  }
+
+  // The handler may have removed this socket.
+  if(e->socket != 0) {
+    if(e->stream != 0) {
+      check(e);
+    } else {
+      updateActive(e);
+    }
+  }
+}
+
+socket_reactor::timer_id socket_reactor::addTimer(unsigned long milliseconds,
+                                                  const timer_handler & h)
+{
+  return _timers.scheduleAt(now() + milliseconds, h);
+}
+
+int socket_reactor::sleepFor(unsigned long milliseconds,
+                             const wait_handler & h)
+{
+  if(_closing) {
+    return -1;
+  }
+  std::list<wait_handler>::iterator I = _sleepers.insert(_sleepers.end(), h);
+  addTimer(milliseconds, [this, I]() {
+    wait_handler woken;
+    woken.swap(*I);
+    _sleepers.erase(I);
+    woken(true);
+  });
+  return 0;
+}
+
+void socket_reactor::cancelTimer(timer_id id)
+{
+  _timers.cancel(id);
+}
+
+int socket_reactor::setIdleTimeout(basic_socket * sock,
+                                   unsigned long milliseconds,
+                                   const timer_handler & h)
+{
+  entry_map::const_iterator I = _entries.find(sock);
+  if(I == _entries.end()) {
+    return -1;
+  }
+  entry * e = I->second;
+  e->idle_timeout = milliseconds;
+  e->on_idle = h;
+  if(milliseconds != 0) {
+    restartIdle(e);
+  } else {
+    _timers.cancel(e->idle_timer);
+    e->idle_timer = 0;
+  }
+  return 0;
+}
+
+void socket_reactor::restartIdle(entry * e)
+{
+  _timers.cancel(e->idle_timer);
+  e->idle_timer = _timers.scheduleAt(now() + e->idle_timeout, [e]() {
+    e->idle_timer = 0;
+    e->idle_timeout = 0;
+    // The handler may replace itself by setting a new timeout.
+    timer_handler h = e->on_idle;
+    h();
+  });
+}
+
+int socket_reactor::runTimers()
+{
+  if(_timers.size() == 0) {
+    return 0;
+  }
+  return _timers.advance(now());
+}
+
+unsigned long socket_reactor::nextTimeout(unsigned long timeout) const
+{
+  if(!_buffered.empty()) {
+    return 0;
+  }
+  const timer_wheel::tick_type deadline = _timers.nextExpiry();
+  if(deadline == timer_wheel::never) {
+    return timeout;
+  }
+  const timer_wheel::tick_type time = now();
+  if(deadline <= time) {
+    return 0;
+  }
+  if(deadline - time < timeout) {
+    return deadline - time;
+  }
+  return timeout;
+}
+
+void socket_reactor::post(const timer_handler & task)
+{
+  _tasks.push(task);
+  wakeup();
+}
+
+void socket_reactor::wakeup()
+{
+  // Only the first wakeup since the reactor last ran its tasks writes.
+  if(_wake_pending.exchange(true) || _wakefd[1] == -1) {
+    return;
+  }
+#ifndef _WIN32
+# ifdef HAVE_SYS_EVENTFD_H
+  const eventfd_t one = 1;
+# else // HAVE_SYS_EVENTFD_H
+  const char one = 0;
+# endif // HAVE_SYS_EVENTFD_H
+  ssize_t ret = ::write(_wakefd[1], &one, sizeof(one));
+  (void)ret;
+#endif // _WIN32
+}
+
+void socket_reactor::runTasks()
+{
+  _wake_pending.store(false);
+  timer_handler task;
+  while(_tasks.pop(task)) {
+    task();
+  }
+}
+
+// Empty the wakeup descriptor so it stops being readable.
+static void drainWakeup(int fd)
+{
+#ifndef _WIN32
+  char buf[64];
+  while(::read(fd, buf, sizeof(buf)) > 0) { }
+#endif // _WIN32
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+int socket_reactor::waitEpoll(unsigned long timeout)
+{
+  int dispatched = 0;
+  struct epoll_event events[MAX_EVENTS];
+  int count = ::epoll_wait(_epfd, events, MAX_EVENTS, (int)timeout);
+  if(count < 0) {
+    if(errno != EINTR) {
+      return -1;
+    }
+    count = 0;
+  }
+
+  for(int i = 0; i < count; ++i) {
+    entry * e = static_cast<entry *>(events[i].data.ptr);
+    if(e == 0) {
+      drainWakeup(_wakefd[0]);
+      continue;
+    }
+    if(e->socket == 0) {
+      continue;
+    }
+    int ready = 0;
+    if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+      // Let the handler discover the error by reading or writing.
+      ready |= basic_socket_poll::READ | basic_socket_poll::WRITE;
+    }
+    if(events[i].events & EPOLLIN) {
+      ready |= basic_socket_poll::READ;
+    }
+    if(events[i].events & EPOLLOUT) {
+      ready |= basic_socket_poll::WRITE;
+    }
+    if(events[i].events & EPOLLPRI) {
+      ready |= basic_socket_poll::EXCEPT;
+    }
+    dispatch(e, ready);
+    ++dispatched;
+  }
+  return dispatched;
+}
+#endif // HAVE_SYS_EPOLL_H
+
+int socket_reactor::waitSelect(unsigned long timeout)
+{
+  int dispatched = 0;
+  basic_socket_poll::socket_map sockets;
+  entry_map::const_iterator I = _entries.begin();
+  for(; I != _entries.end(); ++I) {
+    sockets.insert(std::make_pair(I->first, (poll_type)I->second->active));
+  }
+  wake_socket waker(_wakefd[0]);
+  if(_wakefd[0] != -1) {
+    sockets.insert(std::make_pair(&waker, basic_socket_poll::READ));
+  }
+
+  if(_poll.poll(sockets, timeout) < 0) {
+    return -1;
+  }
+  if(_poll.isReady(&waker, basic_socket_poll::READ) != 0) {
+    drainWakeup(_wakefd[0]);
+  }
+
+  std::vector<entry *> ready;
+  for(I = _entries.begin(); I != _entries.end(); ++I) {
+    if(_poll.isReady(I->first, (poll_type)I->second->active) != 0) {
+      ready.push_back(I->second);
+    }
+  }
+
+  std::vector<entry *>::const_iterator J = ready.begin();
+  for(; J != ready.end(); ++J) {
+    entry * e = *J;
+    if(e->socket == 0) {
+      continue;
+    }
+    dispatch(e, _poll.isReady(e->socket, (poll_type)e->active));
+    ++dispatched;
+  }
+  return dispatched;
+}
+
+int socket_reactor::poll(unsigned long timeout)
+{
+  std::vector<entry *> buffered;
+  buffered.swap(_buffered);
+  if(!buffered.empty()) {
+    timeout = 0;
+  }
+  timeout = nextTimeout(timeout);
+
+  int dispatched = -1;
+#ifdef HAVE_SYS_EPOLL_H
+  if(_epfd != -1) {
+    dispatched = waitEpoll(timeout);
+  }
+#endif // HAVE_SYS_EPOLL_H
+  if(_epfd == -1) {
+    dispatched = waitSelect(timeout);
+  }
+  if(dispatched < 0) {
+    return -1;
+  }
+
+  // Streams which already had data in their buffers.
+  std::vector<entry *>::const_iterator K = buffered.begin();
+  for(; K != buffered.end(); ++K) {
+    entry * e = *K;
+    if(e->socket != 0 && e->buffered) {
+      dispatch(e, basic_socket_poll::READ);
+      ++dispatched;
+    }
+  }
+
+  runTimers();
+  runTasks();
+
+  std::vector<entry *>::const_iterator L = _removed.begin();
+  for(; L != _removed.end(); ++L) {
+    delete *L;
+  }
+  _removed.clear();
+
+  return dispatched;
+}
+
+void socket_reactor::run()
+{
+  _running = true;
+  while(_running) {
+    if(poll(1000) < 0 && errno != EINTR) {
+      break;
+    }
+  }
+}
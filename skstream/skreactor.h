@@ -0,0 +1,224 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_REACTOR_H_
+#define RGJ_FREE_SOCKET_REACTOR_H_
+
+#include <skstream/skpoll.h>
+#include <skstream/skqueue.h>
+#include <skstream/sktimer.h>
+
+#include <atomic>
+
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+
+class basic_socket_server;
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_reactor
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Event loop which calls handlers for sockets as they become ready.
+///
+/// Sockets are registered with the events they are interested in, and
+/// only sockets which are ready have their handlers called. epoll is used
+/// where available, otherwise, or if it can't be set up, basic_socket_poll
+/// (select) is used. Timers
+/// are kept in a timer_wheel, and the wait is cut short when one is due.
+/// A reactor belongs to the thread which polls it, and the only methods
+/// which may be called from other threads are post() and wakeup().
+class socket_reactor {
+public:
+  typedef basic_socket_poll::poll_type poll_type;
+  /// Called with the events a socket is ready for.
+  typedef std::function<void(poll_type)> handler;
+  /// Called with each connection accepted on a listen socket.
+  typedef std::function<void(SOCKET_TYPE)> accept_handler;
+  typedef std::function<void()> timer_handler;
+  /// Called with true once a socket is ready, or false if it never will be.
+  typedef std::function<void(bool)> wait_handler;
+  typedef timer_wheel::timer_id timer_id;
+
+  socket_reactor();
+  /** Calls the handlers still waiting in waitFor() or sleepFor() with
+   *  false, so suspended coroutines can finish.
+   */
+  ~socket_reactor();
+
+  /// Register a socket to have its handler called for events in mask.
+  int add(basic_socket * sock, int mask, const handler & h);
+
+  /** Register a stream socket. As well as the events in mask, the
+   *  reactor flushes output queued by a non-blocking stream when the
+   *  socket becomes writable, and reports input already in the stream
+   *  buffer as READ.
+   */
+  int addStream(stream_socket_stream * stream, int mask, const handler & h);
+
+  /** Register a listen socket. Each time a connection is waiting it is
+   *  accepted and passed to the handler.
+   */
+  int addAcceptor(basic_socket_server * server, const accept_handler & h);
+
+  /** Call the handler once, the next time the socket is ready for READ
+   *  or for WRITE, with true. The socket need not have been added, in
+   *  which case it is only watched until the handler has been called. One
+   *  handler may wait for each of READ and WRITE on a socket at a time.
+   *  Handlers still waiting when a socket is removed are called from
+   *  remove() with false, as are those still waiting when the reactor is
+   *  destroyed. Returns 0, or -1 if a handler is already waiting or the
+   *  reactor is being destroyed.
+   */
+  int waitFor(basic_socket * sock, poll_type events, const wait_handler & h);
+
+  /// Change the events a registered socket is interested in.
+  int modify(basic_socket * sock, int mask);
+
+  /** Re-check the buffers of a stream registered with addStream(). This
+   *  is only needed after writing to the stream outside its handler.
+   */
+  void refresh(basic_socket * sock);
+
+  /// Stop watching a socket. Safe to call from within a handler.
+  void remove(basic_socket * sock);
+
+  /// Call the handler once after the given number of milliseconds.
+  timer_id addTimer(unsigned long milliseconds, const timer_handler & h);
+
+  /** Call the handler once after the given number of milliseconds with
+   *  true. Handlers still waiting when the reactor is destroyed are
+   *  called then with false. Returns 0, or -1 once the reactor is being
+   *  destroyed.
+   */
+  int sleepFor(unsigned long milliseconds, const wait_handler & h);
+
+  /// Cancel a timer which has not yet fired.
+  void cancelTimer(timer_id id);
+
+  /** Call the handler if a registered socket goes the given number of
+   *  milliseconds without an event. The timeout is restarted each time the
+   *  socket's handler is called, and the handler is called only once. A
+   *  timeout of zero disables it.
+   */
+  int setIdleTimeout(basic_socket * sock, unsigned long milliseconds,
+                     const timer_handler & h);
+
+  /** Wait up to timeout milliseconds for events or timers, and call
+   *  handlers for whatever is ready. Returns the number of socket handlers
+   *  called, or -1 on error.
+   */
+  int poll(unsigned long timeout);
+
+  /// Run until stop() is called.
+  void run();
+
+  /** Call a function from the thread running the reactor, during its next
+   *  poll. Safe to call from any thread, and wakes the reactor if it is
+   *  waiting.
+   */
+  void post(const timer_handler & task);
+
+  /// Make a waiting poll() return early. Safe to call from any thread.
+  void wakeup();
+
+  /// Make run() return after the current iteration.
+  void stop() {
+    _running = false;
+  }
+
+  /// Return the number of registered sockets.
+  std::size_t size() const {
+    return _entries.size();
+  }
+
+  /** Return true if epoll is being used rather than select. The reactor
+   *  falls back to select if epoll can't be set up.
+   */
+  bool usingEpoll() const;
+
+private:
+  socket_reactor(const socket_reactor&);
+  socket_reactor& operator=(const socket_reactor&);
+
+  struct entry {
+    basic_socket * socket;
+    stream_socket_stream * stream;
+    SOCKET_TYPE fd;
+    /// Events requested by the owner.
+    int mask;
+    /// Events being waited for, including any added by the reactor.
+    int active;
+    bool buffered;
+    handler on_event;
+    unsigned long idle_timeout;
+    timer_id idle_timer;
+    timer_handler on_idle;
+    /// One-shot handlers set by waitFor().
+    wait_handler wait_read;
+    wait_handler wait_write;
+    /// Only registered by waitFor(), so removed once nothing is waiting.
+    bool transient;
+  };
+
+  typedef std::map<const basic_socket *, entry *> entry_map;
+
+  entry_map _entries;
+  std::vector<entry *> _removed;
+  std::vector<entry *> _buffered;
+  /// Handlers waiting in sleepFor().
+  std::list<wait_handler> _sleepers;
+  timer_wheel _timers;
+  mpsc_queue<timer_handler> _tasks;
+  std::atomic<bool> _wake_pending;
+  bool _running;
+  /// Set once the destructor has started, after which nothing may wait.
+  bool _closing;
+  int _epfd;
+  /// Read and write ends of the wakeup pipe, which are the same eventfd
+  /// where that is available.
+  int _wakefd[2];
+  basic_socket_poll _poll;
+
+  int insert(entry * e);
+  int update(entry * e);
+  void dispatch(entry * e, int events);
+  void check(entry * e);
+  void restartIdle(entry * e);
+  void updateActive(entry * e);
+  int waitEpoll(unsigned long timeout);
+  int waitSelect(unsigned long timeout);
+  int runTimers();
+  unsigned long nextTimeout(unsigned long timeout) const;
+  void runTasks();
+
+  static timer_wheel::tick_type now();
+};
+
+#endif // RGJ_FREE_SOCKET_REACTOR_H_
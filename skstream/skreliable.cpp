@@ -0,0 +1,555 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skreliable.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <errno.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+// Packet header: flags, packet number, newest packet received and the
+// bitmap of the 32 packets before it. Each message then has its channel,
+// mode, number on the channel and length.
+static const std::size_t HEADER_SIZE = 13;
+static const std::size_t MESSAGE_HEADER_SIZE = 8;
+
+static const unsigned char FLAG_DATA = 1 << 0;
+static const unsigned char FLAG_ACK = 1 << 1;
+
+/// Packets a later one must overtake before an earlier one is lost.
+static const int32_t REORDER_THRESHOLD = 3;
+
+static const reliable_channel::tick_type INITIAL_RTO = 100;
+static const reliable_channel::tick_type MIN_RTO = 10;
+static const reliable_channel::tick_type MAX_RTO = 2000;
+
+static const double INITIAL_WINDOW = 10;
+static const double MIN_WINDOW = 2;
+static const double MAX_WINDOW = 1024;
+static const double MIN_BURST = 4;
+/// Pace a little faster than the window needs, so pacing alone never
+/// holds back a window's worth of packets.
+static const double PACING_GAIN = 1.25;
+
+const unsigned reliable_channel::CHANNELS;
+const std::size_t reliable_channel::MAX_PACKET;
+const std::size_t reliable_channel::MAX_MESSAGE =
+      reliable_channel::MAX_PACKET - HEADER_SIZE - MESSAGE_HEADER_SIZE;
+const reliable_channel::tick_type reliable_channel::never;
+
+static inline void put16(std::string & s, unsigned value)
+{
+  s += (char)(value >> 8);
+  s += (char)value;
+}
+
+static inline void put32(std::string & s, uint32_t value)
+{
+  s += (char)(value >> 24);
+  s += (char)(value >> 16);
+  s += (char)(value >> 8);
+  s += (char)value;
+}
+
+static inline unsigned get16(const char * p)
+{
+  const unsigned char * u = (const unsigned char *)p;
+  return (u[0] << 8) | u[1];
+}
+
+static inline uint32_t get32(const char * p)
+{
+  const unsigned char * u = (const unsigned char *)p;
+  return ((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) |
+         ((uint32_t)u[2] << 8) | u[3];
+}
+
+static inline bool isWouldBlock(int error)
+{
+  #ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+  #else
+    return error == EAGAIN || error == EWOULDBLOCK;
+  #endif
+}
+
+static inline int pollSocket(struct pollfd * fds, int timeout)
+{
+  #ifdef _WIN32
+    return ::WSAPoll(fds, 1, timeout);
+  #else
+    return ::poll(fds, 1, timeout);
+  #endif
+}
+
+reliable_channel::reliable_channel(dgram_socket_stream & stream) :
+    _stream(stream), _next_message(0), _next_packet(0), _in_flight(0),
+    _any_acked(false), _largest_acked(0),
+    _received_any(false), _received_newest(0), _received_bits(0),
+    _ack_pending(false),
+    _srtt(0), _rttvar(0), _rto(INITIAL_RTO), _have_rtt(false),
+    _cwnd(INITIAL_WINDOW), _ssthresh(MAX_WINDOW), _recovery(0),
+    _tokens(MIN_BURST), _last_refill(0), _started(false),
+    _lost(0), _retransmitted(0), _last_error(0)
+{
+  for(unsigned i = 0; i < CHANNELS; ++i) {
+    _modes[i] = ORDERED;
+    _next_sequence[i] = 0;
+    _incoming[i].next = 0;
+  }
+}
+
+reliable_channel::~reliable_channel()
+{
+}
+
+int reliable_channel::send(unsigned channel, const char * data,
+                           std::size_t size)
+{
+  if(channel >= CHANNELS) {
+    _last_error = EINVAL;
+    return -1;
+  }
+  if(size > MAX_MESSAGE) {
+    _last_error = EMSGSIZE;
+    return -1;
+  }
+  outgoing & o = _messages[_next_message];
+  o.channel = channel;
+  o.mode = _modes[channel];
+  o.sequence = (o.mode == UNRELIABLE) ? 0 : _next_sequence[channel]++;
+  o.data.assign(data, size);
+  _queue.push_back(_next_message++);
+  return 0;
+}
+
+void reliable_channel::acknowledge(uint32_t sequence, tick_type now,
+                                   bool newest)
+{
+  if(_sent.empty()) {
+    return;
+  }
+  uint32_t offset = sequence - _sent.front().sequence;
+  if(offset >= _sent.size() || _sent[offset].resolved) {
+    return;
+  }
+  sent_packet & p = _sent[offset];
+  p.resolved = true;
+  --_in_flight;
+  for(std::size_t i = 0; i < p.messages.size(); ++i) {
+    _messages.erase(p.messages[i]);
+  }
+
+  if(!_any_acked || (int32_t)(sequence - _largest_acked) > 0) {
+    _largest_acked = sequence;
+    _any_acked = true;
+  }
+
+  // Only the newest packet acknowledged gives a fair round trip time, as
+  // the others may have been acknowledged before.
+  if(newest) {
+    tick_type sample = now - p.sent;
+    if(!_have_rtt) {
+      _srtt = sample;
+      _rttvar = sample / 2;
+      _have_rtt = true;
+    } else {
+      tick_type diff = sample > _srtt ? sample - _srtt : _srtt - sample;
+      _rttvar = (3 * _rttvar + diff) / 4;
+      _srtt = (7 * _srtt + sample) / 8;
+    }
+    _rto = std::min(std::max(_srtt + std::max<tick_type>(1, 4 * _rttvar),
+                             MIN_RTO), MAX_RTO);
+  }
+
+  if(_cwnd < _ssthresh) {
+    _cwnd += 1;
+  } else {
+    _cwnd += 1 / _cwnd;
+  }
+  _cwnd = std::min(_cwnd, MAX_WINDOW);
+}
+
+void reliable_channel::packetLost(sent_packet & p)
+{
+  p.resolved = true;
+  --_in_flight;
+  ++_lost;
+  for(std::size_t i = 0; i < p.messages.size(); ++i) {
+    if(_messages.find(p.messages[i]) != _messages.end()) {
+      _resend.push_back(p.messages[i]);
+    }
+  }
+  // Shrink the window once for each round of losses.
+  if((int32_t)(p.sequence - _recovery) >= 0) {
+    _cwnd = std::max(_cwnd / 2, MIN_WINDOW);
+    _ssthresh = _cwnd;
+    _recovery = _next_packet;
+  }
+}
+
+void reliable_channel::detectLoss(tick_type now)
+{
+  bool timed_out = false;
+  for(std::size_t i = 0; i < _sent.size(); ++i) {
+    sent_packet & p = _sent[i];
+    if(p.resolved) {
+      continue;
+    }
+    if(_any_acked &&
+       (int32_t)(_largest_acked - p.sequence) >= REORDER_THRESHOLD) {
+      packetLost(p);
+    } else if(now >= p.sent + _rto) {
+      packetLost(p);
+      timed_out = true;
+    }
+  }
+  if(timed_out) {
+    _rto = std::min(_rto * 2, MAX_RTO);
+  }
+  while(!_sent.empty() && _sent.front().resolved) {
+    _sent.pop_front();
+  }
+}
+
+void reliable_channel::receivePacket(uint32_t sequence, bool & duplicate)
+{
+  duplicate = false;
+  if(!_received_any) {
+    _received_any = true;
+    _received_newest = sequence;
+    _received_bits = 0;
+    return;
+  }
+  int32_t ahead = sequence - _received_newest;
+  if(ahead > 32) {
+    _received_bits = 0;
+    _received_newest = sequence;
+  } else if(ahead > 0) {
+    _received_bits = (uint32_t)(((uint64_t)_received_bits << ahead) |
+                                (1ULL << (ahead - 1)));
+    _received_newest = sequence;
+  } else if(ahead == 0) {
+    duplicate = true;
+  } else if(-ahead <= 32) {
+    uint32_t bit = 1U << (-ahead - 1);
+    if(_received_bits & bit) {
+      duplicate = true;
+    }
+    _received_bits |= bit;
+  }
+  // Packets too old for the bitmap are handled, and the channels drop
+  // any messages already delivered.
+}
+
+void reliable_channel::deliver(unsigned channel, mode m, uint32_t sequence,
+                               const char * data, std::size_t size)
+{
+  incoming & in = _incoming[channel];
+  if(m == UNRELIABLE) {
+    if(_on_message) {
+      _on_message(channel, data, size);
+    }
+    return;
+  }
+  if((int32_t)(sequence - in.next) < 0) {
+    return;
+  }
+
+  if(m == RELIABLE) {
+    if(!in.delivered.insert(sequence).second) {
+      return;
+    }
+    if(_on_message) {
+      _on_message(channel, data, size);
+    }
+    while(in.delivered.erase(in.next) != 0) {
+      ++in.next;
+    }
+    return;
+  }
+
+  if(sequence != in.next) {
+    in.held.insert(std::make_pair(sequence, std::string(data, size)));
+    return;
+  }
+  if(_on_message) {
+    _on_message(channel, data, size);
+  }
+  ++in.next;
+  std::map<uint32_t, std::string>::iterator I;
+  while((I = in.held.find(in.next)) != in.held.end()) {
+    std::string held;
+    held.swap(I->second);
+    in.held.erase(I);
+    ++in.next;
+    if(_on_message) {
+      _on_message(channel, held.data(), held.size());
+    }
+  }
+}
+
+int reliable_channel::input(const char * data, std::size_t size,
+                            tick_type now)
+{
+  if(size < HEADER_SIZE) {
+    _last_error = EINVAL;
+    return -1;
+  }
+  unsigned char flags = data[0];
+  uint32_t sequence = get32(data + 1);
+  uint32_t ack = get32(data + 5);
+  uint32_t bits = get32(data + 9);
+
+  if(flags & FLAG_ACK) {
+    acknowledge(ack, now, true);
+    for(int i = 0; i < 32; ++i) {
+      if(bits & (1U << i)) {
+        acknowledge(ack - 1 - i, now, false);
+      }
+    }
+    detectLoss(now);
+  }
+
+  if(!(flags & FLAG_DATA)) {
+    return 0;
+  }
+  bool duplicate;
+  receivePacket(sequence, duplicate);
+  // Acknowledge duplicates too, as our acknowledgement may have been lost.
+  _ack_pending = true;
+  if(duplicate) {
+    return 0;
+  }
+
+  std::size_t offset = HEADER_SIZE;
+  while(offset < size) {
+    if(size - offset < MESSAGE_HEADER_SIZE) {
+      _last_error = EINVAL;
+      return -1;
+    }
+    unsigned channel = (unsigned char)data[offset];
+    unsigned m = (unsigned char)data[offset + 1];
+    uint32_t message = get32(data + offset + 2);
+    std::size_t length = get16(data + offset + 6);
+    offset += MESSAGE_HEADER_SIZE;
+    if(channel >= CHANNELS || m > UNRELIABLE || size - offset < length) {
+      _last_error = EINVAL;
+      return -1;
+    }
+    deliver(channel, (mode)m, message, data + offset, length);
+    offset += length;
+  }
+  return 0;
+}
+
+int reliable_channel::receive(tick_type now)
+{
+  SOCKET_TYPE sock = _stream.getSocket();
+  int count = 0;
+  for(;;) {
+    // Datagrams the stream has already read come first, and only then is
+    // the socket checked, so a blocking socket is never waited on.
+    if(!_stream.datagramBuffered()) {
+      struct pollfd pfd;
+      pfd.fd = sock;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if(pollSocket(&pfd, 0) <= 0) {
+        break;
+      }
+    }
+
+    datagram_view datagram;
+    int size = _stream.receiveDatagram(datagram);
+    if(size < 0) {
+      if(isWouldBlock(_stream.getLastError())) {
+        break;
+      }
+      _last_error = _stream.getLastError();
+      return -1;
+    }
+    // Malformed datagrams are dropped.
+    if(input(datagram.data, size, now) == 0) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+double reliable_channel::rate() const
+{
+  return _cwnd * PACING_GAIN / std::max<tick_type>(_srtt, 1);
+}
+
+double reliable_channel::burst() const
+{
+  return std::max(MIN_BURST, _cwnd / 4);
+}
+
+void reliable_channel::refill(tick_type now)
+{
+  if(now > _last_refill) {
+    _tokens = std::min(_tokens + (now - _last_refill) * rate(), burst());
+    _last_refill = now;
+  }
+}
+
+int reliable_channel::sendPacket(tick_type now, bool ack_only)
+{
+  _packet.clear();
+  _packet += (char)((ack_only ? 0 : FLAG_DATA) |
+                    (_received_any ? FLAG_ACK : 0));
+  put32(_packet, _next_packet);
+  put32(_packet, _received_newest);
+  put32(_packet, _received_bits);
+
+  sent_packet p;
+  p.sequence = _next_packet;
+  p.sent = now;
+  p.resolved = false;
+
+  if(!ack_only) {
+    for(;;) {
+      std::deque<uint64_t> & queue = _resend.empty() ? _queue : _resend;
+      if(queue.empty()) {
+        break;
+      }
+      uint64_t id = queue.front();
+      std::unordered_map<uint64_t, outgoing>::iterator I = _messages.find(id);
+      if(I == _messages.end()) {
+        // Acknowledged since it was found lost.
+        queue.pop_front();
+        continue;
+      }
+      const outgoing & o = I->second;
+      if(_packet.size() + MESSAGE_HEADER_SIZE + o.data.size() > MAX_PACKET) {
+        break;
+      }
+      _packet += (char)o.channel;
+      _packet += (char)o.mode;
+      put32(_packet, o.sequence);
+      put16(_packet, o.data.size());
+      _packet += o.data;
+      if(&queue == &_resend) {
+        ++_retransmitted;
+      }
+      queue.pop_front();
+      if(o.mode == UNRELIABLE) {
+        _messages.erase(I);
+      } else {
+        p.messages.push_back(id);
+      }
+    }
+    if(_packet.size() == HEADER_SIZE) {
+      return 0;
+    }
+  }
+  _ack_pending = false;
+
+  if(!_loss_model || !_loss_model(_packet.data(), _packet.size())) {
+    if(_stream.sendDatagram(_packet.data(), _packet.size()) < 0 &&
+       !isWouldBlock(_stream.getLastError())) {
+      // A full socket buffer is left to look like a loss.
+      _last_error = _stream.getLastError();
+      return -1;
+    }
+  }
+
+  if(!ack_only) {
+    _sent.push_back(p);
+    ++_next_packet;
+    ++_in_flight;
+  }
+  return 1;
+}
+
+int reliable_channel::update(tick_type now)
+{
+  if(!_started) {
+    _last_refill = now;
+    _started = true;
+  }
+  detectLoss(now);
+  refill(now);
+
+  int sent = 0;
+  while((!_resend.empty() || !_queue.empty()) && _in_flight < _cwnd &&
+        _tokens >= 1) {
+    int ret = sendPacket(now, false);
+    if(ret < 0) {
+      return -1;
+    }
+    if(ret == 0) {
+      break;
+    }
+    _tokens -= 1;
+    ++sent;
+  }
+  if(_ack_pending) {
+    if(sendPacket(now, true) < 0) {
+      return -1;
+    }
+    ++sent;
+  }
+  return sent;
+}
+
+reliable_channel::tick_type reliable_channel::nextTimeout(tick_type now) const
+{
+  if(_ack_pending) {
+    return now;
+  }
+  tick_type next = never;
+  if((!_resend.empty() || !_queue.empty()) && _in_flight < _cwnd) {
+    if(_tokens >= 1) {
+      return now;
+    }
+    tick_type wait = (tick_type)((1 - _tokens) / rate()) + 1;
+    next = _last_refill + wait;
+  }
+  // Packets are in the order sent, so the first unresolved one is the
+  // first to time out.
+  for(std::size_t i = 0; i < _sent.size(); ++i) {
+    if(!_sent[i].resolved) {
+      next = std::min(next, _sent[i].sent + _rto);
+      break;
+    }
+  }
+  return next;
+}
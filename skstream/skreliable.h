@@ -0,0 +1,266 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_RELIABLE_H_
+#define RGJ_FREE_SOCKET_RELIABLE_H_
+
+#include <skstream/skstream.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// class reliable_channel
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Sequenced, optionally reliable messages over a datagram stream.
+///
+/// Messages are packed into numbered packets sent through the stream to
+/// its target. Each packet carries the number of the newest packet
+/// received from the peer and a bitmap of the 32 before it, so one lost
+/// acknowledgement is covered by the next. Reliable messages in a packet
+/// which is not acknowledged within the retransmission timeout, or which
+/// three later packets overtake, are sent again in a new packet.
+///
+/// Each of the CHANNELS channels is ORDERED, RELIABLE or UNRELIABLE. An
+/// ordered channel holds back messages until those before them arrive,
+/// so a loss only delays its own channel. A reliable channel delivers
+/// each message once as soon as it arrives, and an unreliable one sends
+/// each message once. Packets are limited to a congestion window, halved
+/// on loss and grown as packets are acknowledged, and paced out across
+/// the round trip time rather than sent in bursts.
+///
+/// The caller drives the channel: receive() or input() with datagrams
+/// from the peer, update() to send, and update() again by nextTimeout().
+/// Times are in milliseconds from an epoch chosen by the caller, as with
+/// timer_wheel. The stream should be non-blocking.
+class reliable_channel {
+public:
+  typedef unsigned long long tick_type;
+
+  enum mode {
+    ORDERED,
+    RELIABLE,
+    UNRELIABLE
+  };
+
+  static const unsigned CHANNELS = 16;
+  /// Largest datagram sent.
+  static const std::size_t MAX_PACKET = 1200;
+  /// Largest message which fits in a packet.
+  static const std::size_t MAX_MESSAGE;
+  static const tick_type never = ~0ULL;
+
+  /// Called with each message delivered.
+  typedef std::function<void(unsigned channel, const char *, std::size_t)>
+          message_handler;
+  /// Called with each packet about to be sent. Returning true drops it.
+  typedef std::function<bool(const char *, std::size_t)> loss_model;
+
+  explicit reliable_channel(dgram_socket_stream & stream);
+  ~reliable_channel();
+
+  /** Set how messages sent on a channel are delivered. The peer follows
+   *  the mode each message was sent with.
+   */
+  void setMode(unsigned channel, mode m) {
+    if(channel < CHANNELS) {
+      _modes[channel] = m;
+    }
+  }
+
+  mode getMode(unsigned channel) const {
+    return _modes[channel];
+  }
+
+  void setMessageHandler(const message_handler & h) {
+    _on_message = h;
+  }
+
+  /// Drop outgoing packets chosen by a loss model, to test recovery.
+  void setLossModel(const loss_model & l) {
+    _loss_model = l;
+  }
+
+  /** Queue a message to be sent by the next update(). Returns 0, or -1 if
+   *  it is larger than MAX_MESSAGE or the channel is out of range.
+   */
+  int send(unsigned channel, const char * data, std::size_t size);
+
+  int send(unsigned channel, const std::string & data) {
+    return send(channel, data.data(), data.size());
+  }
+
+  /** Handle a datagram from the peer, delivering any messages which are
+   *  now ready. Returns 0, or -1 if the datagram is malformed.
+   */
+  int input(const char * data, std::size_t size, tick_type now);
+
+  /** Read and handle the datagrams waiting on the stream. Returns the
+   *  number read, or -1 on error.
+   */
+  int receive(tick_type now);
+
+  /** Resend lost messages, send queued messages as far as the congestion
+   *  window and pacing allow, and acknowledge what has been received.
+   *  Returns the number of packets sent, or -1 on error.
+   */
+  int update(tick_type now);
+
+  /// Return when update() next needs to be called, or never.
+  tick_type nextTimeout(tick_type now) const;
+
+  /// Return the smoothed round trip time.
+  tick_type getRoundTrip() const {
+    return _srtt;
+  }
+
+  /// Return the current retransmission timeout.
+  tick_type getTimeout() const {
+    return _rto;
+  }
+
+  /// Return the congestion window, in packets.
+  double getWindow() const {
+    return _cwnd;
+  }
+
+  /// Return the number of packets sent and not yet acknowledged or lost.
+  std::size_t inFlight() const {
+    return _in_flight;
+  }
+
+  /// Return the number of messages queued and not yet acknowledged.
+  std::size_t pending() const {
+    return _messages.size();
+  }
+
+  /// Return the number of packets found to be lost.
+  unsigned long getLost() const {
+    return _lost;
+  }
+
+  /// Return the number of times a message has been sent again.
+  unsigned long getRetransmitted() const {
+    return _retransmitted;
+  }
+
+  int getLastError() const {
+    return _last_error;
+  }
+
+private:
+  reliable_channel(const reliable_channel&);
+  reliable_channel& operator=(const reliable_channel&);
+
+  struct outgoing {
+    unsigned char channel;
+    unsigned char mode;
+    uint32_t sequence;
+    std::string data;
+  };
+
+  struct sent_packet {
+    uint32_t sequence;
+    tick_type sent;
+    /// Set once acknowledged or found lost.
+    bool resolved;
+    /// Reliable messages carried.
+    std::vector<uint64_t> messages;
+  };
+
+  struct incoming {
+    /// All messages before this have been delivered.
+    uint32_t next;
+    /// Messages after next delivered, or held back on an ordered channel.
+    std::set<uint32_t> delivered;
+    std::map<uint32_t, std::string> held;
+  };
+
+  dgram_socket_stream & _stream;
+  mode _modes[CHANNELS];
+  message_handler _on_message;
+  loss_model _loss_model;
+
+  // Sending
+  uint64_t _next_message;
+  uint32_t _next_sequence[CHANNELS];
+  std::unordered_map<uint64_t, outgoing> _messages;
+  std::deque<uint64_t> _queue;
+  std::deque<uint64_t> _resend;
+  std::deque<sent_packet> _sent;
+  uint32_t _next_packet;
+  std::size_t _in_flight;
+  bool _any_acked;
+  uint32_t _largest_acked;
+
+  // Receiving
+  incoming _incoming[CHANNELS];
+  bool _received_any;
+  uint32_t _received_newest;
+  uint32_t _received_bits;
+  bool _ack_pending;
+
+  // Timing and congestion control
+  tick_type _srtt;
+  tick_type _rttvar;
+  tick_type _rto;
+  bool _have_rtt;
+  double _cwnd;
+  double _ssthresh;
+  /// Losses of packets before this don't shrink the window again.
+  uint32_t _recovery;
+  double _tokens;
+  tick_type _last_refill;
+  bool _started;
+
+  unsigned long _lost;
+  unsigned long _retransmitted;
+  int _last_error;
+
+  std::string _packet;
+
+  void acknowledge(uint32_t sequence, tick_type now, bool newest);
+  void packetLost(sent_packet & p);
+  void detectLoss(tick_type now);
+  void receivePacket(uint32_t sequence, bool & duplicate);
+  void deliver(unsigned channel, mode m, uint32_t sequence,
+               const char * data, std::size_t size);
+  double rate() const;
+  double burst() const;
+  void refill(tick_type now);
+  int sendPacket(tick_type now, bool ack_only);
+};
+
+#endif // RGJ_FREE_SOCKET_RELIABLE_H_
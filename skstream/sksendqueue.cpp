@@ -0,0 +1,94 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/sksendqueue.h>
+
+struct stream_send_queue::state {
+  mpsc_queue<std::string> messages;
+  /// Set while a drain task is waiting in the reactor.
+  std::atomic<bool> scheduled;
+  /// Cleared when the queue is destroyed, so late drain tasks do nothing.
+  stream_socket_stream * stream;
+  socket_reactor & reactor;
+
+  state(stream_socket_stream & s, socket_reactor & r) : scheduled(false),
+                                                        stream(&s),
+                                                        reactor(r) { }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class stream_send_queue implementation
+/////////////////////////////////////////////////////////////////////////////
+
+stream_send_queue::stream_send_queue(stream_socket_stream & stream,
+                                     socket_reactor & reactor) :
+    _state(std::make_shared<state>(stream, reactor))
+{
+}
+
+stream_send_queue::~stream_send_queue()
+{
+  _state->stream = 0;
+}
+
+void stream_send_queue::push(std::string && message)
+{
+  _state->messages.push(std::move(message));
+  if(!_state->scheduled.exchange(true)) {
+    std::shared_ptr<state> s = _state;
+    _state->reactor.post([s]() {
+      // The stream is only cleared on this thread, so this is safe.
+      if(s->stream != 0) {
+        drainState(*s);
+      }
+    });
+  }
+}
+
+int stream_send_queue::drainState(state & s)
+{
+  // Clear the flag first, so a message pushed from now on posts again.
+  s.scheduled.store(false);
+  std::string message;
+  while(s.messages.pop(message)) {
+    s.stream->queueBuffer(message);
+  }
+  int ret = s.stream->flushPending();
+  // Let the reactor wait for the socket to take the rest.
+  s.reactor.refresh(s.stream);
+  return ret;
+}
+
+int stream_send_queue::drain()
+{
+  return drainState(*_state);
+}
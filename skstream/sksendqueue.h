@@ -0,0 +1,85 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_SEND_QUEUE_H_
+#define RGJ_FREE_SOCKET_SEND_QUEUE_H_
+
+#include <skstream/skreactor.h>
+
+#include <memory>
+#include <string>
+
+/////////////////////////////////////////////////////////////////////////////
+// class stream_send_queue
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Lets any thread send messages on a stream owned by a reactor thread.
+///
+/// Messages are serialised by the sending thread and pushed onto a
+/// lock-free queue. The first message pushed while the queue is idle posts
+/// a task to the reactor, which moves everything queued into the stream
+/// and sends it with as few system calls as possible. Whatever the socket
+/// won't take is sent when the reactor next finds it writable. The stream
+/// must be in non-blocking mode and registered with addStream().
+class stream_send_queue {
+public:
+  /** Create a queue for a stream. Must be created and destroyed on the
+   *  reactor's thread.
+   */
+  stream_send_queue(stream_socket_stream & stream, socket_reactor & reactor);
+  ~stream_send_queue();
+
+  /// Queue a message to be sent. Safe to call from any thread.
+  void send(const std::string & message) {
+    push(std::string(message));
+  }
+
+  /// Queue a message, taking over its contents.
+  void send(std::string && message) {
+    push(std::move(message));
+  }
+
+  /** Move queued messages into the stream and send as much as possible.
+   *  This is called automatically on the reactor's thread when messages
+   *  arrive. Returns 0, or -1 if the stream has failed.
+   */
+  int drain();
+
+private:
+  stream_send_queue(const stream_send_queue&);
+  stream_send_queue& operator=(const stream_send_queue&);
+
+  struct state;
+
+  /// Shared with any drain tasks still waiting in the reactor.
+  std::shared_ptr<state> _state;
+
+  void push(std::string && message);
+  static int drainState(state & s);
+};
+
+#endif // RGJ_FREE_SOCKET_SEND_QUEUE_H_
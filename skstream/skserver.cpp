@@ -82,6 +82,7 @@ static inline int closesocket(SOCKET_TYPE sock)
 const int basic_socket_server::SK_SRV_NONE;
 const int basic_socket_server::SK_SRV_PURE;
 const int basic_socket_server::SK_SRV_REUSE;
+const int basic_socket_server::SK_SRV_REUSEPORT;
 
 basic_socket_server::~basic_socket_server() {
   if(_socket != INVALID_SOCKET) {
@@ -93,6 +94,13 @@ SOCKET_TYPE basic_socket_server::getSocket() const {
   return _socket;
 }
 
+void basic_socket_server::setSocket(SOCKET_TYPE sock) {
+  if(_socket != INVALID_SOCKET) {
+    close();
+  }
+  _socket = sock;
+}
+
 // close server's underlying socket
 //   The shutdown is a little rude... -  RGJ
 void basic_socket_server::close() {
@@ -159,6 +167,13 @@ int ip_socket_server::bindToAddressInfo(struct addrinfo * i)
     ::setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, (char *)&flag, sizeof(flag));
   }
 
+#ifdef SO_REUSEPORT
+  if (_flags & SK_SRV_REUSEPORT) {
+    int flag = 1;
+    ::setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, (char *)&flag, sizeof(flag));
+  }
+#endif // SO_REUSEPORT
+
   sockaddr_storage iaddr;
   ::memcpy(&iaddr, i->ai_addr, i->ai_addrlen);
   SOCKLEN iaddrlen = i->ai_addrlen;
@@ -179,7 +194,10 @@ int ip_socket_server::bindToIpService(int service, int type, int protocol)
 
   ::sprintf(serviceName, "%d", service);
 
-  tcp_address l;
+  tcp_address stream_address;
+  ip_datagram_address datagram_address;
+  basic_address & l = (type == SOCK_DGRAM) ?
+                      (basic_address &)datagram_address : stream_address;
 
   if (l.resolveListener(serviceName) != 0) {
     return -1;
@@ -187,7 +205,7 @@ int ip_socket_server::bindToIpService(int service, int type, int protocol)
 
   int success = -1;
 
-  tcp_address::const_iterator I = l.begin();
+  basic_address::const_iterator I = l.begin();
   for(; success == -1 && I != l.end(); ++I) {
     success = bindToAddressInfo(*I);
   }
@@ -214,6 +232,8 @@ SOCKET_TYPE tcp_socket_server::accept()
   SOCKET_TYPE commsock = ::accept(_socket, NULL, NULL);
   if(commsock == INVALID_SOCKET) {
     setLastError();
+  } else {
+    _accept_options.apply(commsock);
   }
   return commsock;
 }
@@ -281,11 +301,80 @@ int udp_socket_server::open(int service)
   return 0;
 }
 
+SOCKET_TYPE udp_socket_server::connectPeer(const sockaddr_storage & peer,
+                                           SOCKLEN peer_size)
+{
+  if(_socket == INVALID_SOCKET) {
+    return INVALID_SOCKET;
+  }
+
+#ifdef SO_REUSEPORT
+  if(!(_flags & SK_SRV_REUSEPORT)) {
+    LastError = EINVAL;
+    return INVALID_SOCKET;
+  }
+
+  sockaddr_storage local;
+  SOCKLEN local_size = sizeof(local);
+  if(::getsockname(_socket, (sockaddr*)&local, &local_size) == SOCKET_ERROR) {
+    setLastError();
+    return INVALID_SOCKET;
+  }
+
+  SOCKET_TYPE sock = ::socket(local.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+  if(sock == INVALID_SOCKET) {
+    setLastError();
+    return INVALID_SOCKET;
+  }
+
+  int flag = 1;
+  ::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *)&flag, sizeof(flag));
+  ::setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (char *)&flag, sizeof(flag));
+  if(local.ss_family == AF_INET6) {
+    // Match the server, so mapped IPv4 peers are handled the same way.
+    SOCKLEN flag_size = sizeof(flag);
+    if(::getsockopt(_socket, IPPROTO_IPV6, IPV6_V6ONLY,
+                    (char *)&flag, &flag_size) == 0) {
+      ::setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, (char *)&flag,
+                   sizeof(flag));
+    }
+  }
+
+  if(::bind(sock, (sockaddr*)&local, local_size) == SOCKET_ERROR ||
+     ::connect(sock, (const sockaddr*)&peer, peer_size) == SOCKET_ERROR) {
+    setLastError();
+    ::closesocket(sock);
+    return INVALID_SOCKET;
+  }
+
+  // Between bind() and connect() the socket was in the port's group like
+  // any other, so it may hold datagrams meant for the server. They can't
+  // be handed back, so drop them rather than pass them off as the peer's.
+  for(;;) {
+    sockaddr_storage from;
+    SOCKLEN from_size = sizeof(from);
+    char byte;
+    if(::recvfrom(sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT,
+                  (sockaddr*)&from, &from_size) < 0) {
+      break;
+    }
+    if(from_size == peer_size && ::memcmp(&from, &peer, peer_size) == 0) {
+      break;
+    }
+    ::recv(sock, &byte, 1, MSG_DONTWAIT);
+  }
+
+  return sock;
+#else // SO_REUSEPORT
+  LastError = ENOPROTOOPT;
+  return INVALID_SOCKET;
+#endif // SO_REUSEPORT
+}
+
 #ifdef SKSTREAM_UNIX_SOCKETS
 
 #include <skstream/skserver_unix.h>
-
-#include <sys/un.h>
+#include <skstream/skstream_unix.h>
 
 /////////////////////////////////////////////////////////////////////////////
 // class unix_socket_server implementation
@@ -301,30 +390,31 @@ SOCKET_TYPE unix_socket_server::accept() {
   SOCKET_TYPE commsock = ::accept(_socket, NULL, NULL);
   if(commsock == INVALID_SOCKET) {
     setLastError();
+  } else {
+    _accept_options.apply(commsock);
   }
   return commsock;
 }
 
 // start unix server and put it in listen state
-int unix_socket_server::open(const std::string & service) {
+int unix_socket_server::open(const std::string & service, int type) {
   if(is_open()) close();
 
-  if (service.size() > 107) {
+  unix_address sa(service);
+  if(!sa.isValid()) {
+    LastError = sa.getError();
     return -1;
   }
 
   // create socket
-  _socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  _socket = ::socket(AF_UNIX, type, 0);
   if(_socket == INVALID_SOCKET) {
     setLastError();
     return -1;
   }
 
   // Bind Socket
-  sockaddr_un sa;
-  sa.sun_family = AF_UNIX;
-  strncpy(sa.sun_path, service.c_str(), 108);
-  if(::bind(_socket, (sockaddr*)&sa, sizeof(sa)) == SOCKET_ERROR) {
+  if(::bind(_socket, sa.addr(), sa.size()) == SOCKET_ERROR) {
     setLastError();
     close();
     return -1;
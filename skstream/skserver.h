@@ -41,9 +41,12 @@ public:
   static const int SK_SRV_NONE = 0;
   static const int SK_SRV_PURE = 1 << 0;
   static const int SK_SRV_REUSE = 1 << 1;
+  /// Allow several listen sockets on one port, sharing out connections.
+  static const int SK_SRV_REUSEPORT = 1 << 2;
 protected:
   SOCKET_TYPE _socket;
   int _flags;
+  socket_options _accept_options;
 private:
   basic_socket_server(const basic_socket_server&);
   basic_socket_server& operator=(const basic_socket_server&);
@@ -61,12 +64,29 @@ public:
 
   virtual SOCKET_TYPE getSocket() const;
 
+  /** Take over a socket which is already listening, such as one passed
+   *  from another process. Any socket already open is closed.
+   */
+  void setSocket(SOCKET_TYPE sock);
+
   void close();
   void shutdown();
 
   /// See if accept() can be called without blocking on it.
   bool can_accept();
 
+  /** Set options to be applied to each accepted socket, for options which
+   *  are not inherited from the listen socket. Failing to set them does
+   *  not stop a connection being accepted.
+   */
+  void setAcceptOptions(const socket_options & options) {
+    _accept_options = options;
+  }
+
+  const socket_options & getAcceptOptions() const {
+    return _accept_options;
+  }
+
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -115,7 +135,8 @@ public:
 /// \brief Encapsulates a UDP/IP datagram listen socket.
 class udp_socket_server : public ip_socket_server {
 public:
-  explicit udp_socket_server(int service) { 
+  explicit udp_socket_server(int service, int flags = SK_SRV_NONE) :
+      ip_socket_server(INVALID_SOCKET, flags) {
     open(service); 
   }
 
@@ -124,6 +145,15 @@ public:
 
   int open(int service);
 
+  /** Create a socket on the server's port connected to one peer, so the
+   *  kernel hands datagrams from that peer to it rather than to the
+   *  server socket. The server must have been opened with
+   *  SK_SRV_REUSEPORT. Datagrams from other peers already queued on the
+   *  new socket are passed over. Returns the socket, or INVALID_SOCKET on
+   *  error.
+   */
+  SOCKET_TYPE connectPeer(const sockaddr_storage & peer, SOCKLEN peer_size);
+
 };
 
 #endif // RGJ_FREE_THREADS_SERVER_H_
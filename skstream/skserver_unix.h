@@ -41,8 +41,9 @@ public:
   unix_socket_server() {
   }
 
-  explicit unix_socket_server(const std::string & service) { 
-    open(service); 
+  explicit unix_socket_server(const std::string & service,
+                              int type = SOCK_STREAM) {
+    open(service, type);
   }
 
   // Destructor
@@ -50,7 +51,12 @@ public:
 
   SOCKET_TYPE accept();
 
-  int open(const std::string & service);
+  /** Listen on service, which may be a path or an abstract name
+   *  starting with '@', as described for unix_address. The type may be
+   *  SOCK_STREAM or SOCK_SEQPACKET, and each connection accepted has the
+   *  same type.
+   */
+  int open(const std::string & service, int type = SOCK_STREAM);
 };
 
 #endif // RGJ_FREE_THREADS_SERVER_UNIX_H_
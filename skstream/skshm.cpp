@@ -0,0 +1,537 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skshm.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_EVENTFD_H)
+#define SKSTREAM_SHM 1
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0
+#endif // MFD_ALLOW_SEALING
+#endif // HAVE_MEMFD_CREATE && HAVE_SYS_EVENTFD_H
+
+namespace skstream_detail {
+
+// Kept at the start of each ring, in its own page. The producer and
+// consumer positions are on separate cache lines so the two sides do not
+// contend for one line. Positions only grow, and are reduced modulo the
+// capacity to index the data.
+struct shm_ring_header {
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) std::atomic<uint32_t> reader_waiting;
+  std::atomic<uint32_t> writer_waiting;
+  std::atomic<uint32_t> closed;
+  uint32_t magic;
+  uint64_t capacity;
+};
+
+} // namespace skstream_detail
+
+using skstream_detail::shm_ring_header;
+
+// Tag sent with the rings by shm_socket_stream::open()
+static const char SHM_TAG[] = "skstream-shm";
+static const uint32_t SHM_MAGIC = 0x736b7368;
+static const std::size_t SHM_HEADER_SIZE = 4096;
+static const std::size_t SHM_MIN_CAPACITY = 4096;
+static const std::size_t SHM_MAX_CAPACITY = std::size_t(1) << 30;
+// The memory file, then the data and space eventfds of each ring.
+static const std::size_t SHM_FDS = 5;
+
+static std::size_t ring_span(std::size_t capacity)
+{
+  return SHM_HEADER_SIZE + capacity;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class shm_socketbuf implementation
+/////////////////////////////////////////////////////////////////////////////
+
+shm_socketbuf::shm_socketbuf() : _map(0), _map_size(0), _capacity(0),
+                                 _control(-1), _peer_gone(false)
+{
+  _in.header = _out.header = 0;
+  _in.data = _out.data = 0;
+  _in.position = _out.position = 0;
+  _in.data_fd = _in.space_fd = _out.data_fd = _out.space_fd = -1;
+}
+
+shm_socketbuf::~shm_socketbuf()
+{
+  close();
+}
+
+void shm_socketbuf::attach(void * map, std::size_t map_size,
+                           std::size_t capacity, const int * events,
+                           bool initiator, int control)
+{
+  close();
+  _map = map;
+  _map_size = map_size;
+  _capacity = capacity;
+  _control = control;
+  _peer_gone = false;
+
+  char * first = static_cast<char *>(map);
+  char * second = first + ring_span(capacity);
+  ring_end & forward = initiator ? _out : _in;
+  ring_end & backward = initiator ? _in : _out;
+  forward.header = reinterpret_cast<shm_ring_header *>(first);
+  forward.data = first + SHM_HEADER_SIZE;
+  forward.data_fd = events[0];
+  forward.space_fd = events[1];
+  backward.header = reinterpret_cast<shm_ring_header *>(second);
+  backward.data = second + SHM_HEADER_SIZE;
+  backward.data_fd = events[2];
+  backward.space_fd = events[3];
+
+  _out.position = _out.header->head.load(std::memory_order_relaxed);
+  _in.position = _in.header->tail.load(std::memory_order_relaxed);
+  setp(0, 0);
+  setg(0, 0, 0);
+}
+
+void shm_socketbuf::close()
+{
+#ifdef SKSTREAM_SHM
+  if(_map == 0) {
+    return;
+  }
+  publishOut();
+  _out.header->closed.store(1, std::memory_order_release);
+  _in.header->closed.store(1, std::memory_order_release);
+  signal(_out.data_fd);
+  signal(_in.space_fd);
+
+  ::munmap(_map, _map_size);
+  ::close(_in.data_fd);
+  ::close(_in.space_fd);
+  ::close(_out.data_fd);
+  ::close(_out.space_fd);
+  if(_control != -1) {
+    ::close(_control);
+  }
+#endif // SKSTREAM_SHM
+  _map = 0;
+  _map_size = 0;
+  _in.header = _out.header = 0;
+  _in.data_fd = _in.space_fd = _out.data_fd = _out.space_fd = -1;
+  _control = -1;
+  setp(0, 0);
+  setg(0, 0, 0);
+}
+
+// Make what has been written into the put area visible to the reader, and
+// wake it if it is waiting.
+void shm_socketbuf::publishOut()
+{
+  std::size_t count = pptr() - pbase();
+  if(count == 0) {
+    return;
+  }
+  _out.position += count;
+  _out.header->head.store(_out.position, std::memory_order_release);
+  // Pairs with the fence in underflow(), so either the reader sees the
+  // new head or this side sees its flag.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(_out.header->reader_waiting.load(std::memory_order_relaxed)) {
+    signal(_out.data_fd);
+  }
+  setp(pptr(), epptr());
+}
+
+// Give the space already read from the get area back to the writer.
+void shm_socketbuf::releaseIn()
+{
+  std::size_t count = gptr() - eback();
+  if(count == 0) {
+    return;
+  }
+  _in.position += count;
+  _in.header->tail.store(_in.position, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(_in.header->writer_waiting.load(std::memory_order_relaxed)) {
+    signal(_in.space_fd);
+  }
+  setg(gptr(), gptr(), egptr());
+}
+
+void shm_socketbuf::signal(int fd)
+{
+#ifdef SKSTREAM_SHM
+  const eventfd_t one = 1;
+  ssize_t r = ::write(fd, &one, sizeof(one));
+  (void)r;
+#endif // SKSTREAM_SHM
+}
+
+// Sleep until fd is signalled. Returns false if the peer has gone away.
+bool shm_socketbuf::wait(int fd)
+{
+#ifdef SKSTREAM_SHM
+  struct pollfd fds[2];
+  fds[0].fd = fd;
+  fds[0].events = POLLIN;
+  fds[0].revents = 0;
+  // Only a hangup is wanted from the control socket.
+  fds[1].fd = _control;
+  fds[1].events = 0;
+  fds[1].revents = 0;
+  int count = (_control == -1) ? 1 : 2;
+  if(::poll(fds, count, -1) < 0) {
+    if(errno != EINTR) {
+      _peer_gone = true;
+    }
+    return !_peer_gone;
+  }
+  if(fds[0].revents & POLLIN) {
+    eventfd_t value;
+    ssize_t r = ::read(fd, &value, sizeof(value));
+    (void)r;
+  }
+  if(fds[1].revents & (POLLHUP | POLLERR)) {
+    _peer_gone = true;
+    return false;
+  }
+  return true;
+#else // SKSTREAM_SHM
+  return false;
+#endif // SKSTREAM_SHM
+}
+
+shm_socketbuf::int_type shm_socketbuf::overflow(int_type c)
+{
+  if(_map == 0) {
+    return traits_type::eof();
+  }
+  publishOut();
+  releaseIn();
+
+  shm_ring_header & header = *_out.header;
+  uint64_t tail = header.tail.load(std::memory_order_acquire);
+  while(_out.position - tail == _capacity) {
+    if(_peer_gone || header.closed.load(std::memory_order_acquire)) {
+      return traits_type::eof();
+    }
+    header.writer_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    tail = header.tail.load(std::memory_order_acquire);
+    if(_out.position - tail == _capacity) {
+      wait(_out.space_fd);
+      tail = header.tail.load(std::memory_order_acquire);
+    }
+    header.writer_waiting.store(0, std::memory_order_relaxed);
+  }
+  if(header.closed.load(std::memory_order_acquire)) {
+    return traits_type::eof();
+  }
+
+  // The put area runs to the end of the free space or of the ring,
+  // whichever is first.
+  std::size_t offset = _out.position & (_capacity - 1);
+  std::size_t space = _capacity - (_out.position - tail);
+  if(space > _capacity - offset) {
+    space = _capacity - offset;
+  }
+  setp(_out.data + offset, _out.data + offset + space);
+
+  if(!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+shm_socketbuf::int_type shm_socketbuf::underflow()
+{
+  if(_map == 0) {
+    return traits_type::eof();
+  }
+  releaseIn();
+  if(gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  shm_ring_header & header = *_in.header;
+  uint64_t head = header.head.load(std::memory_order_acquire);
+  while(head == _in.position) {
+    // Data published before the ring was closed is still delivered.
+    if(_peer_gone || header.closed.load(std::memory_order_acquire)) {
+      head = header.head.load(std::memory_order_acquire);
+      if(head != _in.position) {
+        break;
+      }
+      return traits_type::eof();
+    }
+    header.reader_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    head = header.head.load(std::memory_order_acquire);
+    if(head == _in.position && !header.closed.load(std::memory_order_acquire)) {
+      wait(_in.data_fd);
+      head = header.head.load(std::memory_order_acquire);
+    }
+    header.reader_waiting.store(0, std::memory_order_relaxed);
+  }
+
+  std::size_t offset = _in.position & (_capacity - 1);
+  std::size_t avail = head - _in.position;
+  if(avail > _capacity - offset) {
+    avail = _capacity - offset;
+  }
+  setg(_in.data + offset, _in.data + offset, _in.data + offset + avail);
+  return traits_type::to_int_type(*gptr());
+}
+
+int shm_socketbuf::sync()
+{
+  if(_map == 0) {
+    return -1;
+  }
+  publishOut();
+  releaseIn();
+  if(_out.header->closed.load(std::memory_order_acquire)) {
+    return -1;
+  }
+  return 0;
+}
+
+std::streamsize shm_socketbuf::showmanyc()
+{
+  if(_map == 0) {
+    return -1;
+  }
+  uint64_t head = _in.header->head.load(std::memory_order_acquire);
+  std::streamsize avail = head - (_in.position + (egptr() - eback()));
+  if(avail == 0 && (_peer_gone ||
+                    _in.header->closed.load(std::memory_order_acquire))) {
+    return -1;
+  }
+  return avail;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class shm_socket_stream implementation
+/////////////////////////////////////////////////////////////////////////////
+
+shm_socket_stream::shm_socket_stream() : std::iostream(&_shmbuf),
+                                         _last_error(0)
+{
+}
+
+shm_socket_stream::~shm_socket_stream()
+{
+}
+
+int shm_socket_stream::setError(int error)
+{
+  _last_error = error;
+  setstate(std::ios::failbit);
+  return -1;
+}
+
+void shm_socket_stream::close()
+{
+  _shmbuf.close();
+}
+
+bool shm_socket_stream::supported()
+{
+#ifdef SKSTREAM_SHM
+  return true;
+#else // SKSTREAM_SHM
+  return false;
+#endif // SKSTREAM_SHM
+}
+
+#ifdef SKSTREAM_SHM
+
+static void close_all(const int * fds, std::size_t count)
+{
+  for(std::size_t i = 0; i < count; ++i) {
+    if(fds[i] != -1) {
+      ::close(fds[i]);
+    }
+  }
+}
+
+int shm_socket_stream::open(unix_socket_stream & control,
+                            std::size_t capacity)
+{
+  close();
+  clear();
+
+  std::size_t size = SHM_MIN_CAPACITY;
+  while(size < capacity && size < SHM_MAX_CAPACITY) {
+    size <<= 1;
+  }
+  std::size_t map_size = 2 * ring_span(size);
+
+  int fds[SHM_FDS] = { -1, -1, -1, -1, -1 };
+  fds[0] = ::memfd_create(SHM_TAG, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if(fds[0] == -1 || ::ftruncate(fds[0], map_size) != 0) {
+    int error = errno;
+    close_all(fds, SHM_FDS);
+    return setError(error);
+  }
+#ifdef F_ADD_SEALS
+  // Stop either side resizing the file under the other's mapping.
+  ::fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+#endif // F_ADD_SEALS
+  for(std::size_t i = 1; i < SHM_FDS; ++i) {
+    fds[i] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fds[i] == -1) {
+      int error = errno;
+      close_all(fds, SHM_FDS);
+      return setError(error);
+    }
+  }
+
+  void * map = ::mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fds[0], 0);
+  if(map == MAP_FAILED) {
+    int error = errno;
+    close_all(fds, SHM_FDS);
+    return setError(error);
+  }
+  for(int ring = 0; ring < 2; ++ring) {
+    char * base = static_cast<char *>(map) + ring * ring_span(size);
+    shm_ring_header * header = new (base) shm_ring_header;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->reader_waiting.store(0, std::memory_order_relaxed);
+    header->writer_waiting.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->magic = SHM_MAGIC;
+    header->capacity = size;
+  }
+
+  char tag[64];
+  snprintf(tag, sizeof(tag), "%s %lu\n", SHM_TAG, (unsigned long)size);
+  int own_control = ::fcntl(control.getSocket(), F_DUPFD_CLOEXEC, 0);
+  if(own_control == -1 || control.sendFds(fds, SHM_FDS, tag) != 0) {
+    int error = (own_control == -1) ? errno : control.getLastError();
+    ::munmap(map, map_size);
+    close_all(fds, SHM_FDS);
+    if(own_control != -1) {
+      ::close(own_control);
+    }
+    return setError(error);
+  }
+  // The peer has its own copy of the file, and the mapping keeps ours.
+  ::close(fds[0]);
+  _shmbuf.attach(map, map_size, size, fds + 1, true, own_control);
+  return 0;
+}
+
+int shm_socket_stream::accept(unix_socket_stream & control)
+{
+  close();
+  clear();
+
+  std::string line;
+  if(!control.readLine(line)) {
+    return setError(control.getLastError() ? control.getLastError() : EPIPE);
+  }
+  std::vector<SOCKET_TYPE> received;
+  control.recvFds(received, SHM_FDS);
+  const std::string prefix = std::string(SHM_TAG) + ' ';
+  if(received.size() != SHM_FDS || line.compare(0, prefix.size(), prefix) != 0) {
+    close_all(received.data(), received.size());
+    return setError(EPROTO);
+  }
+  unsigned long size = std::strtoul(line.c_str() + prefix.size(), 0, 10);
+  std::size_t map_size = 2 * ring_span(size);
+
+  struct stat st;
+  if(size < SHM_MIN_CAPACITY || size > SHM_MAX_CAPACITY ||
+     (size & (size - 1)) != 0 || ::fstat(received[0], &st) != 0 ||
+     (std::size_t)st.st_size < map_size) {
+    close_all(received.data(), received.size());
+    return setError(EPROTO);
+  }
+  void * map = ::mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      received[0], 0);
+  if(map == MAP_FAILED) {
+    int error = errno;
+    close_all(received.data(), received.size());
+    return setError(error);
+  }
+  for(int ring = 0; ring < 2; ++ring) {
+    const shm_ring_header * header = reinterpret_cast<shm_ring_header *>(
+        static_cast<char *>(map) + ring * ring_span(size));
+    if(header->magic != SHM_MAGIC || header->capacity != size) {
+      ::munmap(map, map_size);
+      close_all(received.data(), received.size());
+      return setError(EPROTO);
+    }
+  }
+
+  int own_control = ::fcntl(control.getSocket(), F_DUPFD_CLOEXEC, 0);
+  if(own_control == -1) {
+    int error = errno;
+    ::munmap(map, map_size);
+    close_all(received.data(), received.size());
+    return setError(error);
+  }
+  ::close(received[0]);
+  _shmbuf.attach(map, map_size, size, received.data() + 1, false,
+                 own_control);
+  return 0;
+}
+
+#else // SKSTREAM_SHM
+
+int shm_socket_stream::open(unix_socket_stream &, std::size_t)
+{
+  return setError(ENOSYS);
+}
+
+int shm_socket_stream::accept(unix_socket_stream &)
+{
+  return setError(ENOSYS);
+}
+
+#endif // SKSTREAM_SHM
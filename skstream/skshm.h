@@ -0,0 +1,175 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_SHM_H_
+#define RGJ_FREE_SOCKET_SHM_H_
+
+#include <skstream/skstream_unix.h>
+
+#include <iostream>
+
+#include <stdint.h>
+
+namespace skstream_detail {
+struct shm_ring_header;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class shm_socketbuf
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief A stream buffer over rings in memory shared with another process.
+///
+/// Each direction has a single producer, single consumer byte ring. The
+/// put area is free space in the outgoing ring and the get area is data in
+/// the incoming ring, so each byte is copied once on each side, and no
+/// system call is made unless one side has to wait for the other. A side
+/// which finds its ring full or empty sets a flag and sleeps on an
+/// eventfd, which the other side only signals when it sees the flag.
+/// While waiting, the unix socket the rings were set up over is watched
+/// too, so a peer which dies is seen as end of file.
+class shm_socketbuf : public std::streambuf {
+private:
+  struct ring_end {
+    skstream_detail::shm_ring_header * header;
+    char * data;
+    /// Ring position of the start of the put or get area.
+    uint64_t position;
+    /// Signalled when data is added to the ring.
+    int data_fd;
+    /// Signalled when space is freed in the ring.
+    int space_fd;
+  };
+
+  void * _map;
+  std::size_t _map_size;
+  std::size_t _capacity;
+  ring_end _in;
+  ring_end _out;
+  int _control;
+  bool _peer_gone;
+
+  shm_socketbuf(const shm_socketbuf&);
+  shm_socketbuf& operator=(const shm_socketbuf&);
+
+  void publishOut();
+  void releaseIn();
+  bool wait(int fd);
+  static void signal(int fd);
+
+public:
+  shm_socketbuf();
+  virtual ~shm_socketbuf();
+
+  /** Use a mapping made by shm_socket_stream. The buffer takes over the
+   *  mapping and the descriptors. events holds the data and space eventfds
+   *  of the ring written by the initiating side, then those of the ring it
+   *  reads.
+   */
+  void attach(void * map, std::size_t map_size, std::size_t capacity,
+              const int * events, bool initiator, int control);
+
+  /// Flush output, tell the peer, and release the rings.
+  void close();
+
+  bool is_open() const {
+    return _map != 0;
+  }
+
+  /// Return the size of each ring.
+  std::size_t capacity() const {
+    return _capacity;
+  }
+
+protected:
+  virtual int_type overflow(int_type c = traits_type::eof());
+  virtual int_type underflow();
+  virtual int sync();
+  virtual std::streamsize showmanyc();
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class shm_socket_stream
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief An iostream between co-located processes over shared memory.
+///
+/// The rings are created by one side with open() and sent with their
+/// eventfds over an existing unix_socket_stream, where the other side
+/// picks them up with accept(). After that the unix socket is only used
+/// to notice if the peer dies, and may be closed by its owner. Reads and
+/// writes block like a blocking socket stream.
+class shm_socket_stream : public std::iostream {
+private:
+  shm_socketbuf _shmbuf;
+  int _last_error;
+
+  shm_socket_stream(const shm_socket_stream&);
+  shm_socket_stream& operator=(const shm_socket_stream&);
+
+  int setError(int error);
+
+public:
+  /// The ring size used unless another is given to open().
+  static const std::size_t DEFAULT_CAPACITY = 1 << 20;
+
+  shm_socket_stream();
+  virtual ~shm_socket_stream();
+
+  /** Create a ring in each direction, of at least capacity bytes, and
+   *  send them to the peer at the other end of control. Data can be
+   *  written at once, and is read by the peer once it calls accept().
+   *  Returns 0, or -1 on error.
+   */
+  int open(unix_socket_stream & control,
+           std::size_t capacity = DEFAULT_CAPACITY);
+
+  /** Take the rings sent by a peer calling open(). Blocks until they
+   *  arrive. Returns 0, or -1 on error.
+   */
+  int accept(unix_socket_stream & control);
+
+  /// Flush output and tell the peer it will see end of file.
+  void close();
+
+  bool is_open() const {
+    return _shmbuf.is_open();
+  }
+
+  int getLastError() const {
+    return _last_error;
+  }
+
+  std::size_t capacity() const {
+    return _shmbuf.capacity();
+  }
+
+  /// Return true if shared memory streams can be used on this system.
+  static bool supported();
+};
+
+#endif // RGJ_FREE_SOCKET_SHM_H_
@@ -35,6 +35,7 @@
 
 #ifndef _WIN32
 #include <errno.h>
+#include <netinet/tcp.h>
 #endif
 
 #include <cstdio>
@@ -48,6 +49,148 @@ static inline int getSystemError()
   #endif
 }
 
+// Options which take an int value, looked up by the table below.
+enum {
+  OPT_NODELAY,
+  OPT_CORK,
+  OPT_QUICKACK,
+  OPT_SNDBUF,
+  OPT_RCVBUF,
+  OPT_NOTSENT_LOWAT,
+  OPT_KEEPALIVE,
+  OPT_KEEPIDLE,
+  OPT_KEEPINTVL,
+  OPT_KEEPCNT,
+  OPT_BUSY_POLL
+};
+
+// Find the level and name of an option, or return false if this system
+// doesn't have it.
+static bool lookupOption(int opt, int & level, int & name)
+{
+  switch(opt) {
+    case OPT_NODELAY:
+      level = IPPROTO_TCP; name = TCP_NODELAY;
+      return true;
+#if defined(TCP_CORK)
+    case OPT_CORK:
+      level = IPPROTO_TCP; name = TCP_CORK;
+      return true;
+#elif defined(TCP_NOPUSH)
+    case OPT_CORK:
+      level = IPPROTO_TCP; name = TCP_NOPUSH;
+      return true;
+#endif
+#ifdef TCP_QUICKACK
+    case OPT_QUICKACK:
+      level = IPPROTO_TCP; name = TCP_QUICKACK;
+      return true;
+#endif
+    case OPT_SNDBUF:
+      level = SOL_SOCKET; name = SO_SNDBUF;
+      return true;
+    case OPT_RCVBUF:
+      level = SOL_SOCKET; name = SO_RCVBUF;
+      return true;
+#ifdef TCP_NOTSENT_LOWAT
+    case OPT_NOTSENT_LOWAT:
+      level = IPPROTO_TCP; name = TCP_NOTSENT_LOWAT;
+      return true;
+#endif
+    case OPT_KEEPALIVE:
+      level = SOL_SOCKET; name = SO_KEEPALIVE;
+      return true;
+#if defined(TCP_KEEPIDLE)
+    case OPT_KEEPIDLE:
+      level = IPPROTO_TCP; name = TCP_KEEPIDLE;
+      return true;
+#elif defined(TCP_KEEPALIVE)
+    case OPT_KEEPIDLE:
+      level = IPPROTO_TCP; name = TCP_KEEPALIVE;
+      return true;
+#endif
+#ifdef TCP_KEEPINTVL
+    case OPT_KEEPINTVL:
+      level = IPPROTO_TCP; name = TCP_KEEPINTVL;
+      return true;
+#endif
+#ifdef TCP_KEEPCNT
+    case OPT_KEEPCNT:
+      level = IPPROTO_TCP; name = TCP_KEEPCNT;
+      return true;
+#endif
+#ifdef SO_BUSY_POLL
+    case OPT_BUSY_POLL:
+      level = SOL_SOCKET; name = SO_BUSY_POLL;
+      return true;
+#endif
+    default:
+      break;
+  }
+#ifdef _WIN32
+  WSASetLastError(WSAENOPROTOOPT);
+#else
+  errno = ENOPROTOOPT;
+#endif
+  return false;
+}
+
+static int setIntOption(SOCKET_TYPE sock, int opt, int value)
+{
+  int level, name;
+  if(!lookupOption(opt, level, name)) {
+    return -1;
+  }
+  if(::setsockopt(sock, level, name, (char*)&value,
+                  sizeof(value)) == SOCKET_ERROR) {
+    return -1;
+  }
+  return 0;
+}
+
+static int getIntOption(SOCKET_TYPE sock, int opt)
+{
+  int level, name;
+  if(!lookupOption(opt, level, name)) {
+    return -1;
+  }
+  int value = 0;
+  SOCKLEN len = sizeof(value);
+  if(::getsockopt(sock, level, name, (char*)&value, &len) == SOCKET_ERROR) {
+    return -1;
+  }
+  return value;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_options implementation
+/////////////////////////////////////////////////////////////////////////////
+
+socket_options::socket_options() : nodelay(UNSET), cork(UNSET),
+                                   quickack(UNSET), send_buffer(UNSET),
+                                   receive_buffer(UNSET),
+                                   notsent_lowat(UNSET), keepalive(UNSET),
+                                   keepalive_idle(UNSET),
+                                   keepalive_interval(UNSET),
+                                   keepalive_count(UNSET), busy_poll(UNSET)
+{
+}
+
+int socket_options::apply(SOCKET_TYPE sock) const
+{
+  const int values[] = { nodelay, cork, quickack, send_buffer,
+                         receive_buffer, notsent_lowat, keepalive,
+                         keepalive_idle, keepalive_interval,
+                         keepalive_count, busy_poll };
+  int ret = 0;
+  for(int opt = OPT_NODELAY; opt <= OPT_BUSY_POLL; ++opt) {
+    if(values[opt] != UNSET && setIntOption(sock, opt, values[opt]) != 0) {
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // class basic_socket implementation
 /////////////////////////////////////////////////////////////////////////////
@@ -69,6 +212,150 @@ basic_socket::~basic_socket()
 {
 }
 
+bool basic_socket::setOption(int opt, int value)
+{
+  if(setIntOption(getSocket(), opt, value) != 0) {
+    setLastError();
+    return false;
+  }
+  return true;
+}
+
+int basic_socket::getOption(int opt) const
+{
+  int value = getIntOption(getSocket(), opt);
+  if(value == -1) {
+    setLastError();
+  }
+  return value;
+}
+
+int basic_socket::getLocalPort() const
+{
+  sockaddr_storage addr;
+  SOCKLEN addr_len = sizeof(addr);
+  if(::getsockname(getSocket(), (sockaddr*)&addr, &addr_len) != 0) {
+    setLastError();
+    return -1;
+  }
+  if(addr.ss_family == AF_INET6) {
+    return ntohs(((sockaddr_in6 &)addr).sin6_port);
+  }
+  if(addr.ss_family == AF_INET) {
+    return ntohs(((sockaddr_in &)addr).sin_port);
+  }
+  LastError = EAFNOSUPPORT;
+  return -1;
+}
+
+int basic_socket::getFamily() const
+{
+  sockaddr_storage addr;
+  SOCKLEN addr_len = sizeof(addr);
+  if(::getsockname(getSocket(), (sockaddr*)&addr, &addr_len) != 0) {
+    setLastError();
+    return AF_UNSPEC;
+  }
+  return addr.ss_family;
+}
+
+bool basic_socket::setNoDelay(bool opt)
+{
+  return setOption(OPT_NODELAY, opt ? 1 : 0);
+}
+
+int basic_socket::getNoDelay() const
+{
+  return getOption(OPT_NODELAY);
+}
+
+bool basic_socket::setCork(bool opt)
+{
+  return setOption(OPT_CORK, opt ? 1 : 0);
+}
+
+int basic_socket::getCork() const
+{
+  return getOption(OPT_CORK);
+}
+
+bool basic_socket::setQuickAck(bool opt)
+{
+  return setOption(OPT_QUICKACK, opt ? 1 : 0);
+}
+
+int basic_socket::getQuickAck() const
+{
+  return getOption(OPT_QUICKACK);
+}
+
+bool basic_socket::setSendBufferSize(int bytes)
+{
+  return setOption(OPT_SNDBUF, bytes);
+}
+
+int basic_socket::getSendBufferSize() const
+{
+  return getOption(OPT_SNDBUF);
+}
+
+bool basic_socket::setReceiveBufferSize(int bytes)
+{
+  return setOption(OPT_RCVBUF, bytes);
+}
+
+int basic_socket::getReceiveBufferSize() const
+{
+  return getOption(OPT_RCVBUF);
+}
+
+bool basic_socket::setNotSentLowat(int bytes)
+{
+  return setOption(OPT_NOTSENT_LOWAT, bytes);
+}
+
+int basic_socket::getNotSentLowat() const
+{
+  return getOption(OPT_NOTSENT_LOWAT);
+}
+
+bool basic_socket::setKeepAlive(bool opt, int idle, int interval, int count)
+{
+  if(!setOption(OPT_KEEPALIVE, opt ? 1 : 0)) {
+    return false;
+  }
+  if(!opt) {
+    return true;
+  }
+  return (idle <= 0 || setOption(OPT_KEEPIDLE, idle)) &&
+         (interval <= 0 || setOption(OPT_KEEPINTVL, interval)) &&
+         (count <= 0 || setOption(OPT_KEEPCNT, count));
+}
+
+int basic_socket::getKeepAlive() const
+{
+  return getOption(OPT_KEEPALIVE);
+}
+
+bool basic_socket::setBusyPoll(int usec)
+{
+  return setOption(OPT_BUSY_POLL, usec);
+}
+
+int basic_socket::getBusyPoll() const
+{
+  return getOption(OPT_BUSY_POLL);
+}
+
+bool basic_socket::setOptions(const socket_options & options)
+{
+  if(options.apply(getSocket()) != 0) {
+    setLastError();
+    return false;
+  }
+  return true;
+}
+
 // System dependant initialization
 bool basic_socket::startup() {
 #ifdef _WIN32
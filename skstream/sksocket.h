@@ -71,6 +71,40 @@ namespace FreeSockets {
   };
 };
 
+/////////////////////////////////////////////////////////////////////////////
+// class socket_options
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief A set of socket options to be applied together.
+///
+/// Each option is left alone unless it has been given a value, so a set can
+/// be built once and applied to many sockets, such as those accepted by a
+/// server. Sizes are in bytes and times in seconds, except busy_poll which
+/// is in microseconds.
+class socket_options {
+public:
+  static const int UNSET = -1;
+
+  int nodelay;
+  int cork;
+  int quickack;
+  int send_buffer;
+  int receive_buffer;
+  int notsent_lowat;
+  int keepalive;
+  int keepalive_idle;
+  int keepalive_interval;
+  int keepalive_count;
+  int busy_poll;
+
+  socket_options();
+
+  /** Set every option which has a value on a socket. Returns 0, or -1 if
+   *  any option could not be set, in which case the rest are still tried.
+   */
+  int apply(SOCKET_TYPE sock) const;
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // class basic_socket, a virtual base class for use in polling
 /////////////////////////////////////////////////////////////////////////////
@@ -84,6 +118,9 @@ protected:
 
   void setLastError() const;
 
+  bool setOption(int opt, int value);
+  int getOption(int opt) const;
+
   basic_socket();
 public:
   virtual ~basic_socket();
@@ -102,6 +139,59 @@ public:
     return (getSocket() != INVALID_SOCKET); 
   }
 
+  /** Return the local port of an IP socket, which is the one the system
+   *  chose if it was bound to port 0. Returns -1 on error.
+   */
+  int getLocalPort() const;
+
+  /// Return the address family of the socket, or AF_UNSPEC on error.
+  int getFamily() const;
+
+  // Socket options. Setters return false and getters -1 on error,
+  // including when the option is not available on this system. Options
+  // set on a listen socket are inherited by the sockets it accepts on
+  // most systems, and buffer sizes must be set before listening to
+  // affect the TCP window.
+
+  /// Disable Nagle's algorithm, sending small writes at once.
+  bool setNoDelay(bool opt);
+  int getNoDelay() const;
+
+  /** Hold back partial segments until uncorked. This is TCP_NOPUSH on
+   *  systems without TCP_CORK. See socket_cork.
+   */
+  bool setCork(bool opt);
+  int getCork() const;
+
+  /// Acknowledge received data at once. Linux may turn this back off.
+  bool setQuickAck(bool opt);
+  int getQuickAck() const;
+
+  bool setSendBufferSize(int bytes);
+  int getSendBufferSize() const;
+
+  bool setReceiveBufferSize(int bytes);
+  int getReceiveBufferSize() const;
+
+  /** Limit the unsent data held in the kernel, so a writable socket
+   *  means little is already queued ahead of the next write.
+   */
+  bool setNotSentLowat(int bytes);
+  int getNotSentLowat() const;
+
+  /** Enable or disable keepalive probes. Non-zero idle time, interval and
+   *  probe count override the system defaults.
+   */
+  bool setKeepAlive(bool opt, int idle = 0, int interval = 0, int count = 0);
+  int getKeepAlive() const;
+
+  /// Busy poll the device for up to this many microseconds on receive.
+  bool setBusyPoll(int usec);
+  int getBusyPoll() const;
+
+  /// Set every option in the set which has a value.
+  bool setOptions(const socket_options & options);
+
   static bool startup();
 
 };
@@ -0,0 +1,136 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skstats.h>
+
+#include <algorithm>
+
+tcp_info_sampler::tcp_info_sampler(socket_reactor & reactor,
+                                   unsigned long interval) :
+    _reactor(reactor), _interval(interval), _timer(0), _slow_rtt(~0U)
+{
+  schedule();
+}
+
+tcp_info_sampler::~tcp_info_sampler()
+{
+  if(_timer != 0) {
+    _reactor.cancelTimer(_timer);
+  }
+}
+
+void tcp_info_sampler::schedule()
+{
+  if(_interval == 0) {
+    return;
+  }
+  _timer = _reactor.addTimer(_interval, [this]() {
+    _timer = 0;
+    sample();
+    schedule();
+  });
+}
+
+void tcp_info_sampler::add(const tcp_socket_stream * stream)
+{
+  tcp_connection_stats & stats = _stats[stream];
+  stats = tcp_connection_stats();
+}
+
+void tcp_info_sampler::remove(const tcp_socket_stream * stream)
+{
+  _stats.erase(stream);
+}
+
+void tcp_info_sampler::sample()
+{
+  stats_map::iterator I = _stats.begin();
+  for(; I != _stats.end(); ++I) {
+    tcp_connection_info info;
+    if(I->first->getTcpInfo(info) != 0) {
+      continue;
+    }
+    tcp_connection_stats & stats = I->second;
+    if(stats.samples == 0) {
+      stats.smoothed_rtt = info.rtt;
+      stats.recent_retransmits = 0;
+    } else {
+      // The same 1/8 gain the kernel uses for its own smoothed RTT
+      stats.smoothed_rtt = (7 * (unsigned long long)stats.smoothed_rtt +
+                            info.rtt) / 8;
+      stats.recent_retransmits = info.total_retransmits -
+                                 std::min(info.total_retransmits,
+                                          stats.info.total_retransmits);
+    }
+    stats.max_rtt = std::max(stats.max_rtt, info.rtt);
+    stats.info = info;
+    ++stats.samples;
+  }
+}
+
+const tcp_connection_stats *
+tcp_info_sampler::getStats(const tcp_socket_stream * stream) const
+{
+  stats_map::const_iterator I = _stats.find(stream);
+  if(I == _stats.end()) {
+    return 0;
+  }
+  return &I->second;
+}
+
+bool tcp_info_sampler::isSlow(const tcp_socket_stream * stream) const
+{
+  const tcp_connection_stats * stats = getStats(stream);
+  if(stats == 0 || stats->samples == 0) {
+    return false;
+  }
+  return stats->smoothed_rtt > _slow_rtt || stats->recent_retransmits > 0;
+}
+
+void tcp_info_sampler::sortByLatency(
+        std::vector<const tcp_socket_stream *> & streams) const
+{
+  std::stable_sort(streams.begin(), streams.end(),
+                   [this](const tcp_socket_stream * a,
+                          const tcp_socket_stream * b) {
+    const tcp_connection_stats * sa = getStats(a);
+    const tcp_connection_stats * sb = getStats(b);
+    // Nothing is known about the latency of an unsampled connection, so
+    // it goes after all those which have been measured.
+    bool ua = sa == 0 || sa->samples == 0;
+    bool ub = sb == 0 || sb->samples == 0;
+    if(ua || ub) {
+      return !ua && ub;
+    }
+    return sa->smoothed_rtt < sb->smoothed_rtt;
+  });
+}
@@ -0,0 +1,114 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_STATS_H_
+#define RGJ_FREE_SOCKET_STATS_H_
+
+#include <skstream/skreactor.h>
+#include <skstream/skstream.h>
+
+#include <map>
+#include <vector>
+
+/// \brief Statistics kept for each connection by a tcp_info_sampler.
+struct tcp_connection_stats {
+  /// The most recent sample.
+  tcp_connection_info info;
+  /// RTT smoothed over recent samples, in microseconds.
+  unsigned smoothed_rtt;
+  /// Highest RTT seen, in microseconds.
+  unsigned max_rtt;
+  /// Retransmits since the previous sample.
+  unsigned recent_retransmits;
+  unsigned long samples;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class tcp_info_sampler
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Samples TCP_INFO for a set of connections at regular intervals.
+///
+/// Sampling is driven by a timer on a socket_reactor, so must be done on
+/// that reactor's thread. The statistics make it possible to find peers
+/// with high latency or loss, and to serve them last when broadcasting.
+class tcp_info_sampler {
+public:
+  /** Create a sampler which samples every interval milliseconds. With an
+   *  interval of zero, sampling is only done by calling sample().
+   */
+  tcp_info_sampler(socket_reactor & reactor, unsigned long interval);
+  ~tcp_info_sampler();
+
+  /// Start keeping statistics for a connection.
+  void add(const tcp_socket_stream * stream);
+
+  /// Stop keeping statistics for a connection. Call before closing it.
+  void remove(const tcp_socket_stream * stream);
+
+  /// Sample every connection now.
+  void sample();
+
+  /// Return the statistics for a connection, or 0 if it has none.
+  const tcp_connection_stats * getStats(const tcp_socket_stream * stream) const;
+
+  /// Set the smoothed RTT, in microseconds, above which a peer is slow.
+  void setSlowThreshold(unsigned rtt) {
+    _slow_rtt = rtt;
+  }
+
+  /** Check whether a peer is slow, either because its smoothed RTT is
+   *  above the threshold or because it had to retransmit since the
+   *  previous sample.
+   */
+  bool isSlow(const tcp_socket_stream * stream) const;
+
+  /** Sort connections by smoothed RTT, fastest first. Connections which
+   *  have not been sampled yet go last.
+   */
+  void sortByLatency(std::vector<const tcp_socket_stream *> & streams) const;
+
+  std::size_t size() const {
+    return _stats.size();
+  }
+
+private:
+  tcp_info_sampler(const tcp_info_sampler&);
+  tcp_info_sampler& operator=(const tcp_info_sampler&);
+
+  typedef std::map<const tcp_socket_stream *, tcp_connection_stats> stats_map;
+
+  stats_map _stats;
+  socket_reactor & _reactor;
+  unsigned long _interval;
+  socket_reactor::timer_id _timer;
+  unsigned _slow_rtt;
+
+  void schedule();
+};
+
+#endif // RGJ_FREE_SOCKET_STATS_H_
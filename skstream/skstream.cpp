@@ -34,15 +34,28 @@
 #include <skstream/skstream.h>
 
 #include <skstream/skaddress.h>
+#include <skstream/skserver.h>
 
 #ifndef _WIN32
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <net/if.h>
 #include <errno.h>
 #endif // _WIN32
 
+#ifdef HAVE_LINUX_SOCKIOS_H
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#endif // HAVE_LINUX_SOCKIOS_H
+
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cassert>
 
@@ -52,6 +65,15 @@
 #define SHUT_RDWR SD_BOTH
 #endif
 
+// Windows has no per-call non-blocking flag, so there the socket itself is
+// put in non-blocking mode by stream_socketbuf::setNonBlocking().
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0
+#endif
+
+static const std::size_t PENDING_CHUNK_SIZE = 0x4000;
+static const int PENDING_IOV_BATCH = 64;
+
 // This would be using, but streambuf is a class, not a namespace
 typedef std::streambuf::int_type int_type;
 
@@ -64,6 +86,15 @@ static inline int getSystemError()
   #endif
 }
 
+static inline bool isWouldBlock(int error)
+{
+  #ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+  #else
+    return error == EAGAIN || error == EWOULDBLOCK;
+  #endif
+}
+
 #ifndef HAVE_CLOSESOCKET
 static inline int closesocket(SOCKET_TYPE sock)
 {
@@ -140,7 +171,8 @@ static const char * gai_strerror(int errcode)
 // Constructor
 socketbuf::socketbuf(SOCKET_TYPE sock, std::streamsize insize,
                                        std::streamsize outsize)
-    : _buffer(0), _socket(sock), Timeout(false)
+    : _buffer(0), _socket(sock), Timeout(false), WouldBlock(false),
+      ReadError(0)
 {
   // allocate 16k buffer each for input and output
   const std::streamsize bufsize = insize + outsize;
@@ -162,7 +194,8 @@ socketbuf::socketbuf(SOCKET_TYPE sock, std::streamsize insize,
 // Constructor
 socketbuf::socketbuf(SOCKET_TYPE sock, std::streambuf::char_type * buf,
                                        std::streamsize length)
-    : _buffer(0), _socket(sock), Timeout(false)
+    : _buffer(0), _socket(sock), Timeout(false), WouldBlock(false),
+      ReadError(0)
 {
   setbuf(buf, length);
 
@@ -204,6 +237,15 @@ int socketbuf::sync()
     }
 }
 
+std::streamsize socketbuf::fillBuffer(const std::streambuf::char_type *& data)
+{
+  if(gptr() == egptr() && underflow() == traits_type::eof()) {
+    return 0;
+  }
+  data = gptr();
+  return egptr() - gptr();
+}
+
 std::streambuf * socketbuf::setbuf(std::streambuf::char_type * buf,
                                    std::streamsize len)
 {
@@ -219,22 +261,44 @@ std::streambuf * socketbuf::setbuf(std::streambuf::char_type * buf,
 stream_socketbuf::stream_socketbuf(SOCKET_TYPE sock,
                                    std::streamsize insize,
                                    std::streamsize outsize)
-    : socketbuf(sock, insize, outsize) { }
+    : socketbuf(sock, insize, outsize), _get_base(0), _get_end(0),
+      _pending_offset(0), _pending_bytes(0),
+      _low_watermark(0x10000), _high_watermark(0x40000),
+      _congested(false), _nonblocking(false) { }
 
 stream_socketbuf::stream_socketbuf(SOCKET_TYPE sock,
                                    std::streambuf::char_type * buf,
                                    std::streamsize length)
-    : socketbuf(sock, buf, length) { }
+    : socketbuf(sock, buf, length), _get_base(0), _get_end(0),
+      _pending_offset(0), _pending_bytes(0),
+      _low_watermark(0x10000), _high_watermark(0x40000),
+      _congested(false), _nonblocking(false) { }
 
 stream_socketbuf::~stream_socketbuf()
 {
 }
 
+void stream_socketbuf::setNonBlocking(bool nonblock)
+{
+  _nonblocking = nonblock;
+#ifdef _WIN32
+  if(_socket != INVALID_SOCKET) {
+    u_long arg = nonblock ? 1 : 0;
+    ::ioctlsocket(_socket, FIONBIO, &arg);
+  }
+#endif // _WIN32
+}
+
 dgram_socketbuf::dgram_socketbuf(SOCKET_TYPE sock,
                                  std::streamsize insize,
                                  std::streamsize outsize)
     : socketbuf(sock, insize, outsize),
-      out_p_size(sizeof(out_peer)), in_p_size(sizeof(in_peer))
+      out_p_size(sizeof(out_peer)), in_p_size(sizeof(in_peer)),
+      _segment_size(0), _connected(false),
+      _in_datagram(false), _datagram_overflow(false),
+      _send_offload(true), _receive_offload(false),
+      _offload_socket(INVALID_SOCKET), _offload_offset(0),
+      _offload_length(0), _offload_segment(0)
 {
 }
 
@@ -242,7 +306,12 @@ dgram_socketbuf::dgram_socketbuf(SOCKET_TYPE sock,
                                  std::streambuf::char_type * buf,
                                  std::streamsize length)
     : socketbuf(sock, buf, length),
-      out_p_size(sizeof(out_peer)), in_p_size(sizeof(in_peer))
+      out_p_size(sizeof(out_peer)), in_p_size(sizeof(in_peer)),
+      _segment_size(0), _connected(false),
+      _in_datagram(false), _datagram_overflow(false),
+      _send_offload(true), _receive_offload(false),
+      _offload_socket(INVALID_SOCKET), _offload_offset(0),
+      _offload_length(0), _offload_segment(0)
 {
 }
 
@@ -260,6 +329,37 @@ int_type stream_socketbuf::overflow(int_type nCh) {
     return traits_type::eof(); // Invalid socket
   }
 
+  if(_nonblocking) {
+    // Never wait for the socket. Whatever it won't take now is queued.
+    if(flushPending() != 0) {
+      return traits_type::eof();
+    }
+
+    const std::streambuf::char_type * data = pbase();
+    std::size_t len = pptr() - pbase();
+
+    if(_pending_bytes == 0 && len > 0) {
+      int size = transmit(data, len, MSG_DONTWAIT);
+      if(size < 0) {
+        if(!isWouldBlock(getSystemError())) {
+          return traits_type::eof(); // Socket Could not send
+        }
+        size = 0;
+      }
+      data += size;
+      len -= size;
+    }
+    queueOutput(data, len);
+    checkWatermarks();
+
+    setp(pbase(), epptr());
+    if(nCh != traits_type::eof()) {
+      *pptr() = nCh;
+      pbump(1);
+    }
+    return 0;
+  }
+
   if(pptr()-pbase() <= 0) {
     return 0; // nothing to send
   }
@@ -286,7 +386,7 @@ int_type stream_socketbuf::overflow(int_type nCh) {
   Timeout = false;
 
   // send pending data or return eof() on error
-  int size=::send(_socket, pbase(),pptr()-pbase(),0);
+  int size=transmit(pbase(),pptr()-pbase(),0);
 
   if(size < 0) {
     return traits_type::eof(); // Socket Could not send
@@ -327,6 +427,12 @@ int_type stream_socketbuf::underflow()
     return traits_type::to_int_type(*this->gptr());
   }
 
+  if(_get_base != 0) {
+    // A held back record has been read, so go back to the usual buffer.
+    setg(_get_base, _get_end, _get_end);
+    _get_base = _get_end = 0;
+  }
+
   // prepare structure for detecting timeout
 
   // if a timeout was specified, wait for it.
@@ -350,7 +456,16 @@ int_type stream_socketbuf::underflow()
 
   // fill up from eback to egptr
   // receive data or return eof() on error
-  int size = ::recv(_socket, eback(), egptr()-eback(), 0);
+  int size = receive(eback(), egptr()-eback(),
+                     _nonblocking ? MSG_DONTWAIT : 0);
+
+  if(size < 0 && isWouldBlock(getSystemError())) {
+    WouldBlock = true;
+    return traits_type::eof(); // No data yet, but the connection is fine
+  }
+  WouldBlock = false;
+  // Only the last read counts, so a read which works clears an error.
+  ReadError = (size < 0) ? getSystemError() : 0;
 
   if(size <= 0) {
     return traits_type::eof(); // remote site has closed connection or (TCP) Receive error
@@ -366,6 +481,181 @@ int_type stream_socketbuf::underflow()
   return traits_type::to_int_type(*this->gptr()); // traits::not_eof(...)
 }
 
+int stream_socketbuf::receive(std::streambuf::char_type * buf,
+                              std::size_t len, int flags)
+{
+  return ::recv(_socket, buf, len, flags);
+}
+
+int stream_socketbuf::transmit(const std::streambuf::char_type * buf,
+                               std::size_t len, int flags)
+{
+  return ::send(_socket, buf, len, flags);
+}
+
+#ifndef _WIN32
+int stream_socketbuf::transmitv(const struct iovec * iov, int count,
+                                int flags)
+{
+  struct msghdr msg;
+  ::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_iovlen = count;
+  return ::sendmsg(_socket, &msg, flags);
+}
+#endif // _WIN32
+
+// flushPending() - send queued output until the socket would block.
+int stream_socketbuf::flushPending()
+{
+  if(_socket == INVALID_SOCKET) {
+    return -1;
+  }
+
+  while(!_pending.empty()) {
+#ifndef _WIN32
+    // Gather as many chunks as possible into each call.
+    struct iovec iov[PENDING_IOV_BATCH];
+    std::size_t len = 0;
+    int count = 0;
+    std::size_t offset = _pending_offset;
+    std::deque<std::string>::const_iterator I = _pending.begin();
+    for(; I != _pending.end() && count < PENDING_IOV_BATCH; ++I, ++count) {
+      iov[count].iov_base = (void *)(I->data() + offset);
+      iov[count].iov_len = I->size() - offset;
+      len += iov[count].iov_len;
+      offset = 0;
+    }
+    int size = transmitv(iov, count, MSG_DONTWAIT);
+#else // _WIN32
+    const std::string & chunk = _pending.front();
+    const std::size_t len = chunk.size() - _pending_offset;
+    int size = transmit(chunk.data() + _pending_offset, len, MSG_DONTWAIT);
+#endif // _WIN32
+    if(size < 0) {
+      if(isWouldBlock(getSystemError())) {
+        break;
+      }
+      return -1;
+    }
+    _pending_bytes -= size;
+    std::size_t sent = size;
+    while(sent > 0) {
+      const std::size_t remaining = _pending.front().size() - _pending_offset;
+      if(sent < remaining) {
+        _pending_offset += sent;
+        break;
+      }
+      sent -= remaining;
+      _pending.pop_front();
+      _pending_offset = 0;
+    }
+    if((std::size_t)size < len) {
+      // The socket buffer is full.
+      break;
+    }
+  }
+
+  checkWatermarks();
+
+  return 0;
+}
+
+void stream_socketbuf::queueBuffer(std::string & buffer)
+{
+  // Anything in the put area was written first.
+  queueOutput(pbase(), pptr() - pbase());
+  setp(pbase(), epptr());
+
+  if(buffer.empty()) {
+    return;
+  }
+  if(buffer.size() < PENDING_CHUNK_SIZE / 4) {
+    // Small messages are cheaper to copy than to send separately.
+    queueOutput(buffer.data(), buffer.size());
+    buffer.clear();
+  } else {
+    _pending_bytes += buffer.size();
+    _pending.push_back(std::string());
+    _pending.back().swap(buffer);
+  }
+  checkWatermarks();
+}
+
+void stream_socketbuf::queueOutput(const std::streambuf::char_type * data,
+                                   std::size_t len)
+{
+  while(len > 0) {
+    if(_pending.empty() || _pending.back().size() >= PENDING_CHUNK_SIZE) {
+      _pending.push_back(std::string());
+      _pending.back().reserve(PENDING_CHUNK_SIZE);
+    }
+    std::string & chunk = _pending.back();
+    const std::size_t count = std::min(len,
+                                       PENDING_CHUNK_SIZE - chunk.size());
+    chunk.append(data, count);
+    data += count;
+    len -= count;
+    _pending_bytes += count;
+  }
+}
+
+void stream_socketbuf::checkWatermarks()
+{
+  if(_pending_bytes >= _high_watermark) {
+    _congested = true;
+  } else if(_pending_bytes <= _low_watermark) {
+    _congested = false;
+  }
+}
+
+// readUntil() - extract a delimited record straight from the get area.
+std::streamsize stream_socketbuf::readUntil(std::string & line, char delim)
+{
+  line.clear();
+  std::streamsize count = 0;
+
+  for (;;) {
+    if(gptr() >= egptr() && underflow() == traits_type::eof()) {
+      if(WouldBlock && count > 0) {
+        // Put back what we have until the rest of the record arrives.
+        holdBack(line);
+        line.clear();
+        return -1;
+      }
+      return (count > 0) ? count : -1;
+    }
+
+    std::streambuf::char_type * start = gptr();
+    const std::streamsize avail = egptr() - start;
+    std::streambuf::char_type * found =
+        static_cast<std::streambuf::char_type *>(::memchr(start, delim, avail));
+
+    if(found != 0) {
+      const std::streamsize len = found - start;
+      line.append(start, len);
+      gbump(len + 1);
+      return count + len + 1;
+    }
+
+    // No delimiter in the buffer, so take all of it and refill.
+    line.append(start, avail);
+    count += avail;
+    setg(eback(), egptr(), egptr());
+  }
+}
+
+// holdBack() - make data the get area, ahead of anything still to be read.
+void stream_socketbuf::holdBack(const std::string & data)
+{
+  if(_get_base == 0) {
+    _get_base = eback();
+    _get_end = egptr();
+  }
+  _held.assign(data.begin(), data.end());
+  setg(&_held[0], &_held[0], &_held[0] + _held.size());
+}
+
 // setTarget() - set the target socket address
 bool dgram_socketbuf::setTarget(const std::string& address, unsigned port,
                                 int proto)
@@ -374,6 +664,7 @@ bool dgram_socketbuf::setTarget(const std::string& address, unsigned port,
     ::closesocket(_socket);
     _socket = INVALID_SOCKET;
   }
+  _offload_offset = _offload_length = 0;
 
   ip_datagram_address target;
 
@@ -400,9 +691,47 @@ bool dgram_socketbuf::setTarget(const std::string& address, unsigned port,
 
   }
 
+  if(success && _connected) {
+    success = setConnected(true);
+  }
+
   return success;
 }
 
+bool dgram_socketbuf::setConnected(bool opt)
+{
+  if(_socket == INVALID_SOCKET) {
+    _connected = opt;
+    return true;
+  }
+
+  if(opt) {
+    if(::connect(_socket, (sockaddr*)&out_peer, out_p_size) == SOCKET_ERROR) {
+      return false;
+    }
+    // Only the target can send to us now.
+    in_peer = out_peer;
+    in_p_size = out_p_size;
+  } else if(_connected) {
+    sockaddr unspec;
+    ::memset(&unspec, 0, sizeof(unspec));
+    unspec.sa_family = AF_UNSPEC;
+    // Some systems report an error even though this disconnects.
+    ::connect(_socket, &unspec, sizeof(unspec));
+  }
+  _connected = opt;
+  return true;
+}
+
+// Send one datagram to the target.
+int dgram_socketbuf::sendPacket(const char * data, std::size_t len)
+{
+  if(_connected) {
+    return ::send(_socket, data, len, 0);
+  }
+  return ::sendto(_socket, data, len, 0, (sockaddr*)&out_peer, out_p_size);
+}
+
 /// Handle output to a connected socket.
 int_type dgram_socketbuf::overflow(int_type nCh)
 {
@@ -411,35 +740,33 @@ int_type dgram_socketbuf::overflow(int_type nCh)
     return traits_type::eof(); // Invalid socket
   }
 
+  if(_in_datagram) {
+    // Nothing is sent until sendDatagram(), and a datagram which has
+    // outgrown the buffer can't be sent whole.
+    if(nCh == traits_type::eof()) {
+      return 0;
+    }
+    _datagram_overflow = true;
+    setp(pbase(), epptr());
+    return traits_type::eof();
+  }
+
   if(pptr()-pbase() <= 0) {
     return 0; // nothing to send
   }
 
   int size;
 
-  // prepare structure for detecting timeout
-
-  // if a timeout was specified, wait for it.
+  if(!waitTimeout(true)) {
+    return traits_type::eof();
+  }
 
-  if((_overflow_timeout.tv_sec+_overflow_timeout.tv_usec) > 0) {
-    int sr;
-    timeval tv = _overflow_timeout;
-    fd_set socks;
-    FD_ZERO(&socks); // zero fd_set
-    FD_SET(_socket,&socks); // add buffer socket to fd_set
-    sr = ::select(_socket+1,NULL,&socks,NULL,&tv);
-    if(sr == 0){
-      Timeout = true;
-      return traits_type::eof(); // a timeout error should be set here! - RGJ
-    } else if(sr < 0) {
-      return traits_type::eof(); // error on select()
-    }
-    assert(FD_ISSET(_socket,&socks));
+  if(_segment_size > 0) {
+    return overflowSegments(nCh);
   }
-  Timeout = false;
 
   // send pending data or return eof() on error
-  size=::sendto(_socket, pbase(),pptr()-pbase(),0,(sockaddr*)&out_peer,out_p_size);
+  size = sendPacket(pbase(), pptr() - pbase());
 
   if(size < 0) {
     return traits_type::eof(); // Socket Could not send
@@ -478,34 +805,36 @@ int_type dgram_socketbuf::underflow() {
     return traits_type::to_int_type(*this->gptr());
   }
 
+  if(_offload_offset < _offload_length) {
+    return nextSegment();
+  }
+
   // fill up from eback to egptr
   int size;
 
-  // prepare structure for detecting timeout
-
-  // if a timeout was specified, wait for it.
-  if((_underflow_timeout.tv_sec+_underflow_timeout.tv_usec) > 0) {
-    int sr;
-    timeval tv = _underflow_timeout;
-    fd_set socks;
-    FD_ZERO(&socks); // zero fd_set
-    FD_SET(_socket,&socks); // add buffer socket to fd_set
-    sr = ::select(_socket+1,&socks,NULL,NULL,&tv);
-    if(sr == 0){
-      Timeout = true;
-      return traits_type::eof(); // a timeout error should be set here! - RGJ
-    } else if(sr < 0) {
-      return traits_type::eof(); // error on select()
-    }
-    assert(FD_ISSET(_socket,&socks));
+  if(!waitTimeout(false)) {
+    return traits_type::eof();
   }
-  Timeout = false;
 
+  if(_receive_offload) {
+    return underflowOffload();
+  }
 
   // receive data or return eof() on error
-  in_p_size = sizeof(in_peer);
-  size = ::recvfrom(_socket, eback(), egptr()-eback(), 0,
-                    (sockaddr*)&in_peer, &in_p_size);
+  if(_connected) {
+    // The sender can only be the target.
+    size = ::recv(_socket, eback(), egptr()-eback(), 0);
+  } else {
+    in_p_size = sizeof(in_peer);
+    size = ::recvfrom(_socket, eback(), egptr()-eback(), 0,
+                      (sockaddr*)&in_peer, &in_p_size);
+  }
+
+  if(size < 0 && isWouldBlock(getSystemError())) {
+    WouldBlock = true;
+    return traits_type::eof(); // No datagram waiting
+  }
+  WouldBlock = false;
 
   if(size <= 0) {
     return traits_type::eof(); // remote site has closed connection or (TCP) Receive error
@@ -521,107 +850,446 @@ int_type dgram_socketbuf::underflow() {
   return (int)(unsigned char)(*gptr()); // traits::not_eof(...)
 }
 
-/////////////////////////////////////////////////////////////////////////////
-// class basic_socket_stream implementation
-/////////////////////////////////////////////////////////////////////////////
-
-// Constructor
+// The kernel limits how many segments, and how many bytes, one send can
+// carry with UDP_SEGMENT.
+static const std::size_t MAX_OFFLOAD_SEGMENTS = 64;
+static const std::size_t MAX_OFFLOAD_BYTES = 65000;
 
-basic_socket_stream::basic_socket_stream(socketbuf & buffer, int proto)
-    : std::iostream(&buffer), _sockbuf(buffer),
-      m_protocol(proto)
+bool dgram_socketbuf::setReceiveOffload(bool opt)
 {
-  init(&_sockbuf); // initialize underlying streambuf
+#ifdef UDP_GRO
+  _receive_offload = opt;
+  _offload_socket = INVALID_SOCKET;
+  return true;
+#else // UDP_GRO
+  return !opt;
+#endif // UDP_GRO
 }
 
-basic_socket_stream::~basic_socket_stream()
+// Send data as datagrams of _segment_size, as few system calls as the
+// kernel allows.
+int dgram_socketbuf::sendSegments(const char * data, std::size_t len)
 {
-  delete &_sockbuf;
+  const std::size_t segment = _segment_size;
+  while(len > 0) {
+#ifdef UDP_SEGMENT
+    if(_send_offload && len > segment && segment <= MAX_OFFLOAD_BYTES / 2) {
+      std::size_t batch = std::min(MAX_OFFLOAD_SEGMENTS,
+                                   MAX_OFFLOAD_BYTES / segment) * segment;
+      batch = std::min(batch, len);
+
+      struct iovec iov;
+      iov.iov_base = const_cast<char *>(data);
+      iov.iov_len = batch;
+
+      char control[CMSG_SPACE(sizeof(uint16_t))];
+      std::memset(control, 0, sizeof(control));
+      struct msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      if(!_connected) {
+        msg.msg_name = &out_peer;
+        msg.msg_namelen = out_p_size;
+      }
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      struct cmsghdr * cm = CMSG_FIRSTHDR(&msg);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t gso_size = segment;
+      std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+
+      if(::sendmsg(_socket, &msg, 0) >= 0) {
+        data += batch;
+        len -= batch;
+        continue;
+      }
+      int err = getSystemError();
+      if(err != EIO && err != EINVAL && err != ENOPROTOOPT &&
+         err != EOPNOTSUPP) {
+        return -1;
+      }
+      // Not supported by this kernel or device, so stop trying.
+      _send_offload = false;
+    }
+#endif // UDP_SEGMENT
+    std::size_t one = std::min(len, segment);
+    if(sendPacket(data, one) < 0) {
+      return -1;
+    }
+    data += one;
+    len -= one;
+  }
+  return 0;
 }
 
-SOCKET_TYPE basic_socket_stream::getSocket() const
+int_type dgram_socketbuf::overflowSegments(int_type nCh)
 {
-  return _sockbuf.getSocket();
-}
+  std::size_t len = pptr() - pbase();
+  std::size_t send_len = len;
+  if(nCh != traits_type::eof() && len >= _segment_size) {
+    // The buffer is full, so send the complete datagrams and keep the
+    // start of the next one.
+    send_len -= len % _segment_size;
+  }
 
-void basic_socket_stream::shutdown(bool wr_only) {
-  SOCKET_TYPE fd = getSocket();
-  if(fd != INVALID_SOCKET){
-    if(::shutdown(fd, wr_only ? SHUT_WR : SHUT_RDWR) == SOCKET_ERROR) {
-      setLastError();
-    }
+  if(sendSegments(pbase(), send_len) != 0) {
+    return traits_type::eof();
   }
-}
 
-// closes a socket connection
-void basic_socket_stream::close() {
-  SOCKET_TYPE fd = getSocket();
-  if(fd != INVALID_SOCKET){
-    if(::closesocket(fd) == SOCKET_ERROR) {
-      setLastError();
-      return;
-    }
-    _sockbuf.setSocket(INVALID_SOCKET);
+  std::memmove(pbase(), pbase() + send_len, len - send_len);
+  setp(pbase(), epptr());
+  pbump(len - send_len);
+
+  if(nCh != traits_type::eof()) {
+    *pptr() = traits_type::to_char_type(nCh);
+    pbump(1);
   }
+
+  return 0;
 }
 
-// Check for failure condition
-bool basic_socket_stream::fail() {
-  if(timeout()) {
-    clear();
-    return false;
-  }
-  if(std::iostream::fail()) {
-    setLastError();
+// Turn on UDP_GRO for the current socket. Returns false, and stops trying,
+// if it is not supported.
+bool dgram_socketbuf::enableOffload()
+{
+#ifdef UDP_GRO
+  if(_offload_socket == _socket) {
     return true;
   }
+  int on = 1;
+  if(::setsockopt(_socket, SOL_UDP, UDP_GRO, (char*)&on, sizeof(on)) != 0) {
+    _receive_offload = false;
+    return false;
+  }
+  _offload_socket = _socket;
+  return true;
+#else // UDP_GRO
+  _receive_offload = false;
   return false;
+#endif // UDP_GRO
 }
 
-static int set_nonblock(int sfd)
+// Receive into the offload buffer, which is large enough for any
+// datagram, or for several coalesced by the kernel. Returns the size
+// received, or -1 on error.
+int dgram_socketbuf::receiveBatch()
 {
-#ifndef _WIN32
-  int flags = ::fcntl(sfd, F_GETFL, 0);
-  if (flags == -1) {
-    flags = 0;
+  if(_offload_buffer.empty()) {
+    _offload_buffer.resize(0x10000);
   }
-  return ::fcntl(sfd, F_SETFL, flags | O_NONBLOCK);
+
+#ifndef _WIN32
+  struct iovec iov;
+  iov.iov_base = &_offload_buffer[0];
+  iov.iov_len = _offload_buffer.size();
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  if(!_connected) {
+    msg.msg_name = &in_peer;
+    msg.msg_namelen = sizeof(in_peer);
+  }
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+#ifdef UDP_GRO
+  char control[CMSG_SPACE(sizeof(int))];
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+#endif // UDP_GRO
+
+  ssize_t size = ::recvmsg(_socket, &msg, 0);
 #else // _WIN32
-  u_long nonblocking = 1;  // This flag may be set elsewhere,
-                           // in a header ?
-  return ::ioctlsocket(sfd, FIONBIO, &nonblocking);
+  SOCKLEN name_len = sizeof(in_peer);
+  int size = ::recvfrom(_socket, &_offload_buffer[0], _offload_buffer.size(),
+                        0, (sockaddr*)&in_peer, &name_len);
 #endif // _WIN32
-}
 
-static int reset_nonblock(int sfd)
-{
+  if(size < 0 && isWouldBlock(getSystemError())) {
+    WouldBlock = true;
+    return -1; // No datagram waiting
+  }
+  WouldBlock = false;
+
+  if(size < 0) {
+    return -1;
+  }
+
+  // Without the control message this is a single datagram.
+  _offload_segment = size;
 #ifndef _WIN32
-  int flags = ::fcntl(sfd, F_GETFL, 0);
-  if (flags == -1) {
-    flags = 0;
+  if(!_connected) {
+    in_p_size = msg.msg_namelen;
+  }
+#ifdef UDP_GRO
+  struct cmsghdr * cm = CMSG_FIRSTHDR(&msg);
+  for(; cm != 0; cm = CMSG_NXTHDR(&msg, cm)) {
+    if(cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+      int gso_size;
+      std::memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+      if(gso_size > 0) {
+        _offload_segment = gso_size;
+      }
+    }
   }
-  return ::fcntl(sfd, F_SETFL, flags & ~O_NONBLOCK);
+#endif // UDP_GRO
 #else // _WIN32
-  u_long blocking = 0;
-  return ::ioctlsocket(sfd, FIONBIO, &blocking);
+  in_p_size = name_len;
 #endif // _WIN32
+  _offload_offset = 0;
+  _offload_length = size;
+  return size;
 }
 
-/////////////////////////////////////////////////////////////////////////////
-// class stream_socket_stream implementation
-/////////////////////////////////////////////////////////////////////////////
-
-stream_socket_stream::stream_socket_stream()
-    : basic_socket_stream(*new stream_socketbuf(INVALID_SOCKET)),
-      _connecting_socket(INVALID_SOCKET)
+// Receive, allowing the kernel to coalesce datagrams from one sender.
+int_type dgram_socketbuf::underflowOffload()
 {
+  if(!enableOffload()) {
+    // Not supported here, so receive datagrams one at a time.
+    return underflow();
+  }
+
+  if(receiveBatch() <= 0) {
+    return traits_type::eof();
+  }
+
+  return nextSegment();
 }
 
-stream_socket_stream::stream_socket_stream(SOCKET_TYPE socket)
-    : basic_socket_stream(*new stream_socketbuf(socket)),
-      _connecting_socket(INVALID_SOCKET)
+// Move the next datagram from the offload buffer to the end of the get area.
+int_type dgram_socketbuf::nextSegment()
 {
-}
+  std::size_t len = std::min(_offload_segment,
+                             _offload_length - _offload_offset);
+  std::size_t copy = std::min(len, (std::size_t)(egptr() - eback()));
+  std::memcpy(egptr() - copy, _offload_buffer.data() + _offload_offset, copy);
+  _offload_offset += len;
+
+  setg(eback(), egptr() - copy, egptr());
+
+  return traits_type::to_int_type(*gptr());
+}
+
+// Wait for the socket if a timeout was specified. Returns false on timeout
+// or error.
+bool dgram_socketbuf::waitTimeout(bool write)
+{
+  const timeval & timeout = write ? _overflow_timeout : _underflow_timeout;
+  if((timeout.tv_sec + timeout.tv_usec) > 0) {
+    timeval tv = timeout;
+    fd_set socks;
+    FD_ZERO(&socks); // zero fd_set
+    FD_SET(_socket,&socks); // add buffer socket to fd_set
+    int sr = ::select(_socket+1, write ? NULL : &socks, write ? &socks : NULL,
+                      NULL, &tv);
+    if(sr == 0){
+      Timeout = true;
+      return false; // a timeout error should be set here! - RGJ
+    } else if(sr < 0) {
+      return false; // error on select()
+    }
+    assert(FD_ISSET(_socket,&socks));
+  }
+  Timeout = false;
+  return true;
+}
+
+int dgram_socketbuf::beginDatagram()
+{
+  if(_in_datagram) {
+    return 0;
+  }
+  if(pptr() > pbase() && overflow() == traits_type::eof()) {
+    return -1;
+  }
+  _in_datagram = true;
+  _datagram_overflow = false;
+  return 0;
+}
+
+int dgram_socketbuf::sendDatagram()
+{
+  const bool overflowed = _datagram_overflow;
+  const std::size_t len = pptr() - pbase();
+  _in_datagram = false;
+  _datagram_overflow = false;
+  setp(pbase(), epptr());
+
+  if(overflowed) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+  if(_socket == INVALID_SOCKET || !waitTimeout(true)) {
+    return -1;
+  }
+  return sendPacket(pbase(), len);
+}
+
+int dgram_socketbuf::sendDatagram(const char * data, std::size_t len)
+{
+  if(_in_datagram) {
+    errno = EINVAL;
+    return -1;
+  }
+  if(pptr() > pbase() && overflow() == traits_type::eof()) {
+    return -1;
+  }
+  if(_socket == INVALID_SOCKET || !waitTimeout(true)) {
+    return -1;
+  }
+  return sendPacket(data, len);
+}
+
+int dgram_socketbuf::receiveDatagram(datagram_view & datagram)
+{
+  if(_socket == INVALID_SOCKET) {
+    return -1;
+  }
+
+  datagram.peer = &in_peer;
+  if(gptr() < egptr()) {
+    // The rest of the datagram last read into the get area.
+    datagram.data = gptr();
+    datagram.size = egptr() - gptr();
+    datagram.peer_size = in_p_size;
+    setg(eback(), egptr(), egptr());
+    return datagram.size;
+  }
+
+  if(_offload_offset >= _offload_length) {
+    if(!waitTimeout(false)) {
+      return -1;
+    }
+    if(_receive_offload) {
+      enableOffload();
+    }
+    if(receiveBatch() < 0) {
+      return -1;
+    }
+  }
+
+  std::size_t len = std::min(_offload_segment,
+                             _offload_length - _offload_offset);
+  datagram.data = _offload_buffer.data() + _offload_offset;
+  datagram.size = len;
+  datagram.peer_size = in_p_size;
+  _offload_offset += len;
+  return len;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class basic_socket_stream implementation
+/////////////////////////////////////////////////////////////////////////////
+
+// Constructor
+
+basic_socket_stream::basic_socket_stream(socketbuf & buffer, int proto)
+    : std::iostream(&buffer), _sockbuf(buffer),
+      m_protocol(proto)
+{
+  init(&_sockbuf); // initialize underlying streambuf
+}
+
+basic_socket_stream::~basic_socket_stream()
+{
+  delete &_sockbuf;
+}
+
+SOCKET_TYPE basic_socket_stream::getSocket() const
+{
+  return _sockbuf.getSocket();
+}
+
+void basic_socket_stream::shutdown(bool wr_only) {
+  SOCKET_TYPE fd = getSocket();
+  if(fd != INVALID_SOCKET){
+    if(::shutdown(fd, wr_only ? SHUT_WR : SHUT_RDWR) == SOCKET_ERROR) {
+      setLastError();
+    }
+  }
+}
+
+// closes a socket connection
+void basic_socket_stream::close() {
+  SOCKET_TYPE fd = getSocket();
+  if(fd != INVALID_SOCKET){
+    if(::closesocket(fd) == SOCKET_ERROR) {
+      setLastError();
+      return;
+    }
+    _sockbuf.setSocket(INVALID_SOCKET);
+  }
+}
+
+// Check for failure condition
+bool basic_socket_stream::fail() {
+  if(timeout() || wouldBlock()) {
+    clear();
+    return false;
+  }
+  if(std::iostream::fail()) {
+    setLastError();
+    return true;
+  }
+  return false;
+}
+
+static int set_nonblock(int sfd)
+{
+#ifndef _WIN32
+  int flags = ::fcntl(sfd, F_GETFL, 0);
+  if (flags == -1) {
+    flags = 0;
+  }
+  return ::fcntl(sfd, F_SETFL, flags | O_NONBLOCK);
+#else // _WIN32
+  u_long nonblocking = 1;  // This flag may be set elsewhere,
+                           // in a header ?
+  return ::ioctlsocket(sfd, FIONBIO, &nonblocking);
+#endif // _WIN32
+}
+
+static int reset_nonblock(int sfd)
+{
+#ifndef _WIN32
+  int flags = ::fcntl(sfd, F_GETFL, 0);
+  if (flags == -1) {
+    flags = 0;
+  }
+  return ::fcntl(sfd, F_SETFL, flags & ~O_NONBLOCK);
+#else // _WIN32
+  u_long blocking = 0;
+  return ::ioctlsocket(sfd, FIONBIO, &blocking);
+#endif // _WIN32
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class stream_socket_stream implementation
+/////////////////////////////////////////////////////////////////////////////
+
+stream_socket_stream::stream_socket_stream()
+    : basic_socket_stream(*new stream_socketbuf(INVALID_SOCKET)),
+      stream_sockbuf((stream_socketbuf&)_sockbuf),
+      _connecting_socket(INVALID_SOCKET)
+{
+}
+
+stream_socket_stream::stream_socket_stream(SOCKET_TYPE socket)
+    : basic_socket_stream(*new stream_socketbuf(socket)),
+      stream_sockbuf((stream_socketbuf&)_sockbuf),
+      _connecting_socket(INVALID_SOCKET)
+{
+}
+
+stream_socket_stream::stream_socket_stream(stream_socketbuf & buffer)
+    : basic_socket_stream(buffer),
+      stream_sockbuf(buffer),
+      _connecting_socket(INVALID_SOCKET)
+{
+}
 
 stream_socket_stream::~stream_socket_stream()
 {
@@ -646,6 +1314,31 @@ SOCKET_TYPE stream_socket_stream::getSocket() const
             ? basic_socket_stream::getSocket() : _connecting_socket;
 }
 
+int stream_socket_stream::flushPending()
+{
+  if(stream_sockbuf.flushPending() != 0) {
+    setLastError();
+    return -1;
+  }
+  return 0;
+}
+
+bool stream_socket_stream::readLine(std::string & line, char delim)
+{
+  std::streamsize count = stream_sockbuf.readUntil(line, delim);
+  if(count < 0) {
+    if(!wouldBlock()) {
+      setstate(std::ios::eofbit | std::ios::failbit);
+    }
+    return false;
+  }
+  if(count == (std::streamsize)line.size()) {
+    // The last record had no delimiter, as std::getline() sees it.
+    setstate(std::ios::eofbit);
+  }
+  return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // class tcp_socket_stream implementation
 /////////////////////////////////////////////////////////////////////////////
@@ -665,6 +1358,14 @@ tcp_socket_stream::tcp_socket_stream(SOCKET_TYPE socket)
   m_protocol = FreeSockets::proto_TCP;
 }
 
+tcp_socket_stream::tcp_socket_stream(stream_socketbuf & buffer)
+    : stream_socket_stream(buffer),
+      _connecting_address(0),
+      _connecting_addrlist(0)
+{
+  m_protocol = FreeSockets::proto_TCP;
+}
+
 tcp_socket_stream::tcp_socket_stream(const std::string& address, int service,
                                      bool nonblock) :
       _connecting_address(0),
@@ -942,6 +1643,46 @@ const std::string tcp_socket_stream::getRemoteService(bool lookup) const
   return "[unknown]";
 }
 
+int tcp_socket_stream::getTcpInfo(tcp_connection_info & info) const
+{
+  info = tcp_connection_info();
+#if defined(TCP_INFO) && defined(__linux__)
+  struct tcp_info ti;
+  SOCKLEN len = sizeof(ti);
+  if(::getsockopt(getSocket(), IPPROTO_TCP, TCP_INFO, &ti, &len) != 0) {
+    setLastError();
+    return -1;
+  }
+  info.rtt = ti.tcpi_rtt;
+  info.rtt_var = ti.tcpi_rttvar;
+  info.rto = ti.tcpi_rto;
+  info.cwnd = ti.tcpi_snd_cwnd;
+  info.ssthresh = ti.tcpi_snd_ssthresh;
+  info.mss = ti.tcpi_snd_mss;
+  info.unacked = ti.tcpi_unacked;
+  info.lost = ti.tcpi_lost;
+  info.retransmits = ti.tcpi_retransmits;
+  info.total_retransmits = ti.tcpi_total_retrans;
+# ifdef HAVE_LINUX_SOCKIOS_H
+  // The send queue holds both unsent and unacknowledged bytes.
+  int queued = 0, unsent = 0;
+  if(::ioctl(getSocket(), SIOCOUTQ, &queued) == 0 &&
+     ::ioctl(getSocket(), SIOCOUTQNSD, &unsent) == 0 && queued >= unsent) {
+    info.unacked_bytes = queued - unsent;
+    info.unsent_bytes = unsent;
+  }
+# endif // HAVE_LINUX_SOCKIOS_H
+  return 0;
+#else // TCP_INFO
+# ifdef _WIN32
+  LastError = WSAENOPROTOOPT;
+# else // _WIN32
+  LastError = ENOPROTOOPT;
+# endif // _WIN32
+  return -1;
+#endif // TCP_INFO
+}
+
 bool tcp_socket_stream::isReady(unsigned int milliseconds)
 {
   if(_connecting_socket == INVALID_SOCKET) {
@@ -1026,7 +1767,8 @@ dgram_socket_stream::~dgram_socket_stream()
 {
 }
 
-int dgram_socket_stream::bindToIpService(int service, int type, int protocol)
+int dgram_socket_stream::bindToIpService(int service, int type, int protocol,
+                                         int family)
 {
   struct addrinfo req, *ans;
   char serviceName[32];
@@ -1034,7 +1776,7 @@ int dgram_socket_stream::bindToIpService(int service, int type, int protocol)
   ::sprintf(serviceName, "%d", service);
 
   req.ai_flags = AI_PASSIVE;
-  req.ai_family = PF_UNSPEC;
+  req.ai_family = family;
   req.ai_socktype = type;
   req.ai_protocol = 0;
   req.ai_addrlen = 0;
@@ -1088,54 +1830,491 @@ udp_socket_stream::~udp_socket_stream()
   // destructor
 }
 
-int udp_socket_stream::open(int service)
+int udp_socket_stream::open(int service, int family)
 {
   if (is_open()) {
     close();
   }
 
-  if (bindToIpService(service, SOCK_DGRAM, IPPROTO_UDP) != 0) {
+  if (bindToIpService(service, SOCK_DGRAM, IPPROTO_UDP, family) != 0) {
     return -1;
   }
 
   return 0;
 }
 
+int udp_socket_stream::open(udp_socket_server & server,
+                            const sockaddr_storage & peer, SOCKLEN peer_size)
+{
+  if (is_open()) {
+    close();
+  }
+
+  SOCKET_TYPE sock = server.connectPeer(peer, peer_size);
+  if (sock == INVALID_SOCKET) {
+    copyLastError(server);
+    return -1;
+  }
+
+  dgram_sockbuf.setSocket(sock);
+  dgram_sockbuf.setOutpeer(peer, peer_size);
+  // connectPeer() connected the socket already. Connecting it again to
+  // the same peer changes nothing in the kernel, and marks the buffer as
+  // connected with the peer as the only source.
+  if (!setConnected(true)) {
+    return -1;
+  }
+
+  return 0;
+}
+
+// Parse a numeric group address.
+static bool parseGroup(const std::string & group, sockaddr_storage & addr)
+{
+  struct addrinfo req, *ans;
+  std::memset(&req, 0, sizeof(req));
+  req.ai_flags = AI_NUMERICHOST;
+  req.ai_family = PF_UNSPEC;
+  req.ai_socktype = SOCK_DGRAM;
+
+  if (::getaddrinfo(group.c_str(), 0, &req, &ans) != 0) {
+    return false;
+  }
+  std::memset(&addr, 0, sizeof(addr));
+  std::memcpy(&addr, ans->ai_addr, ans->ai_addrlen);
+  ::freeaddrinfo(ans);
+  return true;
+}
+
+// Find an interface index from a name or a number. Empty means any.
+static bool parseInterface(const std::string & iface, unsigned & index)
+{
+  index = 0;
+  if (iface.empty()) {
+    return true;
+  }
+  char * end;
+  unsigned long number = std::strtoul(iface.c_str(), &end, 10);
+  if (*end == '\0') {
+    index = number;
+    return true;
+  }
+#ifndef _WIN32
+  index = ::if_nametoindex(iface.c_str());
+#endif // _WIN32
+  return index != 0;
+}
+
+bool udp_socket_stream::changeGroup(bool join, const std::string & group,
+                                    const std::string & iface)
+{
+  sockaddr_storage addr;
+  if (!parseGroup(group, addr)) {
+    LastError = EINVAL;
+    return false;
+  }
+  int level = addr.ss_family == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
+
+  // An IPv4 group joined on an interface given by its address goes
+  // through the older option, which takes the address directly.
+  struct in_addr local;
+  local.s_addr = htonl(INADDR_ANY);
+  bool by_address = addr.ss_family == AF_INET && !iface.empty() &&
+                    ::inet_pton(AF_INET, iface.c_str(), &local) == 1;
+
+  unsigned index = 0;
+  if (!by_address && !parseInterface(iface, index)) {
+    LastError = EINVAL;
+    return false;
+  }
+
+  int ret;
+  if (addr.ss_family == AF_INET && (by_address || index == 0)) {
+    struct ip_mreq req;
+    req.imr_multiaddr = ((sockaddr_in&)addr).sin_addr;
+    req.imr_interface = local;
+    ret = ::setsockopt(getSocket(), level,
+                       join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+                       (char*)&req, sizeof(req));
+  } else {
+#ifdef MCAST_JOIN_GROUP
+    struct group_req req;
+    std::memset(&req, 0, sizeof(req));
+    req.gr_interface = index;
+    std::memcpy(&req.gr_group, &addr, sizeof(addr));
+    ret = ::setsockopt(getSocket(), level,
+                       join ? MCAST_JOIN_GROUP : MCAST_LEAVE_GROUP,
+                       (char*)&req, sizeof(req));
+#else // MCAST_JOIN_GROUP
+    if (addr.ss_family == AF_INET6) {
+      struct ipv6_mreq req;
+      req.ipv6mr_multiaddr = ((sockaddr_in6&)addr).sin6_addr;
+      req.ipv6mr_interface = index;
+      ret = ::setsockopt(getSocket(), level,
+                         join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP,
+                         (char*)&req, sizeof(req));
+    } else {
+      // Without the newer interface IPv4 groups can only be joined on an
+      // interface given by address.
+      LastError = EINVAL;
+      return false;
+    }
+#endif // MCAST_JOIN_GROUP
+  }
+
+  if (ret == SOCKET_ERROR) {
+    setLastError();
+    return false;
+  }
+  return true;
+}
+
+bool udp_socket_stream::joinGroup(const std::string & group,
+                                  const std::string & iface)
+{
+  return changeGroup(true, group, iface);
+}
+
+bool udp_socket_stream::leaveGroup(const std::string & group,
+                                   const std::string & iface)
+{
+  return changeGroup(false, group, iface);
+}
+
+bool udp_socket_stream::setMulticastTTL(int hops)
+{
+  int ret;
+  if (getFamily() == AF_INET6) {
+    ret = ::setsockopt(getSocket(), IPPROTO_IPV6, IPV6_MULTICAST_HOPS,
+                       (char*)&hops, sizeof(hops));
+  } else {
+    // Some systems only take a byte for the IPv4 options.
+    unsigned char ttl = hops;
+    ret = ::setsockopt(getSocket(), IPPROTO_IP, IP_MULTICAST_TTL,
+                       (char*)&ttl, sizeof(ttl));
+  }
+  if (ret == SOCKET_ERROR) {
+    setLastError();
+    return false;
+  }
+  return true;
+}
+
+bool udp_socket_stream::setMulticastLoop(bool opt)
+{
+  int ret;
+  if (getFamily() == AF_INET6) {
+    unsigned int loop = opt ? 1 : 0;
+    ret = ::setsockopt(getSocket(), IPPROTO_IPV6, IPV6_MULTICAST_LOOP,
+                       (char*)&loop, sizeof(loop));
+  } else {
+    unsigned char loop = opt ? 1 : 0;
+    ret = ::setsockopt(getSocket(), IPPROTO_IP, IP_MULTICAST_LOOP,
+                       (char*)&loop, sizeof(loop));
+  }
+  if (ret == SOCKET_ERROR) {
+    setLastError();
+    return false;
+  }
+  return true;
+}
+
+bool udp_socket_stream::setMulticastInterface(const std::string & iface)
+{
+  int ret;
+  if (getFamily() == AF_INET6) {
+    unsigned index;
+    if (!parseInterface(iface, index)) {
+      LastError = EINVAL;
+      return false;
+    }
+    ret = ::setsockopt(getSocket(), IPPROTO_IPV6, IPV6_MULTICAST_IF,
+                       (char*)&index, sizeof(index));
+  } else {
+    struct in_addr address;
+    address.s_addr = htonl(INADDR_ANY);
+    if (!iface.empty() &&
+        ::inet_pton(AF_INET, iface.c_str(), &address) != 1) {
+#ifdef __linux__
+      // Linux can take an index instead of an address.
+      struct ip_mreqn req;
+      std::memset(&req, 0, sizeof(req));
+      unsigned index;
+      if (!parseInterface(iface, index)) {
+        LastError = EINVAL;
+        return false;
+      }
+      req.imr_ifindex = index;
+      ret = ::setsockopt(getSocket(), IPPROTO_IP, IP_MULTICAST_IF,
+                         (char*)&req, sizeof(req));
+      if (ret == SOCKET_ERROR) {
+        setLastError();
+        return false;
+      }
+      return true;
+#else // __linux__
+      LastError = EINVAL;
+      return false;
+#endif // __linux__
+    }
+    ret = ::setsockopt(getSocket(), IPPROTO_IP, IP_MULTICAST_IF,
+                       (char*)&address, sizeof(address));
+  }
+  if (ret == SOCKET_ERROR) {
+    setLastError();
+    return false;
+  }
+  return true;
+}
+
 #ifdef SKSTREAM_UNIX_SOCKETS
 
 #include <skstream/skstream_unix.h>
+#include <skstream/skserver.h>
 
 #include <sys/un.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstddef>
+
+/////////////////////////////////////////////////////////////////////////////
+// class unix_address implementation
+/////////////////////////////////////////////////////////////////////////////
+
+unix_address::unix_address(const std::string & name) : _size(0), _dir(-1),
+                                                         _error(0)
+{
+  std::memset(&_address, 0, sizeof(_address));
+  _address.sun_family = AF_UNIX;
+  const SOCKLEN base = offsetof(sockaddr_un, sun_path);
+
+  if(!name.empty() && (name[0] == '@' || name[0] == '\0')) {
+#ifdef __linux__
+    // The name is not NUL terminated, and its length is the address size.
+    if(name.size() > sizeof(_address.sun_path)) {
+      _error = ENAMETOOLONG;
+      return;
+    }
+    std::memcpy(_address.sun_path + 1, name.data() + 1, name.size() - 1);
+    _size = base + name.size();
+#else // __linux__
+    _error = EAFNOSUPPORT;
+#endif // __linux__
+    return;
+  }
+
+  if(name.size() < sizeof(_address.sun_path)) {
+    std::memcpy(_address.sun_path, name.data(), name.size());
+    _size = base + name.size() + 1;
+    return;
+  }
+
+#ifdef O_PATH
+  // Too long for sun_path, so name the socket relative to a descriptor
+  // for its directory.
+  std::string::size_type slash = name.rfind('/');
+  if(slash != std::string::npos && slash != 0) {
+    _dir = ::open(name.substr(0, slash).c_str(),
+                  O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if(_dir == -1) {
+      _error = errno;
+      return;
+    }
+    char path[sizeof(_address.sun_path) + 32];
+    int len = snprintf(path, sizeof(path), "/proc/self/fd/%d/%s", _dir,
+                       name.c_str() + slash + 1);
+    if(len > 0 && (std::size_t)len < sizeof(_address.sun_path)) {
+      std::memcpy(_address.sun_path, path, len);
+      _size = base + len + 1;
+      return;
+    }
+  }
+#endif // O_PATH
+  _error = ENAMETOOLONG;
+}
+
+unix_address::~unix_address()
+{
+  if(_dir != -1) {
+    ::close(_dir);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class unix_socketbuf implementation
+/////////////////////////////////////////////////////////////////////////////
+
+unix_socketbuf::unix_socketbuf(SOCKET_TYPE sock) : stream_socketbuf(sock)
+{
+}
+
+unix_socketbuf::~unix_socketbuf()
+{
+  std::deque<SOCKET_TYPE>::const_iterator I = _fds.begin();
+  for(; I != _fds.end(); ++I) {
+    ::closesocket(*I);
+  }
+}
+
+std::size_t unix_socketbuf::takeFds(std::vector<SOCKET_TYPE> & fds,
+                                    std::size_t max)
+{
+  std::size_t count = 0;
+  for(; count < max && !_fds.empty(); ++count) {
+    fds.push_back(_fds.front());
+    _fds.pop_front();
+  }
+  return count;
+}
+
+// Receive with recvmsg(), as recv() would close any descriptors sent.
+int unix_socketbuf::receive(std::streambuf::char_type * buf,
+                            std::size_t len, int flags)
+{
+  struct iovec iov;
+  iov.iov_base = buf;
+  iov.iov_len = len;
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(MAX_FDS * sizeof(SOCKET_TYPE))];
+  } control;
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+#ifdef MSG_CMSG_CLOEXEC
+  flags |= MSG_CMSG_CLOEXEC;
+#endif
+  ssize_t size = ::recvmsg(_socket, &msg, flags);
+  if(size < 0) {
+    return -1;
+  }
+
+  // Some of the descriptors sent have been lost if the control data was
+  // cut short, so the ones which arrived are no use to anyone.
+  bool truncated = (msg.msg_flags & MSG_CTRUNC) != 0;
+  struct cmsghdr * cm = CMSG_FIRSTHDR(&msg);
+  for(; cm != 0; cm = CMSG_NXTHDR(&msg, cm)) {
+    if(cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    std::size_t count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(SOCKET_TYPE);
+    const unsigned char * data = CMSG_DATA(cm);
+    for(std::size_t i = 0; i < count; ++i) {
+      SOCKET_TYPE fd;
+      std::memcpy(&fd, data + i * sizeof(fd), sizeof(fd));
+      if(truncated) {
+        ::closesocket(fd);
+      } else {
+        _fds.push_back(fd);
+      }
+    }
+  }
+
+  if(truncated) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  if(msg.msg_flags & MSG_TRUNC) {
+    // The rest of a message too big for the buffer has been lost.
+    errno = EMSGSIZE;
+    return -1;
+  }
+  return size;
+}
+
+std::streamsize unix_socketbuf::readMessage(std::string & message)
+{
+  if(_socket == INVALID_SOCKET) {
+    return -1;
+  }
+
+  if(gptr() < egptr()) {
+    message.assign(gptr(), egptr());
+    setg(eback(), egptr(), egptr());
+    return message.size();
+  }
+
+  if(!_nonblocking) {
+    struct pollfd pfd;
+    pfd.fd = _socket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    while(::poll(&pfd, 1, -1) < 0) {
+      if(errno != EINTR) {
+        return -1;
+      }
+    }
+  }
+
+  // All the data waiting, which is at least the size of the next message.
+  int waiting = 0;
+  if(::ioctl(_socket, FIONREAD, &waiting) == SOCKET_ERROR) {
+    return -1;
+  }
+  if(_message.size() < (std::size_t)waiting + 1) {
+    _message.resize(waiting + 1);
+  }
+  int got = receive(&_message[0], _message.size(), MSG_DONTWAIT);
+  if(got < 0) {
+    WouldBlock = isWouldBlock(getSystemError());
+    message.clear();
+    return -1;
+  }
+  WouldBlock = false;
+  message.assign(&_message[0], got);
+  return got;
+}
 
 /////////////////////////////////////////////////////////////////////////////
 // class unix_socket_stream implementation
 /////////////////////////////////////////////////////////////////////////////
 
+// Tag sent with a listen socket by sendListener()
+static const char LISTENER_TAG[] = "skstream-listener";
+
 unix_socket_stream::unix_socket_stream()
+    : stream_socket_stream(*new unix_socketbuf(INVALID_SOCKET)),
+      unix_sockbuf((unix_socketbuf&)_sockbuf)
 {
 }
 
 unix_socket_stream::unix_socket_stream(SOCKET_TYPE socket)
-    : stream_socket_stream(socket)
+    : stream_socket_stream(*new unix_socketbuf(socket)),
+      unix_sockbuf((unix_socketbuf&)_sockbuf)
 {
 }
 
 unix_socket_stream::unix_socket_stream(const std::string & address,
-                                       bool nonblock)
+                                       bool nonblock, int type)
+    : stream_socket_stream(*new unix_socketbuf(INVALID_SOCKET)),
+      unix_sockbuf((unix_socketbuf&)_sockbuf)
 {
-  open(address, nonblock);
+  open(address, nonblock, type);
 }
 
 unix_socket_stream::unix_socket_stream(const std::string & address,
-                                       unsigned int milliseconds)
+                                       unsigned int milliseconds, int type)
+    : stream_socket_stream(*new unix_socketbuf(INVALID_SOCKET)),
+      unix_sockbuf((unix_socketbuf&)_sockbuf)
 {
-  open(address, milliseconds);
+  open(address, milliseconds, type);
 }
 
 unix_socket_stream::unix_socket_stream(unix_socket_stream & other,
-                                       bool nonblock)
+                                       bool nonblock, int type)
+    : stream_socket_stream(*new unix_socketbuf(INVALID_SOCKET)),
+      unix_sockbuf((unix_socketbuf&)_sockbuf)
 {
-  open(other, nonblock);
+  open(other, nonblock, type);
 }
 
 unix_socket_stream::~unix_socket_stream()
@@ -1147,16 +2326,19 @@ unix_socket_stream::~unix_socket_stream()
   }
 }
 
-void unix_socket_stream::open(const std::string & address, bool nonblock)
+void unix_socket_stream::open(const std::string & address, bool nonblock,
+                              int type)
 {
-  if (address.size() >  107) {
+  unix_address sa(address);
+  if(!sa.isValid()) {
+    LastError = sa.getError();
     return;
   }
 
   if(is_open() || _connecting_socket != INVALID_SOCKET) close();
 
   // Create socket
-  SOCKET_TYPE sfd = ::socket(AF_UNIX, SOCK_STREAM, m_protocol);
+  SOCKET_TYPE sfd = ::socket(AF_UNIX, type, m_protocol);
   if(sfd == INVALID_SOCKET) {
     setLastError();
     return;
@@ -1171,12 +2353,7 @@ void unix_socket_stream::open(const std::string & address, bool nonblock)
     }
   }
 
-  // Fill host information
-  sockaddr_un sa;
-  sa.sun_family = AF_UNIX;
-  strncpy(sa.sun_path, address.c_str(), sizeof(sa.sun_path));
-
-  if(::connect(sfd,(sockaddr*)&sa, sizeof(sa)) == SOCKET_ERROR) {
+  if(::connect(sfd, sa.addr(), sa.size()) == SOCKET_ERROR) {
     if(nonblock && getSystemError() == SOCKET_BLOCK_ERROR) {
       _connecting_socket = sfd;
       return;
@@ -1201,17 +2378,156 @@ void unix_socket_stream::open(const std::string & address, bool nonblock)
 }
 
 void unix_socket_stream::open(const std::string & address,
-                              unsigned int milliseconds)
+                              unsigned int milliseconds, int type)
 {
-  open(address, true);
+  open(address, true, type);
   if(!isReady(milliseconds)) {
     close();
   }
 }
 
-void unix_socket_stream::open(unix_socket_stream & other, bool nonblock)
+void unix_socket_stream::open(unix_socket_stream & other, bool nonblock,
+                              int type)
+{
+  if(&other == this) {
+    return;
+  }
+
+  if(is_open() || _connecting_socket != INVALID_SOCKET) close();
+  if(other.is_open() || other._connecting_socket != INVALID_SOCKET) {
+    other.close();
+  }
+
+  SOCKET_TYPE sfds[2];
+  if(::socketpair(AF_UNIX, type, 0, sfds) == SOCKET_ERROR) {
+    setLastError();
+    other.copyLastError(*this);
+    return;
+  }
+
+  // set sockets for underlying socketbufs
+  _sockbuf.setSocket(sfds[0]);
+  other._sockbuf.setSocket(sfds[1]);
+
+  if(nonblock) {
+    setNonBlocking(true);
+    other.setNonBlocking(true);
+  }
+}
+
+int unix_socket_stream::sendFds(const SOCKET_TYPE * fds, std::size_t count,
+                                const std::string & data)
+{
+  if(count == 0 || count > unix_socketbuf::MAX_FDS || data.empty()) {
+    LastError = EINVAL;
+    return -1;
+  }
+
+  // Everything written so far must arrive before the descriptors.
+  flush();
+  if(pendingBytes() > 0) {
+    LastError = EAGAIN;
+    return -1;
+  }
+
+  struct iovec iov;
+  iov.iov_base = const_cast<char *>(data.data());
+  iov.iov_len = data.size();
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(unix_socketbuf::MAX_FDS * sizeof(SOCKET_TYPE))];
+  } control;
+  std::memset(control.buf, 0, sizeof(control.buf));
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = CMSG_SPACE(count * sizeof(SOCKET_TYPE));
+
+  struct cmsghdr * cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_SOCKET;
+  cm->cmsg_type = SCM_RIGHTS;
+  cm->cmsg_len = CMSG_LEN(count * sizeof(SOCKET_TYPE));
+  std::memcpy(CMSG_DATA(cm), fds, count * sizeof(SOCKET_TYPE));
+
+  ssize_t size = ::sendmsg(getSocket(), &msg,
+                           nonBlocking() ? MSG_DONTWAIT : 0);
+  if(size < 0) {
+    setLastError();
+    return -1;
+  }
+
+  // The descriptors went with the first byte, so the rest of the data
+  // can follow as ordinary output.
+  if((std::size_t)size < data.size()) {
+    write(data.data() + size, data.size() - size);
+    flush();
+  }
+  return 0;
+}
+
+int unix_socket_stream::sendMessage(const char * data, std::size_t len)
+{
+  // Everything written so far must arrive before the message.
+  flush();
+  if(pendingBytes() > 0) {
+    LastError = EAGAIN;
+    return -1;
+  }
+
+  ssize_t size = ::send(getSocket(), data, len,
+                        nonBlocking() ? MSG_DONTWAIT : 0);
+  if(size < 0) {
+    setLastError();
+    return -1;
+  }
+
+  // Only a SOCK_STREAM socket takes part of a message, and the rest can
+  // follow as ordinary output, queued if the stream is non-blocking.
+  if((std::size_t)size < len) {
+    write(data + size, len - size);
+    flush();
+    if(bad()) {
+      setLastError();
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int unix_socket_stream::sendListener(const basic_socket_server & server)
 {
-  // FIXME Create a socketpair connecting the two stream together.
+  SOCKET_TYPE sock = server.getSocket();
+  if(sock == INVALID_SOCKET) {
+    LastError = EBADF;
+    return -1;
+  }
+  return sendFds(&sock, 1, std::string(LISTENER_TAG) + '\n');
+}
+
+int unix_socket_stream::recvListener(basic_socket_server & server)
+{
+  std::string line;
+  if(!readLine(line)) {
+    return -1;
+  }
+  // Exactly one descriptor should be waiting. Any others were never
+  // claimed, and passing one of those on would be worse than failing.
+  std::vector<SOCKET_TYPE> fds;
+  recvFds(fds);
+  if(line != LISTENER_TAG || fds.size() != 1) {
+    std::vector<SOCKET_TYPE>::const_iterator I = fds.begin();
+    for(; I != fds.end(); ++I) {
+      ::closesocket(*I);
+    }
+    LastError = EPROTO;
+    return -1;
+  }
+  server.setSocket(fds.front());
+  return 0;
 }
 
 bool unix_socket_stream::isReady(unsigned int milliseconds)
@@ -1274,20 +2590,58 @@ bool unix_socket_stream::isReady(unsigned int milliseconds)
 /////////////////////////////////////////////////////////////////////////////
 #ifdef SOCK_RAW
 
-raw_socket_stream::raw_socket_stream(FreeSockets::IP_Protocol proto)
+raw_socket_stream::raw_socket_stream(FreeSockets::IP_Protocol proto, int type)
+    : m_type(type)
 {
   m_protocol = proto;
-  SOCKET_TYPE sfd = ::socket(AF_INET, SOCK_RAW, m_protocol);
+  SOCKET_TYPE sfd = ::socket(AF_INET, m_type, m_protocol);
+  if(sfd == INVALID_SOCKET) {
+    setLastError();
+  }
   _sockbuf.setSocket(sfd);
 }
 
-void raw_socket_stream::setProtocol(FreeSockets::IP_Protocol proto) {
+void raw_socket_stream::setProtocol(FreeSockets::IP_Protocol proto, int type) {
   if(is_open()) close();
   m_protocol = proto;
-  SOCKET_TYPE sfd = ::socket(AF_INET, SOCK_RAW, m_protocol);
+  m_type = type;
+  SOCKET_TYPE sfd = ::socket(AF_INET, m_type, m_protocol);
+  if(sfd == INVALID_SOCKET) {
+    setLastError();
+  }
   _sockbuf.setSocket(sfd);
 }
 
+bool raw_socket_stream::setTarget(const std::string& address, unsigned port)
+{
+  // Unlike other datagram streams, the socket is not replaced, as a new
+  // one would be a UDP socket.
+  ip_datagram_address target;
+
+  char portName[32];
+
+  ::sprintf(portName, "%u", port);
+
+  if(target.resolveConnector(address, portName) != 0) {
+    copyLastError(target);
+    return false;
+  }
+
+  ip_datagram_address::const_iterator I = target.begin();
+  for(; I != target.end(); ++I) {
+    struct addrinfo * i = *I;
+    if(i->ai_family == AF_INET) {
+      sockaddr_storage peer;
+      ::memcpy(&peer, i->ai_addr, i->ai_addrlen);
+      dgram_sockbuf.setOutpeer(peer, i->ai_addrlen);
+      return true;
+    }
+  }
+
+  LastError = EAFNOSUPPORT;
+  return false;
+}
+
 raw_socket_stream::~raw_socket_stream()
 {
   // Don't close the main socket, that is done in the basic_socket_stream
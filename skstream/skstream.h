@@ -30,6 +30,9 @@
 #define RGJ_FREE_STREAM_H_
 
 #include <iostream>
+#include <string>
+#include <deque>
+#include <vector>
 
 #include <skstream/sksocket.h>
 
@@ -56,6 +59,8 @@ private:
 
 protected:
   bool Timeout;
+  bool WouldBlock;
+  int ReadError;
 
 public:
   /** Make a new socket buffer from an existing socket, with optional
@@ -105,6 +110,33 @@ public:
     return Timeout;
   }
 
+  /** Return the flag indicating that the last read failed because no
+   *  data was available on a non-blocking socket, rather than because
+   *  the connection was closed.
+   */
+  bool wouldBlock() const {
+    return WouldBlock;
+  }
+
+  /** Return the system error which ended the last read on a stream
+   *  socket, or 0 if it ended at end of file.
+   */
+  int readError() const {
+    return ReadError;
+  }
+
+  /** Return the data read from the socket and not yet consumed, reading
+   *  more first if there is none, so a filter can work on it in place
+   *  rather than copying it out. Returns the number of bytes, or 0 at end
+   *  of file, on error, or if a non-blocking socket has nothing waiting.
+   */
+  std::streamsize fillBuffer(const std::streambuf::char_type *& data);
+
+  /// Mark bytes returned by fillBuffer() as consumed.
+  void consumeBuffer(std::streamsize count) {
+    gbump(count);
+  }
+
 protected:
   /// Handle writing data from the buffer to the socket.
   virtual int_type overflow(int_type nCh = traits_type::eof()) = 0;
@@ -122,6 +154,31 @@ protected:
 
 /// A stream buffer class that handles stream sockets
 class stream_socketbuf : public socketbuf {
+private:
+  /** Partial record read before the socket would have blocked, put back
+   *  as the get area so ordinary reads still see it.
+   */
+  std::vector<std::streambuf::char_type> _held;
+  /// The usual get area, while the held record is being read instead.
+  std::streambuf::char_type * _get_base;
+  std::streambuf::char_type * _get_end;
+  /// Output which could not be sent without blocking, in chunks.
+  std::deque<std::string> _pending;
+  /// Offset of the first unsent byte in the first pending chunk.
+  std::size_t _pending_offset;
+  /// Total number of bytes in the pending chunks.
+  std::size_t _pending_bytes;
+  std::size_t _low_watermark;
+  std::size_t _high_watermark;
+  bool _congested;
+
+  void queueOutput(const std::streambuf::char_type * data, std::size_t len);
+  void checkWatermarks();
+  void holdBack(const std::string & data);
+
+protected:
+  bool _nonblocking;
+
 public:
   /** Make a new socket buffer from an existing socket, with optional
    *  buffer sizes.
@@ -138,12 +195,98 @@ public:
   /// Destroy the socket buffer.
   virtual ~stream_socketbuf();
 
+  /** Read characters up to the delimiter into line, discarding the
+   *  delimiter. The buffered data is scanned in bulk, and the socket is
+   *  only read again when no delimiter is found in the buffer.
+   *  Returns the number of characters extracted, including the delimiter,
+   *  or -1 if no data could be read at all. If the socket would block
+   *  before the delimiter is found, -1 is returned and the partial record
+   *  is put back, to be read again by the next call or any other read.
+   */
+  std::streamsize readUntil(std::string & line, char delim);
+
+  /// Read a newline terminated line into line, discarding the newline.
+  std::streamsize readLine(std::string & line) {
+    return readUntil(line, '\n');
+  }
+
+  /** Set whether the socket should be used without blocking. In
+   *  non-blocking mode output which the socket will not accept is queued,
+   *  and must be sent later by calling flushPending() when the socket
+   *  is ready for writing. Reads which find no data fail with the
+   *  wouldBlock() flag set. Windows has no per-call non-blocking flag, so
+   *  there the socket itself is switched, and this must be called again
+   *  if the socket is replaced. Buffers which hand the socket to code
+   *  that cannot be given the flag switch it here too.
+   */
+  virtual void setNonBlocking(bool nonblock);
+
+  bool nonBlocking() const {
+    return _nonblocking;
+  }
+
+  /// Return the number of bytes written but not yet sent.
+  std::size_t pendingBytes() const {
+    return _pending_bytes + (pptr() - pbase());
+  }
+
+  /** Send as much queued output as possible without blocking.
+   *  Returns 0, or -1 if an error occured.
+   */
+  int flushPending();
+
+  /** Queue a complete buffer to be sent after anything already written.
+   *  Large buffers are taken over without copying, leaving buffer empty.
+   *  For non-blocking mode only, with the data sent by flushPending().
+   */
+  void queueBuffer(std::string & buffer);
+
+  /** Set the queue size at which the buffer is flagged as congested,
+   *  and the size it must drain to before the flag is cleared.
+   */
+  void setWatermarks(std::size_t low, std::size_t high) {
+    _low_watermark = low;
+    _high_watermark = high;
+    checkWatermarks();
+  }
+
+  /** Return the flag indicating that queued output has passed the high
+   *  watermark, and has not yet drained to the low watermark.
+   */
+  bool congested() const {
+    return _congested;
+  }
+
 protected:
   /// Handle writing data from the buffer to the socket.
   virtual int_type overflow(int_type nCh = traits_type::eof());
   /// Handle reading data from the socket to the buffer.
   virtual int_type underflow();
+  /// Read from the socket. Returns as recv() does.
+  virtual int receive(std::streambuf::char_type * buf, std::size_t len,
+                      int flags);
+  /// Write to the socket. Returns as send() does.
+  virtual int transmit(const std::streambuf::char_type * buf,
+                       std::size_t len, int flags);
+#ifndef _WIN32
+  /// Write a gathered buffer to the socket. Returns as sendmsg() does.
+  virtual int transmitv(const struct iovec * iov, int count, int flags);
+#endif // _WIN32
+
+};
 
+class udp_socket_server;
+
+/// \brief A datagram received by dgram_socketbuf::receiveDatagram().
+///
+/// The data points into the socket buffer, and is only valid until the
+/// next read from the same buffer.
+struct datagram_view {
+  const char * data;
+  std::size_t size;
+  /// Address of the sender.
+  const sockaddr_storage * peer;
+  SOCKLEN peer_size;
 };
 
 /// A stream buffer class that handles datagram sockets
@@ -168,6 +311,14 @@ public:
 
   void setOutpeer(const sockaddr_storage & peer) { 
     out_peer = peer; 
+    if(_connected) {
+      setConnected(true);
+    }
+  }
+
+  void setOutpeer(const sockaddr_storage & peer, SOCKLEN size) {
+    out_p_size = size;
+    setOutpeer(peer);
   }
 
   const sockaddr_storage & getOutpeer() const {
@@ -186,6 +337,81 @@ public:
     return in_p_size;
   }
 
+  /** Split output into datagrams of this size, rather than sending each
+   *  flush as one datagram. The last datagram of a flush may be shorter.
+   *  Where UDP_SEGMENT is available the kernel does the splitting, so a
+   *  whole buffer of datagrams costs one system call. Zero turns it off.
+   */
+  void setSegmentSize(std::size_t size) {
+    _segment_size = size;
+  }
+
+  std::size_t getSegmentSize() const {
+    return _segment_size;
+  }
+
+  /** Connect the socket to the target, so datagrams are sent with send()
+   *  and the kernel keeps the route rather than looking it up for each
+   *  one. Datagrams from anywhere else are dropped by the kernel. If no
+   *  target has been set yet, the socket is connected when it is. Turning
+   *  it off disconnects the socket. Returns false if connect() failed.
+   */
+  bool setConnected(bool opt);
+
+  bool isConnected() const {
+    return _connected;
+  }
+
+  /** Let the kernel coalesce received datagrams with UDP_GRO. They are
+   *  split up again here, so each is still read separately. Returns false
+   *  if the system does not support it, in which case datagrams are
+   *  received one at a time as usual.
+   */
+  bool setReceiveOffload(bool opt);
+
+  // Explicit datagrams. Normally output is sent whenever the buffer fills
+  // or is flushed, so where one datagram ends is up to the buffer. Between
+  // beginDatagram() and sendDatagram(), output is only sent when
+  // sendDatagram() is called, and always as exactly one datagram.
+
+  /** Start a datagram. Output already written is sent first, as it would
+   *  have been by a flush. Returns 0, or -1 if that could not be sent.
+   */
+  int beginDatagram();
+
+  /** Send everything written since beginDatagram() as one datagram to the
+   *  target. A datagram larger than the output buffer is never split:
+   *  the stream fails when it fills, and nothing is sent. Returns the
+   *  size sent, or -1 on error.
+   */
+  int sendDatagram();
+
+  /** Send data as one datagram to the target, straight from the caller's
+   *  memory. Output already written is sent first. Returns the size sent,
+   *  or -1 on error.
+   */
+  int sendDatagram(const char * data, std::size_t len);
+
+  /// Return true between beginDatagram() and sendDatagram().
+  bool inDatagram() const {
+    return _in_datagram;
+  }
+
+  /** Receive the next datagram whole, without copying it into the stream.
+   *  The rest of a datagram already partly read through the stream comes
+   *  first. Datagrams coalesced by receive offload are returned one at a
+   *  time. Returns the size of the datagram, which may be 0, or -1 on
+   *  error, or if a non-blocking socket has none waiting.
+   */
+  int receiveDatagram(datagram_view & datagram);
+
+  /** Return true if a datagram, or the rest of one, has already been read
+   *  from the socket, so receiveDatagram() can return it without reading.
+   */
+  bool datagramBuffered() const {
+    return gptr() < egptr() || _offload_offset < _offload_length;
+  }
+
 protected:
   /// Target address of datagrams sent via this stream
   sockaddr_storage out_peer;
@@ -196,6 +422,34 @@ protected:
   /// Size of source address
   SOCKLEN in_p_size;
 
+  std::size_t _segment_size;
+  /// Set if the socket is connected to out_peer.
+  bool _connected;
+  /// Set between beginDatagram() and sendDatagram().
+  bool _in_datagram;
+  /// Set if the datagram being written outgrew the buffer.
+  bool _datagram_overflow;
+  /// Cleared if the kernel turns out not to support UDP_SEGMENT.
+  bool _send_offload;
+  bool _receive_offload;
+  /// The socket UDP_GRO has been enabled on.
+  SOCKET_TYPE _offload_socket;
+  /// Datagrams received whole, several if coalesced by the kernel, which
+  /// have not yet been passed on.
+  std::string _offload_buffer;
+  std::size_t _offload_offset;
+  std::size_t _offload_length;
+  std::size_t _offload_segment;
+
+  int sendSegments(const char * data, std::size_t len);
+  int_type overflowSegments(int_type nCh);
+  int_type underflowOffload();
+  int_type nextSegment();
+  bool enableOffload();
+  int receiveBatch();
+  bool waitTimeout(bool write);
+  int sendPacket(const char * data, std::size_t len);
+
   /// Handle writing data from the buffer to the socket.
   virtual int_type overflow(int_type nCh = traits_type::eof());
   /// Handle reading data from the socket to the buffer.
@@ -230,6 +484,19 @@ public:
     return _sockbuf.timeout();
   }
 
+  /** Check whether the last read stopped because no data was available
+   *  yet on a non-blocking socket. Unlike end of file, this leaves the
+   *  stream usable, and fail() resets the stream state.
+   */
+  bool wouldBlock() const {
+    return _sockbuf.wouldBlock();
+  }
+
+  /// Return the system error which ended the last read, or 0 at end of file.
+  int readError() const {
+    return _sockbuf.readError();
+  }
+
   virtual SOCKET_TYPE getSocket() const;
 
   // Needs to be virtual to handle in-progress connect()'s for
@@ -261,19 +528,89 @@ private:
   stream_socket_stream& operator=(const stream_socket_stream& socket);
 
 protected:
+  stream_socketbuf & stream_sockbuf;
   SOCKET_TYPE _connecting_socket;
 
   stream_socket_stream();
   stream_socket_stream(SOCKET_TYPE socket);
+  /// Make a stream using a buffer of a derived type, which it takes over.
+  explicit stream_socket_stream(stream_socketbuf & buffer);
 public:
   virtual ~stream_socket_stream();
-  
+
   virtual void close();
   virtual SOCKET_TYPE getSocket() const;
 
   bool connect_pending() const {
     return (_connecting_socket != INVALID_SOCKET);
   }
+
+  /** Read characters up to the delimiter into line, discarding the
+   *  delimiter. This is a faster alternative to std::getline() for line
+   *  based protocols. Sets the fail bit if no data could be read, unless
+   *  the socket would have blocked. A last record ended by end of file
+   *  instead of the delimiter is returned with the eof bit set.
+   */
+  bool readLine(std::string & line, char delim = '\n');
+
+  void setNonBlocking(bool nonblock) {
+    stream_sockbuf.setNonBlocking(nonblock);
+  }
+
+  bool nonBlocking() const {
+    return stream_sockbuf.nonBlocking();
+  }
+
+  std::size_t pendingBytes() const {
+    return stream_sockbuf.pendingBytes();
+  }
+
+  /** Send queued output. Call this when a poll reports the socket ready
+   *  for writing while pendingBytes() is non-zero.
+   */
+  int flushPending();
+
+  void queueBuffer(std::string & buffer) {
+    stream_sockbuf.queueBuffer(buffer);
+  }
+
+  void setWatermarks(std::size_t low, std::size_t high) {
+    stream_sockbuf.setWatermarks(low, high);
+  }
+
+  bool congested() const {
+    return stream_sockbuf.congested();
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_cork
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Corks a stream socket for as long as it exists.
+///
+/// Writes made while the cork is in place are held back by the kernel
+/// until they fill whole segments. When the cork goes out of scope the
+/// stream is flushed and uncorked, so a batch of small messages goes out
+/// in as few packets as possible without waiting for Nagle's algorithm.
+class socket_cork {
+public:
+  explicit socket_cork(stream_socket_stream & stream) :
+      _stream(stream), _corked(stream.setCork(true)) { }
+
+  ~socket_cork() {
+    _stream.flush();
+    if(_corked) {
+      _stream.setCork(false);
+    }
+  }
+
+private:
+  socket_cork(const socket_cork&);
+  socket_cork& operator=(const socket_cork&);
+
+  stream_socket_stream & _stream;
+  bool _corked;
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -282,6 +619,29 @@ public:
 
 struct addrinfo;
 
+/// \brief The state of a TCP connection, as reported by the kernel.
+///
+/// Times are in microseconds, and the window and counts of segments in
+/// segments. Fields the system does not report are left at zero.
+struct tcp_connection_info {
+  unsigned rtt;
+  unsigned rtt_var;
+  unsigned rto;
+  unsigned cwnd;
+  unsigned ssthresh;
+  unsigned mss;
+  /// Segments sent but not yet acknowledged.
+  unsigned unacked;
+  unsigned lost;
+  /// Timeouts since the last acknowledgement.
+  unsigned retransmits;
+  unsigned total_retransmits;
+  /// Bytes sent but not yet acknowledged.
+  unsigned long unacked_bytes;
+  /// Bytes in the kernel send buffer not yet sent.
+  unsigned long unsent_bytes;
+};
+
 /// An iostream class that handle TCP sockets
 class tcp_socket_stream : public stream_socket_stream {
 private:
@@ -292,6 +652,10 @@ private:
   struct addrinfo * _connecting_address;
   struct addrinfo * _connecting_addrlist;
 
+protected:
+  /// Make a stream using a buffer of a derived type, which it takes over.
+  explicit tcp_socket_stream(stream_socketbuf & buffer);
+
 public:
   tcp_socket_stream();
   tcp_socket_stream(SOCKET_TYPE socket);
@@ -312,6 +676,12 @@ public:
   const std::string getRemoteHost(bool lookup = false) const;
   const std::string getRemoteService(bool lookup = false) const;
   bool isReady(unsigned int milliseconds = 0);
+
+  /** Read RTT, congestion window, retransmits and queued bytes from the
+   *  kernel's TCP_INFO. Returns 0, or -1 if the socket is not connected
+   *  or the system does not provide TCP_INFO.
+   */
+  int getTcpInfo(tcp_connection_info & info) const;
 };
 
 /// An iostream class that handle IP datagram sockets
@@ -324,7 +694,15 @@ private:
 protected:
   dgram_socketbuf & dgram_sockbuf;
 
-  int bindToIpService(int service, int type, int protocol);
+  int bindToIpService(int service, int type, int protocol,
+                      int family = PF_UNSPEC);
+
+  int checkDatagram(int ret) {
+    if(ret < 0) {
+      setLastError();
+    }
+    return ret;
+  }
 
 public:
   dgram_socket_stream();
@@ -339,6 +717,19 @@ public:
     return dgram_sockbuf.setOutpeer(peer); 
   }
 
+  void setOutpeer(const sockaddr_storage& peer, SOCKLEN size) {
+    return dgram_sockbuf.setOutpeer(peer, size);
+  }
+
+  /// See dgram_socketbuf::setConnected().
+  bool setConnected(bool opt) {
+    return checkDatagram(dgram_sockbuf.setConnected(opt) ? 0 : -1) == 0;
+  }
+
+  bool isConnected() const {
+    return dgram_sockbuf.isConnected();
+  }
+
   const sockaddr_storage & getOutpeer() const { 
     return dgram_sockbuf.getOutpeer(); 
   }
@@ -354,6 +745,38 @@ public:
   SOCKLEN getInpeerSize() const {
     return dgram_sockbuf.getInpeerSize();
   }
+
+  /// See dgram_socketbuf::beginDatagram().
+  int beginDatagram() {
+    return checkDatagram(dgram_sockbuf.beginDatagram());
+  }
+
+  /// See dgram_socketbuf::sendDatagram().
+  int sendDatagram() {
+    return checkDatagram(dgram_sockbuf.sendDatagram());
+  }
+
+  int sendDatagram(const char * data, std::size_t len) {
+    return checkDatagram(dgram_sockbuf.sendDatagram(data, len));
+  }
+
+  int sendDatagram(const std::string & data) {
+    return sendDatagram(data.data(), data.size());
+  }
+
+  bool inDatagram() const {
+    return dgram_sockbuf.inDatagram();
+  }
+
+  /// See dgram_socketbuf::receiveDatagram().
+  int receiveDatagram(datagram_view & datagram) {
+    return checkDatagram(dgram_sockbuf.receiveDatagram(datagram));
+  }
+
+  /// See dgram_socketbuf::datagramBuffered().
+  bool datagramBuffered() const {
+    return dgram_sockbuf.datagramBuffered();
+  }
 };
 
 
@@ -373,7 +796,56 @@ public:
 
   virtual ~udp_socket_stream();
 
-  int open(int service);
+  /** Bind to a local port. The family may be given as AF_INET or
+   *  AF_INET6, as it must match any multicast groups to be joined.
+   */
+  int open(int service, int family = PF_UNSPEC);
+
+  /** Open a socket for one peer of a server opened with
+   *  SK_SRV_REUSEPORT. It shares the server's port and is connected to
+   *  the peer, so the kernel delivers the peer's datagrams here rather
+   *  than to the server. See udp_socket_server::connectPeer(). Returns 0,
+   *  or -1 on error.
+   */
+  int open(udp_socket_server & server, const sockaddr_storage & peer,
+           SOCKLEN peer_size);
+
+  void setSegmentSize(std::size_t size) {
+    dgram_sockbuf.setSegmentSize(size);
+  }
+
+  std::size_t getSegmentSize() const {
+    return dgram_sockbuf.getSegmentSize();
+  }
+
+  bool setReceiveOffload(bool opt) {
+    return dgram_sockbuf.setReceiveOffload(opt);
+  }
+
+  // Multicast. A stream bound with open() receives datagrams sent to the
+  // groups it has joined on its port. A stream sends to a group by making
+  // it the target, after which the options below apply. Interfaces are
+  // given by name or index, or for IPv4 by address, and an empty string
+  // leaves the choice to the routing table. These return false on error.
+
+  /// Receive datagrams sent to an IPv4 or IPv6 group address.
+  bool joinGroup(const std::string & group,
+                 const std::string & iface = std::string());
+  bool leaveGroup(const std::string & group,
+                  const std::string & iface = std::string());
+
+  /// Set how many routers datagrams sent to a group may cross.
+  bool setMulticastTTL(int hops);
+
+  /// Set whether datagrams sent to a group are seen by this host.
+  bool setMulticastLoop(bool opt);
+
+  /// Set the interface datagrams sent to a group go out on.
+  bool setMulticastInterface(const std::string & iface);
+
+private:
+  bool changeGroup(bool join, const std::string & group,
+                   const std::string & iface);
 };
 
 #ifdef SOCK_RAW
@@ -389,17 +861,33 @@ private:
 
   raw_socket_stream& operator=(const raw_socket_stream& socket);
 
+  int m_type;
+
 public:
-  raw_socket_stream(FreeSockets::IP_Protocol proto=FreeSockets::proto_RAW);
+  /** Make a raw socket, which needs privileges on most systems. On
+   *  Linux, a type of SOCK_DGRAM with proto_ICMP makes an unprivileged
+   *  ICMP echo socket instead, if the user's group is allowed by the
+   *  net.ipv4.ping_group_range setting. The kernel then fills in the
+   *  echo identifier and checksum, and replies arrive without their IP
+   *  header.
+   */
+  raw_socket_stream(FreeSockets::IP_Protocol proto=FreeSockets::proto_RAW,
+                    int type = SOCK_RAW);
 
   virtual ~raw_socket_stream();
 
-  void setProtocol(FreeSockets::IP_Protocol proto);
+  void setProtocol(FreeSockets::IP_Protocol proto, int type = SOCK_RAW);
 
-  bool setTarget(const std::string& address, unsigned port) { 
-    return dgram_sockbuf.setTarget(address, port, m_protocol); 
+  /// Return SOCK_RAW, or SOCK_DGRAM for an unprivileged ICMP socket.
+  int getType() const {
+    return m_type;
   }
 
+  /** Send to an IPv4 address, keeping the socket. The port is not used
+   *  by raw sockets.
+   */
+  bool setTarget(const std::string& address, unsigned port = 0);
+
   bool setBroadcast(bool opt=false);
 };
 
@@ -29,6 +29,107 @@
 
 #include <skstream/skstream.h>
 
+#include <deque>
+#include <vector>
+
+#include <sys/un.h>
+
+class basic_socket_server;
+
+/////////////////////////////////////////////////////////////////////////////
+// class unix_address
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief The address of a unix socket, ready for bind() or connect().
+///
+/// A name starting with '@' is in the Linux abstract namespace, so there
+/// is no file to create, and nothing to unlink before a restart. A path
+/// too long for sun_path is reached through a descriptor for its
+/// directory, where /proc/self/fd is available. The descriptor is held
+/// until the address is destroyed.
+class unix_address {
+private:
+  sockaddr_un _address;
+  SOCKLEN _size;
+  int _dir;
+  int _error;
+
+  unix_address(const unix_address&);
+  unix_address& operator=(const unix_address&);
+
+public:
+  explicit unix_address(const std::string & name);
+  ~unix_address();
+
+  /// Return true if the name could be made into an address.
+  bool isValid() const {
+    return _size != 0;
+  }
+
+  /// Return the reason the name could not be used.
+  int getError() const {
+    return _error;
+  }
+
+  bool isAbstract() const {
+    return _size != 0 && _address.sun_path[0] == '\0';
+  }
+
+  const sockaddr * addr() const {
+    return reinterpret_cast<const sockaddr *>(&_address);
+  }
+
+  SOCKLEN size() const {
+    return _size;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class unix_socketbuf
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief A stream buffer for unix sockets, which can receive descriptors.
+///
+/// Descriptors sent with SCM_RIGHTS arrive with the data they were sent
+/// alongside, and are held here until they are claimed. Any left when the
+/// buffer is destroyed are closed.
+class unix_socketbuf : public stream_socketbuf {
+private:
+  std::deque<SOCKET_TYPE> _fds;
+  /// Grown to fit the largest message read, and kept for the next.
+  std::vector<char> _message;
+
+public:
+  /// The most descriptors that can be received in one read.
+  static const std::size_t MAX_FDS = 64;
+
+  explicit unix_socketbuf(SOCKET_TYPE sock);
+  virtual ~unix_socketbuf();
+
+  /** Move up to max received descriptors into fds, in the order they were
+   *  sent. Returns the number moved.
+   */
+  std::size_t takeFds(std::vector<SOCKET_TYPE> & fds, std::size_t max);
+
+  /** Read one whole message from a SOCK_SEQPACKET socket into message.
+   *  The buffer is sized from the data waiting, which is at least the
+   *  next message, so a message is never truncated and no peek is needed
+   *  to find its size. A message already partly read through the stream
+   *  buffer is finished first. Returns the size of the message, 0 at end
+   *  of file or -1 on error, or if a non-blocking socket has no message.
+   */
+  std::streamsize readMessage(std::string & message);
+
+  /// Return the number of descriptors received and not yet claimed.
+  std::size_t fdCount() const {
+    return _fds.size();
+  }
+
+protected:
+  virtual int receive(std::streambuf::char_type * buf, std::size_t len,
+                      int flags);
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // class unix_socket_stream
 /////////////////////////////////////////////////////////////////////////////
@@ -40,27 +141,100 @@ private:
 
   unix_socket_stream& operator=(const unix_socket_stream& socket);
 
+protected:
+  unix_socketbuf & unix_sockbuf;
+
 public:
   unix_socket_stream();
 
   explicit unix_socket_stream(SOCKET_TYPE socket);
 
   explicit unix_socket_stream(const std::string & address,
-                              bool nonblock = false);
+                              bool nonblock = false,
+                              int type = SOCK_STREAM);
 
   explicit unix_socket_stream(const std::string & address,
-                              unsigned int milliseconds);
+                              unsigned int milliseconds,
+                              int type = SOCK_STREAM);
 
   explicit unix_socket_stream(unix_socket_stream & other,
-                              bool nonblock = false);
+                              bool nonblock = false,
+                              int type = SOCK_STREAM);
 
   virtual ~unix_socket_stream();
 
-  void open(const std::string& address, bool nonblock = false);
-  void open(const std::string& address, unsigned int milliseconds);
-  void open(unix_socket_stream & other, bool nonblock = false);
+  /** Connect to the socket at address, which may be a path or an
+   *  abstract name starting with '@', as described for unix_address. The
+   *  type may be SOCK_STREAM or SOCK_SEQPACKET, to match the server.
+   */
+  void open(const std::string& address, bool nonblock = false,
+            int type = SOCK_STREAM);
+  void open(const std::string& address, unsigned int milliseconds,
+            int type = SOCK_STREAM);
+  /** Connect this stream and other to each other with socketpair(), for
+   *  a channel within a process or to a child process that has no path
+   *  and needs no server. The type may be SOCK_STREAM or SOCK_SEQPACKET.
+   *  The pair is connected at once, and nonblock puts both ends in
+   *  non-blocking mode.
+   */
+  void open(unix_socket_stream & other, bool nonblock = false,
+            int type = SOCK_STREAM);
 
   bool isReady(unsigned int milliseconds = 0);
+
+  // Messages on SOCK_SEQPACKET streams. Each is sent and received whole,
+  // so no framing of its own is needed. An empty message can't be told
+  // apart from end of file, so should not be sent.
+
+  /** Send data as one message. Output already written to the stream is
+   *  flushed first. On a SOCK_STREAM socket whatever the kernel does not
+   *  take at once follows as ordinary output, so all of it is sent, or
+   *  queued if the stream is non-blocking. Returns 0, or -1 on error,
+   *  including when a non-blocking stream could not flush what was
+   *  already written.
+   */
+  int sendMessage(const char * data, std::size_t len);
+
+  int sendMessage(const std::string & data) {
+    return sendMessage(data.data(), data.size());
+  }
+
+  /// See unix_socketbuf::readMessage().
+  std::streamsize recvMessage(std::string & message) {
+    return unix_sockbuf.readMessage(message);
+  }
+
+  /** Send descriptors to the peer, attached to data. Output already
+   *  written is flushed first, so the data and descriptors arrive in
+   *  order with the rest of the stream. The data must not be empty, and
+   *  at most unix_socketbuf::MAX_FDS descriptors can be sent at once. The
+   *  descriptors stay open here. Returns 0, or -1 on error, including
+   *  when a non-blocking stream could not flush what was already written.
+   */
+  int sendFds(const SOCKET_TYPE * fds, std::size_t count,
+              const std::string & data);
+
+  /** Take up to max descriptors that have been received, adding them to
+   *  fds. Descriptors are received along with the data they were sent
+   *  with, so once that data has been read they are available. The
+   *  caller is responsible for closing them. Returns the number taken.
+   */
+  std::size_t recvFds(std::vector<SOCKET_TYPE> & fds,
+                      std::size_t max = unix_socketbuf::MAX_FDS) {
+    return unix_sockbuf.takeFds(fds, max);
+  }
+
+  /** Pass a listen socket to the process at the other end, for a restart
+   *  without refusing connections. The socket keeps listening throughout,
+   *  so once the peer has it, this process can close its copy.
+   */
+  int sendListener(const basic_socket_server & server);
+
+  /** Receive a listen socket sent with sendListener(), and give it to
+   *  server. Blocks until it arrives. Fails if any other descriptors
+   *  are waiting, closing them all. Returns 0, or -1 on error.
+   */
+  int recvListener(basic_socket_server & server);
 };
 
 #endif // SKSTREAM_UNIX_H_
@@ -0,0 +1,275 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+#include <skstream/sktimer.h>
+
+const timer_wheel::tick_type timer_wheel::never;
+const unsigned timer_wheel::NIL;
+
+static inline int lowestBit(unsigned long long word)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(word);
+#else // __GNUC__
+  int bit = 0;
+  while((word & 1) == 0) {
+    word >>= 1;
+    ++bit;
+  }
+  return bit;
+#endif // __GNUC__
+}
+
+// Find the first set bit at or after start, wrapping round at size.
+static int findNext(const unsigned long long * bits, unsigned size,
+                    unsigned start)
+{
+  const unsigned words = size / 64;
+  unsigned w = start / 64;
+  unsigned long long word = bits[w] & (~0ULL << (start % 64));
+  for(unsigned i = 0; i <= words; ++i) {
+    if(word != 0) {
+      return w * 64 + lowestBit(word);
+    }
+    w = (w + 1) % words;
+    word = bits[w];
+  }
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class timer_wheel implementation
+/////////////////////////////////////////////////////////////////////////////
+
+timer_wheel::timer_wheel(tick_type now) : _free(NIL), _current(now), _now(now),
+                                          _count(0)
+{
+  for(unsigned i = 0; i < SLOTS; ++i) {
+    _slots[i] = NIL;
+  }
+  for(unsigned i = 0; i < SLOTS / 64; ++i) {
+    _occupied[i] = 0;
+  }
+}
+
+// Put a timer in the slot for its expiry, relative to the current tick.
+void timer_wheel::link(unsigned n)
+{
+  node & t = _nodes[n];
+  tick_type expires = t.expires < _current ? _current : t.expires;
+  tick_type delta = expires - _current;
+  unsigned slot;
+  if(delta < ROOT_SIZE) {
+    slot = expires & (ROOT_SIZE - 1);
+  } else {
+    int level = 1;
+    int shift = ROOT_BITS;
+    while(level < LEVELS - 1 && delta >= (1ULL << (shift + LEVEL_BITS))) {
+      ++level;
+      shift += LEVEL_BITS;
+    }
+    if(delta >= (1ULL << (shift + LEVEL_BITS))) {
+      // Beyond the top wheel, so park it as far out as possible.
+      expires = _current + (1ULL << (shift + LEVEL_BITS)) - 1;
+    }
+    slot = ROOT_SIZE + (level - 1) * LEVEL_SIZE +
+           ((expires >> shift) & (LEVEL_SIZE - 1));
+  }
+
+  t.slot = slot;
+  t.prev = NIL;
+  t.next = _slots[slot];
+  if(t.next != NIL) {
+    _nodes[t.next].prev = n;
+  }
+  _slots[slot] = n;
+  _occupied[slot / 64] |= 1ULL << (slot % 64);
+}
+
+void timer_wheel::unlink(unsigned n)
+{
+  node & t = _nodes[n];
+  if(t.prev != NIL) {
+    _nodes[t.prev].next = t.next;
+  } else {
+    _slots[t.slot] = t.next;
+    if(t.next == NIL) {
+      _occupied[t.slot / 64] &= ~(1ULL << (t.slot % 64));
+    }
+  }
+  if(t.next != NIL) {
+    _nodes[t.next].prev = t.prev;
+  }
+  t.slot = NIL;
+}
+
+// Move the timers in one slot of a coarse wheel down to finer ones.
+unsigned timer_wheel::cascade(int level, unsigned index)
+{
+  const unsigned slot = ROOT_SIZE + (level - 1) * LEVEL_SIZE + index;
+  unsigned n = _slots[slot];
+  _slots[slot] = NIL;
+  _occupied[slot / 64] &= ~(1ULL << (slot % 64));
+  while(n != NIL) {
+    unsigned next = _nodes[n].next;
+    link(n);
+    n = next;
+  }
+  return index;
+}
+
+timer_wheel::timer_id timer_wheel::scheduleAt(tick_type expires,
+                                              const handler & h)
+{
+  unsigned n = _free;
+  if(n != NIL) {
+    _free = _nodes[n].next;
+  } else {
+    n = _nodes.size();
+    _nodes.push_back(node());
+    _nodes[n].generation = 1;
+  }
+  node & t = _nodes[n];
+  t.expires = expires;
+  t.on_expire = h;
+  link(n);
+  ++_count;
+  return ((timer_id)t.generation << 32) | n;
+}
+
+bool timer_wheel::cancel(timer_id id)
+{
+  const unsigned n = id & 0xffffffffU;
+  if(n >= _nodes.size()) {
+    return false;
+  }
+  node & t = _nodes[n];
+  if(t.slot == NIL || t.generation != (unsigned)(id >> 32)) {
+    return false;
+  }
+  unlink(n);
+  t.on_expire = handler();
+  if(++t.generation == 0) {
+    t.generation = 1;
+  }
+  t.next = _free;
+  _free = n;
+  --_count;
+  return true;
+}
+
+int timer_wheel::advance(tick_type now)
+{
+  if(now > _now) {
+    _now = now;
+  }
+  if(_count == 0) {
+    _current = _now + 1;
+    return 0;
+  }
+
+  int fired = 0;
+  while(_current <= _now) {
+    const unsigned index = _current & (ROOT_SIZE - 1);
+    if(index == 0) {
+      // Each wheel cascades into the one below when that one wraps.
+      for(int level = 1; level < LEVELS; ++level) {
+        int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+        if(cascade(level, (_current >> shift) & (LEVEL_SIZE - 1)) != 0) {
+          break;
+        }
+      }
+    }
+
+    // Handlers may schedule or cancel timers, so the current tick moves
+    // on first, and the slot is emptied one timer at a time.
+    const tick_type base = _current - index;
+    ++_current;
+    unsigned n;
+    while((n = _slots[index]) != NIL) {
+      handler h;
+      h.swap(_nodes[n].on_expire);
+      cancel(((timer_id)_nodes[n].generation << 32) | n);
+      h();
+      ++fired;
+    }
+
+    // Skip ahead over empty slots, stopping when the wheels need to turn.
+    int next = index + 1 < ROOT_SIZE ? findNext(_occupied, ROOT_SIZE, index + 1)
+                                     : -1;
+    tick_type target = (next > (int)index) ? base + next : base + ROOT_SIZE;
+    if(target > _now + 1) {
+      target = _now + 1;
+    }
+    if(target > _current) {
+      _current = target;
+    }
+  }
+  return fired;
+}
+
+// Find when a wheel next needs attention: when a timer in the root wheel
+// expires, or when a slot of a coarser wheel is cascaded.
+timer_wheel::tick_type timer_wheel::nextInLevel(int level) const
+{
+  if(level == 0) {
+    const unsigned start = _current & (ROOT_SIZE - 1);
+    int slot = findNext(_occupied, ROOT_SIZE, start);
+    if(slot < 0) {
+      return never;
+    }
+    return _current + ((slot - start) & (ROOT_SIZE - 1));
+  }
+
+  const int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+  const unsigned long long bits =
+      _occupied[(ROOT_SIZE + (level - 1) * LEVEL_SIZE) / 64];
+  if(bits == 0) {
+    return never;
+  }
+  // The first boundary of this wheel not yet processed.
+  const tick_type unit = (_current + (1ULL << shift) - 1) >> shift;
+  const unsigned start = unit & (LEVEL_SIZE - 1);
+  int slot = findNext(&bits, LEVEL_SIZE, start);
+  return (unit + ((slot - start) & (LEVEL_SIZE - 1))) << shift;
+}
+
+timer_wheel::tick_type timer_wheel::nextExpiry() const
+{
+  tick_type next = never;
+  if(_count == 0) {
+    return next;
+  }
+  for(int level = 0; level < LEVELS; ++level) {
+    tick_type t = nextInLevel(level);
+    if(t < next) {
+      next = t;
+    }
+  }
+  return next;
+}
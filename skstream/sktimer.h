@@ -0,0 +1,130 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_TIMER_H_
+#define RGJ_FREE_SOCKET_TIMER_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////
+// class timer_wheel
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Hierarchical timing wheel for large numbers of timeouts.
+///
+/// Times are in milliseconds from an arbitrary epoch chosen by the caller.
+/// Scheduling and cancelling a timer take constant time, which makes it
+/// practical to keep idle, connect and keepalive timers for thousands of
+/// sockets, rearming them on every event. Timers expiring within 256ms
+/// are held at full resolution, and later ones in coarser wheels which
+/// are cascaded down as time advances, covering about 18 hours. Timers
+/// beyond that are rescheduled as the top wheel turns.
+class timer_wheel {
+public:
+  typedef unsigned long long tick_type;
+  typedef unsigned long long timer_id;
+  typedef std::function<void()> handler;
+
+  static const tick_type never = ~0ULL;
+
+  /// Create a wheel with the current time set to now.
+  explicit timer_wheel(tick_type now = 0);
+
+  /// Call the handler once, delay milliseconds after the current time.
+  timer_id schedule(tick_type delay, const handler & h) {
+    return scheduleAt(_now + delay, h);
+  }
+
+  /// Call the handler once at the given time.
+  timer_id scheduleAt(tick_type expires, const handler & h);
+
+  /** Cancel a timer. Returns false if the timer has already fired or
+   *  been cancelled.
+   */
+  bool cancel(timer_id id);
+
+  /** Move the current time forward, calling the handlers of all timers
+   *  which have expired. Returns the number of handlers called.
+   */
+  int advance(tick_type now);
+
+  /** Return the time by which advance() next needs to be called, or never
+   *  if no timers are pending. This may be earlier than the first expiry,
+   *  when timers need to be moved to a finer wheel.
+   */
+  tick_type nextExpiry() const;
+
+  /// Return the current time, as last passed to advance().
+  tick_type now() const {
+    return _now;
+  }
+
+  /// Return the number of pending timers.
+  std::size_t size() const {
+    return _count;
+  }
+
+private:
+  timer_wheel(const timer_wheel&);
+  timer_wheel& operator=(const timer_wheel&);
+
+  static const unsigned NIL = ~0U;
+  static const int ROOT_BITS = 8;
+  static const int LEVEL_BITS = 6;
+  static const int LEVELS = 4;
+  static const unsigned ROOT_SIZE = 1U << ROOT_BITS;
+  static const unsigned LEVEL_SIZE = 1U << LEVEL_BITS;
+  static const unsigned SLOTS = ROOT_SIZE + (LEVELS - 1) * LEVEL_SIZE;
+
+  struct node {
+    tick_type expires;
+    handler on_expire;
+    unsigned prev;
+    unsigned next;
+    unsigned slot;
+    unsigned generation;
+  };
+
+  std::vector<node> _nodes;
+  unsigned _free;
+  unsigned _slots[SLOTS];
+  /// One bit for each slot which has timers in it.
+  unsigned long long _occupied[SLOTS / 64];
+  /// The next tick to be processed.
+  tick_type _current;
+  tick_type _now;
+  std::size_t _count;
+
+  void link(unsigned n);
+  void unlink(unsigned n);
+  unsigned cascade(int level, unsigned index);
+  tick_type nextInLevel(int level) const;
+};
+
+#endif // RGJ_FREE_SOCKET_TIMER_H_
@@ -0,0 +1,719 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/sktls.h>
+
+#ifdef HAVE_OPENSSL
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#endif // HAVE_OPENSSL
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif // _WIN32
+
+#include <algorithm>
+
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0
+#endif
+
+static inline int getSystemError()
+{
+  #ifdef _WIN32
+    return WSAGetLastError();
+  #else
+    return errno;
+  #endif
+}
+
+static inline bool isWouldBlock(int error)
+{
+  #ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+  #else
+    return error == EAGAIN || error == EWOULDBLOCK;
+  #endif
+}
+
+static inline void setSystemError(int error)
+{
+  #ifdef _WIN32
+    WSASetLastError(error == EAGAIN ? WSAEWOULDBLOCK : error);
+  #else
+    errno = error;
+  #endif
+}
+
+// Switch whether a socket blocks, keeping the error already reported.
+static void setSocketMode(SOCKET_TYPE sock, bool nonblock)
+{
+  int error = getSystemError();
+#ifndef _WIN32
+  int flags = ::fcntl(sock, F_GETFL);
+  if(flags == -1) {
+    flags = 0;
+  }
+  ::fcntl(sock, F_SETFL, nonblock ? (flags | O_NONBLOCK)
+                                  : (flags & ~O_NONBLOCK));
+#else // _WIN32
+  u_long arg = nonblock ? 1 : 0;
+  ::ioctlsocket(sock, FIONBIO, &arg);
+#endif // _WIN32
+  setSystemError(error);
+}
+
+#ifdef HAVE_OPENSSL
+
+// Take the descriptions of all queued errors, leaving the queue empty.
+static std::string takeErrors()
+{
+  std::string errors;
+  unsigned long code;
+  while((code = ERR_get_error()) != 0) {
+    char buf[256];
+    ERR_error_string_n(code, buf, sizeof(buf));
+    if(!errors.empty()) {
+      errors += "; ";
+    }
+    errors += buf;
+  }
+  return errors;
+}
+
+static bool isAddress(const std::string & host)
+{
+  unsigned char buf[sizeof(struct in6_addr)];
+  return ::inet_pton(AF_INET, host.c_str(), buf) == 1 ||
+         ::inet_pton(AF_INET6, host.c_str(), buf) == 1;
+}
+
+#endif // HAVE_OPENSSL
+
+/////////////////////////////////////////////////////////////////////////////
+// class tls_context implementation
+/////////////////////////////////////////////////////////////////////////////
+
+bool tls_context::supported()
+{
+#ifdef HAVE_OPENSSL
+  return true;
+#else // HAVE_OPENSSL
+  return false;
+#endif // HAVE_OPENSSL
+}
+
+tls_context::tls_context(role r) : _ctx(0), _role(r), _last_error(0)
+{
+#ifdef HAVE_OPENSSL
+  _ctx = SSL_CTX_new(r == SERVER ? TLS_server_method() : TLS_client_method());
+  if(_ctx == 0) {
+    fail();
+    return;
+  }
+  SSL_CTX_set_min_proto_version(_ctx, TLS1_2_VERSION);
+  SSL_CTX_set_mode(_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                         SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+  setKernelTls(true);
+  if(r == SERVER) {
+    // Sessions are not resumed, and tickets the client never reads make
+    // its socket reset the connection when it closes.
+    SSL_CTX_set_num_tickets(_ctx, 0);
+  } else {
+    setVerifyPeer(true);
+    SSL_CTX_set_default_verify_paths(_ctx);
+  }
+#else // HAVE_OPENSSL
+  _last_error = ENOPROTOOPT;
+#endif // HAVE_OPENSSL
+}
+
+tls_context::~tls_context()
+{
+#ifdef HAVE_OPENSSL
+  SSL_CTX_free(_ctx);
+#endif // HAVE_OPENSSL
+}
+
+int tls_context::fail()
+{
+#ifdef HAVE_OPENSSL
+  _error_string = takeErrors();
+  _last_error = EPROTO;
+#else // HAVE_OPENSSL
+  _last_error = ENOPROTOOPT;
+#endif // HAVE_OPENSSL
+  return -1;
+}
+
+int tls_context::useCertificate(const std::string & certificate_file,
+                                const std::string & key_file)
+{
+#ifdef HAVE_OPENSSL
+  if(_ctx == 0 ||
+     SSL_CTX_use_certificate_chain_file(_ctx,
+                                        certificate_file.c_str()) != 1 ||
+     SSL_CTX_use_PrivateKey_file(_ctx, key_file.c_str(),
+                                 SSL_FILETYPE_PEM) != 1 ||
+     SSL_CTX_check_private_key(_ctx) != 1) {
+    return fail();
+  }
+  return 0;
+#else // HAVE_OPENSSL
+  return fail();
+#endif // HAVE_OPENSSL
+}
+
+int tls_context::generateCertificate(const std::string & name)
+{
+#ifdef HAVE_OPENSSL
+  if(_ctx == 0) {
+    return fail();
+  }
+
+  EVP_PKEY * key = 0;
+  EVP_PKEY_CTX * key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, 0);
+  if(key_ctx == 0 || EVP_PKEY_keygen_init(key_ctx) != 1 ||
+     EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx,
+                                            NID_X9_62_prime256v1) != 1 ||
+     EVP_PKEY_keygen(key_ctx, &key) != 1) {
+    EVP_PKEY_CTX_free(key_ctx);
+    return fail();
+  }
+  EVP_PKEY_CTX_free(key_ctx);
+
+  X509 * cert = X509_new();
+  bool ok = cert != 0;
+  if(ok) {
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    // Allow for clocks a little behind this one.
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 30L * 24 * 3600);
+    X509_set_pubkey(cert, key);
+
+    X509_NAME * subject = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                               (const unsigned char *)name.c_str(),
+                               -1, -1, 0);
+    X509_set_issuer_name(cert, subject);
+
+    // Names are checked against the subject alternative name.
+    std::string alt_name = (isAddress(name) ? "IP:" : "DNS:") + name;
+    X509_EXTENSION * ext = X509V3_EXT_conf_nid(0, 0, NID_subject_alt_name,
+                                               (char *)alt_name.c_str());
+    ok = ext != 0 && X509_add_ext(cert, ext, -1) == 1 &&
+         X509_sign(cert, key, EVP_sha256()) > 0 &&
+         SSL_CTX_use_certificate(_ctx, cert) == 1 &&
+         SSL_CTX_use_PrivateKey(_ctx, key) == 1;
+    X509_EXTENSION_free(ext);
+  }
+  X509_free(cert);
+  EVP_PKEY_free(key);
+
+  return ok ? 0 : fail();
+#else // HAVE_OPENSSL
+  return fail();
+#endif // HAVE_OPENSSL
+}
+
+std::string tls_context::certificate() const
+{
+  std::string pem;
+#ifdef HAVE_OPENSSL
+  X509 * cert = _ctx == 0 ? 0 : SSL_CTX_get0_certificate(_ctx);
+  if(cert == 0) {
+    return pem;
+  }
+  BIO * out = BIO_new(BIO_s_mem());
+  if(out != 0 && PEM_write_bio_X509(out, cert) == 1) {
+    char * data;
+    long len = BIO_get_mem_data(out, &data);
+    pem.assign(data, len);
+  }
+  BIO_free(out);
+#endif // HAVE_OPENSSL
+  return pem;
+}
+
+int tls_context::trustCertificate(const std::string & pem)
+{
+#ifdef HAVE_OPENSSL
+  if(_ctx == 0) {
+    return fail();
+  }
+  BIO * in = BIO_new_mem_buf(pem.data(), pem.size());
+  X509 * cert = in == 0 ? 0 : PEM_read_bio_X509(in, 0, 0, 0);
+  BIO_free(in);
+  if(cert == 0) {
+    return fail();
+  }
+  int ret = X509_STORE_add_cert(SSL_CTX_get_cert_store(_ctx), cert);
+  X509_free(cert);
+  return ret == 1 ? 0 : fail();
+#else // HAVE_OPENSSL
+  return fail();
+#endif // HAVE_OPENSSL
+}
+
+int tls_context::trustFile(const std::string & file)
+{
+#ifdef HAVE_OPENSSL
+  if(_ctx == 0) {
+    return fail();
+  }
+  int ret = file.empty() ? SSL_CTX_set_default_verify_paths(_ctx)
+                         : SSL_CTX_load_verify_locations(_ctx, file.c_str(), 0);
+  return ret == 1 ? 0 : fail();
+#else // HAVE_OPENSSL
+  return fail();
+#endif // HAVE_OPENSSL
+}
+
+void tls_context::setVerifyPeer(bool verify)
+{
+#ifdef HAVE_OPENSSL
+  if(_ctx != 0) {
+    SSL_CTX_set_verify(_ctx, verify ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, 0);
+  }
+#endif // HAVE_OPENSSL
+}
+
+void tls_context::setKernelTls(bool enable)
+{
+#if defined(HAVE_OPENSSL) && defined(SSL_OP_ENABLE_KTLS)
+  if(_ctx == 0) {
+    return;
+  }
+  if(enable) {
+    SSL_CTX_set_options(_ctx, SSL_OP_ENABLE_KTLS);
+  } else {
+    SSL_CTX_clear_options(_ctx, SSL_OP_ENABLE_KTLS);
+  }
+#endif // HAVE_OPENSSL && SSL_OP_ENABLE_KTLS
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// class tls_socketbuf implementation
+/////////////////////////////////////////////////////////////////////////////
+
+tls_socketbuf::tls_socketbuf(SOCKET_TYPE sock, tls_context & context)
+    : stream_socketbuf(sock), _context(context), _ssl(0)
+{
+}
+
+tls_socketbuf::~tls_socketbuf()
+{
+  sync();
+  stop();
+}
+
+// Turn a failed TLS call into a system error, as a socket call would
+// have reported it.
+int tls_socketbuf::fail(int ret)
+{
+#ifdef HAVE_OPENSSL
+  switch(SSL_get_error(_ssl, ret)) {
+   case SSL_ERROR_WANT_READ:
+   case SSL_ERROR_WANT_WRITE:
+    setSystemError(EAGAIN);
+    return -1;
+   case SSL_ERROR_ZERO_RETURN:
+    // The peer ended the session cleanly.
+    return 0;
+   case SSL_ERROR_SYSCALL:
+    ERR_clear_error();
+    if(getSystemError() == 0) {
+      setSystemError(ECONNRESET);
+    }
+    return -1;
+   default:
+    _error_string = takeErrors();
+    setSystemError(EPROTO);
+    return -1;
+  }
+#else // HAVE_OPENSSL
+  setSystemError(ENOPROTOOPT);
+  return -1;
+#endif // HAVE_OPENSSL
+}
+
+int tls_socketbuf::start(const std::string & host)
+{
+#ifdef HAVE_OPENSSL
+  stop();
+  if(_socket == INVALID_SOCKET) {
+    setSystemError(ENOTCONN);
+    return -1;
+  }
+  if(_context.handle() == 0) {
+    setSystemError(EINVAL);
+    return -1;
+  }
+  _ssl = SSL_new(_context.handle());
+  if(_ssl == 0 || SSL_set_fd(_ssl, _socket) != 1) {
+    _error_string = takeErrors();
+    stop();
+    setSystemError(EPROTO);
+    return -1;
+  }
+  setSocketMode(_socket, _nonblocking);
+  if(_context.getRole() == tls_context::SERVER) {
+    SSL_set_accept_state(_ssl);
+    return 0;
+  }
+  SSL_set_connect_state(_ssl);
+  if(host.empty()) {
+    return 0;
+  }
+  bool ok;
+  if(isAddress(host)) {
+    // Servers are not told an address, as SNI only carries names.
+    ok = X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(_ssl),
+                                       host.c_str()) == 1;
+  } else {
+    ok = SSL_set_tlsext_host_name(_ssl, host.c_str()) == 1 &&
+         SSL_set1_host(_ssl, host.c_str()) == 1;
+  }
+  if(!ok) {
+    _error_string = takeErrors();
+    stop();
+    setSystemError(EINVAL);
+    return -1;
+  }
+  return 0;
+#else // HAVE_OPENSSL
+  return fail(-1);
+#endif // HAVE_OPENSSL
+}
+
+int tls_socketbuf::handshake()
+{
+#ifdef HAVE_OPENSSL
+  if(_ssl == 0) {
+    setSystemError(ENOTCONN);
+    return -1;
+  }
+  WouldBlock = false;
+  int ret = SSL_do_handshake(_ssl);
+  if(ret == 1) {
+    return 0;
+  }
+  if(fail(ret) == 0) {
+    setSystemError(ECONNRESET);
+  }
+  WouldBlock = isWouldBlock(getSystemError());
+  return -1;
+#else // HAVE_OPENSSL
+  return fail(-1);
+#endif // HAVE_OPENSSL
+}
+
+void tls_socketbuf::stop()
+{
+#ifdef HAVE_OPENSSL
+  if(_ssl == 0) {
+    return;
+  }
+  if(SSL_is_init_finished(_ssl)) {
+    // Send close_notify without waiting for the peer's.
+    SSL_shutdown(_ssl);
+    // Closing a socket with data unread resets the connection, and the
+    // peer loses whatever it has not yet read, so take it first.
+    char buf[0x400];
+    while(::recv(_socket, buf, sizeof(buf), MSG_DONTWAIT) > 0);
+  }
+  SSL_free(_ssl);
+  _ssl = 0;
+  ERR_clear_error();
+#endif // HAVE_OPENSSL
+}
+
+bool tls_socketbuf::established() const
+{
+#ifdef HAVE_OPENSSL
+  return _ssl != 0 && SSL_is_init_finished(_ssl);
+#else // HAVE_OPENSSL
+  return false;
+#endif // HAVE_OPENSSL
+}
+
+bool tls_socketbuf::kernelSend() const
+{
+#if defined(HAVE_OPENSSL) && defined(BIO_get_ktls_send)
+  return _ssl != 0 && BIO_get_ktls_send(SSL_get_wbio(_ssl));
+#else // HAVE_OPENSSL && BIO_get_ktls_send
+  return false;
+#endif // HAVE_OPENSSL && BIO_get_ktls_send
+}
+
+bool tls_socketbuf::kernelReceive() const
+{
+#if defined(HAVE_OPENSSL) && defined(BIO_get_ktls_recv)
+  return _ssl != 0 && BIO_get_ktls_recv(SSL_get_rbio(_ssl));
+#else // HAVE_OPENSSL && BIO_get_ktls_recv
+  return false;
+#endif // HAVE_OPENSSL && BIO_get_ktls_recv
+}
+
+std::string tls_socketbuf::version() const
+{
+#ifdef HAVE_OPENSSL
+  if(_ssl != 0) {
+    return SSL_get_version(_ssl);
+  }
+#endif // HAVE_OPENSSL
+  return std::string();
+}
+
+std::string tls_socketbuf::cipher() const
+{
+#ifdef HAVE_OPENSSL
+  if(_ssl != 0) {
+    const char * name = SSL_get_cipher_name(_ssl);
+    if(name != 0) {
+      return name;
+    }
+  }
+#endif // HAVE_OPENSSL
+  return std::string();
+}
+
+void tls_socketbuf::setNonBlocking(bool nonblock)
+{
+  stream_socketbuf::setNonBlocking(nonblock);
+  if(_socket != INVALID_SOCKET) {
+    setSocketMode(_socket, nonblock);
+  }
+}
+
+long tls_socketbuf::sendFile(int fd, off_t offset, std::size_t count)
+{
+#ifdef HAVE_OPENSSL
+  if(_ssl == 0) {
+    setSystemError(ENOTCONN);
+    return -1;
+  }
+  // The file must follow everything written before it.
+  if(sync() != 0) {
+    return -1;
+  }
+  if(pendingBytes() > 0) {
+    setSystemError(EAGAIN);
+    return -1;
+  }
+# if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  if(kernelSend()) {
+    ossl_ssize_t size = SSL_sendfile(_ssl, fd, offset, count, 0);
+    return size < 0 ? fail(size) : size;
+  }
+# endif // OPENSSL_VERSION_NUMBER
+  // Otherwise the data is encrypted here, a record at a time.
+  char buf[0x4000];
+  ssize_t size = ::pread(fd, buf, std::min(count, sizeof(buf)), offset);
+  if(size <= 0) {
+    return size;
+  }
+  return transmit(buf, size, _nonblocking ? MSG_DONTWAIT : 0);
+#else // HAVE_OPENSSL
+  return fail(-1);
+#endif // HAVE_OPENSSL
+}
+
+int tls_socketbuf::receive(std::streambuf::char_type * buf, std::size_t len,
+                           int flags)
+{
+#ifdef HAVE_OPENSSL
+  if(_ssl == 0) {
+    setSystemError(ENOTCONN);
+    return -1;
+  }
+  // Reads go through the library even with the kernel decrypting, as
+  // records other than data have to be handled there. The library cannot
+  // be given flags, so a read which must not wait switches the socket.
+  bool dontwait = (flags & MSG_DONTWAIT) != 0 && !_nonblocking;
+  if(dontwait) {
+    setSocketMode(_socket, true);
+  }
+  int ret = SSL_read(_ssl, buf, len);
+  if(ret <= 0) {
+    ret = fail(ret);
+  }
+  if(dontwait) {
+    setSocketMode(_socket, false);
+  }
+  return ret;
+#else // HAVE_OPENSSL
+  return fail(-1);
+#endif // HAVE_OPENSSL
+}
+
+int tls_socketbuf::transmit(const std::streambuf::char_type * buf,
+                            std::size_t len, int flags)
+{
+#ifdef HAVE_OPENSSL
+  if(_ssl == 0) {
+    setSystemError(ENOTCONN);
+    return -1;
+  }
+  if(kernelSend()) {
+    return stream_socketbuf::transmit(buf, len, flags);
+  }
+  bool dontwait = (flags & MSG_DONTWAIT) != 0 && !_nonblocking;
+  if(dontwait) {
+    setSocketMode(_socket, true);
+  }
+  int ret = SSL_write(_ssl, buf, len);
+  if(ret <= 0) {
+    if(fail(ret) == 0) {
+      setSystemError(EPIPE);
+    }
+    ret = -1;
+  }
+  if(dontwait) {
+    setSocketMode(_socket, false);
+  }
+  return ret;
+#else // HAVE_OPENSSL
+  return fail(-1);
+#endif // HAVE_OPENSSL
+}
+
+#ifndef _WIN32
+int tls_socketbuf::transmitv(const struct iovec * iov, int count, int flags)
+{
+  if(kernelSend()) {
+    return stream_socketbuf::transmitv(iov, count, flags);
+  }
+  int total = 0;
+  for(int i = 0; i < count; ++i) {
+    int ret = transmit((const char *)iov[i].iov_base, iov[i].iov_len, flags);
+    if(ret < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += ret;
+    if((std::size_t)ret < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+#endif // _WIN32
+
+/////////////////////////////////////////////////////////////////////////////
+// class tls_socket_stream implementation
+/////////////////////////////////////////////////////////////////////////////
+
+tls_socket_stream::tls_socket_stream(tls_context & context)
+    : tcp_socket_stream(*new tls_socketbuf(INVALID_SOCKET, context)),
+      tls_sockbuf((tls_socketbuf&)_sockbuf)
+{
+}
+
+tls_socket_stream::tls_socket_stream(tls_context & context,
+                                     SOCKET_TYPE socket)
+    : tcp_socket_stream(*new tls_socketbuf(socket, context)),
+      tls_sockbuf((tls_socketbuf&)_sockbuf)
+{
+  if(tls_sockbuf.start() != 0) {
+    setFailed();
+  }
+}
+
+tls_socket_stream::~tls_socket_stream()
+{
+}
+
+int tls_socket_stream::setFailed()
+{
+  setLastError();
+  setstate(std::ios::failbit);
+  return -1;
+}
+
+int tls_socket_stream::open(const std::string & address, int service)
+{
+  if(tcp_socket_stream::open(address, service, false) != 0) {
+    return -1;
+  }
+  if(start(address) != 0 || handshake() != 0) {
+    int error = LastError;
+    tcp_socket_stream::close();
+    LastError = error;
+    return -1;
+  }
+  return 0;
+}
+
+int tls_socket_stream::start(const std::string & host)
+{
+  if(tls_sockbuf.start(host) != 0) {
+    return setFailed();
+  }
+  return 0;
+}
+
+int tls_socket_stream::handshake()
+{
+  if(tls_sockbuf.handshake() != 0) {
+    if(tls_sockbuf.wouldBlock()) {
+      setLastError();
+      return -1;
+    }
+    return setFailed();
+  }
+  return 0;
+}
+
+void tls_socket_stream::close()
+{
+  if(tls_sockbuf.started()) {
+    tls_sockbuf.pubsync();
+    tls_sockbuf.stop();
+  }
+  tcp_socket_stream::close();
+}
+
+long tls_socket_stream::sendFile(int fd, off_t offset, std::size_t count)
+{
+  long size = tls_sockbuf.sendFile(fd, offset, count);
+  if(size < 0) {
+    setLastError();
+  }
+  return size;
+}
@@ -0,0 +1,283 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_TLS_H_
+#define RGJ_FREE_SOCKET_TLS_H_
+
+#include <skstream/skstream.h>
+
+#include <sys/types.h>
+
+struct ssl_st;
+struct ssl_ctx_st;
+
+/////////////////////////////////////////////////////////////////////////////
+// class tls_context
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Certificates and settings shared by TLS streams on one side.
+///
+/// A client context checks the server's certificate against the system's
+/// trusted authorities by default. A server context needs a certificate,
+/// either loaded from files or generated for testing. Where the system
+/// supports it, record encryption is handed to the kernel after the
+/// handshake.
+class tls_context {
+public:
+  enum role {
+    CLIENT,
+    SERVER
+  };
+
+  explicit tls_context(role r);
+  ~tls_context();
+
+  /// Return true if this build can use TLS.
+  static bool supported();
+
+  /// Return false if the context could not be created.
+  bool good() const {
+    return _ctx != 0;
+  }
+
+  role getRole() const {
+    return _role;
+  }
+
+  /** Load a PEM certificate chain and its private key. Returns 0, or -1
+   *  on error.
+   */
+  int useCertificate(const std::string & certificate_file,
+                     const std::string & key_file);
+
+  /** Make a new key and a certificate for name signed by it, valid for
+   *  30 days. Peers must be told to trust it with trustCertificate().
+   *  Returns 0, or -1 on error.
+   */
+  int generateCertificate(const std::string & name);
+
+  /// Return the certificate in use in PEM format, or an empty string.
+  std::string certificate() const;
+
+  /** Trust a PEM certificate when checking peers. Returns 0, or -1 on
+   *  error.
+   */
+  int trustCertificate(const std::string & pem);
+
+  /** Trust the certificates in a PEM file, or the system's defaults if
+   *  file is empty. Returns 0, or -1 on error.
+   */
+  int trustFile(const std::string & file);
+
+  /// Set whether the peer's certificate must be valid.
+  void setVerifyPeer(bool verify);
+
+  /// Set whether encryption may be handed to the kernel.
+  void setKernelTls(bool enable);
+
+  int getLastError() const {
+    return _last_error;
+  }
+
+  /// Return the TLS library's description of the last error.
+  const std::string & getErrorString() const {
+    return _error_string;
+  }
+
+  ssl_ctx_st * handle() const {
+    return _ctx;
+  }
+
+private:
+  tls_context(const tls_context&);
+  tls_context& operator=(const tls_context&);
+
+  int fail();
+
+  ssl_ctx_st * _ctx;
+  role _role;
+  int _last_error;
+  std::string _error_string;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class tls_socketbuf
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief A stream buffer which encrypts a stream socket with TLS.
+///
+/// Reads and writes go through the TLS session, and nothing is sent or
+/// received before start() is called. Once the kernel has taken over
+/// encryption, writes, including the gathered writes of non-blocking
+/// mode, go to the socket directly as they would without TLS. A read or
+/// write asked not to wait on a blocking socket switches the socket for
+/// that call.
+class tls_socketbuf : public stream_socketbuf {
+private:
+  tls_context & _context;
+  ssl_st * _ssl;
+  std::string _error_string;
+
+  int fail(int ret);
+
+public:
+  tls_socketbuf(SOCKET_TYPE sock, tls_context & context);
+  virtual ~tls_socketbuf();
+
+  /** Start a session on the socket, in the context's role. A client
+   *  sends host to the server and checks the certificate against it.
+   *  Returns 0, or -1 on error.
+   */
+  int start(const std::string & host = "");
+
+  /** Complete the handshake. This happens anyway on the first read or
+   *  write, but calling it first reports failures directly. Returns 0,
+   *  or -1 on error or if a non-blocking socket would block.
+   */
+  int handshake();
+
+  /// Tell the peer the session is over and end it.
+  void stop();
+
+  bool started() const {
+    return _ssl != 0;
+  }
+
+  bool established() const;
+
+  /// Return true if the kernel encrypts data sent.
+  bool kernelSend() const;
+
+  /// Return true if the kernel decrypts data received.
+  bool kernelReceive() const;
+
+  /// Return the protocol version in use, such as "TLSv1.3".
+  std::string version() const;
+
+  std::string cipher() const;
+
+  const std::string & getErrorString() const {
+    return _error_string;
+  }
+
+  /** Set whether the socket should be used without blocking. Unlike a
+   *  plain stream, the socket itself is switched, as the TLS library
+   *  reads and writes it directly.
+   */
+  virtual void setNonBlocking(bool nonblock);
+
+  /** Send count bytes of a file from offset, after any output already
+   *  written. With the kernel encrypting, the data does not pass through
+   *  user space. Returns the number of bytes sent, or -1 on error.
+   */
+  long sendFile(int fd, off_t offset, std::size_t count);
+
+protected:
+  virtual int receive(std::streambuf::char_type * buf, std::size_t len,
+                      int flags);
+  virtual int transmit(const std::streambuf::char_type * buf,
+                       std::size_t len, int flags);
+#ifndef _WIN32
+  virtual int transmitv(const struct iovec * iov, int count, int flags);
+#endif // _WIN32
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class tls_socket_stream
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief A TCP stream encrypted with TLS.
+///
+/// A client stream connects with open(). A server stream is made from an
+/// accepted socket, and completes the handshake on first use. Both can
+/// be used like a tcp_socket_stream from then on. The context must
+/// outlive the stream.
+class tls_socket_stream : public tcp_socket_stream {
+private:
+  tls_socket_stream(const tls_socket_stream&);
+  tls_socket_stream& operator=(const tls_socket_stream&);
+
+  int setFailed();
+
+protected:
+  tls_socketbuf & tls_sockbuf;
+
+public:
+  explicit tls_socket_stream(tls_context & context);
+  /// Make a server stream from an accepted socket.
+  tls_socket_stream(tls_context & context, SOCKET_TYPE socket);
+  virtual ~tls_socket_stream();
+
+  /** Connect and complete the handshake as a client. Returns 0, or -1
+   *  on error.
+   */
+  int open(const std::string & address, int service);
+
+  /** Start a session on a socket connected some other way, such as with
+   *  a non-blocking tcp_socket_stream::open(). host is checked against
+   *  the server's certificate. Returns 0, or -1 on error.
+   */
+  int start(const std::string & host);
+
+  /** Complete the handshake. Returns 0, or -1 on error or if a
+   *  non-blocking socket would block.
+   */
+  int handshake();
+
+  /// Send close_notify to the peer and close the socket.
+  virtual void close();
+
+  bool established() const {
+    return tls_sockbuf.established();
+  }
+
+  bool kernelSend() const {
+    return tls_sockbuf.kernelSend();
+  }
+
+  bool kernelReceive() const {
+    return tls_sockbuf.kernelReceive();
+  }
+
+  std::string version() const {
+    return tls_sockbuf.version();
+  }
+
+  std::string cipher() const {
+    return tls_sockbuf.cipher();
+  }
+
+  /// Return the TLS library's description of the last error.
+  const std::string & getErrorString() const {
+    return tls_sockbuf.getErrorString();
+  }
+
+  /// See tls_socketbuf::sendFile().
+  long sendFile(int fd, off_t offset, std::size_t count);
+};
+
+#endif // RGJ_FREE_SOCKET_TLS_H_
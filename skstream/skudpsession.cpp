@@ -0,0 +1,403 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skudpsession.h>
+
+#include <skstream/skserver.h>
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <errno.h>
+#endif // _WIN32
+
+const udp_session_table::session_id udp_session_table::none;
+const udp_session_table::tick_type udp_session_table::never;
+const std::size_t udp_session_table::MAX_DATAGRAM;
+const std::size_t udp_session_table::BATCH;
+const unsigned udp_session_table::NIL;
+
+static const std::size_t INITIAL_SLOTS = 64;
+
+static inline int getSystemError()
+{
+  #ifdef _WIN32
+    return WSAGetLastError();
+  #else
+    return errno;
+  #endif
+}
+
+static inline bool isWouldBlock(int error)
+{
+  #ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+  #else
+    return error == EAGAIN || error == EWOULDBLOCK;
+  #endif
+}
+
+udp_session_table::udp_session_table(tick_type idle_timeout) :
+    _slots(INITIAL_SLOTS), _mask(INITIAL_SLOTS - 1), _count(0),
+    _free(NIL), _oldest(NIL), _newest(NIL), _idle_timeout(idle_timeout),
+    _last_error(0)
+{
+  for(std::size_t i = 0; i < _slots.size(); ++i) {
+    _slots[i].session = NIL;
+  }
+}
+
+udp_session_table::~udp_session_table()
+{
+}
+
+// Mix the address a word at a time. Only the bytes the kernel filled in
+// are used, so padding left over in the storage doesn't matter.
+uint32_t udp_session_table::hashAddress(const sockaddr_storage & peer,
+                                        SOCKLEN peer_size)
+{
+  const unsigned char * bytes = (const unsigned char *)&peer;
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ (uint64_t)peer_size;
+  std::size_t i = 0;
+  for(; i + 8 <= (std::size_t)peer_size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    h = (h ^ word) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  if(i < (std::size_t)peer_size) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + i, peer_size - i);
+    h = (h ^ word) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  return (uint32_t)(h >> 32);
+}
+
+// Return the slot holding the address, or the empty slot where it would go.
+std::size_t udp_session_table::findSlot(const sockaddr_storage & peer,
+                                        SOCKLEN peer_size,
+                                        uint32_t hash) const
+{
+  std::size_t i = hash & _mask;
+  for(;;) {
+    const slot & s = _slots[i];
+    if(s.session == NIL) {
+      return i;
+    }
+    if(s.hash == hash) {
+      const session & candidate = _sessions[s.session];
+      if(candidate.peer_size == peer_size &&
+         std::memcmp(&candidate.peer, &peer, peer_size) == 0) {
+        return i;
+      }
+    }
+    i = (i + 1) & _mask;
+  }
+}
+
+void udp_session_table::grow()
+{
+  std::vector<slot> old(_slots.size() * 2);
+  old.swap(_slots);
+  _mask = _slots.size() - 1;
+  for(std::size_t i = 0; i < _slots.size(); ++i) {
+    _slots[i].session = NIL;
+  }
+  for(std::size_t i = 0; i < old.size(); ++i) {
+    if(old[i].session == NIL) {
+      continue;
+    }
+    std::size_t j = old[i].hash & _mask;
+    while(_slots[j].session != NIL) {
+      j = (j + 1) & _mask;
+    }
+    _slots[j] = old[i];
+  }
+}
+
+void udp_session_table::unlinkSession(unsigned id)
+{
+  session & s = _sessions[id];
+  if(s.older != NIL) {
+    _sessions[s.older].newer = s.newer;
+  } else {
+    _oldest = s.newer;
+  }
+  if(s.newer != NIL) {
+    _sessions[s.newer].older = s.older;
+  } else {
+    _newest = s.older;
+  }
+}
+
+void udp_session_table::linkNewest(unsigned id)
+{
+  session & s = _sessions[id];
+  s.older = _newest;
+  s.newer = NIL;
+  if(_newest != NIL) {
+    _sessions[_newest].newer = id;
+  } else {
+    _oldest = id;
+  }
+  _newest = id;
+}
+
+udp_session_table::session_id
+udp_session_table::find(const sockaddr_storage & peer, SOCKLEN peer_size) const
+{
+  uint32_t hash = hashAddress(peer, peer_size);
+  return _slots[findSlot(peer, peer_size, hash)].session;
+}
+
+udp_session_table::session_id
+udp_session_table::touch(const sockaddr_storage & peer, SOCKLEN peer_size,
+                         tick_type now)
+{
+  uint32_t hash = hashAddress(peer, peer_size);
+  std::size_t i = findSlot(peer, peer_size, hash);
+  unsigned id = _slots[i].session;
+  if(id != NIL) {
+    _sessions[id].last_seen = now;
+    if(id != _newest) {
+      unlinkSession(id);
+      linkNewest(id);
+    }
+    return id;
+  }
+
+  // Keep the table at most half full, so probe sequences stay short.
+  if((_count + 1) * 2 > _slots.size()) {
+    grow();
+    i = findSlot(peer, peer_size, hash);
+  }
+
+  if(_free != NIL) {
+    id = _free;
+    _free = _sessions[id].older;
+  } else {
+    id = _sessions.size();
+    _sessions.push_back(session());
+  }
+  session & s = _sessions[id];
+  std::memcpy(&s.peer, &peer, peer_size);
+  s.peer_size = peer_size;
+  s.hash = hash;
+  s.last_seen = now;
+  s.batch_tail = NIL;
+  _slots[i].hash = hash;
+  _slots[i].session = id;
+  ++_count;
+  linkNewest(id);
+
+  if(_on_accept && !_on_accept(id)) {
+    remove(id);
+    return none;
+  }
+  return id;
+}
+
+void udp_session_table::remove(session_id id)
+{
+  if(id >= _sessions.size() || _sessions[id].peer_size == 0) {
+    // Already removed, perhaps by the expire handler.
+    return;
+  }
+  session & s = _sessions[id];
+  std::size_t i = findSlot(s.peer, s.peer_size, s.hash);
+
+  // Shift later entries of the probe sequence back over the hole, so
+  // lookups never have to step over deleted slots.
+  std::size_t j = i;
+  for(;;) {
+    j = (j + 1) & _mask;
+    if(_slots[j].session == NIL) {
+      break;
+    }
+    std::size_t home = _slots[j].hash & _mask;
+    if(((j - home) & _mask) >= ((j - i) & _mask)) {
+      _slots[i] = _slots[j];
+      i = j;
+    }
+  }
+  _slots[i].session = NIL;
+
+  unlinkSession(id);
+  s.peer_size = 0;
+  s.older = _free;
+  _free = id;
+  --_count;
+}
+
+int udp_session_table::expire(tick_type now)
+{
+  int expired = 0;
+  while(_oldest != NIL &&
+        _sessions[_oldest].last_seen + _idle_timeout <= now) {
+    unsigned id = _oldest;
+    if(_on_expire) {
+      _on_expire(id);
+    }
+    remove(id);
+    ++expired;
+  }
+  return expired;
+}
+
+udp_session_table::tick_type udp_session_table::nextExpiry() const
+{
+  if(_oldest == NIL) {
+    return never;
+  }
+  return _sessions[_oldest].last_seen + _idle_timeout;
+}
+
+std::size_t udp_session_table::dispatch(const datagram * datagrams,
+                                        std::size_t count, tick_type now,
+                                        const batch_handler & h)
+{
+  // Chain each session's datagrams together in arrival order, noting the
+  // first datagram of each session in the order sessions were seen.
+  _batch_ids.resize(count);
+  _batch_next.resize(count);
+  _batch_order.clear();
+  for(std::size_t i = 0; i < count; ++i) {
+    unsigned id = touch(*datagrams[i].peer, datagrams[i].peer_size, now);
+    _batch_ids[i] = id;
+    _batch_next[i] = NIL;
+    if(id == none) {
+      continue;
+    }
+    session & s = _sessions[id];
+    if(s.batch_tail == NIL) {
+      _batch_order.push_back(i);
+    } else {
+      _batch_next[s.batch_tail] = i;
+    }
+    s.batch_tail = i;
+  }
+  for(std::size_t n = 0; n < _batch_order.size(); ++n) {
+    _sessions[_batch_ids[_batch_order[n]]].batch_tail = NIL;
+  }
+
+  std::size_t delivered = 0;
+  for(std::size_t n = 0; n < _batch_order.size(); ++n) {
+    unsigned first = _batch_order[n];
+    _batch_out.clear();
+    for(unsigned i = first; i != NIL; i = _batch_next[i]) {
+      _batch_out.push_back(datagrams[i]);
+    }
+    delivered += _batch_out.size();
+    h(_batch_ids[first], &_batch_out[0], _batch_out.size());
+  }
+  return delivered;
+}
+
+int udp_session_table::receive(SOCKET_TYPE sock, tick_type now,
+                               const batch_handler & h)
+{
+  _buffer.resize(BATCH * MAX_DATAGRAM);
+  _addresses.resize(BATCH);
+  datagram datagrams[BATCH];
+  std::size_t count = 0;
+
+#ifdef HAVE_RECVMMSG
+  struct mmsghdr messages[BATCH];
+  struct iovec iov[BATCH];
+  std::memset(messages, 0, sizeof(messages));
+  for(std::size_t i = 0; i < BATCH; ++i) {
+    iov[i].iov_base = &_buffer[i * MAX_DATAGRAM];
+    iov[i].iov_len = MAX_DATAGRAM;
+    messages[i].msg_hdr.msg_name = &_addresses[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    messages[i].msg_hdr.msg_iov = &iov[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  int ret = ::recvmmsg(sock, messages, BATCH, MSG_DONTWAIT, 0);
+  if(ret < 0) {
+    if(isWouldBlock(getSystemError())) {
+      return 0;
+    }
+    _last_error = getSystemError();
+    return -1;
+  }
+  for(; count < (std::size_t)ret; ++count) {
+    datagram & d = datagrams[count];
+    d.data = &_buffer[count * MAX_DATAGRAM];
+    d.size = messages[count].msg_len;
+    d.peer = &_addresses[count];
+    d.peer_size = messages[count].msg_hdr.msg_namelen;
+  }
+#else // HAVE_RECVMMSG
+  for(; count < BATCH; ++count) {
+    fd_set sock_fds;
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    FD_ZERO(&sock_fds);
+    FD_SET(sock, &sock_fds);
+    if(::select(sock + 1, &sock_fds, NULL, NULL, &tv) <= 0) {
+      break;
+    }
+    SOCKLEN peer_size = sizeof(sockaddr_storage);
+    int size = ::recvfrom(sock, &_buffer[count * MAX_DATAGRAM], MAX_DATAGRAM,
+                          0, (sockaddr*)&_addresses[count], &peer_size);
+    if(size < 0) {
+      if(isWouldBlock(getSystemError())) {
+        break;
+      }
+      if(count == 0) {
+        _last_error = getSystemError();
+        return -1;
+      }
+      break;
+    }
+    datagram & d = datagrams[count];
+    d.data = &_buffer[count * MAX_DATAGRAM];
+    d.size = size;
+    d.peer = &_addresses[count];
+    d.peer_size = peer_size;
+  }
+#endif // HAVE_RECVMMSG
+
+  dispatch(datagrams, count, now, h);
+  return count;
+}
+
+int udp_session_table::receive(udp_socket_server & server, tick_type now,
+                               const batch_handler & h)
+{
+  return receive(server.getSocket(), now, h);
+}
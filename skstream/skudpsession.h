@@ -0,0 +1,214 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_UDP_SESSION_H_
+#define RGJ_FREE_SOCKET_UDP_SESSION_H_
+
+#include <skstream/sksocket.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <stdint.h>
+
+class udp_socket_server;
+
+/////////////////////////////////////////////////////////////////////////////
+// class udp_session_table
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Sorts datagrams arriving on one UDP socket into peer sessions.
+///
+/// Sessions are found by the raw bytes of the sender's address in a flat
+/// hash table with open addressing, so looking one up costs a hash and
+/// usually a single compare, with no allocation. A session is created by
+/// the first datagram from a new sender and expires once nothing has been
+/// heard from it for the idle timeout. Received datagrams are delivered
+/// in batches, one call for each session with its datagrams in the order
+/// they arrived. Times are in milliseconds from an epoch chosen by the
+/// caller, as with timer_wheel.
+class udp_session_table {
+public:
+  typedef unsigned long long tick_type;
+  /// Index of a session, reused once the session has gone.
+  typedef unsigned session_id;
+
+  static const session_id none = ~0U;
+  static const tick_type never = ~0ULL;
+
+  /// \brief One datagram passed to or from the table.
+  struct datagram {
+    const char * data;
+    std::size_t size;
+    const sockaddr_storage * peer;
+    SOCKLEN peer_size;
+  };
+
+  /// Called once for each session with datagrams in a batch.
+  typedef std::function<void(session_id, const datagram *, std::size_t)>
+          batch_handler;
+  /** Called when a session is created. Returning false refuses it, and
+   *  its datagrams are dropped.
+   */
+  typedef std::function<bool(session_id)> accept_handler;
+  /// Called when a session expires, before its id can be reused.
+  typedef std::function<void(session_id)> expire_handler;
+
+  /// Largest datagram received by receive(). Longer ones are truncated.
+  static const std::size_t MAX_DATAGRAM = 2048;
+  /// Most datagrams received by one call to receive().
+  static const std::size_t BATCH = 64;
+
+  explicit udp_session_table(tick_type idle_timeout);
+  ~udp_session_table();
+
+  void setAcceptHandler(const accept_handler & h) {
+    _on_accept = h;
+  }
+
+  void setExpireHandler(const expire_handler & h) {
+    _on_expire = h;
+  }
+
+  /// Return the session for an address, or none.
+  session_id find(const sockaddr_storage & peer, SOCKLEN peer_size) const;
+
+  /** Return the session for an address, creating it if the accept handler
+   *  allows, and mark it as active at the given time. Returns none if the
+   *  session was refused.
+   */
+  session_id touch(const sockaddr_storage & peer, SOCKLEN peer_size,
+                   tick_type now);
+
+  /** Remove a session without calling the expire handler. Does nothing
+   *  if the session has already been removed or has expired, so the
+   *  expire handler may call it too.
+   */
+  void remove(session_id id);
+
+  const sockaddr_storage & peer(session_id id) const {
+    return _sessions[id].peer;
+  }
+
+  SOCKLEN peerSize(session_id id) const {
+    return _sessions[id].peer_size;
+  }
+
+  tick_type lastSeen(session_id id) const {
+    return _sessions[id].last_seen;
+  }
+
+  /** Expire sessions idle since before now less the timeout, calling the
+   *  expire handler for each. Returns the number expired.
+   */
+  int expire(tick_type now);
+
+  /** Return the time at which the next session will expire, or never if
+   *  there are no sessions.
+   */
+  tick_type nextExpiry() const;
+
+  /** Sort datagrams received by some other means into sessions, and call
+   *  the handler once for each session. Returns the number delivered.
+   */
+  std::size_t dispatch(const datagram * datagrams, std::size_t count,
+                       tick_type now, const batch_handler & h);
+
+  /** Receive the datagrams waiting on a socket, up to BATCH, without
+   *  blocking, and dispatch them. Returns the number received, or -1 on
+   *  error, with the error from getLastError().
+   */
+  int receive(SOCKET_TYPE sock, tick_type now, const batch_handler & h);
+
+  int receive(udp_socket_server & server, tick_type now,
+              const batch_handler & h);
+
+  /// Return the number of sessions.
+  std::size_t size() const {
+    return _count;
+  }
+
+  int getLastError() const {
+    return _last_error;
+  }
+
+private:
+  udp_session_table(const udp_session_table&);
+  udp_session_table& operator=(const udp_session_table&);
+
+  static const unsigned NIL = ~0U;
+
+  struct session {
+    sockaddr_storage peer;
+    SOCKLEN peer_size;
+    uint32_t hash;
+    tick_type last_seen;
+    /// Neighbours in the list from least to most recently seen, or the
+    /// next free session.
+    unsigned older;
+    unsigned newer;
+    /// Last datagram for this session in the batch being dispatched.
+    unsigned batch_tail;
+  };
+
+  /// A slot in the hash table. Empty slots have session NIL.
+  struct slot {
+    uint32_t hash;
+    unsigned session;
+  };
+
+  std::vector<session> _sessions;
+  std::vector<slot> _slots;
+  std::size_t _mask;
+  std::size_t _count;
+  unsigned _free;
+  unsigned _oldest;
+  unsigned _newest;
+  tick_type _idle_timeout;
+  accept_handler _on_accept;
+  expire_handler _on_expire;
+  int _last_error;
+
+  // Scratch space for dispatch() and receive().
+  std::vector<unsigned> _batch_ids;
+  std::vector<unsigned> _batch_next;
+  std::vector<unsigned> _batch_order;
+  std::vector<datagram> _batch_out;
+  std::vector<char> _buffer;
+  std::vector<sockaddr_storage> _addresses;
+
+  static uint32_t hashAddress(const sockaddr_storage & peer,
+                              SOCKLEN peer_size);
+  std::size_t findSlot(const sockaddr_storage & peer, SOCKLEN peer_size,
+                       uint32_t hash) const;
+  void grow();
+  void unlinkSession(unsigned id);
+  void linkNewest(unsigned id);
+};
+
+#endif // RGJ_FREE_SOCKET_UDP_SESSION_H_
@@ -0,0 +1,226 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <skstream/skworker.h>
+
+#include <skstream/skserver.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif // _WIN32
+
+#ifndef HAVE_CLOSESOCKET
+static inline int closesocket(SOCKET_TYPE sock)
+{
+    return ::close(sock);
+}
+#endif // HAVE_CLOSESOCKET
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_worker_pool implementation
+/////////////////////////////////////////////////////////////////////////////
+
+socket_worker_pool::socket_worker_pool(std::size_t workers,
+                                       const connection_handler & h,
+                                       placement p) :
+    _handler(h), _placement(p), _next(0), _last_error(0), _started(false)
+{
+  if(workers == 0) {
+    workers = 1;
+  }
+  for(std::size_t i = 0; i < workers; ++i) {
+    _workers.push_back(new socket_worker(i));
+  }
+}
+
+socket_worker_pool::~socket_worker_pool()
+{
+  stop();
+  closeAcceptors();
+  closePending();
+  std::vector<socket_worker *>::const_iterator I = _workers.begin();
+  for(; I != _workers.end(); ++I) {
+    delete *I;
+  }
+}
+
+void socket_worker_pool::closeAcceptors()
+{
+  std::vector<acceptor *>::const_iterator I = _acceptors.begin();
+  for(; I != _acceptors.end(); ++I) {
+    delete (*I)->server;
+    delete *I;
+  }
+  _acceptors.clear();
+}
+
+// Close connections no handler has seen. Only called with the workers
+// stopped, so nothing else is taking them.
+void socket_worker_pool::closePending()
+{
+  std::vector<socket_worker *>::const_iterator I = _workers.begin();
+  for(; I != _workers.end(); ++I) {
+    SOCKET_TYPE sock;
+    while((*I)->_pending.pop(sock)) {
+      ::closesocket(sock);
+      (*I)->release();
+    }
+  }
+}
+
+int socket_worker_pool::listen(int service, std::size_t acceptors)
+{
+  if(_started) {
+    return -1;
+  }
+  closeAcceptors();
+
+#ifndef SO_REUSEPORT
+  acceptors = 1;
+#endif // SO_REUSEPORT
+  if(acceptors == 0) {
+    acceptors = 1;
+  }
+
+  int flags = basic_socket_server::SK_SRV_PURE |
+              basic_socket_server::SK_SRV_REUSE;
+  if(acceptors > 1) {
+    flags |= basic_socket_server::SK_SRV_REUSEPORT;
+  }
+
+  for(std::size_t i = 0; i < acceptors; ++i) {
+    acceptor * a = new acceptor;
+    a->server = new tcp_socket_server(flags);
+    a->server->setAcceptOptions(_accept_options);
+    _acceptors.push_back(a);
+    if(a->server->open(service) != 0) {
+      _last_error = a->server->getLastError();
+      closeAcceptors();
+      return -1;
+    }
+    // Make sure the rest share the port the first one was given.
+    service = port();
+  }
+  return 0;
+}
+
+int socket_worker_pool::port() const
+{
+  if(_acceptors.empty()) {
+    return -1;
+  }
+  return _acceptors.front()->server->getLocalPort();
+}
+
+int socket_worker_pool::start()
+{
+  if(_started) {
+    return -1;
+  }
+  _started = true;
+
+  std::vector<socket_worker *>::const_iterator I = _workers.begin();
+  for(; I != _workers.end(); ++I) {
+    socket_worker * w = *I;
+    w->_thread = std::thread([w]() { w->_reactor.run(); });
+  }
+
+  std::vector<acceptor *>::const_iterator J = _acceptors.begin();
+  for(; J != _acceptors.end(); ++J) {
+    acceptor * a = *J;
+    a->reactor.addAcceptor(a->server, [this](SOCKET_TYPE sock) {
+      dispatch(sock);
+    });
+    a->thread = std::thread([a]() { a->reactor.run(); });
+  }
+  return 0;
+}
+
+void socket_worker_pool::stop()
+{
+  if(!_started) {
+    return;
+  }
+  _started = false;
+
+  // Stop accepting first, so nothing more is handed to the workers.
+  std::vector<acceptor *>::const_iterator I = _acceptors.begin();
+  for(; I != _acceptors.end(); ++I) {
+    socket_reactor * r = &(*I)->reactor;
+    r->post([r]() { r->stop(); });
+    (*I)->thread.join();
+    r->remove((*I)->server);
+  }
+
+  std::vector<socket_worker *>::const_iterator J = _workers.begin();
+  for(; J != _workers.end(); ++J) {
+    socket_reactor * r = &(*J)->_reactor;
+    r->post([r]() { r->stop(); });
+    (*J)->_thread.join();
+  }
+  closePending();
+}
+
+socket_worker * socket_worker_pool::choose()
+{
+  const std::size_t count = _workers.size();
+  const std::size_t first = _next.fetch_add(1, std::memory_order_relaxed);
+  if(_placement == ROUND_ROBIN) {
+    return _workers[first % count];
+  }
+
+  // Start the scan at a different worker each time, so ties are spread.
+  socket_worker * best = 0;
+  for(std::size_t i = 0; i < count; ++i) {
+    socket_worker * w = _workers[(first + i) % count];
+    if(best == 0 || w->load() < best->load()) {
+      best = w;
+    }
+  }
+  return best;
+}
+
+void socket_worker_pool::dispatch(SOCKET_TYPE sock)
+{
+  socket_worker * w = choose();
+  w->_load.fetch_add(1, std::memory_order_relaxed);
+  // The socket is queued separately from the task, so that stop() can
+  // close it if the task never runs.
+  w->_pending.push(sock);
+  connection_handler & h = _handler;
+  w->_reactor.post([w, &h]() {
+    SOCKET_TYPE s;
+    while(w->_pending.pop(s)) {
+      h(*w, s);
+    }
+  });
+}
@@ -0,0 +1,176 @@
+/**************************************************************************
+ FreeSockets - Portable C++ classes for IP(sockets) applications. (v0.3)
+ Copyright (C) 2026 The WorldForge Project
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+**************************************************************************/
+
+/**
+ * This software package has been extensively modified by members of the
+ * Worldforge Project. See the file ChangeLog for details.
+ *
+ * $Id$
+ *
+ */
+#ifndef RGJ_FREE_SOCKET_WORKER_H_
+#define RGJ_FREE_SOCKET_WORKER_H_
+
+#include <skstream/skreactor.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class tcp_socket_server;
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_worker
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief A thread running its own socket_reactor, as part of a pool.
+///
+/// Connections handed to a worker are only ever touched from its thread,
+/// so the streams it creates for them need no locking.
+class socket_worker {
+public:
+  /// The reactor run by this worker's thread.
+  socket_reactor & reactor() {
+    return _reactor;
+  }
+
+  /// Position of this worker in its pool.
+  std::size_t index() const {
+    return _index;
+  }
+
+  /// Number of connections handed to this worker and not yet released.
+  long load() const {
+    return _load.load(std::memory_order_relaxed);
+  }
+
+  /// Tell the pool one of this worker's connections has closed.
+  void release() {
+    _load.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+private:
+  friend class socket_worker_pool;
+
+  explicit socket_worker(std::size_t index) : _load(0), _index(index) { }
+  socket_worker(const socket_worker&);
+  socket_worker& operator=(const socket_worker&);
+
+  socket_reactor _reactor;
+  /// Connections handed over but not yet passed to the handler.
+  mpsc_queue<SOCKET_TYPE> _pending;
+  std::atomic<long> _load;
+  std::size_t _index;
+  std::thread _thread;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// class socket_worker_pool
+/////////////////////////////////////////////////////////////////////////////
+
+/// \brief Accepts TCP connections and shares them out between worker threads.
+///
+/// One or more acceptor threads wait for connections, and hand each one
+/// to a worker through the worker reactor's lock-free task queue. The
+/// connection handler is then called on the worker's thread, where it
+/// would typically wrap the socket in a stream and register it with the
+/// worker's reactor.
+class socket_worker_pool {
+public:
+  /// How a worker is chosen for each new connection.
+  enum placement {
+    ROUND_ROBIN,
+    LEAST_LOADED
+  };
+
+  /// Called on a worker's thread with each connection handed to it.
+  typedef std::function<void(socket_worker &, SOCKET_TYPE)> connection_handler;
+
+  socket_worker_pool(std::size_t workers, const connection_handler & h,
+                     placement p = LEAST_LOADED);
+  ~socket_worker_pool();
+
+  /** Listen on a TCP port. With more than one acceptor, each has its own
+   *  listen socket bound with SO_REUSEPORT, and the kernel spreads
+   *  incoming connections between them. Where SO_REUSEPORT is not
+   *  available a single acceptor is used. Returns 0 on success.
+   */
+  int listen(int service, std::size_t acceptors = 1);
+
+  /// Set options for accepted connections. Call this before listen().
+  void setAcceptOptions(const socket_options & options) {
+    _accept_options = options;
+  }
+
+  /// Return the port being listened on, or -1.
+  int port() const;
+
+  /// Start the worker and acceptor threads.
+  int start();
+
+  /** Stop all threads and wait for them to finish. Connections handed
+   *  to a worker which has not yet passed them to the handler are closed.
+   */
+  void stop();
+
+  /** Hand a connection to a worker. Safe to call from any thread. A
+   *  connection handed over after stop() is closed by the next stop() or
+   *  by the destructor.
+   */
+  void dispatch(SOCKET_TYPE sock);
+
+  /// Return the number of workers.
+  std::size_t size() const {
+    return _workers.size();
+  }
+
+  socket_worker & worker(std::size_t i) {
+    return *_workers[i];
+  }
+
+  int getLastError() const {
+    return _last_error;
+  }
+
+private:
+  socket_worker_pool(const socket_worker_pool&);
+  socket_worker_pool& operator=(const socket_worker_pool&);
+
+  struct acceptor {
+    tcp_socket_server * server;
+    socket_reactor reactor;
+    std::thread thread;
+  };
+
+  std::vector<socket_worker *> _workers;
+  std::vector<acceptor *> _acceptors;
+  connection_handler _handler;
+  socket_options _accept_options;
+  placement _placement;
+  std::atomic<std::size_t> _next;
+  int _last_error;
+  bool _started;
+
+  socket_worker * choose();
+  void closeAcceptors();
+  void closePending();
+};
+
+#endif // RGJ_FREE_SOCKET_WORKER_H_
@@ -98,11 +98,23 @@
 #define CHILDSKSTREAMTEST_H
 
 #include <skstream/skstream.h>
+#include <skstream/skstream_unix.h>
+#include <skstream/skserver.h>
+#include <skstream/skserver_unix.h>
 
 #include <cppunit/TestCase.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 class tcpskstreamtest : public CppUnit::TestCase
 {
@@ -216,8 +228,133 @@ class udpskstreamtest : public CppUnit::TestCase
     //some macros for building the suite() method
     CPPUNIT_TEST_SUITE(udpskstreamtest);
     CPPUNIT_TEST(testConstructor_1);
+    CPPUNIT_TEST(testSegments);
+    CPPUNIT_TEST(testSegmentsFullBuffer);
+    CPPUNIT_TEST(testDatagramBoundaries);
+    CPPUNIT_TEST(testDatagramTooLarge);
+    CPPUNIT_TEST(testDatagramOffload);
+    CPPUNIT_TEST(testConnected);
+    CPPUNIT_TEST(testServerPeer);
+    CPPUNIT_TEST(testMulticast);
+    CPPUNIT_TEST(testMulticastIPv6);
+    CPPUNIT_TEST(testMulticastByAddress);
     CPPUNIT_TEST_SUITE_END();
 
+    private:
+        // Read one datagram, or return an empty string on timeout
+        static std::string readDatagram(udp_socket_stream & s)
+        {
+            std::streambuf * sb = s.rdbuf();
+            if (sb->sgetc() == std::streambuf::traits_type::eof()) {
+                return std::string();
+            }
+            std::string datagram(sb->in_avail(), '\0');
+            sb->sgetn(&datagram[0], datagram.size());
+            return datagram;
+        }
+
+        // Send segmented output from one stream, and check the datagrams
+        // received by another.
+        void checkSegments(std::size_t segment, std::size_t total)
+        {
+            udp_socket_stream receiver;
+            CPPUNIT_ASSERT(receiver.open(0) == 0);
+            receiver.setTimeout(2);
+            receiver.setReceiveOffload(true);
+
+            udp_socket_stream sender;
+            CPPUNIT_ASSERT(sender.setTarget(
+                               receiver.getFamily() == AF_INET6 ?
+                               "::1" : "127.0.0.1",
+                               receiver.getLocalPort()));
+            sender.setSegmentSize(segment);
+            CPPUNIT_ASSERT(sender.getSegmentSize() == segment);
+
+            std::string data;
+            for (std::size_t i = 0; i < total; ++i) {
+                data += (char)('a' + i % 26);
+            }
+            sender.write(data.data(), data.size());
+            sender.flush();
+            CPPUNIT_ASSERT(sender.good());
+
+            std::size_t offset = 0;
+            while (offset < total) {
+                std::string datagram = readDatagram(receiver);
+                std::size_t expected = std::min(segment, total - offset);
+                CPPUNIT_ASSERT(datagram.size() == expected);
+                CPPUNIT_ASSERT(datagram == data.substr(offset, expected));
+                offset += expected;
+            }
+        }
+
+        // Open a receiver on an ephemeral port, and point sender at it.
+        static void connectPair(udp_socket_stream & receiver,
+                                udp_socket_stream & sender)
+        {
+            CPPUNIT_ASSERT(receiver.open(0) == 0);
+            receiver.setTimeout(2);
+
+            CPPUNIT_ASSERT(sender.setTarget(
+                               receiver.getFamily() == AF_INET6 ?
+                               "::1" : "127.0.0.1",
+                               receiver.getLocalPort()));
+        }
+
+        static int peerPort(const sockaddr_storage & addr)
+        {
+            return ntohs(addr.ss_family == AF_INET6 ?
+                         ((const sockaddr_in6&)addr).sin6_port :
+                         ((const sockaddr_in&)addr).sin_port);
+        }
+
+        // Contents of datagram number i, of a size which varies with i.
+        static std::string datagramFor(int i)
+        {
+            std::size_t size = (i % 500 == 7) ? 0 : 1 + (i * 37) % 1400;
+            std::string data(size, (char)('a' + i % 26));
+            char tag[16];
+            int len = snprintf(tag, sizeof(tag), "%d.", i);
+            data.replace(0, std::min(data.size(), (std::size_t)len),
+                         tag, std::min(data.size(), (std::size_t)len));
+            return data;
+        }
+
+        // Send to a group on the loopback interface, and see if receiver
+        // gets it within a second.
+        static bool checkMulticast(udp_socket_stream & receiver,
+                                   const char * group, int port,
+                                   const std::string & text)
+        {
+            udp_socket_stream sender;
+            CPPUNIT_ASSERT(sender.setTarget(group, port));
+            CPPUNIT_ASSERT(sender.setMulticastInterface("lo"));
+            CPPUNIT_ASSERT(sender.setMulticastLoop(true));
+            CPPUNIT_ASSERT(sender.setMulticastTTL(1));
+            CPPUNIT_ASSERT(sender.sendDatagram(text) == (int)text.size());
+
+            struct pollfd pfd = { receiver.getSocket(), POLLIN, 0 };
+            if (::poll(&pfd, 1, 1000) <= 0) {
+                return false;
+            }
+            CPPUNIT_ASSERT(readDatagram(receiver) == text);
+            return true;
+        }
+
+        void checkGroup(int family, const char * group,
+                        const char * iface = "lo")
+        {
+            udp_socket_stream receiver;
+            CPPUNIT_ASSERT(receiver.open(0, family) == 0);
+            CPPUNIT_ASSERT(receiver.getFamily() == family);
+            int port = receiver.getLocalPort();
+
+            CPPUNIT_ASSERT(receiver.joinGroup(group, iface));
+            CPPUNIT_ASSERT(checkMulticast(receiver, group, port, "update"));
+            CPPUNIT_ASSERT(receiver.leaveGroup(group, iface));
+            CPPUNIT_ASSERT(!checkMulticast(receiver, group, port, "missed"));
+        }
+
     public:
         udpskstreamtest(std::string name) : TestCase(name) { }
         udpskstreamtest() { }
@@ -230,6 +367,591 @@ class udpskstreamtest : public CppUnit::TestCase
             CPPUNIT_ASSERT(!skstream.is_open());
         }
 
+        void testSegments()
+        {
+            checkSegments(100, 250);
+        }
+
+        void testSegmentsFullBuffer()
+        {
+            // More than the output buffer holds, so some goes in overflow()
+            checkSegments(1000, 40500);
+        }
+
+        void testDatagramBoundaries()
+        {
+            udp_socket_stream receiver;
+            udp_socket_stream sender;
+            connectPair(receiver, sender);
+
+            // Bursts of datagrams of every size, some empty, written both
+            // through the stream and straight from memory.
+            const int count = 2000;
+            const int burst = 50;
+            int sender_port = -1;
+            for (int start = 0; start < count; start += burst) {
+                for (int i = start; i < start + burst; ++i) {
+                    std::string data = datagramFor(i);
+                    if (i % 2 == 0) {
+                        CPPUNIT_ASSERT(sender.beginDatagram() == 0);
+                        sender << data;
+                        CPPUNIT_ASSERT(sender.inDatagram());
+                        // A flush does not end the datagram.
+                        sender.flush();
+                        CPPUNIT_ASSERT(sender.sendDatagram() == (int)data.size());
+                    } else {
+                        CPPUNIT_ASSERT(sender.sendDatagram(data) == (int)data.size());
+                    }
+                }
+                if (sender_port == -1) {
+                    sender_port = sender.getLocalPort();
+                }
+                for (int i = start; i < start + burst; ++i) {
+                    datagram_view datagram;
+                    std::string data = datagramFor(i);
+                    int size = receiver.receiveDatagram(datagram);
+                    CPPUNIT_ASSERT(size == (int)data.size());
+                    CPPUNIT_ASSERT(datagram.size == data.size());
+                    CPPUNIT_ASSERT(std::string(datagram.data, datagram.size) == data);
+                    CPPUNIT_ASSERT(peerPort(*datagram.peer) == sender_port);
+                }
+            }
+
+            // Reading part of a datagram through the stream leaves the rest
+            // of it, and only it, for receiveDatagram().
+            CPPUNIT_ASSERT(sender.sendDatagram("hello world") == 11);
+            CPPUNIT_ASSERT(sender.sendDatagram("next") == 4);
+            std::string word;
+            receiver >> word;
+            CPPUNIT_ASSERT(word == "hello");
+            datagram_view datagram;
+            CPPUNIT_ASSERT(receiver.receiveDatagram(datagram) == 6);
+            CPPUNIT_ASSERT(std::string(datagram.data, datagram.size) == " world");
+            CPPUNIT_ASSERT(receiver.receiveDatagram(datagram) == 4);
+            CPPUNIT_ASSERT(std::string(datagram.data, datagram.size) == "next");
+        }
+
+        void testDatagramTooLarge()
+        {
+            udp_socket_stream receiver;
+            udp_socket_stream sender;
+            connectPair(receiver, sender);
+
+            // Larger than the output buffer, so it can't be sent whole.
+            std::string big(40000, 'x');
+            CPPUNIT_ASSERT(sender.beginDatagram() == 0);
+            sender.write(big.data(), big.size());
+            CPPUNIT_ASSERT(!sender.good());
+            CPPUNIT_ASSERT(sender.sendDatagram() == -1);
+            CPPUNIT_ASSERT(sender.getLastError() == EMSGSIZE);
+            CPPUNIT_ASSERT(!sender.inDatagram());
+
+            // Nothing was sent, not even part of it. Loopback delivers at
+            // once, so a non-blocking read is enough to show that.
+            int flags = ::fcntl(receiver.getSocket(), F_GETFL);
+            ::fcntl(receiver.getSocket(), F_SETFL, flags | O_NONBLOCK);
+            datagram_view datagram;
+            CPPUNIT_ASSERT(receiver.receiveDatagram(datagram) == -1);
+            CPPUNIT_ASSERT(receiver.wouldBlock());
+            ::fcntl(receiver.getSocket(), F_SETFL, flags);
+
+            sender.clear();
+            CPPUNIT_ASSERT(sender.beginDatagram() == 0);
+            sender << "fits";
+            CPPUNIT_ASSERT(sender.sendDatagram() == 4);
+            CPPUNIT_ASSERT(receiver.receiveDatagram(datagram) == 4);
+            CPPUNIT_ASSERT(std::string(datagram.data, datagram.size) == "fits");
+        }
+
+        void testDatagramOffload()
+        {
+            udp_socket_stream receiver;
+            udp_socket_stream sender;
+            connectPair(receiver, sender);
+            receiver.setReceiveOffload(true);
+            sender.setSegmentSize(500);
+
+            std::string data;
+            for (int i = 0; i < 5000; ++i) {
+                data += (char)('a' + i % 26);
+            }
+            sender.write(data.data(), data.size());
+            sender.flush();
+            CPPUNIT_ASSERT(sender.good());
+
+            // However the kernel batched them, each comes back separately.
+            for (std::size_t offset = 0; offset < data.size(); offset += 500) {
+                datagram_view datagram;
+                CPPUNIT_ASSERT(receiver.receiveDatagram(datagram) == 500);
+                CPPUNIT_ASSERT(std::string(datagram.data, datagram.size) ==
+                               data.substr(offset, 500));
+            }
+        }
+
+        void testConnected()
+        {
+            udp_socket_stream receiver;
+            udp_socket_stream sender;
+            connectPair(receiver, sender);
+            CPPUNIT_ASSERT(!sender.isConnected());
+            CPPUNIT_ASSERT(sender.setConnected(true));
+            CPPUNIT_ASSERT(sender.isConnected());
+
+            CPPUNIT_ASSERT(sender.sendDatagram("hello") == 5);
+            CPPUNIT_ASSERT(readDatagram(receiver) == "hello");
+
+            // Only the target gets through to a connected socket.
+            udp_socket_stream stray;
+            CPPUNIT_ASSERT(stray.setTarget(sender.getFamily() == AF_INET6 ?
+                                           "::1" : "127.0.0.1",
+                                           sender.getLocalPort()));
+            CPPUNIT_ASSERT(stray.sendDatagram("stray") == 5);
+            receiver.setOutpeer(receiver.getInpeer(),
+                                receiver.getInpeerSize());
+            CPPUNIT_ASSERT(receiver.sendDatagram("reply") == 5);
+            CPPUNIT_ASSERT(readDatagram(sender) == "reply");
+
+            // Stream output goes out the same way.
+            sender << "streamed" << std::flush;
+            CPPUNIT_ASSERT(readDatagram(receiver) == "streamed");
+
+            CPPUNIT_ASSERT(sender.setConnected(false));
+            CPPUNIT_ASSERT(!sender.isConnected());
+            CPPUNIT_ASSERT(sender.sendDatagram("again") == 5);
+            CPPUNIT_ASSERT(readDatagram(receiver) == "again");
+        }
+
+        void testServerPeer()
+        {
+            udp_socket_server server(0, udp_socket_server::SK_SRV_REUSEPORT);
+            CPPUNIT_ASSERT(server.is_open());
+            const char * host = server.getFamily() == AF_INET6 ? "::1"
+                                                                : "127.0.0.1";
+
+            udp_socket_stream first, second;
+            CPPUNIT_ASSERT(first.setTarget(host, server.getLocalPort()));
+            CPPUNIT_ASSERT(second.setTarget(host, server.getLocalPort()));
+            CPPUNIT_ASSERT(first.sendDatagram("hello") == 5);
+
+            char buf[64];
+            sockaddr_storage from;
+            SOCKLEN from_len = sizeof(from);
+            int len = ::recvfrom(server.getSocket(), buf, sizeof(buf), 0,
+                                 (sockaddr*)&from, &from_len);
+            CPPUNIT_ASSERT(std::string(buf, len) == "hello");
+
+            // The first peer now has a socket of its own.
+            udp_socket_stream peer;
+            CPPUNIT_ASSERT(peer.open(server, from, from_len) == 0);
+            CPPUNIT_ASSERT(peer.isConnected());
+            CPPUNIT_ASSERT(first.sendDatagram("mine") == 4);
+            CPPUNIT_ASSERT(second.sendDatagram("theirs") == 6);
+            CPPUNIT_ASSERT(readDatagram(peer) == "mine");
+            len = ::recv(server.getSocket(), buf, sizeof(buf), 0);
+            CPPUNIT_ASSERT(std::string(buf, len) == "theirs");
+
+            CPPUNIT_ASSERT(peer.sendDatagram("ack") == 3);
+            CPPUNIT_ASSERT(readDatagram(first) == "ack");
+
+            // Without SK_SRV_REUSEPORT the port can't be shared.
+            udp_socket_server plain(0);
+            CPPUNIT_ASSERT(peer.open(plain, from, from_len) == -1);
+            CPPUNIT_ASSERT(!peer.is_open());
+        }
+
+        void testMulticast()
+        {
+            checkGroup(AF_INET, "239.255.42.99");
+
+            udp_socket_stream receiver;
+            CPPUNIT_ASSERT(receiver.open(0, AF_INET) == 0);
+            CPPUNIT_ASSERT(!receiver.joinGroup("not a group"));
+            CPPUNIT_ASSERT(receiver.getLastError() == EINVAL);
+            CPPUNIT_ASSERT(!receiver.joinGroup("239.255.42.99", "nosuchif0"));
+        }
+
+        void testMulticastIPv6()
+        {
+            udp_socket_stream probe;
+            if (probe.open(0, AF_INET6) != 0) {
+                return; // No IPv6 here
+            }
+            CPPUNIT_ASSERT(probe.joinGroup("ff02::4242", "lo"));
+            CPPUNIT_ASSERT(probe.leaveGroup("ff02::4242", "lo"));
+
+            // Linux gives lo no IPv6 multicast route unless one is added.
+            udp_socket_stream sender;
+            CPPUNIT_ASSERT(sender.setTarget("ff02::4242", 9));
+            CPPUNIT_ASSERT(sender.setMulticastInterface("lo"));
+            if (sender.sendDatagram("probe") < 0) {
+                return;
+            }
+            checkGroup(AF_INET6, "ff02::4242");
+        }
+
+        void testMulticastByAddress()
+        {
+            // The loopback interface given by its IPv4 address
+            checkGroup(AF_INET, "239.255.42.98", "127.0.0.1");
+
+            udp_socket_stream receiver;
+            CPPUNIT_ASSERT(receiver.open(0, AF_INET) == 0);
+            CPPUNIT_ASSERT(!receiver.joinGroup("239.255.42.98", "10.255.255.254"));
+        }
+
+        void setUp()
+        {
+        }
+
+        void tearDown()
+        {
+        }
+
+};
+
+#ifdef AF_UNIX
+class unixskstreamtest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(unixskstreamtest);
+    CPPUNIT_TEST(testConstructor_1);
+    CPPUNIT_TEST(testPair);
+    CPPUNIT_TEST(testPairSeqpacket);
+    CPPUNIT_TEST(testPairNonblock);
+    CPPUNIT_TEST(testReadLineEof);
+    CPPUNIT_TEST(testSendFds);
+    CPPUNIT_TEST(testSendListener);
+    CPPUNIT_TEST(testRecvListenerStray);
+    CPPUNIT_TEST(testMessages);
+    CPPUNIT_TEST(testMessageNonblock);
+    CPPUNIT_TEST(testMessagePartial);
+    CPPUNIT_TEST(testSeqpacketServer);
+    CPPUNIT_TEST(testLongPath);
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+        unixskstreamtest(std::string name) : TestCase(name) { }
+        unixskstreamtest() { }
+
+        void testConstructor_1()
+        {
+            unix_socket_stream skstream;
+            CPPUNIT_ASSERT(skstream);
+
+            CPPUNIT_ASSERT(!skstream.is_open());
+        }
+
+        void testPair()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+            CPPUNIT_ASSERT(a.is_open());
+            CPPUNIT_ASSERT(b.is_open());
+
+            std::string line;
+            a << "hello" << std::endl;
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "hello");
+
+            b << "world" << std::endl;
+            CPPUNIT_ASSERT(a.readLine(line));
+            CPPUNIT_ASSERT(line == "world");
+
+            // Reopening replaces both ends
+            a.open(b);
+            CPPUNIT_ASSERT(a.is_open());
+            CPPUNIT_ASSERT(b.is_open());
+            b << "again" << std::endl;
+            CPPUNIT_ASSERT(a.readLine(line));
+            CPPUNIT_ASSERT(line == "again");
+        }
+
+        void testPairSeqpacket()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a, false, SOCK_SEQPACKET);
+            CPPUNIT_ASSERT(a.is_open());
+            CPPUNIT_ASSERT(b.is_open());
+
+            int type = 0;
+            SOCKLEN len = sizeof(type);
+            ::getsockopt(a.getSocket(), SOL_SOCKET, SO_TYPE, (char*)&type, &len);
+            CPPUNIT_ASSERT(type == SOCK_SEQPACKET);
+
+            std::string line;
+            a << "message" << std::endl;
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "message");
+        }
+
+        void testPairNonblock()
+        {
+            unix_socket_stream a;
+            a.open(a);
+            CPPUNIT_ASSERT(!a.is_open());
+
+            unix_socket_stream b(a, true);
+            CPPUNIT_ASSERT(a.nonBlocking());
+            CPPUNIT_ASSERT(b.nonBlocking());
+
+            std::string line;
+            CPPUNIT_ASSERT(!b.readLine(line));
+            CPPUNIT_ASSERT(b.wouldBlock());
+            b.clear();
+
+            a << "ready" << std::endl;
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "ready");
+        }
+
+        void testReadLineEof()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+
+            a << "whole\nlast" << std::flush;
+            a.close();
+
+            std::string line;
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "whole");
+            CPPUNIT_ASSERT(!b.eof());
+
+            // The unterminated record is returned, with eof set.
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "last");
+            CPPUNIT_ASSERT(b.eof());
+            CPPUNIT_ASSERT(!b.fail());
+
+            CPPUNIT_ASSERT(!b.readLine(line));
+            CPPUNIT_ASSERT(b.fail());
+        }
+
+        void testSendFds()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+
+            // A second pair, whose ends are passed across the first
+            unix_socket_stream c;
+            unix_socket_stream d(c);
+            SOCKET_TYPE fds[2] = { c.getSocket(), d.getSocket() };
+
+            std::string line;
+            a << "before" << std::endl;
+            CPPUNIT_ASSERT(a.sendFds(fds, 2, "fds\n") == 0);
+            a << "after" << std::endl;
+
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "before");
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "fds");
+
+            std::vector<SOCKET_TYPE> received;
+            CPPUNIT_ASSERT(b.recvFds(received) == 2);
+            CPPUNIT_ASSERT(received.size() == 2);
+            CPPUNIT_ASSERT(b.recvFds(received) == 0);
+
+            CPPUNIT_ASSERT(b.readLine(line));
+            CPPUNIT_ASSERT(line == "after");
+
+            // The received descriptors are the same pair
+            unix_socket_stream e(received[0]);
+            unix_socket_stream f(received[1]);
+            e << "passed" << std::endl;
+            CPPUNIT_ASSERT(d.readLine(line));
+            CPPUNIT_ASSERT(line == "passed");
+            c << "back" << std::endl;
+            CPPUNIT_ASSERT(f.readLine(line));
+            CPPUNIT_ASSERT(line == "back");
+
+            CPPUNIT_ASSERT(a.sendFds(fds, 0, "none\n") == -1);
+            CPPUNIT_ASSERT(a.sendFds(fds, 1, "") == -1);
+        }
+
+        void testSendListener()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+
+            tcp_socket_server *old_server = new tcp_socket_server;
+            CPPUNIT_ASSERT(old_server->open(0) == 0);
+            int port = old_server->getLocalPort();
+
+            // A connection waiting before the handover is not lost
+            tcp_socket_stream early(std::string("localhost"), port);
+            CPPUNIT_ASSERT(early.is_open());
+
+            CPPUNIT_ASSERT(a.sendListener(*old_server) == 0);
+            tcp_socket_server new_server;
+            CPPUNIT_ASSERT(b.recvListener(new_server) == 0);
+            CPPUNIT_ASSERT(new_server.is_open());
+            delete old_server;
+
+            tcp_socket_stream late(std::string("localhost"), port);
+            CPPUNIT_ASSERT(late.is_open());
+
+            SOCKET_TYPE s1 = new_server.accept();
+            SOCKET_TYPE s2 = new_server.accept();
+            CPPUNIT_ASSERT(s1 != INVALID_SOCKET);
+            CPPUNIT_ASSERT(s2 != INVALID_SOCKET);
+            ::close(s1);
+            ::close(s2);
+        }
+
+        void testRecvListenerStray()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+
+            unix_socket_stream c;
+            unix_socket_stream d(c);
+            SOCKET_TYPE fds[2] = { c.getSocket(), d.getSocket() };
+
+            // Two descriptors under the listener tag is not a listener
+            // handover, and neither of them may be kept open.
+            int next = ::dup(0);
+            ::close(next);
+            CPPUNIT_ASSERT(a.sendFds(fds, 2, "skstream-listener\n") == 0);
+            tcp_socket_server server;
+            CPPUNIT_ASSERT(b.recvListener(server) == -1);
+            CPPUNIT_ASSERT(b.getLastError() == EPROTO);
+            CPPUNIT_ASSERT(!server.is_open());
+            int after = ::dup(0);
+            ::close(after);
+            CPPUNIT_ASSERT(after == next);
+        }
+
+        void testMessages()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a, false, SOCK_SEQPACKET);
+
+            // Larger than the stream buffer, so only the message calls
+            // can carry it whole.
+            std::string big(20000, 'x');
+            big[19999] = 'y';
+            CPPUNIT_ASSERT(a.sendMessage("one") == 0);
+            CPPUNIT_ASSERT(a.sendMessage(big) == 0);
+            CPPUNIT_ASSERT(a.sendMessage("three") == 0);
+
+            std::string message;
+            CPPUNIT_ASSERT(b.recvMessage(message) == 3);
+            CPPUNIT_ASSERT(message == "one");
+            CPPUNIT_ASSERT(b.recvMessage(message) == 20000);
+            CPPUNIT_ASSERT(message == big);
+            CPPUNIT_ASSERT(b.recvMessage(message) == 5);
+            CPPUNIT_ASSERT(message == "three");
+
+            // Stream output is sent as a message on each flush.
+            a << "flushed" << std::flush;
+            CPPUNIT_ASSERT(b.recvMessage(message) == 7);
+            CPPUNIT_ASSERT(message == "flushed");
+
+            a.close();
+            CPPUNIT_ASSERT(b.recvMessage(message) == 0);
+        }
+
+        void testMessageNonblock()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a, true, SOCK_SEQPACKET);
+
+            std::string message;
+            CPPUNIT_ASSERT(b.recvMessage(message) == -1);
+            CPPUNIT_ASSERT(b.wouldBlock());
+
+            CPPUNIT_ASSERT(a.sendMessage("ready") == 0);
+            CPPUNIT_ASSERT(b.recvMessage(message) == 5);
+            CPPUNIT_ASSERT(message == "ready");
+            CPPUNIT_ASSERT(!b.wouldBlock());
+        }
+
+        void testMessagePartial()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a, true);
+
+            // Far more than the socket takes at once, so the rest of the
+            // message is queued rather than lost.
+            const std::size_t total = 0x100000;
+            std::string big(total, 'x');
+            big[total - 1] = 'y';
+            CPPUNIT_ASSERT(a.sendMessage(big) == 0);
+            CPPUNIT_ASSERT(a.pendingBytes() > 0);
+
+            std::string received;
+            char buf[0x1000];
+            while (received.size() < total) {
+                CPPUNIT_ASSERT(a.flushPending() == 0);
+                ssize_t len = ::read(b.getSocket(), buf, sizeof(buf));
+                CPPUNIT_ASSERT(len > 0);
+                received.append(buf, len);
+            }
+            CPPUNIT_ASSERT(received == big);
+            CPPUNIT_ASSERT(a.pendingBytes() == 0);
+        }
+
+        void testSeqpacketServer()
+        {
+#ifdef __linux__
+            char name[64];
+            snprintf(name, sizeof(name), "@skstream-test-%d", (int)getpid());
+            unix_address address(name);
+            CPPUNIT_ASSERT(address.isValid());
+            CPPUNIT_ASSERT(address.isAbstract());
+
+            unix_socket_server server(name, SOCK_SEQPACKET);
+            CPPUNIT_ASSERT(server.is_open());
+            // Nothing was created in the filesystem.
+            CPPUNIT_ASSERT(::access(name, F_OK) != 0);
+
+            unix_socket_stream client(name, false, SOCK_SEQPACKET);
+            CPPUNIT_ASSERT(client.is_open());
+            unix_socket_stream peer(server.accept());
+            CPPUNIT_ASSERT(peer.is_open());
+
+            std::string message;
+            CPPUNIT_ASSERT(client.sendMessage("hello") == 0);
+            CPPUNIT_ASSERT(peer.recvMessage(message) == 5);
+            CPPUNIT_ASSERT(message == "hello");
+
+            // A second server can't take the same name while this one
+            // is listening.
+            unix_socket_server other;
+            CPPUNIT_ASSERT(other.open(name, SOCK_SEQPACKET) != 0);
+#endif // __linux__
+        }
+
+        void testLongPath()
+        {
+            char base[] = "/tmp/skstreamXXXXXX";
+            CPPUNIT_ASSERT(mkdtemp(base) != 0);
+            std::string dir = std::string(base) + "/" + std::string(100, 'd');
+            CPPUNIT_ASSERT(::mkdir(dir.c_str(), 0700) == 0);
+            std::string path = dir + "/socket";
+            CPPUNIT_ASSERT(path.size() > 108);
+
+            unix_socket_server server;
+            int ret = server.open(path);
+            if(ret == 0) {
+                unix_socket_stream client(path);
+                CPPUNIT_ASSERT(client.is_open());
+                unix_socket_stream peer(server.accept());
+                client << "long" << std::endl;
+                std::string line;
+                CPPUNIT_ASSERT(peer.readLine(line));
+                CPPUNIT_ASSERT(line == "long");
+                server.close();
+                ::unlink(path.c_str());
+            } else {
+                // Systems without /proc/self/fd still refuse it cleanly.
+                CPPUNIT_ASSERT(server.getLastError() == ENAMETOOLONG);
+            }
+            ::rmdir(dir.c_str());
+            ::rmdir(base);
+        }
+
         void setUp()
         {
         }
@@ -239,6 +961,7 @@ class udpskstreamtest : public CppUnit::TestCase
         }
 
 };
+#endif
 
 #ifdef SOCK_RAW
 class rawskstreamtest : public CppUnit::TestCase
@@ -246,6 +969,7 @@ class rawskstreamtest : public CppUnit::TestCase
     //some macros for building the suite() method
     CPPUNIT_TEST_SUITE(rawskstreamtest);
     CPPUNIT_TEST(testConstructor_1);
+    CPPUNIT_TEST(testIcmpEcho);
     CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -262,6 +986,56 @@ class rawskstreamtest : public CppUnit::TestCase
                     skstream.is_open());
         }
 
+        void testIcmpEcho()
+        {
+            // Unprivileged where the system allows it, otherwise raw.
+            raw_socket_stream skstream(FreeSockets::proto_ICMP, SOCK_DGRAM);
+            if(!skstream.is_open()) {
+                skstream.setProtocol(FreeSockets::proto_ICMP, SOCK_RAW);
+            }
+            if(!skstream.is_open()) {
+                return;
+            }
+            SOCKET_TYPE sock = skstream.getSocket();
+            CPPUNIT_ASSERT(skstream.setTarget("127.0.0.1"));
+            CPPUNIT_ASSERT(skstream.getSocket() == sock);
+
+            // An echo request, with a checksum only a raw socket needs.
+            unsigned char request[16] = { 8, 0, 0, 0, 0x12, 0x34, 0, 7,
+                                          'p', 'i', 'n', 'g' };
+            unsigned sum = 0;
+            for(std::size_t i = 0; i < sizeof(request); i += 2) {
+                sum += (request[i] << 8) | request[i + 1];
+            }
+            sum = (sum >> 16) + (sum & 0xffff);
+            sum = ~(sum + (sum >> 16)) & 0xffff;
+            request[2] = sum >> 8;
+            request[3] = sum & 0xff;
+            CPPUNIT_ASSERT(skstream.sendDatagram((const char *)request,
+                                                 sizeof(request)) ==
+                           (int)sizeof(request));
+
+            // A raw socket also sees the request itself on loopback.
+            bool replied = false;
+            for(int i = 0; i < 4 && !replied; ++i) {
+                struct pollfd pfd = { sock, POLLIN, 0 };
+                if(::poll(&pfd, 1, 1000) != 1) {
+                    break;
+                }
+                datagram_view datagram;
+                int size = skstream.receiveDatagram(datagram);
+                CPPUNIT_ASSERT(size > 0);
+                const unsigned char * icmp =
+                    (const unsigned char *)datagram.data;
+                if(skstream.getType() == SOCK_RAW) {
+                    icmp += (icmp[0] & 0x0f) * 4;
+                }
+                replied = icmp[0] == 0 && icmp[7] == 7 &&
+                          std::memcmp(icmp + 8, "ping", 4) == 0;
+            }
+            CPPUNIT_ASSERT(replied);
+        }
+
         void setUp()
         {
         }
@@ -0,0 +1,198 @@
+// internet_checksum test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+
+#ifndef SKCHECKSUMTEST_H
+#define SKCHECKSUMTEST_H
+
+#include <skstream/skchecksum.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class skchecksumtest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skchecksumtest);
+    CPPUNIT_TEST(testKnownValue);
+    CPPUNIT_TEST(testImplementations);
+    CPPUNIT_TEST(testIncremental);
+    CPPUNIT_TEST(testUpdate);
+    CPPUNIT_TEST_SUITE_END();
+
+    // The plain 16-bit word loop the other implementations must match.
+    static uint16_t reference(const unsigned char * data, std::size_t len)
+    {
+        uint32_t sum = 0;
+        for(std::size_t i = 0; i + 1 < len; i += 2) {
+            uint16_t word;
+            std::memcpy(&word, data + i, 2);
+            sum += word;
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        if(len & 1) {
+            unsigned char last[2] = { data[len - 1], 0 };
+            uint16_t word;
+            std::memcpy(&word, last, 2);
+            sum += word;
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        return ~sum;
+    }
+
+    static uint16_t folded(uint64_t sum)
+    {
+        while(sum >> 16) {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        return ~sum;
+    }
+
+    static std::vector<unsigned char> randomData(std::size_t len)
+    {
+        std::vector<unsigned char> data(len);
+        for(std::size_t i = 0; i < len; ++i) {
+            data[i] = std::rand();
+        }
+        return data;
+    }
+
+    public:
+        skchecksumtest(std::string name) : TestCase(name) { }
+        skchecksumtest() { }
+
+        void testKnownValue()
+        {
+            // The example from RFC 1071, section 3.
+            const unsigned char data[] = { 0x00, 0x01, 0xf2, 0x03,
+                                           0xf4, 0xf5, 0xf6, 0xf7 };
+            uint16_t checksum = internet_checksum::compute(data, sizeof(data));
+            const unsigned char * bytes = (const unsigned char *)&checksum;
+            CPPUNIT_ASSERT(bytes[0] == 0x22);
+            CPPUNIT_ASSERT(bytes[1] == 0x0d);
+
+            // Data with its checksum in it sums to zero.
+            unsigned char packet[10];
+            std::memcpy(packet, data, sizeof(data));
+            std::memcpy(packet + sizeof(data), &checksum, 2);
+            CPPUNIT_ASSERT(internet_checksum::compute(packet, 10) == 0);
+
+            CPPUNIT_ASSERT(internet_checksum::compute(data, 0) == 0xffff);
+        }
+
+        void testImplementations()
+        {
+            std::srand(1071);
+            const internet_checksum::implementation impls[] = {
+                internet_checksum::SCALAR,
+                internet_checksum::SSE2,
+                internet_checksum::AVX2
+            };
+            CPPUNIT_ASSERT(internet_checksum::supported(
+                               internet_checksum::best()));
+            std::vector<unsigned char> buffer = randomData(4096);
+            // Runs of 0xff make the widest carries.
+            std::memset(&buffer[2048], 0xff, 2048);
+            for(int i = 0; i < 2000; ++i) {
+                std::size_t offset = std::rand() % 32;
+                std::size_t len = std::rand() % 2048;
+                if(i % 4 == 0) {
+                    offset += 2048;
+                }
+                const unsigned char * data = &buffer[offset];
+                uint16_t expected = reference(data, len);
+                for(int j = 0; j < 3; ++j) {
+                    if(!internet_checksum::supported(impls[j])) {
+                        continue;
+                    }
+                    uint64_t sum = internet_checksum::sum(data, len, impls[j]);
+                    CPPUNIT_ASSERT(folded(sum) == expected);
+                }
+                CPPUNIT_ASSERT(internet_checksum::compute(data, len) ==
+                               expected);
+            }
+        }
+
+        void testIncremental()
+        {
+            std::srand(1624);
+            for(int i = 0; i < 500; ++i) {
+                std::size_t len = std::rand() % 1500;
+                std::vector<unsigned char> data = randomData(len + 1);
+                internet_checksum checksum;
+                std::size_t done = 0;
+                while(done < len) {
+                    std::size_t part = std::rand() % (len - done + 1);
+                    checksum.add(&data[done], part);
+                    done += part;
+                }
+                CPPUNIT_ASSERT(checksum.value() ==
+                               internet_checksum::compute(&data[0], len));
+            }
+
+            internet_checksum checksum;
+            checksum.add("abc", 3);
+            checksum.reset();
+            CPPUNIT_ASSERT(checksum.value() == 0xffff);
+        }
+
+        void testUpdate()
+        {
+            std::srand(1141);
+            for(int i = 0; i < 500; ++i) {
+                std::size_t len = 2 + 2 * (std::rand() % 700);
+                std::vector<unsigned char> data = randomData(len);
+                uint16_t checksum = internet_checksum::compute(&data[0], len);
+
+                // Change one word, as a router does to the TTL.
+                std::size_t word = 2 * (std::rand() % (len / 2));
+                uint16_t old_word, new_word;
+                std::memcpy(&old_word, &data[word], 2);
+                new_word = (i % 8 == 0) ? 0 : std::rand();
+                std::memcpy(&data[word], &new_word, 2);
+                checksum = internet_checksum::update(checksum, old_word,
+                                                     new_word);
+                CPPUNIT_ASSERT(checksum ==
+                               internet_checksum::compute(&data[0], len));
+
+                // Change a field of several words.
+                std::size_t field = 2 * (std::rand() % (len / 2));
+                std::size_t field_len = std::min<std::size_t>(
+                    len - field, 2 + std::rand() % 16);
+                std::vector<unsigned char> old_field(&data[field],
+                                                     &data[field] + field_len);
+                std::vector<unsigned char> new_field = randomData(field_len);
+                std::memcpy(&data[field], &new_field[0], field_len);
+                checksum = internet_checksum::update(checksum, &old_field[0],
+                                                     &new_field[0], field_len);
+                CPPUNIT_ASSERT(checksum ==
+                               internet_checksum::compute(&data[0], len));
+            }
+        }
+};
+
+#endif // SKCHECKSUMTEST_H
@@ -0,0 +1,185 @@
+// compress_streambuf test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+
+#ifndef SKCOMPRESSTEST_H
+#define SKCOMPRESSTEST_H
+
+#include <skstream/skcompress.h>
+#include <skstream/skstream_unix.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sstream>
+#include <string>
+
+class skcompresstest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skcompresstest);
+    CPPUNIT_TEST(testExchange);
+    CPPUNIT_TEST(testExchangeZstd);
+    CPPUNIT_TEST(testBadLevel);
+    CPPUNIT_TEST(testLarge);
+    CPPUNIT_TEST(testFinish);
+    CPPUNIT_TEST(testCorrupt);
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+        skcompresstest(std::string name) : TestCase(name) { }
+        skcompresstest() { }
+
+        void checkExchange(compress_streambuf::method m)
+        {
+            if(!compress_streambuf::supported(m)) {
+                return;
+            }
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+            compress_stream ca(a, m);
+            compress_stream cb(b, m);
+            CPPUNIT_ASSERT(ca.good());
+
+            // Each flush is readable at once, and later updates compress
+            // against earlier ones.
+            std::string word;
+            for(int i = 0; i < 100; ++i) {
+                ca << "entity position update " << i << std::endl;
+                int number = -1;
+                cb >> word >> word >> word >> number;
+                CPPUNIT_ASSERT(word == "update");
+                CPPUNIT_ASSERT(number == i);
+            }
+            CPPUNIT_ASSERT(ca.compressbuf().packedOut() <
+                           ca.compressbuf().plainOut());
+            CPPUNIT_ASSERT(cb.compressbuf().packedIn() ==
+                           ca.compressbuf().packedOut());
+
+            // The other direction works too.
+            cb << "reply " << std::flush;
+            ca >> word;
+            CPPUNIT_ASSERT(word == "reply");
+
+            // Flushing with nothing written sends nothing.
+            unsigned long long sent = ca.compressbuf().packedOut();
+            ca << std::flush;
+            CPPUNIT_ASSERT(ca.compressbuf().packedOut() == sent);
+        }
+
+        void testExchange()
+        {
+            checkExchange(compress_streambuf::ZLIB);
+        }
+
+        void testExchangeZstd()
+        {
+            if(!compress_streambuf::supported(compress_streambuf::ZSTD)) {
+                // Built without zstd, so a buffer asking for it fails.
+                std::stringstream packed;
+                compress_streambuf out(*packed.rdbuf(),
+                                       compress_streambuf::ZSTD);
+                CPPUNIT_ASSERT(!out.good());
+                return;
+            }
+            checkExchange(compress_streambuf::ZSTD);
+        }
+
+        void testBadLevel()
+        {
+            if(!compress_streambuf::supported(compress_streambuf::ZLIB)) {
+                return;
+            }
+            // zlib refuses the level, and the half set up codec is freed.
+            std::stringstream packed;
+            compress_streambuf out(*packed.rdbuf(), compress_streambuf::ZLIB,
+                                   42);
+            CPPUNIT_ASSERT(!out.good());
+        }
+
+        void testLarge()
+        {
+            if(!compress_streambuf::supported(compress_streambuf::ZLIB)) {
+                return;
+            }
+            // A buffer which is not a socketbuf is read through a copy.
+            std::stringstream packed;
+            std::string text;
+            for(int i = 0; i < 20000; ++i) {
+                text += "line " + std::to_string(i * 7919 % 10007) + '\n';
+            }
+            {
+                compress_streambuf out(*packed.rdbuf());
+                CPPUNIT_ASSERT(out.sputn(text.data(), text.size()) ==
+                               (std::streamsize)text.size());
+                CPPUNIT_ASSERT(out.finish() == 0);
+                CPPUNIT_ASSERT(out.plainOut() == text.size());
+            }
+            compress_streambuf in(*packed.rdbuf());
+            std::istream reader(&in);
+            std::string result((std::istreambuf_iterator<char>(reader)),
+                               std::istreambuf_iterator<char>());
+            CPPUNIT_ASSERT(result == text);
+            CPPUNIT_ASSERT(in.good());
+        }
+
+        void testFinish()
+        {
+            if(!compress_streambuf::supported(compress_streambuf::ZLIB)) {
+                return;
+            }
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+            compress_stream ca(a);
+            compress_stream cb(b);
+
+            ca << "last";
+            CPPUNIT_ASSERT(ca.finish() == 0);
+            ca << "more" << std::flush;
+            CPPUNIT_ASSERT(ca.fail());
+
+            // The end of the compressed data is end of file, though the
+            // socket is still open.
+            std::string word;
+            cb >> word;
+            CPPUNIT_ASSERT(word == "last");
+            CPPUNIT_ASSERT(cb.eof());
+            CPPUNIT_ASSERT(b.is_open());
+        }
+
+        void testCorrupt()
+        {
+            if(!compress_streambuf::supported(compress_streambuf::ZLIB)) {
+                return;
+            }
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+            compress_stream cb(b);
+
+            a << "not compressed at all" << std::flush;
+            std::string word;
+            cb >> word;
+            CPPUNIT_ASSERT(cb.fail());
+            CPPUNIT_ASSERT(!cb.compressbuf().good());
+        }
+};
+
+#endif // SKCOMPRESSTEST_H
@@ -0,0 +1,273 @@
+// coroutine layer test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+#ifndef SKCOROTEST_H
+#define SKCOROTEST_H
+
+#include <skstream/skcoro.h>
+#include <skstream/skstream_unix.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory>
+#include <vector>
+
+class skcorotest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skcorotest);
+    CPPUNIT_TEST(testSleep);
+    CPPUNIT_TEST(testEcho);
+    CPPUNIT_TEST(testManySessions);
+    CPPUNIT_TEST(testConnectRefused);
+    CPPUNIT_TEST(testRemoveWhileWaiting);
+    CPPUNIT_TEST(testReadEnd);
+    CPPUNIT_TEST(testDestroyWhileWaiting);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        socket_reactor *reactor;
+        tcp_socket_server *server;
+        int port;
+
+        // Echo everything back until the client closes.
+        static socket_task<> echo(socket_reactor & r, SOCKET_TYPE s)
+        {
+            tcp_socket_stream stream(s);
+            char buf[256];
+            for (;;) {
+                std::streamsize len = co_await async_read_some(r, stream, buf,
+                                                               sizeof(buf));
+                if (len <= 0) {
+                    break;
+                }
+                std::streamsize sent = co_await async_write(r, stream, buf,
+                                                            len);
+                if (sent != len) {
+                    break;
+                }
+            }
+        }
+
+        static socket_task<> serve(socket_reactor & r,
+                                   tcp_socket_server & server, int count)
+        {
+            for (int i = 0; i < count; ++i) {
+                SOCKET_TYPE s = co_await async_accept(r, server);
+                if (s == INVALID_SOCKET) {
+                    break;
+                }
+                spawn(echo(r, s));
+            }
+        }
+
+        static socket_task<> client(socket_reactor & r, int port,
+                                    std::string message, int & done)
+        {
+            tcp_socket_stream stream;
+            int result = co_await async_connect(r, stream, "localhost", port);
+            if (result != 0) {
+                co_return;
+            }
+            co_await async_write(r, stream, message);
+            std::string reply;
+            char buf[256];
+            while (reply.size() < message.size()) {
+                std::streamsize len = co_await async_read_some(r, stream, buf,
+                                                               sizeof(buf));
+                if (len <= 0) {
+                    co_return;
+                }
+                reply.append(buf, len);
+            }
+            if (reply == message) {
+                ++done;
+            }
+        }
+
+        void run(const int & done, int target)
+        {
+            for (int i = 0; i < 1000 && done < target; ++i) {
+                reactor->poll(100);
+            }
+        }
+
+    public:
+        skcorotest(std::string name) : TestCase(name) { }
+        skcorotest() { }
+
+        void testSleep()
+        {
+            std::vector<int> order;
+            auto sleeper = [this, &order](int ms) -> socket_task<> {
+                co_await async_sleep(*reactor, ms);
+                order.push_back(ms);
+            };
+            spawn(sleeper(30));
+            spawn(sleeper(10));
+            spawn(sleeper(20));
+            for (int i = 0; i < 100 && order.size() < 3; ++i) {
+                reactor->poll(50);
+            }
+            CPPUNIT_ASSERT(order.size() == 3);
+            CPPUNIT_ASSERT(order[0] == 10 && order[1] == 20 && order[2] == 30);
+        }
+
+        void testEcho()
+        {
+            int done = 0;
+            spawn(serve(*reactor, *server, 1));
+            spawn(client(*reactor, port, "hello world", done));
+            run(done, 1);
+            CPPUNIT_ASSERT(done == 1);
+        }
+
+        void testManySessions()
+        {
+            // Sessions overlap, all on this one thread. The listen backlog
+            // is small, so only one client is started each poll.
+            const int sessions = 200;
+            int done = 0;
+            spawn(serve(*reactor, *server, sessions));
+            for (int i = 0; i < sessions; ++i) {
+                spawn(client(*reactor, port,
+                             "session " + std::to_string(i), done));
+                reactor->poll(0);
+            }
+            run(done, sessions);
+            CPPUNIT_ASSERT(done == sessions);
+        }
+
+        void testConnectRefused()
+        {
+            server->close();
+            int result = 1;
+            auto connect = [this, &result]() -> socket_task<> {
+                tcp_socket_stream stream;
+                result = co_await async_connect(*reactor, stream,
+                                                "localhost", port);
+            };
+            spawn(connect());
+            for (int i = 0; i < 50 && result == 1; ++i) {
+                reactor->poll(100);
+            }
+            CPPUNIT_ASSERT(result == -1);
+        }
+
+        void testRemoveWhileWaiting()
+        {
+            SOCKET_TYPE accepted = 0;
+            auto accept = [this, &accepted]() -> socket_task<> {
+                accepted = co_await async_accept(*reactor, *server);
+            };
+            spawn(accept());
+            reactor->poll(0);
+            CPPUNIT_ASSERT(accepted == 0);
+
+            // The waiting coroutine is resumed as having failed.
+            reactor->remove(server);
+            CPPUNIT_ASSERT(accepted == INVALID_SOCKET);
+
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+            std::streamsize result = 1;
+            auto read = [this, &b, &result]() -> socket_task<> {
+                char buf[16];
+                result = co_await async_read_some(*reactor, b, buf,
+                                                  sizeof(buf));
+            };
+            spawn(read());
+            reactor->poll(0);
+            CPPUNIT_ASSERT(result == 1);
+            reactor->remove(&b);
+            CPPUNIT_ASSERT(result == -1);
+        }
+
+        void testDestroyWhileWaiting()
+        {
+            socket_reactor * local = new socket_reactor;
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+            std::streamsize result = 1;
+            bool slept = true, finished = false;
+            auto wait = [&]() -> socket_task<> {
+                char buf[16];
+                result = co_await async_read_some(*local, b, buf,
+                                                  sizeof(buf));
+                // Nothing can wait once the reactor is going.
+                slept = co_await async_sleep(*local, 10);
+                finished = true;
+            };
+            bool timer_slept = true;
+            auto sleep = [&]() -> socket_task<> {
+                timer_slept = co_await async_sleep(*local, 60000);
+            };
+            spawn(wait());
+            spawn(sleep());
+            local->poll(0);
+            CPPUNIT_ASSERT(result == 1);
+
+            // Both coroutines are resumed as having failed, and finish.
+            delete local;
+            CPPUNIT_ASSERT(result == -1);
+            CPPUNIT_ASSERT(!slept);
+            CPPUNIT_ASSERT(finished);
+            CPPUNIT_ASSERT(!timer_slept);
+        }
+
+        void testReadEnd()
+        {
+            unix_socket_stream a;
+            unix_socket_stream b(a);
+            std::streamsize result = 1;
+            auto read = [this, &b, &result]() -> socket_task<> {
+                char buf[16];
+                result = co_await async_read_some(*reactor, b, buf,
+                                                  sizeof(buf));
+            };
+            spawn(read());
+            reactor->poll(0);
+            a.close();
+            for (int i = 0; i < 10 && result == 1; ++i) {
+                reactor->poll(100);
+            }
+            // End of file is 0, not an error.
+            CPPUNIT_ASSERT(result == 0);
+        }
+
+        void setUp()
+        {
+            reactor = new socket_reactor;
+            server = new tcp_socket_server;
+            server->open(0);
+
+            port = server->getLocalPort();
+        }
+
+        void tearDown()
+        {
+            delete server;
+            delete reactor;
+        }
+};
+
+#endif
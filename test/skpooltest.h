@@ -0,0 +1,320 @@
+// tcp_connection_pool test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+
+#ifndef SKPOOLTEST_H
+#define SKPOOLTEST_H
+
+#include <skstream/skpool.h>
+#include <skstream/skserver.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+class skpooltest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skpooltest);
+    CPPUNIT_TEST(testReuse);
+    CPPUNIT_TEST(testPeerClosed);
+    CPPUNIT_TEST(testLimit);
+    CPPUNIT_TEST(testReap);
+    CPPUNIT_TEST(testPrewarm);
+    CPPUNIT_TEST(testConnectTimeout);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        tcp_socket_server * listener;
+        int port;
+        std::thread * acceptor;
+        std::vector<std::thread> handlers;
+        std::atomic<int> accepted;
+        std::atomic<bool> stopping;
+        /// Close each connection after this many lines, or never if 0.
+        int lines_per_connection;
+
+        // Echo lines back on each connection until the client closes.
+        void serve()
+        {
+            for(;;) {
+                SOCKET_TYPE sock = listener->accept();
+                if(sock == INVALID_SOCKET || stopping) {
+                    if(sock != INVALID_SOCKET) {
+                        ::close(sock);
+                    }
+                    return;
+                }
+                ++accepted;
+                int lines = lines_per_connection;
+                handlers.push_back(std::thread([sock, lines]() {
+                    tcp_socket_stream peer(sock);
+                    std::string line;
+                    for(int i = 0; peer.readLine(line); ++i) {
+                        peer << line << std::endl;
+                        if(i + 1 == lines) {
+                            break;
+                        }
+                    }
+                }));
+            }
+        }
+
+        // Connections may be counted a little after the client sees them.
+        bool waitAccepted(int count)
+        {
+            for(int i = 0; i < 100 && accepted < count; ++i) {
+                ::usleep(10000);
+            }
+            return accepted == count;
+        }
+
+        bool call(tcp_socket_stream & stream, const std::string & request)
+        {
+            stream << request << std::endl;
+            std::string reply;
+            return stream.readLine(reply) && reply == request;
+        }
+
+    public:
+        skpooltest(std::string name) : TestCase(name) { }
+        skpooltest() { }
+
+        void testReuse()
+        {
+            tcp_connection_pool pool;
+            tcp_socket_stream * first = pool.acquire("localhost", port);
+            CPPUNIT_ASSERT(first != 0);
+            CPPUNIT_ASSERT(call(*first, "one"));
+            CPPUNIT_ASSERT(pool.active("localhost", port) == 1);
+            pool.release(first);
+            CPPUNIT_ASSERT(pool.active("localhost", port) == 0);
+            CPPUNIT_ASSERT(pool.idle("localhost", port) == 1);
+
+            tcp_socket_stream * second = pool.acquire("localhost", port);
+            CPPUNIT_ASSERT(second == first);
+            CPPUNIT_ASSERT(call(*second, "two"));
+
+            // A stream in use is not handed out again.
+            tcp_socket_stream * third = pool.acquire("localhost", port);
+            CPPUNIT_ASSERT(third != 0);
+            CPPUNIT_ASSERT(third != second);
+            CPPUNIT_ASSERT(waitAccepted(2));
+
+            // A stream given back as unusable is closed.
+            pool.release(third, false);
+            pool.release(second);
+            CPPUNIT_ASSERT(pool.idle("localhost", port) == 1);
+        }
+
+        void testPeerClosed()
+        {
+            lines_per_connection = 1;
+            tcp_connection_pool pool;
+            tcp_socket_stream * stream = pool.acquire("localhost", port);
+            CPPUNIT_ASSERT(stream != 0);
+            CPPUNIT_ASSERT(call(*stream, "only"));
+            pool.release(stream);
+
+            // Wait for the server's close to arrive.
+            for(int i = 0; i < 100 && pool.reap() == 0; ++i) {
+                ::usleep(10000);
+            }
+            CPPUNIT_ASSERT(pool.idle("localhost", port) == 0);
+
+            // Unread data also makes a stream unfit for reuse.
+            lines_per_connection = 0;
+            stream = pool.acquire("localhost", port);
+            CPPUNIT_ASSERT(stream != 0);
+            *stream << "unread" << std::endl;
+            pollfd reply = { stream->getSocket(), POLLIN, 0 };
+            CPPUNIT_ASSERT(::poll(&reply, 1, 1000) == 1);
+            CPPUNIT_ASSERT(!tcp_connection_pool::isAlive(*stream));
+            pool.release(stream);
+            tcp_socket_stream * fresh = pool.acquire("localhost", port);
+            CPPUNIT_ASSERT(fresh != 0);
+            CPPUNIT_ASSERT(call(*fresh, "clean"));
+            CPPUNIT_ASSERT(waitAccepted(3));
+            pool.release(fresh);
+        }
+
+        void testLimit()
+        {
+            tcp_connection_pool pool(1);
+            tcp_socket_stream * first = pool.acquire("localhost", port);
+            CPPUNIT_ASSERT(first != 0);
+            CPPUNIT_ASSERT(pool.acquire("localhost", port) == 0);
+            CPPUNIT_ASSERT(pool.getLastError() == ETIMEDOUT);
+
+            // The error is only seen by the thread which got it.
+            int other_error = -1;
+            std::thread([&pool, &other_error]() {
+                other_error = pool.getLastError();
+            }).join();
+            CPPUNIT_ASSERT(other_error == 0);
+
+            // Nor by another pool on the same thread.
+            tcp_connection_pool other_pool;
+            CPPUNIT_ASSERT(other_pool.getLastError() == 0);
+
+            // A waiting caller gets the stream once it is released.
+            std::thread user([&pool, first]() {
+                ::usleep(50000);
+                pool.release(first);
+            });
+            tcp_socket_stream * second = pool.acquire("localhost", port, 5000);
+            user.join();
+            CPPUNIT_ASSERT(second == first);
+            CPPUNIT_ASSERT(call(*second, "waited"));
+            pool.release(second);
+            CPPUNIT_ASSERT(waitAccepted(1));
+        }
+
+        void testReap()
+        {
+            tcp_connection_pool pool(8, 50);
+            tcp_socket_stream * streams[3];
+            for(int i = 0; i < 3; ++i) {
+                streams[i] = pool.acquire("localhost", port);
+                CPPUNIT_ASSERT(streams[i] != 0);
+            }
+            for(int i = 0; i < 3; ++i) {
+                pool.release(streams[i]);
+            }
+            CPPUNIT_ASSERT(pool.reap() == 0);
+            CPPUNIT_ASSERT(pool.idle("localhost", port) == 3);
+            ::usleep(100000);
+            CPPUNIT_ASSERT(pool.reap() == 3);
+            CPPUNIT_ASSERT(pool.idle("localhost", port) == 0);
+        }
+
+        void testPrewarm()
+        {
+            tcp_connection_pool pool(8, 50);
+            CPPUNIT_ASSERT(pool.start() == 0);
+            CPPUNIT_ASSERT(pool.prewarm("localhost", port, 2) == 0);
+            for(int i = 0; i < 100 && pool.idle("localhost", port) < 2; ++i) {
+                ::usleep(10000);
+            }
+            CPPUNIT_ASSERT(pool.idle("localhost", port) == 2);
+            CPPUNIT_ASSERT(waitAccepted(2));
+
+            // Streams beyond the prewarmed ones are reaped by the thread.
+            tcp_socket_stream * streams[3];
+            for(int i = 0; i < 3; ++i) {
+                streams[i] = pool.acquire("localhost", port);
+                CPPUNIT_ASSERT(streams[i] != 0);
+            }
+            CPPUNIT_ASSERT(waitAccepted(3));
+            for(int i = 0; i < 3; ++i) {
+                pool.release(streams[i]);
+            }
+            for(int i = 0; i < 100 && pool.idle("localhost", port) > 2; ++i) {
+                ::usleep(10000);
+            }
+            CPPUNIT_ASSERT(pool.idle("localhost", port) == 2);
+            pool.stop();
+
+            CPPUNIT_ASSERT(pool.prewarm("no.such.host.invalid", port, 1) == -1);
+        }
+
+        void testConnectTimeout()
+        {
+            // A listener whose queue is full drops further connection
+            // attempts, so they neither succeed nor fail.
+            SOCKET_TYPE full = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            CPPUNIT_ASSERT(::bind(full, (sockaddr*)&addr, sizeof(addr)) == 0);
+            CPPUNIT_ASSERT(::listen(full, 0) == 0);
+            SOCKLEN addr_len = sizeof(addr);
+            ::getsockname(full, (sockaddr*)&addr, &addr_len);
+            int full_port = ntohs(addr.sin_port);
+            SOCKET_TYPE queued = ::socket(AF_INET, SOCK_STREAM, 0);
+            CPPUNIT_ASSERT(::connect(queued, (sockaddr*)&addr,
+                                     sizeof(addr)) == 0);
+
+            using std::chrono::steady_clock;
+            tcp_connection_pool pool;
+            pool.setConnectTimeout(200);
+            steady_clock::time_point begin = steady_clock::now();
+            CPPUNIT_ASSERT(pool.acquire("127.0.0.1", full_port) == 0);
+            CPPUNIT_ASSERT(pool.getLastError() == ETIMEDOUT);
+            CPPUNIT_ASSERT(steady_clock::now() - begin <
+                           std::chrono::seconds(2));
+
+            // Stopping the thread gives up on a connect in progress.
+            pool.setConnectTimeout(60000);
+            CPPUNIT_ASSERT(pool.start() == 0);
+            CPPUNIT_ASSERT(pool.prewarm("127.0.0.1", full_port, 1) == 0);
+            ::usleep(50000);
+            begin = steady_clock::now();
+            pool.stop();
+            CPPUNIT_ASSERT(steady_clock::now() - begin <
+                           std::chrono::seconds(2));
+
+            ::close(queued);
+            ::close(full);
+        }
+
+        void setUp()
+        {
+            listener = new tcp_socket_server;
+            CPPUNIT_ASSERT(listener->open(0) == 0);
+
+            port = listener->getLocalPort();
+
+            accepted = 0;
+            stopping = false;
+            lines_per_connection = 0;
+            acceptor = new std::thread(&skpooltest::serve, this);
+        }
+
+        void tearDown()
+        {
+            // Wake the acceptor with one last connection.
+            stopping = true;
+            {
+                tcp_socket_stream last("localhost", port);
+            }
+            acceptor->join();
+            delete acceptor;
+            for(std::size_t i = 0; i < handlers.size(); ++i) {
+                handlers[i].join();
+            }
+            handlers.clear();
+            delete listener;
+        }
+};
+
+#endif // SKPOOLTEST_H
@@ -0,0 +1,345 @@
+// socket_reactor test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+#ifndef SKREACTORTEST_H
+#define SKREACTORTEST_H
+
+#include <skstream/skreactor.h>
+#include <skstream/sksendqueue.h>
+#include <skstream/skserver.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <chrono>
+#include <thread>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+class skreactortest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skreactortest);
+    CPPUNIT_TEST(testReadDispatch);
+    CPPUNIT_TEST(testRemoveInHandler);
+    CPPUNIT_TEST(testTimer);
+    CPPUNIT_TEST(testIdleTimeout);
+    CPPUNIT_TEST(testPost);
+    CPPUNIT_TEST(testSendQueue);
+    CPPUNIT_TEST(testBufferedStream);
+    CPPUNIT_TEST(testRemoveBufferedStream);
+    CPPUNIT_TEST(testAcceptor);
+    CPPUNIT_TEST(testSelectFallback);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        socket_reactor *reactor;
+        int fds1[2];
+        int fds2[2];
+
+    public:
+        skreactortest(std::string name) : TestCase(name) { }
+        skreactortest() { }
+
+        void testReadDispatch()
+        {
+            tcp_socket_stream one(fds1[0]), two(fds2[0]);
+            int calls1 = 0, calls2 = 0;
+
+            CPPUNIT_ASSERT(reactor->add(&one, basic_socket_poll::READ,
+                [&calls1](basic_socket_poll::poll_type t) {
+                    if (t & basic_socket_poll::READ) { ++calls1; }
+                }) == 0);
+            CPPUNIT_ASSERT(reactor->add(&two, basic_socket_poll::READ,
+                [&calls2](basic_socket_poll::poll_type) { ++calls2; }) == 0);
+            CPPUNIT_ASSERT(reactor->size() == 2);
+
+            CPPUNIT_ASSERT(reactor->poll(0) == 0);
+
+            CPPUNIT_ASSERT(::write(fds1[1], "x", 1) == 1);
+            CPPUNIT_ASSERT(reactor->poll(100) == 1);
+            CPPUNIT_ASSERT(calls1 == 1);
+            CPPUNIT_ASSERT(calls2 == 0);
+
+            reactor->remove(&one);
+            reactor->remove(&two);
+            CPPUNIT_ASSERT(reactor->size() == 0);
+            CPPUNIT_ASSERT(reactor->poll(0) == 0);
+            fds1[0] = fds2[0] = -1;
+        }
+
+        void testRemoveInHandler()
+        {
+            tcp_socket_stream one(fds1[0]), two(fds2[0]);
+            int calls = 0;
+
+            // Whichever runs first removes both, so only one is called.
+            socket_reactor::handler h =
+                [&](basic_socket_poll::poll_type) {
+                    ++calls;
+                    reactor->remove(&one);
+                    reactor->remove(&two);
+                };
+            reactor->add(&one, basic_socket_poll::READ, h);
+            reactor->add(&two, basic_socket_poll::READ, h);
+
+            CPPUNIT_ASSERT(::write(fds1[1], "x", 1) == 1);
+            CPPUNIT_ASSERT(::write(fds2[1], "x", 1) == 1);
+            reactor->poll(100);
+            CPPUNIT_ASSERT(calls == 1);
+            CPPUNIT_ASSERT(reactor->size() == 0);
+            fds1[0] = fds2[0] = -1;
+        }
+
+        void testTimer()
+        {
+            int fired = 0;
+            reactor->addTimer(10, [&fired]() { ++fired; });
+            socket_reactor::timer_id cancelled =
+                reactor->addTimer(10, [&fired]() { fired += 100; });
+            reactor->cancelTimer(cancelled);
+
+            for (int i = 0; i < 100 && fired == 0; ++i) {
+                reactor->poll(50);
+            }
+            CPPUNIT_ASSERT(fired == 1);
+        }
+
+        void testIdleTimeout()
+        {
+            tcp_socket_stream one(fds1[0]);
+            int events = 0, idle = 0;
+
+            reactor->add(&one, basic_socket_poll::READ,
+                [&](basic_socket_poll::poll_type) {
+                    char c;
+                    ::read(fds1[0], &c, 1);
+                    ++events;
+                });
+            CPPUNIT_ASSERT(reactor->setIdleTimeout(&one, 50,
+                [&]() { ++idle; reactor->remove(&one); }) == 0);
+
+            // Activity keeps the socket alive
+            for (int i = 0; i < 4; ++i) {
+                CPPUNIT_ASSERT(::write(fds1[1], "x", 1) == 1);
+                reactor->poll(100);
+                CPPUNIT_ASSERT(idle == 0);
+            }
+            CPPUNIT_ASSERT(events == 4);
+
+            for (int i = 0; i < 100 && idle == 0; ++i) {
+                reactor->poll(100);
+            }
+            CPPUNIT_ASSERT(idle == 1);
+            CPPUNIT_ASSERT(reactor->size() == 0);
+            fds1[0] = -1;
+        }
+
+        void testPost()
+        {
+            int ran = 0;
+            std::thread poster([this, &ran]() {
+                reactor->post([&ran]() { ++ran; });
+            });
+
+            // The post wakes the reactor well before the timeout
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            for (int i = 0; i < 10 && ran == 0; ++i) {
+                reactor->poll(5000);
+            }
+            poster.join();
+            CPPUNIT_ASSERT(ran == 1);
+            CPPUNIT_ASSERT(std::chrono::steady_clock::now() - start <
+                           std::chrono::seconds(4));
+        }
+
+        void testSendQueue()
+        {
+            const int producers = 4, messages = 2000;
+            tcp_socket_stream stream(fds1[0]);
+            stream.setNonBlocking(true);
+            reactor->addStream(&stream, 0, [](basic_socket_poll::poll_type) { });
+            stream_send_queue queue(stream, *reactor);
+
+            std::vector<std::thread> threads;
+            for (int p = 0; p < producers; ++p) {
+                threads.push_back(std::thread([&queue, p]() {
+                    for (int i = 0; i < messages; ++i) {
+                        queue.send(std::to_string(p) + " " +
+                                   std::to_string(i) + "\n");
+                    }
+                }));
+            }
+
+            // Read everything back on another thread while the reactor runs
+            std::atomic<bool> done(false);
+            int errors = 0, received = 0;
+            std::thread reader([&]() {
+                tcp_socket_stream in(fds1[1]);
+                std::vector<int> last(producers, -1);
+                int p, i;
+                while (received < producers * messages && in >> p >> i) {
+                    if (p < 0 || p >= producers || i != last[p] + 1) {
+                        ++errors;
+                    } else {
+                        last[p] = i;
+                    }
+                    ++received;
+                }
+                done = true;
+            });
+            for (int i = 0; i < 1000 && !done; ++i) {
+                reactor->poll(10);
+            }
+            for (std::size_t p = 0; p < threads.size(); ++p) {
+                threads[p].join();
+            }
+            reader.join();
+            CPPUNIT_ASSERT(received == producers * messages);
+            CPPUNIT_ASSERT(errors == 0);
+            reactor->remove(&stream);
+            fds1[0] = fds1[1] = -1;
+        }
+
+        void testBufferedStream()
+        {
+            tcp_socket_stream stream(fds1[0]);
+            std::vector<std::string> lines;
+
+            reactor->addStream(&stream, basic_socket_poll::READ,
+                [&](basic_socket_poll::poll_type) {
+                    std::string line;
+                    // Read only one line per call
+                    if (stream.readLine(line)) {
+                        lines.push_back(line);
+                    }
+                });
+
+            // Both lines arrive in one read, but each should still be
+            // delivered even though the socket is no longer readable.
+            CPPUNIT_ASSERT(::write(fds1[1], "one\ntwo\n", 8) == 8);
+            for (int i = 0; i < 10 && lines.size() < 2; ++i) {
+                reactor->poll(100);
+            }
+            CPPUNIT_ASSERT(lines.size() == 2);
+            CPPUNIT_ASSERT(lines[1] == "two");
+            reactor->remove(&stream);
+            fds1[0] = -1;
+        }
+
+        void testRemoveBufferedStream()
+        {
+            tcp_socket_stream stream(fds1[0]);
+            int calls = 0;
+
+            reactor->addStream(&stream, basic_socket_poll::READ,
+                [&](basic_socket_poll::poll_type) {
+                    ++calls;
+                    std::string line;
+                    stream.readLine(line);
+                    // The second line is still buffered, so this queues
+                    // the stream for the next poll, which must not see
+                    // it once it has been removed.
+                    reactor->modify(&stream, basic_socket_poll::READ);
+                    reactor->refresh(&stream);
+                    reactor->remove(&stream);
+                });
+
+            CPPUNIT_ASSERT(::write(fds1[1], "one\ntwo\n", 8) == 8);
+            for (int i = 0; i < 10 && calls == 0; ++i) {
+                reactor->poll(100);
+            }
+            CPPUNIT_ASSERT(calls == 1);
+            CPPUNIT_ASSERT(reactor->size() == 0);
+            CPPUNIT_ASSERT(reactor->poll(0) == 0);
+            CPPUNIT_ASSERT(calls == 1);
+            fds1[0] = -1;
+        }
+
+        void testAcceptor()
+        {
+            tcp_socket_server server;
+            CPPUNIT_ASSERT(server.open(0) == 0);
+
+            int port = server.getLocalPort();
+
+            SOCKET_TYPE accepted = INVALID_SOCKET;
+            reactor->addAcceptor(&server, [&accepted](SOCKET_TYPE s) {
+                accepted = s;
+            });
+
+            tcp_socket_stream client("localhost", port);
+            CPPUNIT_ASSERT(client.is_open());
+            for (int i = 0; i < 10 && accepted == INVALID_SOCKET; ++i) {
+                reactor->poll(100);
+            }
+            CPPUNIT_ASSERT(accepted != INVALID_SOCKET);
+            ::close(accepted);
+        }
+
+        void testSelectFallback()
+        {
+            // No descriptors are left, so epoll can't be set up.
+            struct rlimit saved, limit;
+            CPPUNIT_ASSERT(::getrlimit(RLIMIT_NOFILE, &saved) == 0);
+            int next = ::dup(0);
+            ::close(next);
+            limit = saved;
+            limit.rlim_cur = next;
+            CPPUNIT_ASSERT(::setrlimit(RLIMIT_NOFILE, &limit) == 0);
+            socket_reactor * fallback = new socket_reactor;
+            CPPUNIT_ASSERT(::setrlimit(RLIMIT_NOFILE, &saved) == 0);
+            CPPUNIT_ASSERT(!fallback->usingEpoll());
+
+            tcp_socket_stream one(fds1[0]);
+            int calls = 0;
+            CPPUNIT_ASSERT(fallback->add(&one, basic_socket_poll::READ,
+                [&calls](basic_socket_poll::poll_type) { ++calls; }) == 0);
+            CPPUNIT_ASSERT(::write(fds1[1], "x", 1) == 1);
+            CPPUNIT_ASSERT(fallback->poll(100) == 1);
+            CPPUNIT_ASSERT(calls == 1);
+            fallback->remove(&one);
+            delete fallback;
+            fds1[0] = -1;
+        }
+
+        void setUp()
+        {
+            reactor = new socket_reactor;
+            ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds1);
+            ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds2);
+        }
+
+        void tearDown()
+        {
+            delete reactor;
+            // Streams took ownership of any descriptor set to -1
+            for (int i = 0; i < 2; ++i) {
+                if (fds1[i] != -1) ::close(fds1[i]);
+                if (fds2[i] != -1) ::close(fds2[i]);
+            }
+        }
+
+};
+
+#endif
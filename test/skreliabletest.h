@@ -0,0 +1,301 @@
+// reliable_channel test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+
+#ifndef SKRELIABLETEST_H
+#define SKRELIABLETEST_H
+
+#include <skstream/skreliable.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+
+class skreliabletest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skreliabletest);
+    CPPUNIT_TEST(testExchange);
+    CPPUNIT_TEST(testLoss);
+    CPPUNIT_TEST(testUnordered);
+    CPPUNIT_TEST(testUnreliable);
+    CPPUNIT_TEST(testCongestion);
+    CPPUNIT_TEST(testMalformed);
+    CPPUNIT_TEST(testBuffered);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        udp_socket_stream * _a;
+        udp_socket_stream * _b;
+
+        // Drops a fraction of packets, the same ones on every run.
+        struct loss {
+            unsigned seed;
+            unsigned percent;
+            unsigned dropped;
+
+            loss(unsigned p) : seed(1), percent(p), dropped(0) { }
+
+            bool operator()(const char *, std::size_t) {
+                seed = seed * 1103515245 + 12345;
+                if ((seed >> 16) % 100 < percent) {
+                    ++dropped;
+                    return true;
+                }
+                return false;
+            }
+        };
+
+        // Run both ends for a number of milliseconds.
+        static void pump(reliable_channel & a, reliable_channel & b,
+                         reliable_channel::tick_type & now, int ticks)
+        {
+            for (int i = 0; i < ticks; ++i, ++now) {
+                a.update(now);
+                b.receive(now);
+                b.update(now);
+                a.receive(now);
+            }
+        }
+
+        // Message number i, with some padding so sizes vary.
+        static std::string messageFor(int i)
+        {
+            char text[16];
+            snprintf(text, sizeof(text), "%d:", i);
+            return std::string(text) + std::string(i % 300, 'x');
+        }
+
+    public:
+        skreliabletest(std::string name) : TestCase(name) { }
+        skreliabletest() { }
+
+        void testExchange()
+        {
+            reliable_channel a(*_a), b(*_b);
+            std::vector<std::string> received;
+            b.setMessageHandler([&](unsigned channel, const char * data,
+                                    std::size_t size) {
+                CPPUNIT_ASSERT(channel == 3);
+                received.push_back(std::string(data, size));
+            });
+            for (int i = 0; i < 100; ++i) {
+                CPPUNIT_ASSERT(a.send(3, messageFor(i)) == 0);
+            }
+            reliable_channel::tick_type now = 0;
+            pump(a, b, now, 100);
+
+            CPPUNIT_ASSERT(received.size() == 100);
+            bool ordered = true;
+            for (int i = 0; i < 100; ++i) {
+                ordered = ordered && received[i] == messageFor(i);
+            }
+            CPPUNIT_ASSERT(ordered);
+            CPPUNIT_ASSERT(a.pending() == 0);
+            CPPUNIT_ASSERT(a.inFlight() == 0);
+            CPPUNIT_ASSERT(a.getLost() == 0);
+            CPPUNIT_ASSERT(a.getWindow() > 10);
+        }
+
+        void testLoss()
+        {
+            reliable_channel a(*_a), b(*_b);
+            loss a_loss(20), b_loss(20);
+            a.setLossModel(std::ref(a_loss));
+            b.setLossModel(std::ref(b_loss));
+            std::vector<std::string> received;
+            b.setMessageHandler([&](unsigned, const char * data,
+                                    std::size_t size) {
+                received.push_back(std::string(data, size));
+            });
+            const int count = 500;
+            reliable_channel::tick_type now = 0;
+            for (int i = 0; i < count; ++i) {
+                a.send(0, messageFor(i));
+                pump(a, b, now, 1);
+            }
+            pump(a, b, now, 5000);
+
+            // Everything arrives once, in order, despite both data and
+            // acknowledgements being lost.
+            CPPUNIT_ASSERT(received.size() == (std::size_t)count);
+            bool ordered = true;
+            for (int i = 0; i < count; ++i) {
+                ordered = ordered && received[i] == messageFor(i);
+            }
+            CPPUNIT_ASSERT(ordered);
+            CPPUNIT_ASSERT(a_loss.dropped > 0 && b_loss.dropped > 0);
+            CPPUNIT_ASSERT(a.getLost() > 0);
+            CPPUNIT_ASSERT(a.getRetransmitted() > 0);
+            CPPUNIT_ASSERT(a.pending() == 0);
+        }
+
+        void testUnordered()
+        {
+            reliable_channel a(*_a), b(*_b);
+            a.setMode(1, reliable_channel::RELIABLE);
+            int packets = 0;
+            // Lose the first packet only.
+            a.setLossModel([&](const char *, std::size_t) {
+                return packets++ == 0;
+            });
+            std::vector<std::string> received;
+            b.setMessageHandler([&](unsigned channel, const char * data,
+                                    std::size_t size) {
+                received.push_back(std::string(1, '0' + channel) +
+                                   std::string(data, size));
+            });
+
+            reliable_channel::tick_type now = 0;
+            a.send(0, "a");
+            a.send(1, "x");
+            a.update(now);
+            a.send(0, "b");
+            a.send(1, "y");
+            pump(a, b, now, 500);
+
+            // The reliable channel doesn't wait for the lost message, and
+            // the ordered one does.
+            CPPUNIT_ASSERT(received.size() == 4);
+            CPPUNIT_ASSERT(received[0] == "1y");
+            std::size_t a_at = std::find(received.begin(), received.end(),
+                                         "0a") - received.begin();
+            std::size_t b_at = std::find(received.begin(), received.end(),
+                                         "0b") - received.begin();
+            CPPUNIT_ASSERT(a_at < b_at && b_at < received.size());
+            CPPUNIT_ASSERT(std::find(received.begin(), received.end(),
+                                     "1x") != received.end());
+        }
+
+        void testUnreliable()
+        {
+            reliable_channel a(*_a), b(*_b);
+            a.setMode(2, reliable_channel::UNRELIABLE);
+            int packets = 0;
+            a.setLossModel([&](const char *, std::size_t) {
+                return packets++ == 0;
+            });
+            std::vector<std::string> received;
+            b.setMessageHandler([&](unsigned, const char * data,
+                                    std::size_t size) {
+                received.push_back(std::string(data, size));
+            });
+
+            reliable_channel::tick_type now = 0;
+            a.send(2, "lost");
+            a.update(now);
+            a.send(2, "kept");
+            pump(a, b, now, 500);
+            CPPUNIT_ASSERT(received.size() == 1);
+            CPPUNIT_ASSERT(received[0] == "kept");
+            CPPUNIT_ASSERT(a.getRetransmitted() == 0);
+            CPPUNIT_ASSERT(a.pending() == 0);
+        }
+
+        void testCongestion()
+        {
+            reliable_channel a(*_a), b(*_b);
+            const std::string big(reliable_channel::MAX_MESSAGE, 'z');
+            CPPUNIT_ASSERT(a.send(0, big + "z") == -1);
+            CPPUNIT_ASSERT(a.getLastError() == EMSGSIZE);
+            for (int i = 0; i < 200; ++i) {
+                CPPUNIT_ASSERT(a.send(0, big) == 0);
+            }
+
+            // Packets are paced out, not sent in one burst.
+            reliable_channel::tick_type now = 0;
+            int sent = a.update(now);
+            CPPUNIT_ASSERT(sent > 0 && sent <= 4);
+            CPPUNIT_ASSERT(a.nextTimeout(now) > now);
+
+            // Heavy loss shrinks the window.
+            loss a_loss(50);
+            a.setLossModel(std::ref(a_loss));
+            double before = a.getWindow();
+            pump(a, b, now, 200);
+            CPPUNIT_ASSERT(a.getWindow() < before);
+            CPPUNIT_ASSERT(a.getTimeout() >= 10);
+
+            a.setLossModel(reliable_channel::loss_model());
+            pump(a, b, now, 20000);
+            CPPUNIT_ASSERT(a.pending() == 0);
+            CPPUNIT_ASSERT(a.nextTimeout(now) == reliable_channel::never);
+        }
+
+        void testMalformed()
+        {
+            reliable_channel a(*_a);
+            CPPUNIT_ASSERT(a.input("short", 5, 0) == -1);
+            // A message claiming to be longer than the packet.
+            const char bad[] = { 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                 0, 0, 0, 0, 0, 0, 1, 0 };
+            CPPUNIT_ASSERT(a.input(bad, sizeof(bad), 0) == -1);
+        }
+
+        void testBuffered()
+        {
+            reliable_channel a(*_a), b(*_b);
+            std::vector<std::string> received;
+            b.setMessageHandler([&](unsigned, const char * data,
+                                    std::size_t size) {
+                received.push_back(std::string(data, size));
+            });
+            CPPUNIT_ASSERT(a.send(0, "early") == 0);
+            CPPUNIT_ASSERT(a.update(0) == 1);
+
+            // Already read by the stream, so the socket has nothing left.
+            CPPUNIT_ASSERT(_b->peek() != std::iostream::traits_type::eof());
+            CPPUNIT_ASSERT(_b->datagramBuffered());
+            CPPUNIT_ASSERT(b.receive(1) == 1);
+            CPPUNIT_ASSERT(!_b->datagramBuffered());
+            CPPUNIT_ASSERT(received.size() == 1);
+            CPPUNIT_ASSERT(received[0] == "early");
+        }
+
+        void setUp()
+        {
+            _a = new udp_socket_stream;
+            _b = new udp_socket_stream;
+            CPPUNIT_ASSERT(_a->open(0, AF_INET) == 0);
+            CPPUNIT_ASSERT(_b->setTarget("127.0.0.1", _a->getLocalPort()));
+            // Connecting gives b a local port for a to send back to.
+            CPPUNIT_ASSERT(_b->setConnected(true));
+            sockaddr_storage addr;
+            SOCKLEN addr_len = sizeof(addr);
+            ::getsockname(_b->getSocket(), (sockaddr*)&addr, &addr_len);
+            _a->setOutpeer(addr, addr_len);
+            ::fcntl(_a->getSocket(), F_SETFL, O_NONBLOCK);
+            ::fcntl(_b->getSocket(), F_SETFL, O_NONBLOCK);
+        }
+
+        void tearDown()
+        {
+            delete _a;
+            delete _b;
+        }
+};
+
+#endif // SKRELIABLETEST_H
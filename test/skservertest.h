@@ -76,6 +76,7 @@
 #define SKSERVERTEST_H
 
 #include <skstream/skserver.h>
+#include <skstream/skstream.h>
 
 #include <cppunit/TestCase.h>
 #include <cppunit/extensions/HelperMacros.h>
@@ -88,6 +89,8 @@ class tcpskservertest : public CppUnit::TestCase {
     CPPUNIT_TEST(testAccept);
     CPPUNIT_TEST(testOpen);
     CPPUNIT_TEST(testClose);
+    CPPUNIT_TEST(testSocketOptions);
+    CPPUNIT_TEST(testAcceptOptions);
     CPPUNIT_TEST_SUITE_END();
 
     private:
@@ -133,6 +136,55 @@ class tcpskservertest : public CppUnit::TestCase {
             CPPUNIT_ASSERT(!skserver->is_open());
         }
 
+        void testSocketOptions()
+        {
+            tcp_socket_server server;
+            CPPUNIT_ASSERT(server.open(0) == 0);
+            tcp_socket_stream tss(std::string("localhost"), server.getLocalPort());
+            CPPUNIT_ASSERT(tss.is_open());
+
+            CPPUNIT_ASSERT(tss.setNoDelay(true));
+            CPPUNIT_ASSERT(tss.getNoDelay() != 0);
+            CPPUNIT_ASSERT(tss.setNoDelay(false));
+            CPPUNIT_ASSERT(tss.getNoDelay() == 0);
+
+            CPPUNIT_ASSERT(tss.setSendBufferSize(65536));
+            CPPUNIT_ASSERT(tss.getSendBufferSize() >= 65536);
+
+            CPPUNIT_ASSERT(tss.setKeepAlive(true));
+            CPPUNIT_ASSERT(tss.getKeepAlive() != 0);
+
+            {
+                socket_cork cork(tss);
+                tss << "corked" << std::flush;
+            }
+            // The cork is removed again, where the system has one
+            CPPUNIT_ASSERT(tss.getCork() <= 0);
+
+            tcp_socket_stream closed;
+            CPPUNIT_ASSERT(!closed.setNoDelay(true));
+            CPPUNIT_ASSERT(closed.getNoDelay() == -1);
+        }
+
+        void testAcceptOptions()
+        {
+            tcp_socket_server server;
+            socket_options options;
+            options.nodelay = 1;
+            options.keepalive = 1;
+            server.setAcceptOptions(options);
+            CPPUNIT_ASSERT(server.open(0) == 0);
+
+            tcp_socket_stream tss(std::string("localhost"), server.getLocalPort());
+            CPPUNIT_ASSERT(tss.is_open());
+
+            tcp_socket_stream accepted(server.accept());
+            CPPUNIT_ASSERT(accepted.is_open());
+            CPPUNIT_ASSERT(accepted.getNoDelay() != 0);
+            CPPUNIT_ASSERT(accepted.getKeepAlive() != 0);
+            CPPUNIT_ASSERT(tss.getNoDelay() == 0);
+        }
+
         void setUp()
         {
             port = 8888;
@@ -0,0 +1,175 @@
+// shm_socket_stream test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+#ifndef SKSHMTEST_H
+#define SKSHMTEST_H
+
+#include <skstream/skshm.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+class skshmtest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skshmtest);
+    CPPUNIT_TEST(testExchange);
+    CPPUNIT_TEST(testWrap);
+    CPPUNIT_TEST(testClose);
+    CPPUNIT_TEST(testPeerExit);
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+        skshmtest(std::string name) : TestCase(name) { }
+        skshmtest() { }
+
+        void testExchange()
+        {
+            if(!shm_socket_stream::supported()) {
+                return;
+            }
+            unix_socket_stream control_a;
+            unix_socket_stream control_b(control_a);
+            shm_socket_stream a, b;
+            CPPUNIT_ASSERT(a.open(control_a, 1000) == 0);
+            CPPUNIT_ASSERT(!a.fail());
+            CPPUNIT_ASSERT(a.capacity() == 4096);
+            CPPUNIT_ASSERT(b.accept(control_b) == 0);
+            CPPUNIT_ASSERT(b.capacity() == 4096);
+
+            std::string word;
+            a << "hello " << 42 << std::endl;
+            int number = 0;
+            b >> word >> number;
+            CPPUNIT_ASSERT(word == "hello");
+            CPPUNIT_ASSERT(number == 42);
+
+            // Unflushed output is not seen by the peer.
+            b << "world ";
+            CPPUNIT_ASSERT(a.rdbuf()->in_avail() == 0);
+            b << std::flush;
+            CPPUNIT_ASSERT(a.rdbuf()->in_avail() > 0);
+            a >> word;
+            CPPUNIT_ASSERT(word == "world");
+
+            // The control socket is still usable.
+            control_a << "still here" << std::endl;
+            std::string line;
+            CPPUNIT_ASSERT(control_b.readLine(line));
+            CPPUNIT_ASSERT(line == "still here");
+        }
+
+        void testWrap()
+        {
+            if(!shm_socket_stream::supported()) {
+                return;
+            }
+            unix_socket_stream control_a;
+            unix_socket_stream control_b(control_a);
+            shm_socket_stream a, b;
+            CPPUNIT_ASSERT(a.open(control_a, 4096) == 0);
+            CPPUNIT_ASSERT(b.accept(control_b) == 0);
+
+            // Many times the ring size, so the writer has to wait for
+            // the reader and the data wraps around.
+            const int count = 20000;
+            std::thread writer([&a, count]() {
+                for(int i = 0; i < count; ++i) {
+                    a << i << '\n';
+                }
+                a.flush();
+            });
+            bool ordered = true;
+            for(int i = 0; i < count; ++i) {
+                int value = -1;
+                b >> value;
+                if(value != i) {
+                    ordered = false;
+                    break;
+                }
+            }
+            writer.join();
+            CPPUNIT_ASSERT(ordered);
+        }
+
+        void testClose()
+        {
+            if(!shm_socket_stream::supported()) {
+                return;
+            }
+            unix_socket_stream control_a;
+            unix_socket_stream control_b(control_a);
+            shm_socket_stream a, b;
+            CPPUNIT_ASSERT(a.open(control_a) == 0);
+            CPPUNIT_ASSERT(b.accept(control_b) == 0);
+
+            // Data written before closing is still delivered.
+            a << "last";
+            a.close();
+            CPPUNIT_ASSERT(!a.is_open());
+            std::string word;
+            b >> word;
+            CPPUNIT_ASSERT(word == "last");
+            CPPUNIT_ASSERT(b.eof());
+
+            b.clear();
+            b << "nobody" << std::flush;
+            CPPUNIT_ASSERT(b.bad());
+        }
+
+        void testPeerExit()
+        {
+            if(!shm_socket_stream::supported()) {
+                return;
+            }
+            unix_socket_stream control_a;
+            unix_socket_stream control_b(control_a);
+            pid_t pid = ::fork();
+            CPPUNIT_ASSERT(pid != -1);
+            if(pid == 0) {
+                // Leave without closing, as a crash would.
+                control_a.close();
+                shm_socket_stream b;
+                if(b.accept(control_b) == 0) {
+                    b << "bye" << std::flush;
+                }
+                ::_exit(0);
+            }
+            control_b.close();
+
+            shm_socket_stream a;
+            CPPUNIT_ASSERT(a.open(control_a) == 0);
+            std::string word;
+            a >> word;
+            CPPUNIT_ASSERT(word == "bye");
+            a >> word;
+            CPPUNIT_ASSERT(a.eof());
+            ::waitpid(pid, 0, 0);
+        }
+};
+
+#endif // SKSHMTEST_H
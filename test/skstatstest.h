@@ -0,0 +1,149 @@
+// tcp_info_sampler test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+#ifndef SKSTATSTEST_H
+#define SKSTATSTEST_H
+
+#include <skstream/skstats.h>
+#include <skstream/skserver.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+class skstatstest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skstatstest);
+    CPPUNIT_TEST(testTcpInfo);
+    CPPUNIT_TEST(testSampler);
+    CPPUNIT_TEST(testSortByLatency);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        tcp_socket_server *server;
+        tcp_socket_stream *client;
+        tcp_socket_stream *peer;
+
+    public:
+        skstatstest(std::string name) : TestCase(name) { }
+        skstatstest() { }
+
+        void testTcpInfo()
+        {
+            tcp_connection_info info;
+#ifdef __linux__
+            *client << "ping" << std::endl;
+            std::string line;
+            *peer >> line;
+            CPPUNIT_ASSERT(line == "ping");
+
+            CPPUNIT_ASSERT(client->getTcpInfo(info) == 0);
+            CPPUNIT_ASSERT(info.mss > 0);
+            CPPUNIT_ASSERT(info.cwnd > 0);
+            CPPUNIT_ASSERT(info.unacked == 0);
+
+            tcp_socket_stream unconnected;
+            CPPUNIT_ASSERT(unconnected.getTcpInfo(info) == -1);
+#else
+            CPPUNIT_ASSERT(client->getTcpInfo(info) == -1);
+#endif
+        }
+
+        void testSampler()
+        {
+            socket_reactor reactor;
+            tcp_info_sampler sampler(reactor, 10);
+            sampler.add(client);
+            CPPUNIT_ASSERT(sampler.size() == 1);
+            CPPUNIT_ASSERT(sampler.getStats(client)->samples == 0);
+            CPPUNIT_ASSERT(sampler.getStats(peer) == 0);
+
+            for (int i = 0; i < 100 &&
+                            sampler.getStats(client)->samples < 2; ++i) {
+                reactor.poll(10);
+            }
+#ifdef __linux__
+            const tcp_connection_stats * stats = sampler.getStats(client);
+            CPPUNIT_ASSERT(stats->samples >= 2);
+            CPPUNIT_ASSERT(stats->max_rtt >= stats->info.rtt);
+            CPPUNIT_ASSERT(stats->recent_retransmits == 0);
+
+            CPPUNIT_ASSERT(!sampler.isSlow(client));
+            sampler.setSlowThreshold(0);
+            CPPUNIT_ASSERT(sampler.isSlow(client) == (stats->smoothed_rtt > 0));
+#endif
+
+            sampler.remove(client);
+            CPPUNIT_ASSERT(sampler.size() == 0);
+        }
+
+        void testSortByLatency()
+        {
+            socket_reactor reactor;
+            tcp_info_sampler sampler(reactor, 0);
+            sampler.add(client);
+            sampler.add(peer);
+            sampler.sample();
+
+            std::vector<const tcp_socket_stream *> streams;
+            streams.push_back(client);
+            streams.push_back(peer);
+            sampler.sortByLatency(streams);
+            CPPUNIT_ASSERT(streams.size() == 2);
+            const tcp_connection_stats * first = sampler.getStats(streams[0]);
+            const tcp_connection_stats * second = sampler.getStats(streams[1]);
+            CPPUNIT_ASSERT(first->smoothed_rtt <= second->smoothed_rtt);
+
+#ifdef __linux__
+            // Never sampled, so its RTT of 0 means nothing and it goes last.
+            tcp_socket_stream unsampled;
+            sampler.add(&unsampled);
+            streams.insert(streams.begin(), &unsampled);
+            sampler.sortByLatency(streams);
+            CPPUNIT_ASSERT(streams.size() == 3);
+            CPPUNIT_ASSERT(streams[2] == &unsampled);
+            sampler.remove(&unsampled);
+#endif
+        }
+
+        void setUp()
+        {
+            server = new tcp_socket_server;
+            server->open(0);
+
+            int port = server->getLocalPort();
+
+            client = new tcp_socket_stream(std::string("localhost"), port);
+            peer = new tcp_socket_stream(server->accept());
+        }
+
+        void tearDown()
+        {
+            delete peer;
+            delete client;
+            delete server;
+        }
+};
+
+#endif
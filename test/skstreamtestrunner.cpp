@@ -145,6 +145,17 @@
 #include "basicskstreamtest.h"
 #include "childskstreamtest.h"
 #include "skservertest.h"
+#include "skchecksumtest.h"
+#include "skcompresstest.h"
+#include "skshmtest.h"
+#include "skreactortest.h"
+#include "skreliabletest.h"
+#include "skstatstest.h"
+#include "skpooltest.h"
+#include "sktlstest.h"
+#include "sktimertest.h"
+#include "skudpsessiontest.h"
+#include "skworkertest.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(socketbuftest);
 CPPUNIT_TEST_SUITE_REGISTRATION(basicskstreamtest);
@@ -155,6 +166,22 @@ CPPUNIT_TEST_SUITE_REGISTRATION(udpskstreamtest);
 CPPUNIT_TEST_SUITE_REGISTRATION(tcpskservertest);
 CPPUNIT_TEST_SUITE_REGISTRATION(udpskservertest);
 
+CPPUNIT_TEST_SUITE_REGISTRATION(skreactortest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skreliabletest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skstatstest);
+CPPUNIT_TEST_SUITE_REGISTRATION(sktlstest);
+CPPUNIT_TEST_SUITE_REGISTRATION(sktimertest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skudpsessiontest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skworkertest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skchecksumtest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skpooltest);
+
+#ifdef AF_UNIX
+CPPUNIT_TEST_SUITE_REGISTRATION(unixskstreamtest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skshmtest);
+CPPUNIT_TEST_SUITE_REGISTRATION(skcompresstest);
+#endif
+
 #ifdef SOCK_RAW
 CPPUNIT_TEST_SUITE_REGISTRATION(rawskstreamtest);
 #endif
@@ -0,0 +1,180 @@
+// timer_wheel test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+#ifndef SKTIMERTEST_H
+#define SKTIMERTEST_H
+
+#include <skstream/sktimer.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+class sktimertest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(sktimertest);
+    CPPUNIT_TEST(testExpiry);
+    CPPUNIT_TEST(testCancel);
+    CPPUNIT_TEST(testHandlerReschedules);
+    CPPUNIT_TEST(testNextExpiry);
+    CPPUNIT_TEST(testRandom);
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+        sktimertest(std::string name) : TestCase(name) { }
+        sktimertest() { }
+
+        void testExpiry()
+        {
+            // One timer for each wheel, and one beyond the top wheel
+            const timer_wheel::tick_type delays[] = {
+                10, 300, 20000, 2000000, 100000000
+            };
+            const timer_wheel::tick_type start = 123456;
+            for (int i = 0; i < 5; ++i) {
+                timer_wheel wheel(start);
+                int fired = 0;
+                wheel.schedule(delays[i], [&fired]() { ++fired; });
+                CPPUNIT_ASSERT(wheel.size() == 1);
+
+                CPPUNIT_ASSERT(wheel.advance(start + delays[i] - 1) == 0);
+                CPPUNIT_ASSERT(fired == 0);
+                CPPUNIT_ASSERT(wheel.advance(start + delays[i]) == 1);
+                CPPUNIT_ASSERT(fired == 1);
+                CPPUNIT_ASSERT(wheel.size() == 0);
+            }
+        }
+
+        void testCancel()
+        {
+            timer_wheel wheel;
+            int fired = 0;
+            timer_wheel::timer_id one = wheel.schedule(10, [&]() { ++fired; });
+            timer_wheel::timer_id two = wheel.schedule(5000, [&]() { ++fired; });
+            timer_wheel::timer_id three = wheel.schedule(20, [&]() { ++fired; });
+
+            CPPUNIT_ASSERT(wheel.cancel(two));
+            CPPUNIT_ASSERT(!wheel.cancel(two));
+            CPPUNIT_ASSERT(wheel.size() == 2);
+
+            wheel.advance(10);
+            CPPUNIT_ASSERT(fired == 1);
+            CPPUNIT_ASSERT(!wheel.cancel(one));
+
+            // A new timer reuses the slot, but not the id
+            timer_wheel::timer_id four = wheel.schedule(10, [&]() { ++fired; });
+            CPPUNIT_ASSERT(four != one && four != two);
+            CPPUNIT_ASSERT(!wheel.cancel(two));
+
+            CPPUNIT_ASSERT(wheel.cancel(three));
+            wheel.advance(10000);
+            CPPUNIT_ASSERT(fired == 2);
+            CPPUNIT_ASSERT(wheel.size() == 0);
+        }
+
+        void testHandlerReschedules()
+        {
+            timer_wheel wheel;
+            std::vector<timer_wheel::tick_type> times;
+            timer_wheel::timer_id victim = 0;
+
+            wheel.schedule(100, [&]() {
+                times.push_back(wheel.now());
+                CPPUNIT_ASSERT(wheel.cancel(victim));
+                // Already due, so runs on the next tick
+                wheel.schedule(0, [&]() { times.push_back(wheel.now()); });
+                wheel.schedule(1000, [&]() { times.push_back(wheel.now()); });
+            });
+            victim = wheel.schedule(150, [&]() { times.push_back(0); });
+
+            wheel.advance(100);
+            CPPUNIT_ASSERT(times.size() == 1);
+            wheel.advance(101);
+            CPPUNIT_ASSERT(times.size() == 2);
+            wheel.advance(5000);
+            CPPUNIT_ASSERT(times.size() == 3);
+            CPPUNIT_ASSERT(times[2] == 5000);
+        }
+
+        void testNextExpiry()
+        {
+            timer_wheel wheel(1000);
+            CPPUNIT_ASSERT(wheel.nextExpiry() == timer_wheel::never);
+
+            int fired = 0;
+            wheel.schedule(50, [&fired]() { ++fired; });
+            CPPUNIT_ASSERT(wheel.nextExpiry() == 1050);
+
+            // Following nextExpiry() should reach a distant timer in a
+            // handful of steps, with no step going past it.
+            timer_wheel::tick_type expires = 1000 + 3600000;
+            wheel.scheduleAt(expires, [&fired]() { fired += 10; });
+            int steps = 0;
+            while (fired < 11) {
+                timer_wheel::tick_type next = wheel.nextExpiry();
+                CPPUNIT_ASSERT(next <= expires);
+                wheel.advance(next);
+                ++steps;
+            }
+            CPPUNIT_ASSERT(wheel.now() == expires);
+            CPPUNIT_ASSERT(steps < 200);
+            CPPUNIT_ASSERT(wheel.nextExpiry() == timer_wheel::never);
+        }
+
+        void testRandom()
+        {
+            timer_wheel wheel;
+            std::map<int, timer_wheel::timer_id> ids;
+            int errors = 0, fired = 0;
+            timer_wheel::tick_type last = 0;
+
+            std::srand(42);
+            for (int i = 0; i < 2000; ++i) {
+                timer_wheel::tick_type delay = 1 + std::rand() % (1 << (std::rand() % 23));
+                timer_wheel::tick_type expires = delay;
+                ids[i] = wheel.schedule(delay, [&, expires]() {
+                    // Must fire in the advance() which passes its expiry
+                    if (expires > wheel.now() || expires < last) { ++errors; }
+                    ++fired;
+                });
+            }
+            int cancelled = 0;
+            for (int i = 0; i < 2000; i += 7) {
+                CPPUNIT_ASSERT(wheel.cancel(ids[i]));
+                ++cancelled;
+            }
+
+            timer_wheel::tick_type now = 0;
+            while (wheel.size() > 0) {
+                last = now + 1;
+                now += std::rand() % 5000;
+                wheel.advance(now);
+            }
+            CPPUNIT_ASSERT(errors == 0);
+            CPPUNIT_ASSERT(fired == 2000 - cancelled);
+        }
+};
+
+#endif
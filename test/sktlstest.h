@@ -0,0 +1,210 @@
+// tls_socket_stream test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+
+#ifndef SKTLSTEST_H
+#define SKTLSTEST_H
+
+#include <skstream/sktls.h>
+#include <skstream/skserver.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <thread>
+
+#include <stdio.h>
+#include <unistd.h>
+
+class sktlstest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(sktlstest);
+    CPPUNIT_TEST(testExchange);
+    CPPUNIT_TEST(testUntrusted);
+    CPPUNIT_TEST(testSendFile);
+    CPPUNIT_TEST(testNonBlocking);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        tls_context * server_context;
+        tcp_socket_server * listener;
+        int port;
+
+    public:
+        sktlstest(std::string name) : TestCase(name) { }
+        sktlstest() { }
+
+        void testExchange()
+        {
+            if(!tls_context::supported()) {
+                return;
+            }
+            tls_context client_context(tls_context::CLIENT);
+            CPPUNIT_ASSERT(client_context.trustCertificate(
+                               server_context->certificate()) == 0);
+
+            std::string received;
+            std::thread server([this, &received]() {
+                tls_socket_stream peer(*server_context, listener->accept());
+                peer >> received;
+                peer << "pong " << received << std::endl;
+            });
+
+            tls_socket_stream client(client_context);
+            CPPUNIT_ASSERT(client.open("localhost", port) == 0);
+            CPPUNIT_ASSERT(!client.fail());
+            CPPUNIT_ASSERT(client.established());
+            CPPUNIT_ASSERT(client.version().compare(0, 4, "TLSv") == 0);
+            client << "ping" << std::endl;
+            std::string line;
+            CPPUNIT_ASSERT(client.readLine(line));
+            server.join();
+            CPPUNIT_ASSERT(received == "ping");
+            CPPUNIT_ASSERT(line == "pong ping");
+
+            // The peer closed cleanly, which is end of file.
+            CPPUNIT_ASSERT(!client.readLine(line));
+        }
+
+        void testUntrusted()
+        {
+            if(!tls_context::supported()) {
+                return;
+            }
+            // Nothing trusts the generated certificate.
+            tls_context client_context(tls_context::CLIENT);
+
+            int server_result = 0;
+            std::thread server([this, &server_result]() {
+                tls_socket_stream peer(*server_context, listener->accept());
+                server_result = peer.handshake();
+            });
+
+            tls_socket_stream client(client_context);
+            CPPUNIT_ASSERT(client.open("localhost", port) == -1);
+            CPPUNIT_ASSERT(!client.is_open());
+            CPPUNIT_ASSERT(!client.getErrorString().empty());
+            server.join();
+            CPPUNIT_ASSERT(server_result == -1);
+        }
+
+        void testNonBlocking()
+        {
+            if(!tls_context::supported()) {
+                return;
+            }
+            tls_context client_context(tls_context::CLIENT);
+            client_context.setVerifyPeer(false);
+
+            std::string received;
+            std::thread server([this, &received]() {
+                tls_socket_stream peer(*server_context, listener->accept());
+                peer >> received;
+                peer << "pong" << std::endl;
+            });
+
+            tls_socket_stream client(client_context);
+            CPPUNIT_ASSERT(client.open("localhost", port) == 0);
+
+            // Switched through the base class, as the coroutine and
+            // reactor helpers do, a read with nothing sent must not wait.
+            stream_socket_stream & base = client;
+            base.setNonBlocking(true);
+            std::string line;
+            CPPUNIT_ASSERT(!client.readLine(line));
+            CPPUNIT_ASSERT(client.wouldBlock());
+            client.clear();
+
+            base.setNonBlocking(false);
+            client << "ping" << std::endl;
+            CPPUNIT_ASSERT(client.readLine(line));
+            CPPUNIT_ASSERT(line == "pong");
+            server.join();
+            CPPUNIT_ASSERT(received == "ping");
+        }
+
+        void testSendFile()
+        {
+            if(!tls_context::supported()) {
+                return;
+            }
+            tls_context client_context(tls_context::CLIENT);
+            client_context.setVerifyPeer(false);
+
+            std::string content;
+            for(int i = 0; content.size() < 200000; ++i) {
+                content += std::to_string(i) + ' ';
+            }
+            FILE * file = ::tmpfile();
+            CPPUNIT_ASSERT(file != 0);
+            CPPUNIT_ASSERT(::fwrite(content.data(), 1, content.size(),
+                                    file) == content.size());
+            ::fflush(file);
+
+            std::string received;
+            std::thread server([this, &received]() {
+                tls_socket_stream peer(*server_context, listener->accept());
+                char buf[4096];
+                while(peer.read(buf, sizeof(buf)) || peer.gcount() > 0) {
+                    received.append(buf, peer.gcount());
+                }
+            });
+
+            tls_socket_stream client(client_context);
+            CPPUNIT_ASSERT(client.open("localhost", port) == 0);
+            // The file follows what was written first.
+            client << "header ";
+            off_t offset = 0;
+            while(offset < (off_t)content.size()) {
+                long sent = client.sendFile(::fileno(file), offset,
+                                            content.size() - offset);
+                CPPUNIT_ASSERT(sent > 0);
+                offset += sent;
+            }
+            client.close();
+            server.join();
+            ::fclose(file);
+            CPPUNIT_ASSERT(received == "header " + content);
+        }
+
+        void setUp()
+        {
+            server_context = new tls_context(tls_context::SERVER);
+            if(tls_context::supported()) {
+                CPPUNIT_ASSERT(server_context->generateCertificate(
+                                   "localhost") == 0);
+            }
+            listener = new tcp_socket_server;
+            CPPUNIT_ASSERT(listener->open(0) == 0);
+
+            port = listener->getLocalPort();
+        }
+
+        void tearDown()
+        {
+            delete listener;
+            delete server_context;
+        }
+};
+
+#endif // SKTLSTEST_H
@@ -0,0 +1,256 @@
+// udp_session_table test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+
+#ifndef SKUDPSESSIONTEST_H
+#define SKUDPSESSIONTEST_H
+
+#include <skstream/skudpsession.h>
+#include <skstream/skserver.h>
+#include <skstream/skstream.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+class skudpsessiontest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skudpsessiontest);
+    CPPUNIT_TEST(testLookup);
+    CPPUNIT_TEST(testExpire);
+    CPPUNIT_TEST(testRemoveTwice);
+    CPPUNIT_TEST(testRefuse);
+    CPPUNIT_TEST(testDispatch);
+    CPPUNIT_TEST(testReceive);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        // An IPv4 address made up from a number.
+        static sockaddr_storage addressFor(unsigned n)
+        {
+            sockaddr_storage addr;
+            std::memset(&addr, 0, sizeof(addr));
+            sockaddr_in & in = (sockaddr_in &)addr;
+            in.sin_family = AF_INET;
+            in.sin_port = htons(1024 + n % 50000);
+            in.sin_addr.s_addr = htonl(0x0a000000 + n / 50000);
+            return addr;
+        }
+
+    public:
+        skudpsessiontest(std::string name) : TestCase(name) { }
+        skudpsessiontest() { }
+
+        void testLookup()
+        {
+            udp_session_table table(1000);
+            const unsigned count = 5000;
+            std::vector<udp_session_table::session_id> ids;
+            for (unsigned n = 0; n < count; ++n) {
+                sockaddr_storage addr = addressFor(n);
+                CPPUNIT_ASSERT(table.find(addr, sizeof(sockaddr_in)) ==
+                               udp_session_table::none);
+                ids.push_back(table.touch(addr, sizeof(sockaddr_in), 0));
+            }
+            CPPUNIT_ASSERT(table.size() == count);
+
+            // Remove every third, and check the rest can still be found
+            // after their neighbours in the table have moved.
+            for (unsigned n = 0; n < count; n += 3) {
+                table.remove(ids[n]);
+            }
+            bool found = true;
+            for (unsigned n = 0; n < count; ++n) {
+                sockaddr_storage addr = addressFor(n);
+                udp_session_table::session_id id =
+                      table.find(addr, sizeof(sockaddr_in));
+                if (id != (n % 3 == 0 ? udp_session_table::none : ids[n])) {
+                    found = false;
+                }
+            }
+            CPPUNIT_ASSERT(found);
+            CPPUNIT_ASSERT(table.size() == count - (count + 2) / 3);
+
+            // Ids of removed sessions are reused.
+            sockaddr_storage addr = addressFor(count);
+            udp_session_table::session_id id =
+                  table.touch(addr, sizeof(sockaddr_in), 0);
+            CPPUNIT_ASSERT(id < count);
+            CPPUNIT_ASSERT(table.peerSize(id) == sizeof(sockaddr_in));
+            CPPUNIT_ASSERT(std::memcmp(&table.peer(id), &addr,
+                                       sizeof(sockaddr_in)) == 0);
+        }
+
+        void testExpire()
+        {
+            udp_session_table table(100);
+            std::vector<udp_session_table::session_id> expired;
+            table.setExpireHandler([&](udp_session_table::session_id id) {
+                expired.push_back(id);
+            });
+            CPPUNIT_ASSERT(table.nextExpiry() == udp_session_table::never);
+
+            sockaddr_storage a = addressFor(1), b = addressFor(2);
+            udp_session_table::session_id ida =
+                  table.touch(a, sizeof(sockaddr_in), 0);
+            udp_session_table::session_id idb =
+                  table.touch(b, sizeof(sockaddr_in), 50);
+            CPPUNIT_ASSERT(table.nextExpiry() == 100);
+
+            // Hearing from a again keeps it alive past b.
+            CPPUNIT_ASSERT(table.touch(a, sizeof(sockaddr_in), 90) == ida);
+            CPPUNIT_ASSERT(table.expire(149) == 0);
+            CPPUNIT_ASSERT(table.expire(150) == 1);
+            CPPUNIT_ASSERT(expired.size() == 1 && expired[0] == idb);
+            CPPUNIT_ASSERT(table.find(b, sizeof(sockaddr_in)) ==
+                           udp_session_table::none);
+            CPPUNIT_ASSERT(table.nextExpiry() == 190);
+            CPPUNIT_ASSERT(table.expire(1000) == 1);
+            CPPUNIT_ASSERT(table.size() == 0);
+        }
+
+        void testRemoveTwice()
+        {
+            udp_session_table table(100);
+            table.setExpireHandler([&](udp_session_table::session_id id) {
+                table.remove(id);
+            });
+
+            sockaddr_storage a = addressFor(1), b = addressFor(2);
+            udp_session_table::session_id ida =
+                  table.touch(a, sizeof(sockaddr_in), 0);
+            table.touch(b, sizeof(sockaddr_in), 50);
+            CPPUNIT_ASSERT(table.expire(100) == 1);
+            CPPUNIT_ASSERT(table.size() == 1);
+            table.remove(ida);
+            CPPUNIT_ASSERT(table.size() == 1);
+
+            // The freed id is handed out once only.
+            sockaddr_storage c = addressFor(3), d = addressFor(4);
+            udp_session_table::session_id idc =
+                  table.touch(c, sizeof(sockaddr_in), 120);
+            udp_session_table::session_id idd =
+                  table.touch(d, sizeof(sockaddr_in), 120);
+            CPPUNIT_ASSERT(idc != udp_session_table::none);
+            CPPUNIT_ASSERT(idd != udp_session_table::none);
+            CPPUNIT_ASSERT(idc != idd);
+            CPPUNIT_ASSERT(table.size() == 3);
+            CPPUNIT_ASSERT(table.find(b, sizeof(sockaddr_in)) != idc);
+            CPPUNIT_ASSERT(table.find(b, sizeof(sockaddr_in)) != idd);
+            CPPUNIT_ASSERT(table.expire(1000) == 3);
+            CPPUNIT_ASSERT(table.size() == 0);
+        }
+
+        void testRefuse()
+        {
+            udp_session_table table(100);
+            int asked = 0;
+            table.setAcceptHandler([&](udp_session_table::session_id) {
+                return ++asked != 1;
+            });
+            sockaddr_storage a = addressFor(1);
+            CPPUNIT_ASSERT(table.touch(a, sizeof(sockaddr_in), 0) ==
+                           udp_session_table::none);
+            CPPUNIT_ASSERT(table.size() == 0);
+            CPPUNIT_ASSERT(table.touch(a, sizeof(sockaddr_in), 0) !=
+                           udp_session_table::none);
+            CPPUNIT_ASSERT(table.touch(a, sizeof(sockaddr_in), 0) !=
+                           udp_session_table::none);
+            CPPUNIT_ASSERT(asked == 2);
+        }
+
+        void testDispatch()
+        {
+            udp_session_table table(100);
+            sockaddr_storage peers[3] = { addressFor(1), addressFor(2),
+                                          addressFor(3) };
+            const char * text[] = { "a1", "b1", "a2", "c1", "b2", "a3" };
+            const int from[] = { 0, 1, 0, 2, 1, 0 };
+            udp_session_table::datagram datagrams[6];
+            for (int i = 0; i < 6; ++i) {
+                datagrams[i].data = text[i];
+                datagrams[i].size = 2;
+                datagrams[i].peer = &peers[from[i]];
+                datagrams[i].peer_size = sizeof(sockaddr_in);
+            }
+
+            // One call for each session, in the order they were first
+            // seen, with datagrams in the order they arrived.
+            std::vector<std::string> calls;
+            CPPUNIT_ASSERT(table.dispatch(datagrams, 6, 0,
+                [&](udp_session_table::session_id id,
+                    const udp_session_table::datagram * d, std::size_t n) {
+                    std::string call;
+                    for (std::size_t i = 0; i < n; ++i) {
+                        call.append(d[i].data, d[i].size);
+                        CPPUNIT_ASSERT(d[i].peer_size == table.peerSize(id));
+                    }
+                    calls.push_back(call);
+                }) == 6);
+            CPPUNIT_ASSERT(calls.size() == 3);
+            CPPUNIT_ASSERT(calls[0] == "a1a2a3");
+            CPPUNIT_ASSERT(calls[1] == "b1b2");
+            CPPUNIT_ASSERT(calls[2] == "c1");
+            CPPUNIT_ASSERT(table.size() == 3);
+        }
+
+        void testReceive()
+        {
+            udp_socket_server server(0);
+            CPPUNIT_ASSERT(server.is_open());
+            const char * host = server.getFamily() == AF_INET6 ? "::1"
+                                                                : "127.0.0.1";
+            int port = server.getLocalPort();
+
+            udp_socket_stream first, second;
+            CPPUNIT_ASSERT(first.setTarget(host, port));
+            CPPUNIT_ASSERT(second.setTarget(host, port));
+            first.sendDatagram("one");
+            second.sendDatagram("two");
+            first.sendDatagram("three");
+
+            udp_session_table table(100);
+            std::vector<std::string> calls;
+            udp_session_table::batch_handler h =
+                [&](udp_session_table::session_id,
+                    const udp_session_table::datagram * d, std::size_t n) {
+                    std::string call;
+                    for (std::size_t i = 0; i < n; ++i) {
+                        call += std::string(d[i].data, d[i].size) + ";";
+                    }
+                    calls.push_back(call);
+                };
+            CPPUNIT_ASSERT(table.receive(server, 0, h) == 3);
+            CPPUNIT_ASSERT(calls.size() == 2);
+            CPPUNIT_ASSERT(calls[0] == "one;three;");
+            CPPUNIT_ASSERT(calls[1] == "two;");
+            CPPUNIT_ASSERT(table.size() == 2);
+
+            // Nothing waiting is not an error.
+            CPPUNIT_ASSERT(table.receive(server, 0, h) == 0);
+        }
+};
+
+#endif // SKUDPSESSIONTEST_H
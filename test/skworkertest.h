@@ -0,0 +1,210 @@
+// socket_worker_pool test cases
+// Copyright (C) 2026 The WorldForge Project
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+//  For information about Worldforge and its authors, please contact
+//  the Worldforge Web Site at http://www.wordforge.org.
+//
+
+#ifndef SKWORKERTEST_H
+#define SKWORKERTEST_H
+
+#include <skstream/skworker.h>
+#include <skstream/skqueue.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+class skworkertest : public CppUnit::TestCase
+{
+    //some macros for building the suite() method
+    CPPUNIT_TEST_SUITE(skworkertest);
+    CPPUNIT_TEST(testQueue);
+    CPPUNIT_TEST(testRoundRobin);
+    CPPUNIT_TEST(testLeastLoaded);
+    CPPUNIT_TEST(testEcho);
+    CPPUNIT_TEST(testStopClosesPending);
+    CPPUNIT_TEST_SUITE_END();
+
+    private:
+        // Wait for a counter to reach a value, for up to two seconds.
+        static bool waitFor(const std::atomic<int> & count, int value)
+        {
+            for (int i = 0; i < 200 && count.load() < value; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return count.load() == value;
+        }
+
+    public:
+        skworkertest(std::string name) : TestCase(name) { }
+        skworkertest() { }
+
+        void testQueue()
+        {
+            const int producers = 4, items = 20000;
+            mpsc_queue<int> queue;
+            std::vector<std::thread> threads;
+            for (int p = 0; p < producers; ++p) {
+                threads.push_back(std::thread([&queue, p]() {
+                    for (int i = 0; i < items; ++i) {
+                        queue.push(p * items + i);
+                    }
+                }));
+            }
+
+            // Each producer's items must come out in the order pushed
+            std::vector<int> last(producers, -1);
+            int received = 0, errors = 0;
+            while (received < producers * items) {
+                int item;
+                if (!queue.pop(item)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                int p = item / items, i = item % items;
+                if (i <= last[p]) { ++errors; }
+                last[p] = i;
+                ++received;
+            }
+            for (std::size_t p = 0; p < threads.size(); ++p) {
+                threads[p].join();
+            }
+            CPPUNIT_ASSERT(errors == 0);
+            CPPUNIT_ASSERT(queue.empty());
+        }
+
+        void testRoundRobin()
+        {
+            std::atomic<int> handled(0), counts[2];
+            counts[0] = counts[1] = 0;
+            socket_worker_pool pool(2, [&](socket_worker & w, SOCKET_TYPE s) {
+                ++counts[w.index()];
+                ::close(s);
+                w.release();
+                ++handled;
+            }, socket_worker_pool::ROUND_ROBIN);
+            CPPUNIT_ASSERT(pool.listen(0) == 0);
+            CPPUNIT_ASSERT(pool.start() == 0);
+
+            for (int i = 0; i < 4; ++i) {
+                tcp_socket_stream client("localhost", pool.port());
+                CPPUNIT_ASSERT(client.is_open());
+            }
+            CPPUNIT_ASSERT(waitFor(handled, 4));
+            CPPUNIT_ASSERT(counts[0] == 2 && counts[1] == 2);
+        }
+
+        void testLeastLoaded()
+        {
+            std::atomic<int> handled(0);
+            std::vector<SOCKET_TYPE> held[2];
+            socket_worker_pool pool(2, [&](socket_worker & w, SOCKET_TYPE s) {
+                held[w.index()].push_back(s);
+                ++handled;
+            });
+            CPPUNIT_ASSERT(pool.listen(0) == 0);
+            CPPUNIT_ASSERT(pool.start() == 0);
+
+            std::vector<std::unique_ptr<tcp_socket_stream> > clients;
+            for (int i = 0; i < 4; ++i) {
+                clients.emplace_back(new tcp_socket_stream("localhost",
+                                                           pool.port()));
+                CPPUNIT_ASSERT(waitFor(handled, i + 1));
+            }
+            CPPUNIT_ASSERT(pool.worker(0).load() == 2);
+            CPPUNIT_ASSERT(pool.worker(1).load() == 2);
+
+            // Once the first worker's connections close, it gets the next two
+            pool.worker(0).release();
+            pool.worker(0).release();
+            for (int i = 4; i < 6; ++i) {
+                clients.emplace_back(new tcp_socket_stream("localhost",
+                                                           pool.port()));
+                CPPUNIT_ASSERT(waitFor(handled, i + 1));
+            }
+            pool.stop();
+            CPPUNIT_ASSERT(held[0].size() == 4);
+            CPPUNIT_ASSERT(held[1].size() == 2);
+            for (int w = 0; w < 2; ++w) {
+                for (std::size_t i = 0; i < held[w].size(); ++i) {
+                    ::close(held[w][i]);
+                }
+            }
+        }
+
+        void testStopClosesPending()
+        {
+            int handled = 0;
+            int fds[2];
+            CPPUNIT_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+            {
+                socket_worker_pool pool(1, [&](socket_worker &, SOCKET_TYPE) {
+                    ++handled;
+                });
+                // Never started, so no handler sees the connection.
+                pool.dispatch(fds[0]);
+                CPPUNIT_ASSERT(pool.worker(0).load() == 1);
+            }
+            CPPUNIT_ASSERT(handled == 0);
+            // The pool closed it, so the peer sees end of file.
+            char c;
+            CPPUNIT_ASSERT(::read(fds[1], &c, 1) == 0);
+            ::close(fds[1]);
+        }
+
+        void testEcho()
+        {
+            // Each worker owns the streams for its own connections
+            std::vector<std::unique_ptr<tcp_socket_stream> > streams[2];
+            socket_worker_pool pool(2, [&](socket_worker & w, SOCKET_TYPE s) {
+                tcp_socket_stream * stream = new tcp_socket_stream(s);
+                streams[w.index()].emplace_back(stream);
+                socket_reactor & r = w.reactor();
+                r.addStream(stream, basic_socket_poll::READ,
+                    [stream, &r, &w](basic_socket_poll::poll_type) {
+                        std::string line;
+                        if (stream->readLine(line)) {
+                            *stream << line << std::endl;
+                        } else if (!stream->wouldBlock()) {
+                            r.remove(stream);
+                            w.release();
+                        }
+                    });
+            }, socket_worker_pool::ROUND_ROBIN);
+            CPPUNIT_ASSERT(pool.listen(0, 2) == 0);
+            CPPUNIT_ASSERT(pool.start() == 0);
+
+            for (int i = 0; i < 4; ++i) {
+                tcp_socket_stream client("localhost", pool.port());
+                CPPUNIT_ASSERT(client.is_open());
+                client << "hello " << i << std::endl;
+                std::string reply;
+                std::getline(client, reply);
+                CPPUNIT_ASSERT(reply == "hello " + std::to_string(i));
+            }
+            pool.stop();
+        }
+};
+
+#endif
@@ -103,6 +103,28 @@
 #include <cppunit/TestCase.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+// A buffer whose first read fails.
+class flaky_socketbuf : public stream_socketbuf
+{
+    public:
+        explicit flaky_socketbuf(SOCKET_TYPE sock) : stream_socketbuf(sock),
+                                                     failed(false) { }
+
+    protected:
+        bool failed;
+
+        virtual int receive(std::streambuf::char_type * buf, std::size_t len,
+                            int flags)
+        {
+            if(!failed) {
+                failed = true;
+                errno = ECONNRESET;
+                return -1;
+            }
+            return stream_socketbuf::receive(buf, len, flags);
+        }
+};
+
 class socketbuftest : public CppUnit::TestCase
 {
     //some macros for building the suite() method
@@ -110,6 +132,11 @@ class socketbuftest : public CppUnit::TestCase
     CPPUNIT_TEST(testConstructor_1);
     CPPUNIT_TEST(testConstructor_2);
     CPPUNIT_TEST(testSetSocket);
+    CPPUNIT_TEST(testReadUntil);
+    CPPUNIT_TEST(testNonBlockingOutput);
+    CPPUNIT_TEST(testNonBlockingInput);
+    CPPUNIT_TEST(testReadErrorCleared);
+    CPPUNIT_TEST(testQueueBuffer);
     CPPUNIT_TEST_SUITE_END();
 
     private: 
@@ -154,6 +181,162 @@ class socketbuftest : public CppUnit::TestCase
             CPPUNIT_ASSERT(socketBuf.getSocket() == socket);
         }
 
+        void testReadUntil()
+        {
+            int fds[2];
+            CPPUNIT_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+            // Small buffers, so lines span more than one refill
+            stream_socketbuf reader(fds[0], 8, 8);
+
+            const std::string data("first\na much longer second line\n\nlast");
+            CPPUNIT_ASSERT(::write(fds[1], data.c_str(), data.size()) ==
+                           (ssize_t)data.size());
+            ::close(fds[1]);
+
+            std::string line;
+            CPPUNIT_ASSERT(reader.readLine(line) == 6);
+            CPPUNIT_ASSERT(line == "first");
+            CPPUNIT_ASSERT(reader.readLine(line) == 26);
+            CPPUNIT_ASSERT(line == "a much longer second line");
+            CPPUNIT_ASSERT(reader.readLine(line) == 1);
+            CPPUNIT_ASSERT(line.empty());
+            CPPUNIT_ASSERT(reader.readUntil(line, 'x') == 4);
+            CPPUNIT_ASSERT(line == "last");
+            CPPUNIT_ASSERT(reader.readLine(line) == -1);
+        }
+
+        void testNonBlockingOutput()
+        {
+            int fds[2];
+            CPPUNIT_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+            stream_socketbuf writer(fds[0]);
+            std::ostream os(&writer);
+            writer.setNonBlocking(true);
+            writer.setWatermarks(0x1000, 0x8000);
+
+            // Write far more than the socket buffer will hold. None of this
+            // may block, and the excess must be queued.
+            const int total = 0x100000;
+            for (int i = 0; i < total; ++i) {
+                os.put((char)(i % 251));
+            }
+            os.flush();
+            CPPUNIT_ASSERT(os.good());
+            CPPUNIT_ASSERT(writer.pendingBytes() > 0);
+            CPPUNIT_ASSERT(writer.congested());
+
+            // Drain the other end, sending the queue as space becomes free.
+            char buf[0x1000];
+            int received = 0;
+            bool ordered = true;
+            while (received < total) {
+                CPPUNIT_ASSERT(writer.flushPending() == 0);
+                ssize_t len = ::read(fds[1], buf, sizeof(buf));
+                CPPUNIT_ASSERT(len > 0);
+                for (ssize_t j = 0; j < len; ++j, ++received) {
+                    ordered = ordered && (buf[j] == (char)(received % 251));
+                }
+            }
+            CPPUNIT_ASSERT(ordered);
+            CPPUNIT_ASSERT(writer.pendingBytes() == 0);
+            CPPUNIT_ASSERT(!writer.congested());
+
+            ::close(fds[1]);
+        }
+
+        void testReadErrorCleared()
+        {
+            int fds[2];
+            CPPUNIT_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+            CPPUNIT_ASSERT(::write(fds[1], "x", 1) == 1);
+
+            flaky_socketbuf reader(fds[0]);
+            CPPUNIT_ASSERT(reader.sgetc() == std::streambuf::traits_type::eof());
+            CPPUNIT_ASSERT(reader.readError() == ECONNRESET);
+
+            // The next read works, so the error no longer stands.
+            CPPUNIT_ASSERT(reader.sgetc() == 'x');
+            CPPUNIT_ASSERT(reader.readError() == 0);
+            ::close(fds[1]);
+        }
+
+        void testQueueBuffer()
+        {
+            int fds[2];
+            CPPUNIT_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+            stream_socketbuf writer(fds[0]);
+            std::ostream os(&writer);
+            writer.setNonBlocking(true);
+
+            // Buffers go after anything already written to the stream
+            os << "head:";
+            std::string small("small:"), large(0x40000, 'x');
+            writer.queueBuffer(small);
+            writer.queueBuffer(large);
+            CPPUNIT_ASSERT(large.empty());
+            os << ":tail";
+            os.flush();
+            const std::size_t total = 5 + 6 + 0x40000 + 5;
+
+            std::string received;
+            char buf[0x1000];
+            while (received.size() < total) {
+                CPPUNIT_ASSERT(writer.flushPending() == 0);
+                ssize_t len = ::read(fds[1], buf, sizeof(buf));
+                CPPUNIT_ASSERT(len > 0);
+                received.append(buf, len);
+            }
+            CPPUNIT_ASSERT(received.substr(0, 11) == "head:small:");
+            CPPUNIT_ASSERT(received.find_first_not_of('x', 11) == total - 5);
+            CPPUNIT_ASSERT(received.substr(total - 5) == ":tail");
+            CPPUNIT_ASSERT(writer.pendingBytes() == 0);
+
+            ::close(fds[1]);
+        }
+
+        void testNonBlockingInput()
+        {
+            int fds[2];
+            CPPUNIT_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+            stream_socketbuf * reader = new stream_socketbuf(fds[0]);
+            basic_socket_stream is(*reader);
+            reader->setNonBlocking(true);
+
+            // Nothing sent yet, so the read fails but the stream is usable.
+            CPPUNIT_ASSERT(is.get() == std::iostream::traits_type::eof());
+            CPPUNIT_ASSERT(is.wouldBlock());
+            CPPUNIT_ASSERT(!is.fail());
+            CPPUNIT_ASSERT(is.good());
+
+            // A partial line is held back until the rest arrives.
+            std::string line;
+            CPPUNIT_ASSERT(::write(fds[1], "par", 3) == 3);
+            CPPUNIT_ASSERT(reader->readLine(line) == -1);
+            CPPUNIT_ASSERT(reader->wouldBlock());
+            CPPUNIT_ASSERT(::write(fds[1], "tial\n", 5) == 5);
+            CPPUNIT_ASSERT(reader->readLine(line) == 8);
+            CPPUNIT_ASSERT(line == "partial");
+
+            // The held back part is still there for ordinary reads.
+            CPPUNIT_ASSERT(::write(fds[1], "word", 4) == 4);
+            CPPUNIT_ASSERT(reader->readLine(line) == -1);
+            CPPUNIT_ASSERT(reader->in_avail() == 4);
+            CPPUNIT_ASSERT(is.get() == 'w');
+            CPPUNIT_ASSERT(::write(fds[1], "s\n", 2) == 2);
+            CPPUNIT_ASSERT(reader->readLine(line) == 5);
+            CPPUNIT_ASSERT(line == "ords");
+
+            // A closed peer is still reported as end of file.
+            ::close(fds[1]);
+            CPPUNIT_ASSERT(is.get() == std::iostream::traits_type::eof());
+            CPPUNIT_ASSERT(!is.wouldBlock());
+            CPPUNIT_ASSERT(is.fail());
+        }
+
         void setUp()
         {
             socket = ::socket(AF_INET, SOCK_STREAM, FreeSockets::proto_TCP);
@@ -0,0 +1,128 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+// Send recorded traffic through compress_stream over a unix socket pair,
+// flushing after every message as a server sending updates would, and
+// report throughput and compression ratio for each method. The traffic
+// is read from the file given, one message per line, or made up as
+// Atlas entity updates like those a WorldForge server sends.
+
+#include <skstream/skcompress.h>
+#include <skstream/skstream_unix.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/time.h>
+
+static long long now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static std::vector<std::string> makeTraffic(int count)
+{
+    std::vector<std::string> messages;
+    unsigned seed = 1;
+    for (int i = 0; i < count; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int entity = (seed >> 16) % 500;
+        std::ostringstream message;
+        message << "{objtype:\"op\",parents:[\"sight\"],to:\"" << 1000 + i % 7
+                << "\",args:[{objtype:\"op\",parents:[\"move\"],from:\""
+                << entity << "\",args:[{id:\"" << entity
+                << "\",loc:\"1\",pos:[" << (seed >> 8) % 2000 / 10.
+                << "," << (seed >> 4) % 2000 / 10. << ",0],velocity:["
+                << (int)(seed % 5) - 2 << ",0,0],stamp:" << 100000 + i * 16
+                << "}]}]}";
+        messages.push_back(message.str());
+    }
+    return messages;
+}
+
+static void run(const char * name, compress_streambuf::method m, int level,
+                const std::vector<std::string> & messages, int batch)
+{
+    if (!compress_streambuf::supported(m)) {
+        printf("%-6s not supported by this build\n", name);
+        return;
+    }
+    unix_socket_stream a;
+    unix_socket_stream b(a);
+    compress_stream writer(a, m, level);
+    compress_stream reader(b, m, level);
+
+    long long start = now();
+    std::thread sender([&]() {
+        for (std::size_t i = 0; i < messages.size(); ++i) {
+            writer << messages[i] << '\n';
+            if ((i + 1) % batch == 0) {
+                writer.flush();
+            }
+        }
+        writer.finish();
+    });
+    std::string line;
+    std::size_t received = 0;
+    while (std::getline(reader, line)) {
+        ++received;
+    }
+    sender.join();
+    long long elapsed = now() - start;
+
+    const compress_streambuf & buf = writer.compressbuf();
+    printf("%-6s level %2d flush/%-3d %8.1f MB/s  %10llu -> %9llu bytes  "
+           "ratio %5.2f%s\n", name, level, batch,
+           buf.plainOut() / (double)elapsed, buf.plainOut(), buf.packedOut(),
+           buf.plainOut() / (double)buf.packedOut(),
+           received == messages.size() ? "" : "  (messages lost)");
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<std::string> messages;
+    if (argc > 1) {
+        std::ifstream recorded(argv[1]);
+        if (!recorded) {
+            fprintf(stderr, "%s: could not read %s\n", argv[0], argv[1]);
+            return 1;
+        }
+        std::string line;
+        while (std::getline(recorded, line)) {
+            messages.push_back(line);
+        }
+    } else {
+        messages = makeTraffic(200000);
+    }
+
+    const int batches[] = { 1, 16 };
+    for (int i = 0; i < 2; ++i) {
+        run("zlib", compress_streambuf::ZLIB, 1, messages, batches[i]);
+        run("zlib", compress_streambuf::ZLIB, 6, messages, batches[i]);
+        run("zstd", compress_streambuf::ZSTD, 1, messages, batches[i]);
+        run("zstd", compress_streambuf::ZSTD, 3, messages, batches[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Echo server benchmark for socket_reactor. A server and a large number of
+// clients run in one reactor, with each client sending a fixed number of
+// messages and waiting for each to be echoed back.
+
+#include <skstream/skreactor.h>
+#include <skstream/skserver.h>
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+static const std::streamsize MESSAGE_SIZE = 64;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+// Read whatever is available without blocking. Returns 0 if nothing is
+// available, and -1 if the connection has closed.
+static std::streamsize read_available(tcp_socket_stream & s,
+                                      char * buf, std::streamsize len)
+{
+    if (s.rdbuf()->in_avail() <= 0 &&
+        s.peek() == std::iostream::traits_type::eof()) {
+        if (s.wouldBlock()) {
+            s.clear();
+            return 0;
+        }
+        return -1;
+    }
+    return s.readsome(buf, len);
+}
+
+struct client {
+    tcp_socket_stream * stream;
+    std::streamsize received;
+    int rounds;
+};
+
+int main(int argc, char ** argv)
+{
+    long connections = 10000;
+    int rounds = 10;
+
+    if (argc > 1) {
+        connections = strtol(argv[1], 0, 10);
+    }
+    if (argc > 2) {
+        rounds = strtol(argv[2], 0, 10);
+    }
+
+    // Each connection needs two descriptors, as both ends are in process.
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    long max_connections = ((long)limit.rlim_cur - 32) / 2;
+    if (connections > max_connections) {
+        fprintf(stderr, "Descriptor limit allows only %ld connections\n",
+                max_connections);
+        connections = max_connections;
+    }
+
+    socket_reactor reactor;
+    tcp_socket_server server;
+
+    if (server.open(0) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    int port = server.getLocalPort();
+    const char * host = server.getFamily() == AF_INET6 ? "::1" : "127.0.0.1";
+
+    // Server side: echo everything back.
+    reactor.addAcceptor(&server, [&reactor](SOCKET_TYPE fd) {
+        tcp_socket_stream * s = new tcp_socket_stream(fd);
+        s->setNonBlocking(true);
+        reactor.addStream(s, basic_socket_poll::READ,
+            [&reactor, s](basic_socket_poll::poll_type) {
+                char buf[4096];
+                std::streamsize len;
+                while ((len = read_available(*s, buf, sizeof(buf))) > 0) {
+                    s->write(buf, len);
+                }
+                s->flush();
+                if (len < 0) {
+                    reactor.remove(s);
+                    delete s;
+                }
+            });
+    });
+
+    std::vector<client> clients(connections);
+    const char message[MESSAGE_SIZE] = { 0 };
+    long completed = 0;
+    const long expected = connections * rounds;
+
+    double start = now();
+    for (long i = 0; i < connections; ++i) {
+        client & c = clients[i];
+        c.stream = new tcp_socket_stream(host, port);
+        if (!c.stream->is_open()) {
+            perror("connect");
+            return 1;
+        }
+        // The listen backlog is small, so accept as we go.
+        reactor.poll(0);
+        c.stream->setNonBlocking(true);
+        c.received = 0;
+        c.rounds = rounds;
+        reactor.addStream(c.stream, basic_socket_poll::READ,
+            [&c, &completed, &message](basic_socket_poll::poll_type) {
+                char buf[4096];
+                std::streamsize len;
+                while ((len = read_available(*c.stream, buf,
+                                             sizeof(buf))) > 0) {
+                    c.received += len;
+                }
+                while (c.received >= MESSAGE_SIZE) {
+                    c.received -= MESSAGE_SIZE;
+                    ++completed;
+                    if (--c.rounds > 0) {
+                        c.stream->write(message, MESSAGE_SIZE);
+                    }
+                }
+                c.stream->flush();
+            });
+    }
+    double connected = now();
+    printf("%ld connections established in %.3f s\n",
+           connections, connected - start);
+
+    start = now();
+    for (long i = 0; i < connections; ++i) {
+        clients[i].stream->write(message, MESSAGE_SIZE);
+        clients[i].stream->flush();
+    }
+
+    while (completed < expected) {
+        if (reactor.poll(1000) < 0) {
+            perror("poll");
+            return 1;
+        }
+    }
+    double elapsed = now() - start;
+
+    printf("%s backend: %ld round trips in %.3f s, %.0f round trips/s\n",
+           reactor.usingEpoll() ? "epoll" : "select",
+           completed, elapsed, completed / elapsed);
+
+    return 0;
+}
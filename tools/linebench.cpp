@@ -0,0 +1,131 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Compare std::getline() with stream_socket_stream::readLine() when
+// reading 100 byte lines from a socket.
+
+#include <skstream/skstream.h>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+static const int LINE_LENGTH = 100;
+
+class line_stream : public stream_socket_stream {
+public:
+  explicit line_stream(SOCKET_TYPE sock) : stream_socket_stream(sock) { }
+};
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+// Fork a child which writes count lines into one end of a socket pair,
+// and return the other end.
+static SOCKET_TYPE start_writer(long count)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid == 0) {
+        ::close(fds[0]);
+        std::string block;
+        std::string line(LINE_LENGTH - 1, 'x');
+        line += '\n';
+        for (int i = 0; i < 80; ++i) {
+            block += line;
+        }
+        long left = count;
+        while (left > 0) {
+            long lines = std::min(left, 80L);
+            const char * p = block.data();
+            ssize_t len = lines * LINE_LENGTH;
+            while (len > 0) {
+                ssize_t ret = ::write(fds[1], p, len);
+                if (ret <= 0) {
+                    _exit(1);
+                }
+                p += ret;
+                len -= ret;
+            }
+            left -= lines;
+        }
+        _exit(0);
+    }
+
+    ::close(fds[1]);
+    return fds[0];
+}
+
+static void report(const char * name, long lines, double elapsed)
+{
+    printf("%-12s %10ld lines %8.3f s %12.0f lines/s %8.1f MB/s\n",
+           name, lines, elapsed, lines / elapsed,
+           lines * LINE_LENGTH / elapsed / 1000000.);
+}
+
+int main(int argc, char ** argv)
+{
+    long count = 2000000;
+
+    if (argc > 1) {
+        count = strtol(argv[1], 0, 10);
+    }
+
+    std::string line;
+
+    {
+        line_stream s(start_writer(count));
+        long lines = 0;
+        double start = now();
+        while (std::getline(s, line)) {
+            ++lines;
+        }
+        report("getline", lines, now() - start);
+        wait(0);
+    }
+
+    {
+        line_stream s(start_writer(count));
+        long lines = 0;
+        double start = now();
+        while (s.readLine(line)) {
+            ++lines;
+        }
+        report("readLine", lines, now() - start);
+        wait(0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Measure round trip latency to a child process over a unix socketpair,
+// stream and seqpacket, over shared memory rings, and over TCP loopback.
+
+#include <skstream/skstream_unix.h>
+#include <skstream/skserver.h>
+#include <skstream/skshm.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+static bool read_line(stream_socket_stream & stream, std::string & line)
+{
+    return stream.readLine(line);
+}
+
+static bool read_line(shm_socket_stream & stream, std::string & line)
+{
+    return !std::getline(stream, line).fail();
+}
+
+// Close the end of the pair which belongs to the other process.
+static void drop(stream_socket_stream & stream)
+{
+    stream.close();
+}
+
+static void drop(shm_socket_stream &)
+{
+    // Both ends share the rings, so closing would end the stream for the
+    // other process too. The unused copy is just left alone.
+}
+
+// Run an echo loop on the child's end in a child process, and time round
+// trips of a short message on the parent's end.
+template <class Stream>
+static void run(const char * name, long count, Stream & parent, Stream & child)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        drop(parent);
+        std::string line;
+        while (read_line(child, line)) {
+            child << line << '\n' << std::flush;
+        }
+        _exit(0);
+    }
+    drop(child);
+
+    std::vector<double> times;
+    times.reserve(count);
+    const std::string message = "position 12.5 7.25 0.0";
+    std::string line;
+    for (long i = 0; i < count; ++i) {
+        double start = now();
+        parent << message << '\n' << std::flush;
+        if (!read_line(parent, line) || line != message) {
+            fprintf(stderr, "%s: bad reply\n", name);
+            exit(1);
+        }
+        times.push_back(now() - start);
+    }
+    parent.close();
+    waitpid(pid, 0, 0);
+
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (long i = 0; i < count; ++i) {
+        total += times[i];
+    }
+    printf("%-10s %8ld round trips  mean %7.2f us  p50 %7.2f us  "
+           "p99 %7.2f us\n", name, count, total / count * 1000000.,
+           times[count / 2] * 1000000., times[count * 99 / 100] * 1000000.);
+}
+
+int main(int argc, char ** argv)
+{
+    long count = 20000;
+
+    if (argc > 1) {
+        count = strtol(argv[1], 0, 10);
+    }
+    if (count < 1) {
+        count = 1;
+    }
+
+    {
+        unix_socket_stream parent;
+        unix_socket_stream child(parent);
+        run("socketpair", count, parent, child);
+    }
+
+    {
+        unix_socket_stream parent;
+        unix_socket_stream child(parent, false, SOCK_SEQPACKET);
+        run("seqpacket", count, parent, child);
+    }
+
+    if (shm_socket_stream::supported()) {
+        unix_socket_stream control_parent;
+        unix_socket_stream control_child(control_parent);
+        shm_socket_stream parent, child;
+        if (parent.open(control_parent, 65536) != 0 ||
+            child.accept(control_child) != 0) {
+            fprintf(stderr, "Could not set up shared memory\n");
+            return 1;
+        }
+        run("shm", count, parent, child);
+    }
+
+    {
+        tcp_socket_server server;
+        if (server.open(0) != 0) {
+            fprintf(stderr, "Could not listen\n");
+            return 1;
+        }
+        int port = server.getLocalPort();
+
+        tcp_socket_stream parent(std::string("localhost"), port);
+        tcp_socket_stream child(server.accept());
+        server.close();
+        parent.setNoDelay(true);
+        child.setNoDelay(true);
+        run("tcp", count, parent, child);
+    }
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Request latency against a local echo server, opening a new connection
+// for every request as a service calling another without a pool would,
+// and taking connections from a tcp_connection_pool. Each request is one
+// line, and is done when the line comes back.
+
+#include <skstream/skpool.h>
+#include <skstream/skserver.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/time.h>
+#include <unistd.h>
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+static const std::string request = "get entity 4711";
+
+// Echo lines on each connection until it is closed.
+static void serve(tcp_socket_server & server, std::atomic<long> & accepted,
+                  std::atomic<bool> & stopping)
+{
+    std::vector<std::thread> handlers;
+    for (;;) {
+        SOCKET_TYPE sock = server.accept();
+        if (sock == INVALID_SOCKET || stopping) {
+            if (sock != INVALID_SOCKET) {
+                ::close(sock);
+            }
+            break;
+        }
+        ++accepted;
+        handlers.push_back(std::thread([sock]() {
+            tcp_socket_stream peer(sock);
+            peer.setNoDelay(true);
+            std::string line;
+            while (peer.readLine(line)) {
+                peer << line << std::endl;
+            }
+        }));
+    }
+    for (std::size_t i = 0; i < handlers.size(); ++i) {
+        handlers[i].join();
+    }
+}
+
+static bool exchange(tcp_socket_stream & stream)
+{
+    stream << request << std::endl;
+    std::string reply;
+    return stream.readLine(reply) && reply == request;
+}
+
+static void report(const char * name, std::vector<double> & times,
+                   long connections)
+{
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        total += times[i];
+    }
+    std::size_t count = times.size();
+    printf("%-8s %7lu requests  mean %8.2f us  p50 %8.2f us  "
+           "p99 %8.2f us  %6ld connections\n", name, (unsigned long)count,
+           total / count * 1000000., times[count / 2] * 1000000.,
+           times[count * 99 / 100] * 1000000., connections);
+}
+
+// Run count requests on each of clients threads, returning the latency
+// of each.
+template <typename Request>
+static std::vector<double> run(long count, int clients, Request r)
+{
+    std::vector<std::vector<double> > times(clients);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; ++c) {
+        threads.push_back(std::thread([&times, c, count, r]() {
+            times[c].reserve(count);
+            for (long i = 0; i < count; ++i) {
+                double start = now();
+                if (!r()) {
+                    fprintf(stderr, "request failed\n");
+                    exit(1);
+                }
+                times[c].push_back(now() - start);
+            }
+        }));
+    }
+    std::vector<double> all;
+    for (int c = 0; c < clients; ++c) {
+        threads[c].join();
+        all.insert(all.end(), times[c].begin(), times[c].end());
+    }
+    return all;
+}
+
+int main(int argc, char ** argv)
+{
+    long count = 5000;
+    int clients = 4;
+
+    if (argc > 1) {
+        count = strtol(argv[1], 0, 10);
+    }
+    if (argc > 2) {
+        clients = atoi(argv[2]);
+    }
+    if (count < 1) {
+        count = 1;
+    }
+    if (clients < 1) {
+        clients = 1;
+    }
+
+    tcp_socket_server server;
+    if (server.open(0) != 0) {
+        fprintf(stderr, "Could not listen\n");
+        return 1;
+    }
+    int port = server.getLocalPort();
+
+    std::atomic<long> accepted(0);
+    std::atomic<bool> stopping(false);
+    std::thread acceptor(serve, std::ref(server), std::ref(accepted),
+                         std::ref(stopping));
+
+    std::vector<double> times = run(count, clients, [port]() {
+        tcp_socket_stream stream(std::string("localhost"), port);
+        if (!stream.is_open()) {
+            return false;
+        }
+        stream.setNoDelay(true);
+        return exchange(stream);
+    });
+    report("connect", times, accepted);
+
+    long before = accepted;
+    {
+        socket_options options;
+        options.nodelay = 1;
+        tcp_connection_pool pool(clients);
+        pool.setOptions(options);
+        pool.start();
+        pool.prewarm("localhost", port, clients);
+
+        tcp_connection_pool * p = &pool;
+        times = run(count, clients, [p, port]() {
+            tcp_socket_stream * stream = p->acquire("localhost", port, 1000);
+            if (stream == 0) {
+                return false;
+            }
+            bool ok = exchange(*stream);
+            p->release(stream, ok);
+            return ok;
+        });
+        report("pooled", times, accepted - before);
+    }
+
+    // Wake the acceptor with one last connection.
+    stopping = true;
+    {
+        tcp_socket_stream last(std::string("localhost"), port);
+    }
+    acceptor.join();
+    return 0;
+}
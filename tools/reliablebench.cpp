@@ -0,0 +1,232 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+// Send a small message every millisecond and report how long messages
+// take to be delivered, over reliable_channel with packets dropped at
+// random, and over TCP. With -x no loss is injected, for comparing both
+// under loss added outside the program, such as with
+//   tc qdisc add dev lo root netem loss 5%
+
+#include <skstream/skreliable.h>
+#include <skstream/skserver.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const std::size_t MESSAGE_SIZE = 64;
+static const int INTERVAL = 1000;
+static const unsigned ENTITY_CHANNELS = 8;
+
+static long long now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+struct random_loss {
+    unsigned seed;
+    int percent;
+
+    random_loss(unsigned s, int p) : seed(s), percent(p) { }
+
+    bool operator()(const char *, std::size_t) {
+        seed = seed * 1103515245 + 12345;
+        return (int)((seed >> 16) % 1000) < percent * 10;
+    }
+};
+
+static void report(const char * name, int loss, std::vector<long long> & us,
+                   int count)
+{
+    if (us.empty()) {
+        printf("%-9s %3d%% nothing delivered\n", name, loss);
+        return;
+    }
+    std::sort(us.begin(), us.end());
+    printf("%-9s %3d%% %6zu/%d delivered  p50 %8.2f ms  p99 %8.2f ms  "
+           "max %8.2f ms\n", name, loss, us.size(), count,
+           us[us.size() / 2] / 1000., us[us.size() * 99 / 100] / 1000.,
+           us.back() / 1000.);
+}
+
+// Message i, stamped with the time it was sent.
+static std::string messageFor(long long stamp)
+{
+    std::string message(MESSAGE_SIZE, '\0');
+    std::memcpy(&message[0], &stamp, sizeof(stamp));
+    return message;
+}
+
+static long long stampOf(const char * data)
+{
+    long long stamp;
+    std::memcpy(&stamp, data, sizeof(stamp));
+    return stamp;
+}
+
+// channels is 1 for a single ordered channel, or several to spread
+// messages across ordered channels, or 0 for one unordered channel.
+static void runChannel(const char * name, int count, int loss,
+                       unsigned channels)
+{
+    udp_socket_stream a, b;
+    if (a.open(0, AF_INET) != 0 ||
+        !b.setTarget("127.0.0.1", a.getLocalPort()) ||
+        !b.setConnected(true)) {
+        fprintf(stderr, "Could not open sockets\n");
+        exit(1);
+    }
+    sockaddr_storage addr;
+    SOCKLEN addr_len = sizeof(addr);
+    ::getsockname(b.getSocket(), (sockaddr*)&addr, &addr_len);
+    a.setOutpeer(addr, addr_len);
+    ::fcntl(a.getSocket(), F_SETFL, O_NONBLOCK);
+    ::fcntl(b.getSocket(), F_SETFL, O_NONBLOCK);
+
+    reliable_channel sender(a), receiver(b);
+    if (channels == 0) {
+        sender.setMode(0, reliable_channel::RELIABLE);
+    }
+    if (loss > 0) {
+        sender.setLossModel(random_loss(1, loss));
+        receiver.setLossModel(random_loss(2, loss));
+    }
+    std::vector<long long> latencies;
+    receiver.setMessageHandler([&latencies](unsigned, const char * data,
+                                            std::size_t) {
+        latencies.push_back(now() - stampOf(data));
+    });
+
+    long long start = now();
+    long long next_send = start;
+    int sent = 0;
+    while ((int)latencies.size() < count) {
+        long long t = now();
+        if (sent < count && t >= next_send) {
+            sender.send(channels > 1 ? sent % channels : 0, messageFor(t));
+            ++sent;
+            next_send += INTERVAL;
+        }
+        if (sent == count && t - next_send > 10000000) {
+            break; // Give up on anything not delivered after 10s
+        }
+        reliable_channel::tick_type ms = (t - start) / 1000;
+        sender.update(ms);
+        receiver.receive(ms);
+        receiver.update(ms);
+        sender.receive(ms);
+
+        long long wait = std::min<long long>(next_send - now(), 1000);
+        reliable_channel::tick_type timeout =
+              std::min(sender.nextTimeout(ms), receiver.nextTimeout(ms));
+        if (timeout <= ms) {
+            wait = 0;
+        }
+        if (wait > 0) {
+            struct pollfd fds[2] = { { a.getSocket(), POLLIN, 0 },
+                                     { b.getSocket(), POLLIN, 0 } };
+            ::poll(fds, 2, (int)((wait + 999) / 1000));
+        }
+    }
+    report(name, loss, latencies, count);
+}
+
+static void runTcp(int count)
+{
+    tcp_socket_server server;
+    if (server.open(0) != 0) {
+        fprintf(stderr, "Could not listen\n");
+        exit(1);
+    }
+    tcp_socket_stream a(std::string("localhost"),
+                        server.getLocalPort());
+    tcp_socket_stream b(server.accept());
+    a.setNoDelay(true);
+
+    std::vector<long long> latencies;
+    std::string partial;
+    long long next_send = now();
+    int sent = 0;
+    char buffer[4096];
+    while ((int)latencies.size() < count) {
+        long long t = now();
+        if (sent < count && t >= next_send) {
+            a << messageFor(t) << std::flush;
+            ++sent;
+            next_send += INTERVAL;
+        }
+        struct pollfd pfd = { b.getSocket(), POLLIN, 0 };
+        long long wait = std::max<long long>(next_send - now(), 0);
+        if (::poll(&pfd, 1, sent < count ? (int)(wait / 1000) : 100) <= 0) {
+            if (sent == count) {
+                break;
+            }
+            continue;
+        }
+        ssize_t len = ::recv(b.getSocket(), buffer, sizeof(buffer), 0);
+        if (len <= 0) {
+            break;
+        }
+        partial.append(buffer, len);
+        std::size_t offset = 0;
+        for (; partial.size() - offset >= MESSAGE_SIZE;
+             offset += MESSAGE_SIZE) {
+            latencies.push_back(now() - stampOf(partial.data() + offset));
+        }
+        partial.erase(0, offset);
+    }
+    report("tcp", 0, latencies, count);
+}
+
+int main(int argc, char ** argv)
+{
+    int count = 2000;
+    bool external = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-x") == 0) {
+            external = true;
+        } else {
+            count = strtol(argv[i], 0, 10);
+        }
+    }
+
+    static const int losses[] = { 0, 1, 5, 10 };
+    for (std::size_t l = 0; l < sizeof(losses) / sizeof(int); ++l) {
+        int loss = external ? 0 : losses[l];
+        runChannel("ordered", count, loss, 1);
+        runChannel("entities", count, loss, ENTITY_CHANNELS);
+        runChannel("unordered", count, loss, 0);
+        if (external) {
+            break;
+        }
+    }
+    runTcp(count);
+
+    return 0;
+}
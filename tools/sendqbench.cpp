@@ -0,0 +1,154 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Compare sending from 8 threads to one stream through a mutex with
+// sending through a stream_send_queue drained by a reactor thread.
+
+#include <skstream/sksendqueue.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+static const int PRODUCERS = 8;
+static const int MESSAGE_LENGTH = 64;
+
+class bench_stream : public stream_socket_stream {
+public:
+  explicit bench_stream(SOCKET_TYPE sock) : stream_socket_stream(sock) { }
+};
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+// Read and discard the given number of bytes.
+static void consume(int fd, long long total)
+{
+    char buf[0x10000];
+    while (total > 0) {
+        ssize_t len = ::read(fd, buf, sizeof(buf));
+        if (len <= 0) {
+            fprintf(stderr, "Short read\n");
+            exit(1);
+        }
+        total -= len;
+    }
+}
+
+static void report(const char * name, long messages, double elapsed)
+{
+    printf("%-8s %10ld messages %8.3f s %12.0f messages/s %8.1f MB/s\n",
+           name, messages, elapsed, messages / elapsed,
+           messages * (double)MESSAGE_LENGTH / elapsed / 1000000.);
+}
+
+static void make_pair(int fds[2])
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        exit(1);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    long count = 200000;
+
+    if (argc > 1) {
+        count = strtol(argv[1], 0, 10);
+    }
+
+    const long messages = count * PRODUCERS;
+    const long long total = (long long)messages * MESSAGE_LENGTH;
+    const std::string message(MESSAGE_LENGTH - 1, 'x');
+
+    {
+        // Every thread writes to the stream while holding a lock.
+        int fds[2];
+        make_pair(fds);
+        bench_stream stream(fds[0]);
+        std::mutex lock;
+
+        double start = now();
+        std::thread reader(consume, fds[1], total);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.push_back(std::thread([&]() {
+                for (long i = 0; i < count; ++i) {
+                    std::string m = message + '\n';
+                    std::lock_guard<std::mutex> guard(lock);
+                    stream << m;
+                }
+            }));
+        }
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers[p].join();
+        }
+        stream.flush();
+        reader.join();
+        report("mutex", messages, now() - start);
+        ::close(fds[1]);
+    }
+
+    {
+        // Threads push onto the queue, and the reactor thread writes.
+        int fds[2];
+        make_pair(fds);
+        bench_stream stream(fds[0]);
+        stream.setNonBlocking(true);
+        socket_reactor reactor;
+        reactor.addStream(&stream, 0, [](basic_socket_poll::poll_type) { });
+        stream_send_queue * queue = new stream_send_queue(stream, reactor);
+
+        double start = now();
+        std::thread reader(consume, fds[1], total);
+        std::thread network([&reactor]() { reactor.run(); });
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.push_back(std::thread([&]() {
+                for (long i = 0; i < count; ++i) {
+                    queue->send(message + '\n');
+                }
+            }));
+        }
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers[p].join();
+        }
+        reader.join();
+        report("queue", messages, now() - start);
+
+        reactor.post([&]() {
+            delete queue;
+            reactor.remove(&stream);
+            reactor.stop();
+        });
+        network.join();
+        ::close(fds[1]);
+    }
+
+    return 0;
+}
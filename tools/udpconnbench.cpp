@@ -0,0 +1,187 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+// Send bursts of small datagrams over loopback, first from unconnected
+// sockets with sendto() and then from connected ones with send(), and
+// receive them from several peers on one server socket and then on a
+// connected socket per peer, reporting the packet rate of each.
+
+#include <skstream/skstream.h>
+#include <skstream/skserver.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/time.h>
+
+static const std::size_t DATAGRAM_SIZE = 64;
+static const int BURST = 32;
+static const int PEERS = 4;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+// Read up to count datagrams from sock, giving up if none come for 100ms.
+static long drain(SOCKET_TYPE sock, int count)
+{
+    char buffer[DATAGRAM_SIZE];
+    long received = 0;
+    while (received < count) {
+        if (::recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT) >= 0) {
+            ++received;
+            continue;
+        }
+        struct pollfd pfd = { sock, POLLIN, 0 };
+        if (::poll(&pfd, 1, 100) <= 0) {
+            break;
+        }
+    }
+    return received;
+}
+
+static void report(const char * name, long sent, long received,
+                   double elapsed)
+{
+    printf("%-10s %10ld sent %10ld received %8.3f s %12.0f packets/s\n",
+           name, sent, received, elapsed, received / elapsed);
+}
+
+static void findServer(udp_socket_server & server, const char *& host,
+                       int & port)
+{
+    if (!server.is_open()) {
+        fprintf(stderr, "Could not open server\n");
+        exit(1);
+    }
+    host = server.getFamily() == AF_INET6 ? "::1" : "127.0.0.1";
+    port = server.getLocalPort();
+}
+
+// One sender to one receiver, connected or not.
+static void runSender(const char * name, long bursts, bool connected)
+{
+    udp_socket_server receiver(0, udp_socket_server::SK_SRV_NONE);
+    const char * host;
+    int port;
+    findServer(receiver, host, port);
+
+    udp_socket_stream sender;
+    sender.setConnected(connected);
+    if (!sender.setTarget(host, port)) {
+        fprintf(stderr, "Could not open sender\n");
+        exit(1);
+    }
+
+    const std::string datagram(DATAGRAM_SIZE, 'x');
+    long received = 0;
+
+    double start = now();
+    for (long b = 0; b < bursts; ++b) {
+        for (int i = 0; i < BURST; ++i) {
+            sender.sendDatagram(datagram);
+        }
+        received += drain(receiver.getSocket(), BURST);
+    }
+    report(name, bursts * BURST, received, now() - start);
+}
+
+// Several senders to one server port, received on the server socket or
+// on a connected socket for each peer.
+static void runServer(const char * name, long bursts, bool per_peer)
+{
+    udp_socket_server server(0, udp_socket_server::SK_SRV_REUSE |
+                                udp_socket_server::SK_SRV_REUSEPORT);
+    const char * host;
+    int port;
+    findServer(server, host, port);
+
+    std::vector<udp_socket_stream *> senders, peers;
+    for (int p = 0; p < PEERS; ++p) {
+        udp_socket_stream * sender = new udp_socket_stream;
+        sender->setConnected(true);
+        if (!sender->setTarget(host, port)) {
+            fprintf(stderr, "Could not open sender\n");
+            exit(1);
+        }
+        senders.push_back(sender);
+        if (!per_peer) {
+            continue;
+        }
+        sockaddr_storage addr;
+        SOCKLEN addr_len = sizeof(addr);
+        ::getsockname(sender->getSocket(), (sockaddr*)&addr, &addr_len);
+        udp_socket_stream * peer = new udp_socket_stream;
+        if (peer->open(server, addr, addr_len) != 0) {
+            fprintf(stderr, "Could not open peer socket: %s\n",
+                    strerror(peer->getLastError()));
+            exit(1);
+        }
+        peers.push_back(peer);
+    }
+
+    const std::string datagram(DATAGRAM_SIZE, 'x');
+    long received = 0;
+
+    double start = now();
+    for (long b = 0; b < bursts; ++b) {
+        for (int p = 0; p < PEERS; ++p) {
+            for (int i = 0; i < BURST / PEERS; ++i) {
+                senders[p]->sendDatagram(datagram);
+            }
+        }
+        if (per_peer) {
+            for (int p = 0; p < PEERS; ++p) {
+                received += drain(peers[p]->getSocket(), BURST / PEERS);
+            }
+        } else {
+            received += drain(server.getSocket(), BURST);
+        }
+    }
+    report(name, bursts * BURST, received, now() - start);
+
+    for (std::size_t i = 0; i < senders.size(); ++i) {
+        delete senders[i];
+    }
+    for (std::size_t i = 0; i < peers.size(); ++i) {
+        delete peers[i];
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    long bursts = 20000;
+
+    if (argc > 1) {
+        bursts = strtol(argv[1], 0, 10);
+    }
+
+    runSender("sendto", bursts, false);
+    runSender("connected", bursts, true);
+    runServer("shared", bursts, false);
+    runServer("per-peer", bursts, true);
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Send bursts of equal-sized datagrams over loopback, one system call
+// each and then with UDP segmentation and receive offload, reporting the
+// packet rate and the CPU time used per packet.
+
+#include <skstream/skstream.h>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+static const std::size_t DATAGRAM_SIZE = 1200;
+static const int BURST = 32;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+static double cpu()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000. +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.;
+}
+
+static void run(const char * name, long bursts, bool offload)
+{
+    udp_socket_stream receiver;
+    if (receiver.open(0) != 0) {
+        fprintf(stderr, "Could not open receiver\n");
+        exit(1);
+    }
+    receiver.setReceiveBufferSize(1 << 22);
+    receiver.setTimeout(0, 100000);
+    if (offload && !receiver.setReceiveOffload(true)) {
+        printf("%-8s receive offload not supported here\n", name);
+    }
+
+    udp_socket_stream sender;
+    if (!sender.setTarget(receiver.getFamily() == AF_INET6 ?
+                          "::1" : "127.0.0.1", receiver.getLocalPort())) {
+        fprintf(stderr, "Could not open sender\n");
+        exit(1);
+    }
+    if (offload) {
+        sender.setSegmentSize(DATAGRAM_SIZE);
+    }
+
+    const std::string datagram(DATAGRAM_SIZE, 'x');
+    std::string buffer(DATAGRAM_SIZE, '\0');
+    std::streambuf * sb = receiver.rdbuf();
+    long received = 0;
+
+    double start = now();
+    double start_cpu = cpu();
+    for (long b = 0; b < bursts; ++b) {
+        for (int i = 0; i < BURST; ++i) {
+            sender.write(datagram.data(), datagram.size());
+            if (!offload) {
+                sender.flush();
+            }
+        }
+        if (offload) {
+            sender.flush();
+        }
+        for (int i = 0; i < BURST; ++i) {
+            if (sb->sgetc() == std::streambuf::traits_type::eof()) {
+                break;
+            }
+            std::streamsize len = sb->in_avail();
+            sb->sgetn(&buffer[0], len);
+            if (len == (std::streamsize)DATAGRAM_SIZE) {
+                ++received;
+            }
+            receiver.clear();
+        }
+    }
+    double elapsed = now() - start;
+    double used = cpu() - start_cpu;
+
+    long sent = bursts * BURST;
+    printf("%-8s %10ld sent %10ld received %8.3f s %12.0f packets/s "
+           "%8.3f us CPU/packet\n", name, sent, received, elapsed,
+           received / elapsed, used * 1000000. / sent);
+}
+
+int main(int argc, char ** argv)
+{
+    long bursts = 20000;
+
+    if (argc > 1) {
+        bursts = strtol(argv[1], 0, 10);
+    }
+
+    run("plain", bursts, false);
+    run("offload", bursts, true);
+
+    return 0;
+}
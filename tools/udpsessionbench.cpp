@@ -0,0 +1,120 @@
+// skstream - Portable C++ classes for IP(sockets) applications.
+// Copyright (C) 2026 The WorldForge Project
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+// Sort datagrams from 50000 simulated peers into sessions, with
+// udp_session_table and with a std::map keyed on the address as a string,
+// reporting the time per datagram. No sockets are used, so this measures
+// the lookups alone.
+
+#include <skstream/skudpsession.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/time.h>
+
+static const unsigned PEERS = 50000;
+static const std::size_t BATCH = 64;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+static void report(const char * name, long datagrams, double elapsed)
+{
+    printf("%-8s %10ld datagrams %8.3f s %8.1f ns/datagram\n",
+           name, datagrams, elapsed, elapsed * 1e9 / datagrams);
+}
+
+int main(int argc, char ** argv)
+{
+    long datagrams = 10000000;
+
+    if (argc > 1) {
+        datagrams = strtol(argv[1], 0, 10);
+    }
+
+    std::vector<sockaddr_storage> peers(PEERS);
+    for (unsigned n = 0; n < PEERS; ++n) {
+        std::memset(&peers[n], 0, sizeof(sockaddr_storage));
+        sockaddr_in6 & in = (sockaddr_in6 &)peers[n];
+        in.sin6_family = AF_INET6;
+        in.sin6_port = htons(1024 + n % 60000);
+        in.sin6_addr.s6_addr[0] = 0x20;
+        in.sin6_addr.s6_addr[1] = 0x01;
+        in.sin6_addr.s6_addr[13] = n >> 16;
+        in.sin6_addr.s6_addr[14] = n >> 8;
+        in.sin6_addr.s6_addr[15] = n;
+    }
+
+    // The order peers are heard from, fixed so both runs see the same.
+    std::vector<unsigned> order(1 << 20);
+    unsigned seed = 12345;
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        seed = seed * 1103515245 + 12345;
+        order[i] = (seed >> 8) % PEERS;
+    }
+
+    const char payload[32] = "";
+    long sessions_seen = 0;
+
+    udp_session_table table(1000);
+    std::vector<udp_session_table::datagram> batch(BATCH);
+    udp_session_table::batch_handler h =
+        [&sessions_seen](udp_session_table::session_id,
+                         const udp_session_table::datagram *, std::size_t) {
+            ++sessions_seen;
+        };
+    double start = now();
+    for (long d = 0; d < datagrams; d += BATCH) {
+        for (std::size_t i = 0; i < BATCH; ++i) {
+            const sockaddr_storage & peer =
+                  peers[order[(d + i) & (order.size() - 1)]];
+            batch[i].data = payload;
+            batch[i].size = sizeof(payload);
+            batch[i].peer = &peer;
+            batch[i].peer_size = sizeof(sockaddr_in6);
+        }
+        // A millisecond passes every 1024 batches.
+        table.dispatch(&batch[0], BATCH, d / (BATCH * 1024), h);
+        table.expire(d / (BATCH * 1024));
+    }
+    report("table", datagrams, now() - start);
+    printf("%-8s %10zu sessions %10ld batch calls\n", "", table.size(),
+           sessions_seen);
+
+    std::map<std::string, long> sessions;
+    long total = 0;
+    start = now();
+    for (long d = 0; d < datagrams; ++d) {
+        const sockaddr_storage & peer = peers[order[d & (order.size() - 1)]];
+        std::string key((const char *)&peer, sizeof(sockaddr_in6));
+        total += ++sessions[key];
+    }
+    report("map", datagrams, now() - start);
+    printf("%-8s %10zu sessions\n", "", sessions.size());
+
+    return total == 0;
+}